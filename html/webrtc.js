@@ -373,7 +373,25 @@
     ws.send(message);
   }
 
+  // Reports the time from the offer to the first frame on screen to Momo
+  // (the session_start metrics)
+  function watchFirstFrame(startedAt) {
+    const report = () => {
+      const ms = Math.round(performance.now() - startedAt);
+      console.log('first frame after ' + ms + ' ms');
+      if (ws && ws.readyState === WebSocket.OPEN) {
+        ws.send(JSON.stringify({ type: 'first_frame', ms: ms }));
+      }
+    };
+    if ('requestVideoFrameCallback' in HTMLVideoElement.prototype) {
+      remoteVideo.requestVideoFrameCallback(report);
+    } else {
+      remoteVideo.addEventListener('loadeddata', report, { once: true });
+    }
+  }
+
   async function makeOffer() {
+    watchFirstFrame(performance.now());
     peerConnection = prepareNewConnection();
     updateUiState();
     try {
@@ -611,6 +611,9 @@ def _build(args):
             cmake_args.append("-DUSE_FAKE_CAPTURE_DEVICE=ON")
             cmake_args.append(f"-DBlend2D_ROOT={cmake_path(os.path.join(install_dir, 'blend2d'))}")
 
+        if args.bench:
+            cmake_args.append("-DMOMO_BUILD_BENCH=ON")
+
         cmd(["cmake", BASE_DIR] + cmake_args)
         cmd(
             [
@@ -704,6 +707,7 @@ def main():
     add_webrtc_build_arguments(bp)
     bp.add_argument("--package", action="store_true")
     bp.add_argument("--disable-cuda", action="store_true")
+    bp.add_argument("--bench", action="store_true", help="Also build the benchmark tools")
     bp.add_argument(
         "--disable-fake-capture-device",
         action="store_true",
@@ -7,6 +7,7 @@
 // WebRTC
 #include <api/peer_connection_interface.h>
 #include <api/rtp_transceiver_interface.h>
+#include <rtc_base/time_utils.h>
 
 #include <algorithm>
 #include <cctype>
@@ -15,6 +16,7 @@
 #include <string>
 #include <vector>
 
+#include "metrics/metrics_registry.h"
 #include "momo_version.h"
 #include "ssl_verifier.h"
 #include "url_parts.h"
@@ -239,6 +241,10 @@ std::shared_ptr<RTCConnection> CreateRTCConnection(
   webrtc::PeerConnectionInterface::RTCConfiguration rtc_config;
 
   rtc_config.servers = ice_servers;
+  // Candidates of a network that comes up later (Wi-Fi handover) are
+  // gathered too, for the ICE restart to use
+  rtc_config.continual_gathering_policy =
+      webrtc::PeerConnectionInterface::GATHER_CONTINUALLY;
   std::shared_ptr<RTCConnection> connection =
       manager->CreateConnection(rtc_config, sender);
   if (!connection) {
@@ -282,7 +288,12 @@ AyameClient::AyameClient(boost::asio::io_context& ioc,
     : ioc_(ioc),
       manager_(manager),
       config_(std::move(config)),
-      watchdog_(ioc, std::bind(&AyameClient::OnWatchdogExpired, this)) {
+      watchdog_(ioc, std::bind(&AyameClient::OnWatchdogExpired, this)),
+      // When ICE does not come back, close the WebSocket and reconnect as
+      // before
+      ice_recovery_(ioc,
+                    std::bind(&AyameClient::RestartIce, this),
+                    std::bind(&AyameClient::Close, this)) {
   Reset();
 }
 
@@ -293,8 +304,10 @@ AyameClient::~AyameClient() {
 }
 
 void AyameClient::Reset() {
+  ice_recovery_.Reset();
   connection_ = nullptr;
   is_send_offer_ = false;
+  is_offerer_ = false;
   has_is_exist_user_flag_ = false;
   ice_servers_.clear();
 
@@ -343,6 +356,28 @@ void AyameClient::ReconnectAfter() {
   retry_count_++;
 }
 
+bool AyameClient::RestartIce() {
+  // Only the side that made the first offer restarts, the other side answers
+  // its offer on the existing connection. Without the isExistUser flag both
+  // sides make offers and an offer makes a new connection.
+  if (!connection_ || !ws_ || !is_offerer_ || !has_is_exist_user_flag_) {
+    return false;
+  }
+  auto self = shared_from_this();
+  connection_->RestartIce([self](webrtc::SessionDescriptionInterface* desc) {
+    std::string sdp;
+    desc->ToString(&sdp);
+    boost::asio::post(self->ioc_, [self, sdp]() {
+      if (!self->connection_) {
+        return;
+      }
+      boost::json::value json_message = {{"type", "offer"}, {"sdp", sdp}};
+      self->ws_->WriteText(boost::json::serialize(json_message));
+    });
+  });
+  return true;
+}
+
 void AyameClient::OnWatchdogExpired() {
   RTC_LOG(LS_WARNING) << __FUNCTION__;
 
@@ -435,6 +470,7 @@ void AyameClient::OnRead(boost::system::error_code ec,
   auto json_message = boost::json::parse(text);
   const std::string type = json_message.at("type").as_string().c_str();
   if (type == "accept") {
+    accepted_ms_ = webrtc::TimeMillis();
     ice_servers_ =
         CreateIceServersFromConfig(json_message, config_.no_google_stun);
     connection_ =
@@ -465,9 +501,11 @@ void AyameClient::OnRead(boost::system::error_code ec,
     if (is_exist_user) {
       RTC_LOG(LS_INFO) << __FUNCTION__ << ": exist_user";
       is_send_offer_ = true;
+      is_offerer_ = true;
       connection_->CreateOffer(on_create_offer);
     } else if (!has_is_exist_user_flag_) {
       // If the flag is not present, send it anyway
+      is_offerer_ = true;
       connection_->CreateOffer(on_create_offer);
     }
   } else if (type == "offer") {
@@ -522,6 +560,7 @@ void AyameClient::OnRead(boost::system::error_code ec,
     DoSendPong();
   } else if (type == "bye") {
     RTC_LOG(LS_INFO) << __FUNCTION__ << ": bye";
+    ice_recovery_.Reset();
     connection_ = nullptr;
     Close();
   }
@@ -559,17 +598,21 @@ void AyameClient::DoIceConnectionStateChange(
   RTC_LOG(LS_INFO) << __FUNCTION__ << ": newState="
                    << Util::IceConnectionStateToString(new_state);
 
+  // A disconnected or failed connection is restarted first. If that does not
+  // bring it back, ice_recovery_ calls Close(), and OnClose(); ->
+  // ReconnectAfter(); -> OnWatchdogExpired(); reconnect the WebSocket.
+  ice_recovery_.OnIceConnectionStateChange(new_state);
   switch (new_state) {
     case webrtc::PeerConnectionInterface::IceConnectionState::
         kIceConnectionConnected:
       retry_count_ = 0;
       watchdog_.Enable(kConnectedWatchdogTimeoutSeconds);
-      break;
-    // If the ice connection state fails, call Close(); to close the WebSocket connection
-    case webrtc::PeerConnectionInterface::IceConnectionState::
-        kIceConnectionFailed:
-      // When the WebSocket is closed by Close();, the functions OnClose(); -> ReconnectAfter(); -> OnWatchdogExpired(); are called in order, and the WebSocket reconnection is performed
-      Close();
+      if (accepted_ms_ != 0) {
+        MetricsRegistry::Instance().Set(
+            "session_start", "ice_connected_ms",
+            static_cast<double>(webrtc::TimeMillis() - accepted_ms_));
+        accepted_ms_ = 0;
+      }
       break;
     default:
       break;
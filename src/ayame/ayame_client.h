@@ -14,6 +14,7 @@
 #include <boost/json.hpp>
 
 #include "metrics/stats_collector.h"
+#include "rtc/ice_recovery.h"
 #include "rtc/rtc_manager.h"
 #include "rtc/rtc_message_sender.h"
 #include "url_parts.h"
@@ -71,6 +72,7 @@ class AyameClient : public std::enable_shared_from_this<AyameClient>,
  private:
   void ReconnectAfter();
   void OnWatchdogExpired();
+  bool RestartIce();
 
  private:
   void DoRead();
@@ -112,8 +114,13 @@ class AyameClient : public std::enable_shared_from_this<AyameClient>,
       webrtc::PeerConnectionInterface::IceConnectionState::kIceConnectionNew;
 
   WatchDog watchdog_;
+  IceRecovery ice_recovery_;
+  // Time of the "accept", for the "session_start" metrics
+  int64_t accepted_ms_ = 0;
 
   bool is_send_offer_ = false;
+  // This side made the first offer, and makes the ICE restart offers
+  bool is_offerer_ = false;
   bool has_is_exist_user_flag_ = false;
 
   webrtc::PeerConnectionInterface::IceServers ice_servers_;
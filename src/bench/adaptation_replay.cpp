@@ -0,0 +1,165 @@
+// momo_adaptreplay: runs DesktopAdaptationPolicy over recorded stats.
+//
+// The input is either a log of momo --network-adaptation, from which the
+// "DesktopAdaptation sample: {json}" lines are taken, or a file with one
+// sample JSON per line. Without an input a synthetic congestion scenario is
+// replayed. Prints every level change and the time spent on each level, so a
+// change of the policy can be compared on the same traces.
+
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <optional>
+#include <string>
+#include <vector>
+
+// CLI11
+#include <CLI/CLI.hpp>
+
+// Boost
+#include <boost/json.hpp>
+
+#include "rtc/desktop_adaptation_policy.h"
+
+namespace {
+
+constexpr char kSamplePrefix[] = "DesktopAdaptation sample: ";
+
+std::optional<AdaptationSample> ParseLine(const std::string& line) {
+  std::string json;
+  auto pos = line.find(kSamplePrefix);
+  if (pos != std::string::npos) {
+    json = line.substr(pos + sizeof(kSamplePrefix) - 1);
+  } else if (!line.empty() && line[0] == '{') {
+    json = line;
+  } else {
+    return std::nullopt;
+  }
+  boost::system::error_code ec;
+  auto value = boost::json::parse(json, ec);
+  if (ec) {
+    return std::nullopt;
+  }
+  return AdaptationSample::FromJson(value);
+}
+
+// 30s of a clean link, 20s of 8% loss, 30s of a queue building up (RTT +250ms)
+// with bandwidth limitation, then 90s of a clean link again
+std::vector<AdaptationSample> CongestionScenario() {
+  std::vector<AdaptationSample> samples;
+  for (int t = 0; t < 170; t++) {
+    AdaptationSample sample;
+    sample.time_s = t;
+    sample.rtt_ms = 40;
+    sample.loss_fraction = 0.0;
+    sample.available_bitrate_bps = 3000000;
+    sample.sent_bitrate_bps = 1500000;
+    sample.encode_ms = 6;
+    sample.fps = 30;
+    if (t >= 30 && t < 50) {
+      sample.loss_fraction = 0.08;
+      sample.available_bitrate_bps = 900000;
+      sample.sent_bitrate_bps = 1000000;
+    } else if (t >= 50 && t < 80) {
+      sample.rtt_ms = 290;
+      sample.available_bitrate_bps = 600000;
+      sample.sent_bitrate_bps = 550000;
+      sample.bandwidth_limited = true;
+    }
+    samples.push_back(sample);
+  }
+  return samples;
+}
+
+}  // namespace
+
+int main(int argc, char* argv[]) {
+  std::string input;
+  int max_framerate = 30;
+  int max_changes = -1;
+  bool json = false;
+
+  CLI::App app("momo_adaptreplay - replay stats through the network adaptation "
+               "policy");
+  app.add_option("--input", input,
+                 "momo log or JSON lines of samples (default: synthetic "
+                 "congestion scenario)")
+      ->check(CLI::ExistingFile);
+  app.add_option("--framerate", max_framerate, "Same as momo --framerate")
+      ->check(CLI::Range(1, 60));
+  app.add_option("--max-changes", max_changes,
+                 "Exit with 1 if the level changes more often than this");
+  app.add_flag("--json", json, "Print the decision of every sample as JSON");
+  CLI11_PARSE(app, argc, argv);
+
+  std::vector<AdaptationSample> samples;
+  if (input.empty()) {
+    samples = CongestionScenario();
+  } else {
+    std::ifstream ifs(input);
+    std::string line;
+    while (std::getline(ifs, line)) {
+      if (auto sample = ParseLine(line)) {
+        samples.push_back(*sample);
+      }
+    }
+  }
+  if (samples.empty()) {
+    std::cerr << "No samples in " << input << std::endl;
+    return 2;
+  }
+
+  DesktopAdaptationPolicy policy({max_framerate});
+  const auto& levels = policy.levels();
+  std::map<int, double> seconds_per_level;
+  int changes = 0;
+  int level = 0;
+  double last_time_s = samples.front().time_s;
+  for (const auto& sample : samples) {
+    seconds_per_level[level] += sample.time_s - last_time_s;
+    last_time_s = sample.time_s;
+
+    auto decision = policy.OnSample(sample);
+    if (json) {
+      boost::json::object obj = sample.ToJson();
+      obj["level"] = decision.level;
+      obj["scale_resolution_down_by"] = decision.scale_resolution_down_by;
+      obj["max_framerate"] = decision.max_framerate;
+      if (decision.max_bitrate_bps) {
+        obj["max_bitrate_bps"] = *decision.max_bitrate_bps;
+      }
+      obj["reason"] = decision.reason;
+      std::cout << boost::json::serialize(obj) << std::endl;
+    } else if (decision.changed) {
+      std::printf("%8.1fs  level %d  scale %.2f  %2d fps  bitrate cap %s  %s\n",
+                  sample.time_s, decision.level,
+                  decision.scale_resolution_down_by, decision.max_framerate,
+                  decision.max_bitrate_bps
+                      ? (std::to_string(*decision.max_bitrate_bps / 1000) +
+                         "kbps")
+                            .c_str()
+                      : "none",
+                  decision.reason.c_str());
+    }
+    if (decision.level != level) {
+      changes++;
+    }
+    level = decision.level;
+  }
+
+  if (!json) {
+    std::printf("\n%zu samples, %d level changes\n", samples.size(), changes);
+    for (int i = 0; i < static_cast<int>(levels.size()); i++) {
+      std::printf("  level %d (scale %.2f, %2d fps): %.0fs\n", i,
+                  levels[i].scale_resolution_down_by, levels[i].max_framerate,
+                  seconds_per_level[i]);
+    }
+  }
+  if (max_changes >= 0 && changes > max_changes) {
+    std::cerr << changes << " level changes, more than " << max_changes
+              << std::endl;
+    return 1;
+  }
+  return 0;
+}
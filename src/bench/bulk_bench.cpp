@@ -0,0 +1,491 @@
+// momo_bulkbench: sends a file over the "bulk" DataChannel between two peer
+// connections in this process, no signaling server needed.
+//
+// Both ends are an RTCManager without audio and video devices, with the same
+// data managers as momo. The offer, the answer and the ICE candidates are
+// handed over directly. While the file goes through, small messages are sent
+// on "input-reliable" at a fixed rate to see how long input waits behind the
+// transfer. A first attempt is cancelled half way to check that the second
+// one goes on from there.
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+// CLI11
+#include <CLI/CLI.hpp>
+
+// Boost
+#include <boost/filesystem.hpp>
+#include <boost/json.hpp>
+
+// WebRTC
+#include <api/peer_connection_interface.h>
+#include <rtc_base/logging.h>
+
+#include "remote/data_channel/bulk_data_manager.h"
+#include "remote/data_channel/input_data_manager.h"
+#include "remote/proto/parser.h"
+#include "rtc/rtc_connection.h"
+#include "rtc/rtc_manager.h"
+#include "rtc/rtc_message_sender.h"
+
+namespace {
+
+using remote::data_channel::BulkDataManager;
+using remote::data_channel::BulkTransferResult;
+using remote::data_channel::InputDataManager;
+
+struct BenchConfig {
+  int size_mb = 256;
+  // Percent of the file after which the first attempt is cancelled (0: none)
+  int resume_at = 50;
+  int input_hz = 250;
+  std::string dir;
+  bool json = false;
+};
+
+int64_t NowNs() {
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(
+             std::chrono::steady_clock::now().time_since_epoch())
+      .count();
+}
+
+double Percentile(std::vector<double> values, double p) {
+  if (values.empty()) {
+    return 0.0;
+  }
+  std::sort(values.begin(), values.end());
+  const size_t index = static_cast<size_t>(
+      std::lround(p * static_cast<double>(values.size() - 1)));
+  return values[std::min(index, values.size() - 1)];
+}
+
+// Hands the ICE candidates of one end to the other, holding them until the
+// other end has the remote description
+class LoopbackSender : public RTCMessageSender {
+ public:
+  void OnIceConnectionStateChange(
+      webrtc::PeerConnectionInterface::IceConnectionState new_state) override {
+    (void)new_state;
+  }
+  void OnIceCandidate(const std::string sdp_mid,
+                      const int sdp_mlineindex,
+                      const std::string sdp) override {
+    std::shared_ptr<RTCConnection> peer;
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      if (!peer_) {
+        pending_.push_back({sdp_mid, sdp_mlineindex, sdp});
+        return;
+      }
+      peer = peer_;
+    }
+    peer->AddIceCandidate(sdp_mid, sdp_mlineindex, sdp);
+  }
+
+  void SetPeer(std::shared_ptr<RTCConnection> peer) {
+    std::vector<Candidate> pending;
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      peer_ = peer;
+      pending.swap(pending_);
+    }
+    for (const auto& c : pending) {
+      peer->AddIceCandidate(c.mid, c.mlineindex, c.sdp);
+    }
+  }
+ private:
+  struct Candidate {
+    std::string mid;
+    int mlineindex;
+    std::string sdp;
+  };
+  std::mutex mutex_;
+  std::shared_ptr<RTCConnection> peer_;
+  std::vector<Candidate> pending_;
+};
+
+// One end of the call
+struct Peer {
+  std::unique_ptr<RTCManager> manager;
+  std::shared_ptr<BulkDataManager> bulk;
+  std::shared_ptr<InputDataManager> input;
+  LoopbackSender sender;
+  std::shared_ptr<RTCConnection> connection;
+};
+
+std::unique_ptr<Peer> CreatePeer() {
+  auto peer = std::make_unique<Peer>();
+  RTCManagerConfig config;
+  config.no_video_device = true;
+  config.no_audio_device = true;
+  peer->manager.reset(new RTCManager(std::move(config), nullptr, nullptr));
+  peer->bulk = std::make_shared<BulkDataManager>();
+  peer->input = std::make_shared<InputDataManager>();
+  peer->manager->AddDataManager(peer->bulk);
+  peer->manager->AddDataManager(peer->input);
+  webrtc::PeerConnectionInterface::RTCConfiguration rtc_config;
+  peer->connection = peer->manager->CreateConnection(rtc_config, &peer->sender);
+  return peer;
+}
+
+template <class T>
+class Waitable {
+ public:
+  void Set(T value) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    value_ = std::move(value);
+    set_ = true;
+    cv_.notify_all();
+  }
+  bool Wait(T* out, std::chrono::seconds timeout) {
+    std::unique_lock<std::mutex> lock(mutex_);
+    if (!cv_.wait_for(lock, timeout, [this] { return set_; })) {
+      return false;
+    }
+    *out = value_;
+    set_ = false;
+    return true;
+  }
+
+ private:
+  std::mutex mutex_;
+  std::condition_variable cv_;
+  T value_{};
+  bool set_ = false;
+};
+
+bool Connect(Peer& offerer, Peer& answerer) {
+  Waitable<std::string> offer;
+  offerer.connection->CreateOffer(
+      [&offer](webrtc::SessionDescriptionInterface* desc) {
+        std::string sdp;
+        desc->ToString(&sdp);
+        offer.Set(sdp);
+      });
+  std::string sdp;
+  if (!offer.Wait(&sdp, std::chrono::seconds(10))) {
+    return false;
+  }
+  Waitable<bool> offer_set;
+  answerer.connection->SetOffer(sdp, [&offer_set]() { offer_set.Set(true); });
+  bool ok = false;
+  if (!offer_set.Wait(&ok, std::chrono::seconds(10))) {
+    return false;
+  }
+  offerer.sender.SetPeer(answerer.connection);
+  Waitable<std::string> answer;
+  answerer.connection->CreateAnswer(
+      [&answer](webrtc::SessionDescriptionInterface* desc) {
+        std::string sdp;
+        desc->ToString(&sdp);
+        answer.Set(sdp);
+      });
+  if (!answer.Wait(&sdp, std::chrono::seconds(10))) {
+    return false;
+  }
+  Waitable<bool> answer_set;
+  offerer.connection->SetAnswer(sdp,
+                                [&answer_set]() { answer_set.Set(true); });
+  if (!answer_set.Wait(&ok, std::chrono::seconds(10))) {
+    return false;
+  }
+  answerer.sender.SetPeer(offerer.connection);
+  return true;
+}
+
+// Input messages from one end, their delay measured at the other
+class InputProbe {
+ public:
+  void OnMessage(const uint8_t* data, size_t length) {
+    std::string_view s(reinterpret_cast<const char*>(data), length);
+    if (remote::proto::JsonGetType(s) != "benchPing") {
+      return;
+    }
+    auto t = remote::proto::JsonGetInt64(s, "t");
+    if (!t) {
+      return;
+    }
+    std::lock_guard<std::mutex> lock(mutex_);
+    latencies_us_.push_back((NowNs() - *t) / 1000.0);
+  }
+
+  bool Send(InputDataManager& input) {
+    const std::string s =
+        "{\"type\":\"benchPing\",\"t\":" + std::to_string(NowNs()) + "}";
+    return input.SendReliable(std::vector<uint8_t>(s.begin(), s.end()));
+  }
+
+  size_t received() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return latencies_us_.size();
+  }
+  // Latencies since the last call
+  std::vector<double> Take() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    std::vector<double> latencies;
+    latencies.swap(latencies_us_);
+    return latencies;
+  }
+
+ private:
+  std::mutex mutex_;
+  std::vector<double> latencies_us_;
+};
+
+// Sends pings at hz until stop() is called
+class Pinger {
+ public:
+  Pinger(InputProbe& probe, InputDataManager& input, int hz)
+      : thread_([this, &probe, &input, hz]() {
+          const auto interval = std::chrono::microseconds(1000000 / hz);
+          auto next = std::chrono::steady_clock::now();
+          std::unique_lock<std::mutex> lock(mutex_);
+          while (!stopped_) {
+            lock.unlock();
+            probe.Send(input);
+            lock.lock();
+            next += interval;
+            cv_.wait_until(lock, next, [this] { return stopped_; });
+          }
+        }) {}
+  ~Pinger() { stop(); }
+  void stop() {
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      stopped_ = true;
+    }
+    cv_.notify_all();
+    if (thread_.joinable()) {
+      thread_.join();
+    }
+  }
+
+ private:
+  std::mutex mutex_;
+  std::condition_variable cv_;
+  bool stopped_ = false;
+  std::thread thread_;
+};
+
+bool WriteTestFile(const std::string& path, uint64_t size) {
+  std::ofstream ofs(path, std::ios::binary | std::ios::trunc);
+  std::vector<uint64_t> block(1024 * 1024 / sizeof(uint64_t));
+  uint64_t x = 0x9e3779b97f4a7c15ull;
+  for (uint64_t written = 0; written < size && ofs;) {
+    for (auto& v : block) {
+      x ^= x << 13;
+      x ^= x >> 7;
+      x ^= x << 17;
+      v = x;
+    }
+    const uint64_t n =
+        std::min<uint64_t>(block.size() * sizeof(uint64_t), size - written);
+    ofs.write(reinterpret_cast<const char*>(block.data()), n);
+    written += n;
+  }
+  return static_cast<bool>(ofs);
+}
+
+// Bytes of the .part files in dir
+uint64_t PartBytes(const boost::filesystem::path& dir) {
+  uint64_t bytes = 0;
+  boost::system::error_code ec;
+  for (boost::filesystem::directory_iterator it(dir, ec), end; !ec && it != end;
+       it.increment(ec)) {
+    if (it->path().extension() == ".part") {
+      bytes += boost::filesystem::file_size(it->path(), ec);
+    }
+  }
+  return bytes;
+}
+
+}  // namespace
+
+int main(int argc, char* argv[]) {
+  BenchConfig config;
+
+  CLI::App app("momo_bulkbench - bulk DataChannel benchmark over loopback");
+  app.add_option("--size-mb", config.size_mb, "Size of the file sent in MiB")
+      ->check(CLI::Range(1, 65536));
+  app.add_option("--resume-at", config.resume_at,
+                 "Cancel the first attempt after this percent and resume it "
+                 "(0: no first attempt)")
+      ->check(CLI::Range(0, 99));
+  app.add_option("--input-hz", config.input_hz,
+                 "Input messages per second sent next to the transfer")
+      ->check(CLI::Range(1, 10000));
+  app.add_option("--dir", config.dir,
+                 "Working directory (default: a new one in the temp "
+                 "directory, removed at the end)");
+  app.add_flag("--json", config.json, "Print the result as JSON");
+  CLI11_PARSE(app, argc, argv);
+
+  webrtc::LogMessage::LogToDebug(webrtc::LS_WARNING);
+
+  const bool own_dir = config.dir.empty();
+  const boost::filesystem::path dir =
+      own_dir ? boost::filesystem::temp_directory_path() /
+                    boost::filesystem::unique_path("momo-bulkbench-%%%%%%%%")
+              : boost::filesystem::path(config.dir);
+  const boost::filesystem::path receive_dir = dir / "received";
+  boost::filesystem::create_directories(receive_dir);
+  const uint64_t size = static_cast<uint64_t>(config.size_mb) * 1024 * 1024;
+  const std::string source = (dir / "source.bin").string();
+  if (!WriteTestFile(source, size)) {
+    std::cerr << "Failed to write " << source << std::endl;
+    return 2;
+  }
+
+  auto a = CreatePeer();
+  auto b = CreatePeer();
+  if (!a->connection || !b->connection) {
+    std::cerr << "Failed to create the connections" << std::endl;
+    return 2;
+  }
+  b->bulk->SetReceiveDirectory(receive_dir.string());
+  InputProbe probe;
+  b->input->SetOnMessage(
+      [&probe](const uint8_t* data, size_t length, bool is_binary) {
+        (void)is_binary;
+        probe.OnMessage(data, length);
+      });
+  Waitable<BulkTransferResult> sent;
+  Waitable<BulkTransferResult> received;
+  a->bulk->SetOnTransferDone(
+      [&sent](const BulkTransferResult& r) { sent.Set(r); });
+  b->bulk->SetOnTransferDone(
+      [&received](const BulkTransferResult& r) { received.Set(r); });
+
+  if (!Connect(*a, *b)) {
+    std::cerr << "Failed to connect" << std::endl;
+    return 2;
+  }
+  // Until the input channel is open
+  const auto open_deadline =
+      std::chrono::steady_clock::now() + std::chrono::seconds(10);
+  while (probe.received() == 0 &&
+         std::chrono::steady_clock::now() < open_deadline) {
+    probe.Send(*a->input);
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+  }
+  if (probe.received() == 0) {
+    std::cerr << "The DataChannels did not open" << std::endl;
+    return 2;
+  }
+
+  // Input alone
+  probe.Take();
+  {
+    Pinger pinger(probe, *a->input, config.input_hz);
+    std::this_thread::sleep_for(std::chrono::seconds(1));
+  }
+  std::this_thread::sleep_for(std::chrono::milliseconds(100));
+  const std::vector<double> idle = probe.Take();
+
+  // First attempt, cancelled part way
+  BulkTransferResult r;
+  uint64_t cancelled_at = 0;
+  if (config.resume_at > 0) {
+    const uint32_t tid = a->bulk->SendFile(source);
+    const uint64_t target = size * config.resume_at / 100;
+    const auto deadline =
+        std::chrono::steady_clock::now() + std::chrono::seconds(120);
+    while (PartBytes(receive_dir) < target &&
+           std::chrono::steady_clock::now() < deadline) {
+      std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    a->bulk->Cancel(tid);
+    received.Wait(&r, std::chrono::seconds(10));
+    sent.Wait(&r, std::chrono::seconds(10));
+    cancelled_at = PartBytes(receive_dir);
+  }
+
+  // The transfer measured, with input next to it
+  probe.Take();
+  BulkTransferResult in;
+  BulkTransferResult out;
+  bool done = false;
+  {
+    Pinger pinger(probe, *a->input, config.input_hz);
+    a->bulk->SendFile(source);
+    done = received.Wait(&in, std::chrono::seconds(600)) &&
+           sent.Wait(&out, std::chrono::seconds(60));
+  }
+  std::this_thread::sleep_for(std::chrono::milliseconds(100));
+  const std::vector<double> busy = probe.Take();
+
+  a->bulk->Shutdown();
+  b->bulk->Shutdown();
+  a->connection.reset();
+  b->connection.reset();
+  a.reset();
+  b.reset();
+  boost::system::error_code ec;
+  if (own_dir) {
+    boost::filesystem::remove_all(dir, ec);
+  }
+
+  const uint64_t moved = in.size - in.resumed;
+  const double mbps = in.seconds > 0 ? moved * 8 / in.seconds / 1000000.0 : 0;
+  const double idle_p50 = Percentile(idle, 0.50) / 1000.0;
+  const double idle_p99 = Percentile(idle, 0.99) / 1000.0;
+  const double busy_p50 = Percentile(busy, 0.50) / 1000.0;
+  const double busy_p99 = Percentile(busy, 0.99) / 1000.0;
+  const double busy_max = Percentile(busy, 1.0) / 1000.0;
+  const bool resumed_ok = config.resume_at == 0 || in.resumed > 0;
+
+  if (config.json) {
+    boost::json::object result = {
+        {"size", size},
+        {"ok", done && in.ok && out.ok},
+        {"error", in.error},
+        {"cancelled_at", cancelled_at},
+        {"resumed", in.resumed},
+        {"seconds", in.seconds},
+        {"mbps", mbps},
+        {"input_idle_p50_ms", idle_p50},
+        {"input_idle_p99_ms", idle_p99},
+        {"input_busy_p50_ms", busy_p50},
+        {"input_busy_p99_ms", busy_p99},
+        {"input_busy_max_ms", busy_max},
+        {"input_messages", busy.size()},
+    };
+    std::cout << boost::json::serialize(result) << std::endl;
+  } else {
+    std::printf("%d MiB file, %s\n", config.size_mb,
+                done && in.ok && out.ok ? "received and checked"
+                                        : ("failed: " + in.error).c_str());
+    if (config.resume_at > 0) {
+      std::printf("  cancelled at %llu bytes, resumed from %llu\n",
+                  (unsigned long long)cancelled_at,
+                  (unsigned long long)in.resumed);
+    }
+    std::printf("  %llu bytes in %.2f s, %.1f Mbps\n",
+                (unsigned long long)moved, in.seconds, mbps);
+    std::printf("  input idle     p50 %.3f ms, p99 %.3f ms\n", idle_p50,
+                idle_p99);
+    std::printf("  input transfer p50 %.3f ms, p99 %.3f ms, max %.3f ms "
+                "(%zu messages)\n",
+                busy_p50, busy_p99, busy_max, busy.size());
+  }
+
+  if (!done || !in.ok || !out.ok || !resumed_ok) {
+    std::cerr << "The transfer did not go as expected" << std::endl;
+    return 1;
+  }
+  return 0;
+}
@@ -0,0 +1,1300 @@
+// momo_encbench: compares the video encoders of this build without a call.
+//
+// Frames from a Y4M / raw I420 file or from a synthetic desktop / camera
+// generator go through MomoVideoEncoderFactory, exactly like in momo, at a
+// ladder of resolutions and bitrates. The encoded frames are decoded again to
+// compare them with the source. Everything runs on the software encoders if
+// there is no GPU, so this also works on a headless CI machine.
+
+#include <algorithm>
+#include <cctype>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <limits>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#if defined(_WIN32)
+#include <windows.h>
+#else
+#include <dlfcn.h>
+#endif
+
+// CLI11
+#include <CLI/CLI.hpp>
+
+// Boost
+#include <boost/json.hpp>
+
+// WebRTC
+#include <absl/strings/match.h>
+#include <api/environment/environment_factory.h>
+#include <api/scoped_refptr.h>
+#include <api/video/encoded_image.h>
+#include <api/video/i420_buffer.h>
+#include <api/video/render_resolution.h>
+#include <api/video/video_bitrate_allocation.h>
+#include <api/video/video_codec_type.h>
+#include <api/video/video_frame.h>
+#include <api/video/video_frame_type.h>
+#include <api/video_codecs/scalability_mode.h>
+#include <api/video_codecs/sdp_video_format.h>
+#include <api/video_codecs/video_codec.h>
+#include <api/video_codecs/video_decoder.h>
+#include <api/video_codecs/video_encoder.h>
+#include <common_video/libyuv/include/webrtc_libyuv.h>
+#include <media/base/media_constants.h>
+#include <modules/video_coding/include/video_codec_interface.h>
+#include <modules/video_coding/include/video_error_codes.h>
+#include <rtc_base/logging.h>
+
+// OpenH264
+#include <wels/codec_api.h>
+#include <wels/codec_app_def.h>
+#include <wels/codec_def.h>
+
+#include "rtc/momo_video_decoder_factory.h"
+#include "rtc/momo_video_encoder_factory.h"
+#include "video_codec_info.h"
+
+#if defined(USE_NVCODEC_ENCODER)
+#include "sora/cuda_context.h"
+#endif
+
+namespace {
+
+// RTP video clock
+constexpr int kRtpClockRate = 90000;
+// Quality before a key frame request is the average of this many frames
+constexpr int kRecoveryBaselineFrames = 10;
+// A frame within this much of the baseline counts as recovered
+constexpr double kRecoveryPsnrMarginDb = 0.5;
+// How long to wait for the last frames of asynchronous (hardware) encoders
+// and decoders
+constexpr auto kDrainTimeout = std::chrono::seconds(2);
+constexpr auto kDrainIdle = std::chrono::milliseconds(200);
+
+struct LadderStep {
+  int width;
+  int height;
+  int kbps;
+};
+
+struct BenchConfig {
+  std::string input;
+  int input_width = 0;
+  int input_height = 0;
+  // desktop / camera: synthetic content and the WebRTC codec mode
+  std::string content = "desktop";
+  std::vector<std::string> codecs;
+  std::vector<LadderStep> ladder;
+  int fps = 30;
+  int frames = 300;
+  bool software_only = false;
+  bool realtime = false;
+  int key_frame_request_interval = 0;
+  std::string openh264;
+  std::string content_profile = "auto";
+  bool intra_refresh = false;
+  bool low_latency = false;
+  // Do not pass the changed area of the source frames to the encoders
+  bool no_damage = false;
+  bool json = false;
+};
+
+// Source frames
+class FrameSource {
+ public:
+  virtual ~FrameSource() = default;
+  // Starts over from the first frame
+  virtual bool Rewind() = 0;
+  virtual webrtc::scoped_refptr<webrtc::I420Buffer> Next(int width,
+                                                         int height) = 0;
+  // Area that changed in the last frame returned by Next, like the update
+  // rect of a screen capturer. nullopt if unknown.
+  virtual std::optional<webrtc::VideoFrame::UpdateRect> LastUpdateRect()
+      const {
+    return std::nullopt;
+  }
+};
+
+// Synthetic content, deterministic so that runs are comparable
+class SyntheticFrameSource : public FrameSource {
+ public:
+  explicit SyntheticFrameSource(bool desktop) : desktop_(desktop) {
+    for (int i = 0; i < 256; i++) {
+      sine_[i] = static_cast<int>(std::lround(
+          127.0 * std::sin(2.0 * 3.14159265358979 * i / 256.0)));
+    }
+  }
+
+  bool Rewind() override {
+    index_ = 0;
+    return true;
+  }
+
+  webrtc::scoped_refptr<webrtc::I420Buffer> Next(int width,
+                                                 int height) override {
+    auto buffer = webrtc::I420Buffer::Create(width, height);
+    if (desktop_) {
+      DrawDesktop(buffer.get(), index_);
+    } else {
+      DrawCamera(buffer.get(), index_);
+    }
+    index_++;
+    return buffer;
+  }
+
+  std::optional<webrtc::VideoFrame::UpdateRect> LastUpdateRect()
+      const override {
+    return update_rect_;
+  }
+
+ private:
+  static uint32_t Hash(uint32_t a, uint32_t b) {
+    uint32_t h = a * 0x9E3779B1u ^ (b + 0x7F4A7C15u + (a << 6) + (a >> 2));
+    h ^= h >> 15;
+    h *= 0x2C1B3C6Du;
+    h ^= h >> 12;
+    return h;
+  }
+
+  // Cursor box at the given frame, the cursor moves during frames 30 to 49
+  // of every 60
+  webrtc::VideoFrame::UpdateRect CursorRect(int w, int h, int index) const {
+    const int t = index / 60 * 20 + std::clamp(index % 60 - 30, 0, 20);
+    const int cx = (w / 2) + sine_[(t * 3) & 255] * (w / 3) / 127;
+    const int cy = (h / 2) + sine_[(t * 2 + 64) & 255] * (h / 3) / 127;
+    return {cx, cy, 9, 18};
+  }
+
+  // Text window with a title bar, mostly static with a scroll every 2
+  // seconds, and a mouse cursor that moves now and then. Also tracks the
+  // changed area like a screen capturer does.
+  void DrawDesktop(webrtc::I420Buffer* buffer, int index) {
+    const int w = buffer->width();
+    const int h = buffer->height();
+    const int title = std::max(8, h / 20);
+    constexpr int kLineHeight = 18;
+    constexpr int kCellWidth = 9;
+    // One line scrolls in over 10 frames every 60 frames
+    const int cycle = index / 60;
+    const int phase = std::min(index % 60, 10);
+    const int scroll_px = cycle * kLineHeight + phase * kLineHeight / 10;
+
+    for (int y = 0; y < h; y++) {
+      uint8_t* row = buffer->MutableDataY() + y * buffer->StrideY();
+      if (y < title) {
+        std::fill(row, row + w, 60);
+        continue;
+      }
+      const int text_y = y - title + scroll_px;
+      const int line = text_y / kLineHeight;
+      const int gy = text_y % kLineHeight;
+      for (int x = 0; x < w; x++) {
+        uint8_t v = 235;
+        const int col = x / kCellWidth;
+        const int gx = x % kCellWidth;
+        // Ragged line ends and about one blank cell in five
+        const uint32_t cell = Hash(line, col);
+        if (gy >= 3 && gy < 15 && gx < 7 && col < 20 + (Hash(line, 0) % 60) &&
+            cell % 5 != 0) {
+          const int sy = gy - 3;
+          const bool vertical = (gx == 0 || gx == 6) && ((cell >> sy) & 1);
+          const bool horizontal =
+              (sy == 0 || sy == 5 || sy == 11) && ((cell >> (gx + 16)) & 1);
+          if (vertical || horizontal) {
+            v = 20;
+          }
+        }
+        row[x] = v;
+      }
+    }
+    const int cw = buffer->ChromaWidth();
+    const int ch = buffer->ChromaHeight();
+    for (int y = 0; y < ch; y++) {
+      const bool in_title = y * 2 < title;
+      std::fill(buffer->MutableDataU() + y * buffer->StrideU(),
+                buffer->MutableDataU() + y * buffer->StrideU() + cw,
+                in_title ? 150 : 128);
+      std::fill(buffer->MutableDataV() + y * buffer->StrideV(),
+                buffer->MutableDataV() + y * buffer->StrideV() + cw,
+                in_title ? 110 : 128);
+    }
+
+    // Cursor
+    const auto cursor = CursorRect(w, h, index);
+    const int cx = cursor.offset_x;
+    const int cy = cursor.offset_y;
+    for (int y = std::max(0, cy); y < std::min(h, cy + 18); y++) {
+      uint8_t* row = buffer->MutableDataY() + y * buffer->StrideY();
+      for (int x = std::max(0, cx); x < std::min(w, cx + (y - cy) / 2 + 1);
+           x++) {
+        row[x] = 0;
+      }
+    }
+
+    if (index == 0) {
+      update_rect_ = webrtc::VideoFrame::UpdateRect{0, 0, w, h};
+      return;
+    }
+    webrtc::VideoFrame::UpdateRect damage{0, 0, 0, 0};
+    if (index % 60 >= 1 && index % 60 <= 10) {
+      damage.Union(webrtc::VideoFrame::UpdateRect{0, title, w, h - title});
+    }
+    const auto previous = CursorRect(w, h, index - 1);
+    if (cursor.offset_x != previous.offset_x ||
+        cursor.offset_y != previous.offset_y) {
+      damage.Union(cursor);
+      damage.Union(previous);
+    }
+    damage.Intersect(webrtc::VideoFrame::UpdateRect{0, 0, w, h});
+    update_rect_ = damage;
+  }
+
+  // Moving gradients with sensor-like noise and a moving object
+  void DrawCamera(webrtc::I420Buffer* buffer, int index) {
+    const int w = buffer->width();
+    const int h = buffer->height();
+    uint32_t noise = Hash(index, 0);
+    const int disc_x = w / 2 + sine_[(index * 2) & 255] * (w / 4) / 127;
+    const int disc_y = h / 2 + sine_[(index * 3 + 64) & 255] * (h / 4) / 127;
+    const int radius = std::max(8, h / 8);
+    for (int y = 0; y < h; y++) {
+      uint8_t* row = buffer->MutableDataY() + y * buffer->StrideY();
+      const int sy = sine_[(y * 2 / 3 + index) & 255];
+      for (int x = 0; x < w; x++) {
+        noise = noise * 1664525u + 1013904223u;
+        int v = 128 + (sine_[(x * 3 / 4 + index * 2) & 255] + sy) / 4 +
+                static_cast<int>(noise >> 29) - 4;
+        const int dx = x - disc_x;
+        const int dy = y - disc_y;
+        if (dx * dx + dy * dy < radius * radius) {
+          v = 200 + static_cast<int>(noise >> 30);
+        }
+        row[x] = static_cast<uint8_t>(std::clamp(v, 0, 255));
+      }
+    }
+    for (int y = 0; y < buffer->ChromaHeight(); y++) {
+      uint8_t* u = buffer->MutableDataU() + y * buffer->StrideU();
+      uint8_t* v = buffer->MutableDataV() + y * buffer->StrideV();
+      for (int x = 0; x < buffer->ChromaWidth(); x++) {
+        const int dx = x * 2 - disc_x;
+        const int dy = y * 2 - disc_y;
+        if (dx * dx + dy * dy < radius * radius) {
+          u[x] = 90;
+          v[x] = 170;
+        } else {
+          u[x] = static_cast<uint8_t>(128 + sine_[(x + index) & 255] / 8);
+          v[x] = static_cast<uint8_t>(128 + sine_[(y + index) & 255] / 8);
+        }
+      }
+    }
+  }
+
+  bool desktop_;
+  int index_ = 0;
+  int sine_[256];
+  std::optional<webrtc::VideoFrame::UpdateRect> update_rect_;
+};
+
+// Y4M (4:2:0 only) or raw I420 file, looped if it is shorter than the run
+class FileFrameSource : public FrameSource {
+ public:
+  static std::unique_ptr<FileFrameSource> Create(const std::string& path,
+                                                 int width,
+                                                 int height) {
+    std::unique_ptr<FileFrameSource> source(new FileFrameSource());
+    source->file_.open(path, std::ios::binary);
+    if (!source->file_) {
+      std::cerr << "Failed to open " << path << std::endl;
+      return nullptr;
+    }
+    source->y4m_ = absl::EndsWithIgnoreCase(path, ".y4m");
+    if (source->y4m_) {
+      if (!source->ReadY4mHeader()) {
+        return nullptr;
+      }
+    } else {
+      if (width <= 0 || height <= 0) {
+        std::cerr << "--input-width and --input-height are required for raw "
+                     "I420 input"
+                  << std::endl;
+        return nullptr;
+      }
+      source->width_ = width;
+      source->height_ = height;
+      source->data_offset_ = 0;
+    }
+    return source;
+  }
+
+  bool Rewind() override {
+    file_.clear();
+    file_.seekg(data_offset_);
+    return static_cast<bool>(file_);
+  }
+
+  webrtc::scoped_refptr<webrtc::I420Buffer> Next(int width,
+                                                 int height) override {
+    auto frame = ReadFrame();
+    if (!frame) {
+      // Loop
+      if (!Rewind()) {
+        return nullptr;
+      }
+      frame = ReadFrame();
+      if (!frame) {
+        return nullptr;
+      }
+    }
+    if (frame->width() == width && frame->height() == height) {
+      return frame;
+    }
+    auto scaled = webrtc::I420Buffer::Create(width, height);
+    scaled->ScaleFrom(*frame);
+    return scaled;
+  }
+
+ private:
+  FileFrameSource() = default;
+
+  bool ReadY4mHeader() {
+    std::string header;
+    if (!std::getline(file_, header) ||
+        header.compare(0, 10, "YUV4MPEG2 ") != 0) {
+      std::cerr << "Not a Y4M file" << std::endl;
+      return false;
+    }
+    std::istringstream tokens(header.substr(10));
+    std::string token;
+    while (tokens >> token) {
+      if (token[0] == 'W') {
+        width_ = std::atoi(token.c_str() + 1);
+      } else if (token[0] == 'H') {
+        height_ = std::atoi(token.c_str() + 1);
+      } else if (token[0] == 'C' && token.compare(1, 3, "420") != 0) {
+        std::cerr << "Only 4:2:0 Y4M files are supported, got " << token
+                  << std::endl;
+        return false;
+      }
+    }
+    if (width_ <= 0 || height_ <= 0) {
+      std::cerr << "Y4M header has no frame size" << std::endl;
+      return false;
+    }
+    data_offset_ = file_.tellg();
+    return true;
+  }
+
+  webrtc::scoped_refptr<webrtc::I420Buffer> ReadFrame() {
+    if (y4m_) {
+      std::string frame_header;
+      if (!std::getline(file_, frame_header) ||
+          frame_header.compare(0, 5, "FRAME") != 0) {
+        return nullptr;
+      }
+    }
+    auto buffer = webrtc::I420Buffer::Create(width_, height_);
+    auto read_plane = [this](uint8_t* data, int stride, int w, int h) {
+      for (int y = 0; y < h; y++) {
+        if (!file_.read(reinterpret_cast<char*>(data + y * stride), w)) {
+          return false;
+        }
+      }
+      return true;
+    };
+    if (!read_plane(buffer->MutableDataY(), buffer->StrideY(), width_,
+                    height_) ||
+        !read_plane(buffer->MutableDataU(), buffer->StrideU(),
+                    buffer->ChromaWidth(), buffer->ChromaHeight()) ||
+        !read_plane(buffer->MutableDataV(), buffer->StrideV(),
+                    buffer->ChromaWidth(), buffer->ChromaHeight())) {
+      return nullptr;
+    }
+    return buffer;
+  }
+
+  std::ifstream file_;
+  bool y4m_ = false;
+  int width_ = 0;
+  int height_ = 0;
+  std::streampos data_offset_;
+};
+
+// momo has no software H.264 decoder, but the OpenH264 library that the
+// encoder is loaded from also contains one
+class OpenH264Decoder : public webrtc::VideoDecoder {
+ public:
+  explicit OpenH264Decoder(const std::string& openh264) {
+#if defined(_WIN32)
+    handle_ = LoadLibraryA(openh264.c_str());
+#else
+    handle_ = ::dlopen(openh264.c_str(), RTLD_LAZY);
+#endif
+    if (handle_ == nullptr) {
+      return;
+    }
+#if defined(_WIN32)
+    create_decoder_ =
+        (CreateDecoderFunc)::GetProcAddress(handle_, "WelsCreateDecoder");
+    destroy_decoder_ =
+        (DestroyDecoderFunc)::GetProcAddress(handle_, "WelsDestroyDecoder");
+#else
+    create_decoder_ = (CreateDecoderFunc)::dlsym(handle_, "WelsCreateDecoder");
+    destroy_decoder_ =
+        (DestroyDecoderFunc)::dlsym(handle_, "WelsDestroyDecoder");
+#endif
+  }
+  ~OpenH264Decoder() override {
+    Release();
+    if (handle_ != nullptr) {
+#if defined(_WIN32)
+      FreeLibrary(handle_);
+#else
+      ::dlclose(handle_);
+#endif
+    }
+  }
+
+  bool Configure(const Settings& settings) override {
+    Release();
+    if (create_decoder_ == nullptr || destroy_decoder_ == nullptr ||
+        create_decoder_(&decoder_) != 0 || decoder_ == nullptr) {
+      decoder_ = nullptr;
+      return false;
+    }
+    SDecodingParam param;
+    memset(&param, 0, sizeof(param));
+    param.sVideoProperty.eVideoBsType = VIDEO_BITSTREAM_AVC;
+    if (decoder_->Initialize(&param) != 0) {
+      Release();
+      return false;
+    }
+    return true;
+  }
+
+  int32_t Decode(const webrtc::EncodedImage& input_image,
+                 int64_t render_time_ms) override {
+    if (decoder_ == nullptr || callback_ == nullptr) {
+      return WEBRTC_VIDEO_CODEC_UNINITIALIZED;
+    }
+    unsigned char* planes[3] = {nullptr, nullptr, nullptr};
+    SBufferInfo info;
+    memset(&info, 0, sizeof(info));
+    DECODING_STATE state = decoder_->DecodeFrameNoDelay(
+        input_image.data(), static_cast<int>(input_image.size()), planes,
+        &info);
+    if (state != dsErrorFree) {
+      return WEBRTC_VIDEO_CODEC_ERROR;
+    }
+    if (info.iBufferStatus != 1) {
+      return WEBRTC_VIDEO_CODEC_OK;
+    }
+    const auto& system_buffer = info.UsrData.sSystemBuffer;
+    auto buffer = webrtc::I420Buffer::Copy(
+        system_buffer.iWidth, system_buffer.iHeight, planes[0],
+        system_buffer.iStride[0], planes[1], system_buffer.iStride[1],
+        planes[2], system_buffer.iStride[1]);
+    webrtc::VideoFrame frame = webrtc::VideoFrame::Builder()
+                                   .set_video_frame_buffer(buffer)
+                                   .set_rtp_timestamp(input_image.RtpTimestamp())
+                                   .build();
+    callback_->Decoded(frame);
+    return WEBRTC_VIDEO_CODEC_OK;
+  }
+
+  int32_t RegisterDecodeCompleteCallback(
+      webrtc::DecodedImageCallback* callback) override {
+    callback_ = callback;
+    return WEBRTC_VIDEO_CODEC_OK;
+  }
+
+  int32_t Release() override {
+    if (decoder_ != nullptr) {
+      decoder_->Uninitialize();
+      destroy_decoder_(decoder_);
+      decoder_ = nullptr;
+    }
+    return WEBRTC_VIDEO_CODEC_OK;
+  }
+
+ private:
+  using CreateDecoderFunc = long (*)(ISVCDecoder**);
+  using DestroyDecoderFunc = void (*)(ISVCDecoder*);
+#if defined(_WIN32)
+  HMODULE handle_ = nullptr;
+#else
+  void* handle_ = nullptr;
+#endif
+  CreateDecoderFunc create_decoder_ = nullptr;
+  DestroyDecoderFunc destroy_decoder_ = nullptr;
+  ISVCDecoder* decoder_ = nullptr;
+  webrtc::DecodedImageCallback* callback_ = nullptr;
+};
+
+// Per-frame results of one run
+struct FrameResult {
+  bool encoded = false;
+  bool key_frame = false;
+  size_t bytes = 0;
+  double latency_ms = 0.0;
+  double psnr = std::numeric_limits<double>::quiet_NaN();
+  double ssim = std::numeric_limits<double>::quiet_NaN();
+};
+
+// Collects the output of the encoder, which may run on another thread
+class EncodedCollector : public webrtc::EncodedImageCallback {
+ public:
+  struct Output {
+    webrtc::EncodedImage image;
+    std::chrono::steady_clock::time_point time;
+  };
+
+  Result OnEncodedImage(
+      const webrtc::EncodedImage& encoded_image,
+      const webrtc::CodecSpecificInfo* codec_specific_info) override {
+    Output output{encoded_image, std::chrono::steady_clock::now()};
+    std::lock_guard<std::mutex> lock(mutex_);
+    outputs_.push_back(std::move(output));
+    return Result(Result::OK);
+  }
+
+  std::vector<Output> Take() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    std::vector<Output> outputs;
+    outputs.swap(outputs_);
+    return outputs;
+  }
+
+ private:
+  std::mutex mutex_;
+  std::vector<Output> outputs_;
+};
+
+// State of one run, shared with the decoder callback, which may run on
+// another thread
+struct RunState {
+  std::mutex mutex;
+  std::map<uint32_t, int> frame_index;
+  // Source frames that have not been decoded yet
+  std::map<uint32_t, webrtc::scoped_refptr<webrtc::I420Buffer>> references;
+  std::vector<FrameResult> frames;
+};
+
+// Compares decoded frames with the source frame of the same RTP timestamp
+class QualityMeter : public webrtc::DecodedImageCallback {
+ public:
+  explicit QualityMeter(RunState* state) : state_(state) {}
+
+  int32_t Decoded(webrtc::VideoFrame& decoded_image) override {
+    const uint32_t timestamp = decoded_image.rtp_timestamp();
+    webrtc::scoped_refptr<webrtc::I420Buffer> reference;
+    int index = -1;
+    {
+      std::lock_guard<std::mutex> lock(state_->mutex);
+      auto it = state_->references.find(timestamp);
+      auto index_it = state_->frame_index.find(timestamp);
+      if (it == state_->references.end() ||
+          index_it == state_->frame_index.end()) {
+        return WEBRTC_VIDEO_CODEC_OK;
+      }
+      reference = it->second;
+      index = index_it->second;
+      // Frames are decoded in order, older ones were skipped by the encoder
+      state_->references.erase(state_->references.begin(), std::next(it));
+    }
+    auto decoded = decoded_image.video_frame_buffer()->ToI420();
+    if (!decoded || decoded->width() != reference->width() ||
+        decoded->height() != reference->height()) {
+      return WEBRTC_VIDEO_CODEC_OK;
+    }
+    const double psnr = webrtc::I420PSNR(*reference, *decoded);
+    const double ssim = webrtc::I420SSIM(*reference, *decoded);
+    std::lock_guard<std::mutex> lock(state_->mutex);
+    state_->frames[index].psnr = psnr;
+    state_->frames[index].ssim = ssim;
+    return WEBRTC_VIDEO_CODEC_OK;
+  }
+
+ private:
+  RunState* state_;
+};
+
+struct RunResult {
+  std::string codec;
+  std::string encoder;
+  LadderStep step;
+  bool ok = false;
+  std::string error;
+  int frames_encoded = 0;
+  double encode_fps = 0.0;
+  double latency_p50_ms = 0.0;
+  double latency_p90_ms = 0.0;
+  double latency_p99_ms = 0.0;
+  double latency_max_ms = 0.0;
+  double bitrate_kbps = 0.0;
+  int key_frames = 0;
+  size_t first_key_frame_bytes = 0;
+  double key_frame_bytes_avg = 0.0;
+  size_t key_frame_bytes_max = 0;
+  double delta_frame_bytes_avg = 0.0;
+  // Largest frame after the first one
+  size_t peak_frame_bytes = 0;
+  int frames_measured = 0;
+  double psnr = 0.0;
+  double ssim = 0.0;
+  int key_frame_requests = 0;
+  double recovery_ms = 0.0;
+};
+
+double Percentile(std::vector<double> values, double p) {
+  if (values.empty()) {
+    return 0.0;
+  }
+  std::sort(values.begin(), values.end());
+  const size_t index = static_cast<size_t>(
+      std::lround(p * static_cast<double>(values.size() - 1)));
+  return values[std::min(index, values.size() - 1)];
+}
+
+webrtc::VideoCodec CreateCodecSettings(webrtc::VideoCodecType type,
+                                       const LadderStep& step,
+                                       int fps,
+                                       bool desktop) {
+  webrtc::VideoCodec codec;
+  codec.codecType = type;
+  codec.width = step.width;
+  codec.height = step.height;
+  codec.startBitrate = step.kbps;
+  codec.maxBitrate = step.kbps;
+  codec.minBitrate = 30;
+  codec.maxFramerate = fps;
+  codec.qpMax = 56;
+  codec.numberOfSimulcastStreams = 0;
+  codec.mode = desktop ? webrtc::VideoCodecMode::kScreensharing
+                       : webrtc::VideoCodecMode::kRealtimeVideo;
+  switch (type) {
+    case webrtc::kVideoCodecVP8:
+      *codec.VP8() = webrtc::VideoEncoder::GetDefaultVp8Settings();
+      break;
+    case webrtc::kVideoCodecVP9: {
+      *codec.VP9() = webrtc::VideoEncoder::GetDefaultVp9Settings();
+      codec.VP9()->numberOfSpatialLayers = 1;
+      webrtc::SpatialLayer& layer = codec.spatialLayers[0];
+      layer.width = step.width;
+      layer.height = step.height;
+      layer.maxFramerate = static_cast<float>(fps);
+      layer.numberOfTemporalLayers = 1;
+      layer.maxBitrate = step.kbps;
+      layer.targetBitrate = step.kbps;
+      layer.minBitrate = codec.minBitrate;
+      layer.qpMax = codec.qpMax;
+      layer.active = true;
+      codec.SetScalabilityMode(webrtc::ScalabilityMode::kL1T1);
+      break;
+    }
+    case webrtc::kVideoCodecAV1:
+      codec.SetScalabilityMode(webrtc::ScalabilityMode::kL1T1);
+      break;
+    case webrtc::kVideoCodecH264:
+      *codec.H264() = webrtc::VideoEncoder::GetDefaultH264Settings();
+      break;
+    default:
+      break;
+  }
+  return codec;
+}
+
+// Prefers packetization-mode=1 for H.264, like a normal negotiation does
+std::optional<webrtc::SdpVideoFormat> FindFormat(
+    const std::vector<webrtc::SdpVideoFormat>& formats,
+    const std::string& codec) {
+  std::optional<webrtc::SdpVideoFormat> found;
+  for (const auto& format : formats) {
+    if (!absl::EqualsIgnoreCase(format.name, codec)) {
+      continue;
+    }
+    auto mode = format.parameters.find(webrtc::kH264FmtpPacketizationMode);
+    if (!found || (mode != format.parameters.end() && mode->second == "1")) {
+      found = format;
+    }
+  }
+  return found;
+}
+
+class EncodeBench {
+ public:
+  EncodeBench(const BenchConfig& config, FrameSource* source)
+      : config_(config), source_(source), info_(VideoCodecInfo::Get()) {
+#if defined(USE_NVCODEC_ENCODER)
+    cuda_context_ = sora::CudaContext::Create();
+#endif
+  }
+
+  std::vector<RunResult> Run() {
+    std::vector<RunResult> results;
+    for (const auto& codec : config_.codecs) {
+      for (auto type : EncoderTypes(codec)) {
+        for (const auto& step : config_.ladder) {
+          results.push_back(RunOne(codec, type, step));
+          Print(results.back());
+        }
+      }
+    }
+    return results;
+  }
+
+ private:
+  std::vector<VideoCodecInfo::Type> EncoderTypes(const std::string& codec) {
+    const std::vector<VideoCodecInfo::Type>* types = nullptr;
+    if (codec == webrtc::kVp8CodecName) {
+      types = &info_.vp8_encoders;
+    } else if (codec == webrtc::kVp9CodecName) {
+      types = &info_.vp9_encoders;
+    } else if (codec == webrtc::kAv1CodecName) {
+      types = &info_.av1_encoders;
+    } else if (codec == webrtc::kH264CodecName) {
+      types = &info_.h264_encoders;
+    } else if (codec == webrtc::kH265CodecName) {
+      types = &info_.h265_encoders;
+    }
+    std::vector<VideoCodecInfo::Type> result;
+    if (types == nullptr) {
+      return result;
+    }
+    for (auto type : *types) {
+      if (config_.software_only && type != VideoCodecInfo::Type::Software) {
+        continue;
+      }
+      // The software H.264 encoder needs the OpenH264 library
+      if (codec == webrtc::kH264CodecName &&
+          type == VideoCodecInfo::Type::Software && config_.openh264.empty()) {
+        std::cerr << "Skipping the software H264 encoder, no --openh264"
+                  << std::endl;
+        continue;
+      }
+      result.push_back(type);
+    }
+    return result;
+  }
+
+  std::unique_ptr<webrtc::VideoDecoder> CreateDecoder(
+      const std::string& codec,
+      const webrtc::SdpVideoFormat& format,
+      const webrtc::Environment& env) {
+    if (codec == webrtc::kH264CodecName && !config_.openh264.empty()) {
+      return std::make_unique<OpenH264Decoder>(config_.openh264);
+    }
+    auto resolve = &VideoCodecInfo::Resolve;
+    const auto d = VideoCodecInfo::Type::Default;
+    MomoVideoDecoderFactoryConfig dc;
+    dc.vp8_decoder = resolve(d, info_.vp8_decoders);
+    dc.vp9_decoder = resolve(d, info_.vp9_decoders);
+    dc.av1_decoder = resolve(d, info_.av1_decoders);
+    dc.h264_decoder = resolve(d, info_.h264_decoders);
+    dc.h265_decoder = resolve(d, info_.h265_decoders);
+#if defined(USE_NVCODEC_ENCODER)
+    dc.cuda_context = cuda_context_;
+#endif
+    MomoVideoDecoderFactory factory(dc);
+    for (const auto& supported : factory.GetSupportedFormats()) {
+      if (absl::EqualsIgnoreCase(supported.name, codec)) {
+        return factory.Create(env, format);
+      }
+    }
+    return nullptr;
+  }
+
+  RunResult RunOne(const std::string& codec,
+                   VideoCodecInfo::Type type,
+                   const LadderStep& step) {
+    RunResult result;
+    result.codec = codec;
+    result.encoder = VideoCodecInfo::TypeToString(type).second;
+    result.step = step;
+
+    MomoVideoEncoderFactoryConfig ec;
+    const auto n = VideoCodecInfo::Type::NotSupported;
+    ec.vp8_encoder = codec == webrtc::kVp8CodecName ? type : n;
+    ec.vp9_encoder = codec == webrtc::kVp9CodecName ? type : n;
+    ec.av1_encoder = codec == webrtc::kAv1CodecName ? type : n;
+    ec.h264_encoder = codec == webrtc::kH264CodecName ? type : n;
+    ec.h265_encoder = codec == webrtc::kH265CodecName ? type : n;
+    ec.simulcast = false;
+    ec.hardware_encoder_only = false;
+#if defined(USE_NVCODEC_ENCODER)
+    ec.cuda_context = cuda_context_;
+#endif
+    ec.openh264 = config_.openh264;
+    ec.content_profile = config_.content_profile;
+    ec.low_latency = config_.low_latency;
+    ec.intra_refresh = config_.intra_refresh;
+    MomoVideoEncoderFactory factory(ec);
+
+    auto format = FindFormat(factory.GetSupportedFormats(), codec);
+    if (!format) {
+      result.error = "format not supported";
+      return result;
+    }
+    const webrtc::Environment env = webrtc::CreateEnvironment();
+    auto encoder = factory.Create(env, *format);
+    if (!encoder) {
+      result.error = "failed to create the encoder";
+      return result;
+    }
+    const webrtc::VideoCodecType codec_type =
+        webrtc::PayloadStringToCodecType(codec);
+    const webrtc::VideoCodec codec_settings = CreateCodecSettings(
+        codec_type, step, config_.fps, config_.content == "desktop");
+    EncodedCollector collector;
+    encoder->RegisterEncodeCompleteCallback(&collector);
+    const int cores = std::max(1u, std::thread::hardware_concurrency());
+    if (encoder->InitEncode(
+            &codec_settings,
+            webrtc::VideoEncoder::Settings(
+                webrtc::VideoEncoder::Capabilities(false), cores, 1200)) !=
+        WEBRTC_VIDEO_CODEC_OK) {
+      result.error = "InitEncode failed";
+      return result;
+    }
+    webrtc::VideoBitrateAllocation allocation;
+    allocation.SetBitrate(0, 0, step.kbps * 1000);
+    encoder->SetRates(webrtc::VideoEncoder::RateControlParameters(
+        allocation, static_cast<double>(config_.fps)));
+
+    RunState state;
+    state.frames.resize(config_.frames);
+    std::vector<std::chrono::steady_clock::time_point> encode_start(
+        config_.frames);
+    QualityMeter meter(&state);
+    auto decoder = CreateDecoder(codec, *format, env);
+    if (decoder) {
+      webrtc::VideoDecoder::Settings decoder_settings;
+      decoder_settings.set_codec_type(codec_type);
+      decoder_settings.set_max_render_resolution(
+          webrtc::RenderResolution(step.width, step.height));
+      decoder_settings.set_number_of_cores(1);
+      if (!decoder->Configure(decoder_settings)) {
+        decoder.reset();
+      } else {
+        decoder->RegisterDecodeCompleteCallback(&meter);
+      }
+    }
+    if (!decoder) {
+      std::cerr << codec << ": no decoder, PSNR/SSIM are not measured"
+                << std::endl;
+    }
+
+    // Hands the encoded frames to the decoder, outside of the encode time.
+    // Returns the number of frames processed.
+    auto process_outputs = [&]() {
+      auto outputs = collector.Take();
+      for (auto& output : outputs) {
+        const uint32_t timestamp = output.image.RtpTimestamp();
+        {
+          std::lock_guard<std::mutex> lock(state.mutex);
+          auto it = state.frame_index.find(timestamp);
+          if (it == state.frame_index.end()) {
+            continue;
+          }
+          FrameResult& frame = state.frames[it->second];
+          frame.encoded = true;
+          frame.key_frame = output.image._frameType ==
+                            webrtc::VideoFrameType::kVideoFrameKey;
+          frame.bytes += output.image.size();
+          frame.latency_ms = std::chrono::duration<double, std::milli>(
+                                 output.time - encode_start[it->second])
+                                 .count();
+          if (!decoder) {
+            state.references.erase(state.references.begin(),
+                                   state.references.upper_bound(timestamp));
+          }
+        }
+        if (decoder) {
+          decoder->Decode(output.image, 0);
+        }
+      }
+      return outputs.size();
+    };
+
+    std::vector<int> requests;
+    const uint32_t rtp_step = kRtpClockRate / config_.fps;
+    const auto frame_interval =
+        std::chrono::microseconds(1000000 / config_.fps);
+    source_->Rewind();
+    auto busy = std::chrono::steady_clock::duration::zero();
+    auto next = std::chrono::steady_clock::now();
+    for (int i = 0; i < config_.frames; i++) {
+      auto buffer = source_->Next(step.width, step.height);
+      if (!buffer) {
+        result.error = "failed to read a frame";
+        break;
+      }
+      const uint32_t timestamp = static_cast<uint32_t>(i + 1) * rtp_step;
+      {
+        std::lock_guard<std::mutex> lock(state.mutex);
+        state.frame_index[timestamp] = i;
+        state.references[timestamp] = buffer;
+      }
+      webrtc::VideoFrame frame =
+          webrtc::VideoFrame::Builder()
+              .set_video_frame_buffer(buffer)
+              .set_rtp_timestamp(timestamp)
+              .set_timestamp_us(static_cast<int64_t>(i) * 1000000 /
+                                config_.fps)
+              .set_update_rect(config_.no_damage ? std::nullopt
+                                                 : source_->LastUpdateRect())
+              .build();
+      std::vector<webrtc::VideoFrameType> types = {
+          webrtc::VideoFrameType::kVideoFrameDelta};
+      if (i == 0) {
+        types[0] = webrtc::VideoFrameType::kVideoFrameKey;
+      } else if (config_.key_frame_request_interval > 0 &&
+                 i % config_.key_frame_request_interval == 0) {
+        // What the sender does on a PLI from a receiver that lost packets
+        types[0] = webrtc::VideoFrameType::kVideoFrameKey;
+        requests.push_back(i);
+      }
+      if (config_.realtime) {
+        std::this_thread::sleep_until(next);
+        next += frame_interval;
+      }
+      encode_start[i] = std::chrono::steady_clock::now();
+      int32_t ret = encoder->Encode(frame, &types);
+      busy += std::chrono::steady_clock::now() - encode_start[i];
+      if (ret != WEBRTC_VIDEO_CODEC_OK) {
+        result.error = "Encode returned " + std::to_string(ret);
+        break;
+      }
+      process_outputs();
+    }
+    // Hardware encoders and decoders may deliver the last frames later
+    const auto drain_until = std::chrono::steady_clock::now() + kDrainTimeout;
+    auto last_output = std::chrono::steady_clock::now();
+    while (result.error.empty()) {
+      const auto now = std::chrono::steady_clock::now();
+      if (now >= drain_until || now - last_output >= kDrainIdle) {
+        break;
+      }
+      {
+        std::lock_guard<std::mutex> lock(state.mutex);
+        if (state.references.empty()) {
+          break;
+        }
+      }
+      std::this_thread::sleep_for(std::chrono::milliseconds(10));
+      if (process_outputs() > 0) {
+        last_output = std::chrono::steady_clock::now();
+      }
+    }
+    encoder->Release();
+    if (decoder) {
+      decoder->Release();
+    }
+    if (!result.error.empty()) {
+      return result;
+    }
+
+    std::lock_guard<std::mutex> lock(state.mutex);
+    Summarize(state.frames, requests, busy, &result);
+    result.ok = true;
+    return result;
+  }
+
+  void Summarize(const std::vector<FrameResult>& frames,
+                 const std::vector<int>& requests,
+                 std::chrono::steady_clock::duration busy,
+                 RunResult* result) {
+    std::vector<double> latencies;
+    size_t total_bytes = 0;
+    size_t key_bytes = 0;
+    size_t delta_bytes = 0;
+    int delta_frames = 0;
+    double psnr_sum = 0.0;
+    double ssim_sum = 0.0;
+    for (size_t i = 0; i < frames.size(); i++) {
+      const FrameResult& frame = frames[i];
+      if (!frame.encoded) {
+        continue;
+      }
+      result->frames_encoded++;
+      latencies.push_back(frame.latency_ms);
+      total_bytes += frame.bytes;
+      if (frame.key_frame) {
+        if (result->key_frames == 0) {
+          result->first_key_frame_bytes = frame.bytes;
+        }
+        result->key_frames++;
+        key_bytes += frame.bytes;
+        result->key_frame_bytes_max =
+            std::max(result->key_frame_bytes_max, frame.bytes);
+      } else {
+        delta_frames++;
+        delta_bytes += frame.bytes;
+      }
+      if (i > 0) {
+        result->peak_frame_bytes =
+            std::max(result->peak_frame_bytes, frame.bytes);
+      }
+      if (!std::isnan(frame.psnr)) {
+        result->frames_measured++;
+        psnr_sum += frame.psnr;
+        ssim_sum += frame.ssim;
+      }
+    }
+    const double seconds = std::chrono::duration<double>(busy).count();
+    result->encode_fps = seconds > 0 ? result->frames_encoded / seconds : 0.0;
+    result->latency_p50_ms = Percentile(latencies, 0.50);
+    result->latency_p90_ms = Percentile(latencies, 0.90);
+    result->latency_p99_ms = Percentile(latencies, 0.99);
+    result->latency_max_ms = Percentile(latencies, 1.0);
+    result->bitrate_kbps = total_bytes * 8.0 * config_.fps /
+                           std::max<size_t>(1, frames.size()) / 1000.0;
+    result->key_frame_bytes_avg =
+        result->key_frames > 0
+            ? static_cast<double>(key_bytes) / result->key_frames
+            : 0.0;
+    result->delta_frame_bytes_avg =
+        delta_frames > 0 ? static_cast<double>(delta_bytes) / delta_frames
+                         : 0.0;
+    if (result->frames_measured > 0) {
+      result->psnr = psnr_sum / result->frames_measured;
+      result->ssim = ssim_sum / result->frames_measured;
+    }
+
+    // Recovery: frames until the quality is back at the level before the
+    // request, or until the next request
+    result->key_frame_requests = static_cast<int>(requests.size());
+    double recovery_frames = 0.0;
+    int recovery_count = 0;
+    for (size_t r = 0; r < requests.size(); r++) {
+      const int request = requests[r];
+      const int end = r + 1 < requests.size()
+                          ? requests[r + 1]
+                          : static_cast<int>(frames.size());
+      double baseline = 0.0;
+      int count = 0;
+      for (int i = std::max(0, request - kRecoveryBaselineFrames); i < request;
+           i++) {
+        if (!std::isnan(frames[i].psnr)) {
+          baseline += frames[i].psnr;
+          count++;
+        }
+      }
+      if (count == 0) {
+        continue;
+      }
+      baseline /= count;
+      int recovered = end;
+      for (int i = request; i < end; i++) {
+        if (!std::isnan(frames[i].psnr) &&
+            frames[i].psnr >= baseline - kRecoveryPsnrMarginDb) {
+          recovered = i;
+          break;
+        }
+      }
+      recovery_frames += recovered - request;
+      recovery_count++;
+    }
+    if (recovery_count > 0) {
+      result->recovery_ms =
+          recovery_frames / recovery_count * 1000.0 / config_.fps;
+    }
+  }
+
+  void Print(const RunResult& r) {
+    if (config_.json) {
+      boost::json::object json = {
+          {"codec", r.codec},
+          {"encoder", r.encoder},
+          {"width", r.step.width},
+          {"height", r.step.height},
+          {"target_kbps", r.step.kbps},
+          {"ok", r.ok},
+      };
+      if (!r.ok) {
+        json["error"] = r.error;
+      } else {
+        json["frames_encoded"] = r.frames_encoded;
+        json["encode_fps"] = r.encode_fps;
+        json["latency_p50_ms"] = r.latency_p50_ms;
+        json["latency_p90_ms"] = r.latency_p90_ms;
+        json["latency_p99_ms"] = r.latency_p99_ms;
+        json["latency_max_ms"] = r.latency_max_ms;
+        json["bitrate_kbps"] = r.bitrate_kbps;
+        json["key_frames"] = r.key_frames;
+        json["first_key_frame_bytes"] = r.first_key_frame_bytes;
+        json["key_frame_bytes_avg"] = r.key_frame_bytes_avg;
+        json["key_frame_bytes_max"] = r.key_frame_bytes_max;
+        json["delta_frame_bytes_avg"] = r.delta_frame_bytes_avg;
+        json["peak_frame_bytes"] = r.peak_frame_bytes;
+        json["frames_measured"] = r.frames_measured;
+        if (r.frames_measured > 0) {
+          json["psnr"] = r.psnr;
+          json["ssim"] = r.ssim;
+        }
+        if (r.key_frame_requests > 0) {
+          json["key_frame_requests"] = r.key_frame_requests;
+          json["recovery_ms"] = r.recovery_ms;
+        }
+      }
+      std::cout << boost::json::serialize(json) << std::endl;
+      return;
+    }
+    std::printf("%s/%s %dx%d %d kbps: ", r.codec.c_str(), r.encoder.c_str(),
+                r.step.width, r.step.height, r.step.kbps);
+    if (!r.ok) {
+      std::printf("%s\n", r.error.c_str());
+      return;
+    }
+    std::printf("%d frames\n", r.frames_encoded);
+    std::printf("  encode   %.1f fps, latency p50 %.2f p90 %.2f p99 %.2f "
+                "max %.2f ms\n",
+                r.encode_fps, r.latency_p50_ms, r.latency_p90_ms,
+                r.latency_p99_ms, r.latency_max_ms);
+    std::printf("  size     %.0f kbps, %d key frames (first %zu, avg %.0f, max "
+                "%zu bytes), delta avg %.0f bytes, peak %zu bytes\n",
+                r.bitrate_kbps, r.key_frames, r.first_key_frame_bytes,
+                r.key_frame_bytes_avg, r.key_frame_bytes_max,
+                r.delta_frame_bytes_avg, r.peak_frame_bytes);
+    if (r.frames_measured > 0) {
+      std::printf("  quality  PSNR %.2f dB, SSIM %.4f (%d frames)\n", r.psnr,
+                  r.ssim, r.frames_measured);
+    }
+    if (r.key_frame_requests > 0) {
+      std::printf("  recovery %.0f ms after %d key frame requests\n",
+                  r.recovery_ms, r.key_frame_requests);
+    }
+  }
+
+  const BenchConfig& config_;
+  FrameSource* source_;
+  VideoCodecInfo info_;
+#if defined(USE_NVCODEC_ENCODER)
+  std::shared_ptr<sora::CudaContext> cuda_context_;
+#endif
+};
+
+bool ParseLadder(const std::string& text, std::vector<LadderStep>* ladder) {
+  std::istringstream items(text);
+  std::string item;
+  while (std::getline(items, item, ',')) {
+    LadderStep step;
+    if (std::sscanf(item.c_str(), "%dx%d@%d", &step.width, &step.height,
+                    &step.kbps) != 3 ||
+        step.width < 16 || step.height < 16 || step.kbps <= 0) {
+      return false;
+    }
+    // Encoders are fed the 16-pixel aligned size (see AlignedEncoderAdapter),
+    // use exactly that so that the output can be compared with the source
+    step.width &= ~15;
+    step.height &= ~15;
+    ladder->push_back(step);
+  }
+  return !ladder->empty();
+}
+
+}  // namespace
+
+int main(int argc, char* argv[]) {
+  BenchConfig config;
+  std::string codecs = "VP8,VP9,AV1,H264,H265";
+  std::string ladder = "1920x1080@4000,1280x720@2000,640x360@600";
+  if (const char* openh264 = std::getenv("OPENH264_PATH")) {
+    config.openh264 = openh264;
+  }
+
+  CLI::App app("momo_encbench - video encoder benchmark");
+  app.add_option("--input", config.input,
+                 "Y4M (.y4m) or raw I420 file (default: synthetic content)")
+      ->check(CLI::ExistingFile);
+  app.add_option("--input-width", config.input_width,
+                 "Frame width of a raw I420 file");
+  app.add_option("--input-height", config.input_height,
+                 "Frame height of a raw I420 file");
+  app.add_option("--content", config.content,
+                 "Synthetic content and codec mode (desktop: screensharing)")
+      ->check(CLI::IsMember({"desktop", "camera"}));
+  app.add_option("--codecs", codecs, "Comma separated codecs to measure");
+  app.add_option("--ladder", ladder,
+                 "Comma separated WIDTHxHEIGHT@KBPS steps to measure");
+  app.add_option("--fps", config.fps, "Frame rate")
+      ->check(CLI::Range(1, 240));
+  app.add_option("--frames", config.frames, "Frames per run")
+      ->check(CLI::Range(1, 100000));
+  app.add_flag("--software-only", config.software_only,
+               "Only measure the software encoders");
+  app.add_flag("--realtime", config.realtime,
+               "Feed frames at --fps instead of as fast as possible");
+  app.add_option("--key-frame-request-interval",
+                 config.key_frame_request_interval,
+                 "Request a key frame every N frames, like after packet loss "
+                 "(0: never)")
+      ->check(CLI::Range(0, 100000));
+  app.add_option("--openh264", config.openh264,
+                 "OpenH264 dynamic library path (default: $OPENH264_PATH)");
+  app.add_option("--video-content-profile", config.content_profile,
+                 "Encoder tuning for the video content")
+      ->check(CLI::IsMember({"auto", "camera", "desktop"}));
+  app.add_flag("--intra-refresh", config.intra_refresh,
+               "Same as momo --intra-refresh");
+  app.add_flag("--low-latency", config.low_latency,
+               "Encoder settings of momo --low-latency");
+  app.add_flag("--no-damage", config.no_damage,
+               "Do not tell the encoders which area of the synthetic desktop "
+               "changed");
+  app.add_flag("--json", config.json, "Print one JSON line per run");
+  CLI11_PARSE(app, argc, argv);
+
+  if (!ParseLadder(ladder, &config.ladder)) {
+    std::cerr << "Invalid --ladder: " << ladder << std::endl;
+    return 2;
+  }
+  std::istringstream codec_items(codecs);
+  std::string codec;
+  while (std::getline(codec_items, codec, ',')) {
+    std::transform(codec.begin(), codec.end(), codec.begin(), ::toupper);
+    config.codecs.push_back(codec);
+  }
+
+  webrtc::LogMessage::LogToDebug(webrtc::LS_WARNING);
+
+  std::unique_ptr<FrameSource> source;
+  if (config.input.empty()) {
+    source = std::make_unique<SyntheticFrameSource>(config.content ==
+                                                    "desktop");
+  } else {
+    source = FileFrameSource::Create(config.input, config.input_width,
+                                     config.input_height);
+    if (!source) {
+      return 2;
+    }
+  }
+
+  EncodeBench bench(config, source.get());
+  auto results = bench.Run();
+  if (results.empty()) {
+    std::cerr << "No encoder to measure" << std::endl;
+    return 2;
+  }
+  for (const auto& result : results) {
+    if (!result.ok) {
+      return 1;
+    }
+  }
+  return 0;
+}
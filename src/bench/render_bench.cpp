@@ -0,0 +1,321 @@
+// momo_renderbench: measures the SDLRenderer video path without a peer
+// connection.
+//
+// Synthetic video tracks push I420/NV12 frames into SDLRenderer, which runs on
+// the offscreen video driver with the software renderer by default, so this
+// also works on a GPU-less CI machine.
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+// CLI11
+#include <CLI/CLI.hpp>
+
+// Boost
+#include <boost/asio.hpp>
+#include <boost/json.hpp>
+
+// SDL
+#include <SDL3/SDL.h>
+
+// WebRTC
+#include <api/make_ref_counted.h>
+#include <api/media_stream_interface.h>
+#include <api/notifier.h>
+#include <api/video/i420_buffer.h>
+#include <api/video/nv12_buffer.h>
+#include <api/video/video_frame.h>
+#include <media/base/video_broadcaster.h>
+#include <rtc_base/logging.h>
+#include <third_party/libyuv/include/libyuv.h>
+
+#include "sdl_renderer/sdl_renderer.h"
+
+namespace {
+
+struct BenchConfig {
+  int width = 1920;
+  int height = 1080;
+  int fps = 60;
+  int tracks = 1;
+  bool nv12 = false;
+  int duration = 10;
+  int window_width = 1280;
+  int window_height = 720;
+  bool json = false;
+  // Fail (exit code 1) if fewer frames per second are uploaded (0: no check)
+  double min_fps = 0.0;
+};
+
+// Video track that is fed directly from a thread, no capturer or source
+class SyntheticVideoTrack
+    : public webrtc::Notifier<webrtc::VideoTrackInterface> {
+ public:
+  SyntheticVideoTrack(std::string id, const BenchConfig& config)
+      : id_(std::move(id)), config_(config) {
+    // Pre-render a few frames so that the generator does not compete with
+    // the renderer for CPU time
+    for (int i = 0; i < kFrameCount; i++) {
+      frames_.push_back(CreateBuffer(i));
+    }
+  }
+  ~SyntheticVideoTrack() override { Stop(); }
+
+  // MediaStreamTrackInterface
+  std::string kind() const override { return kVideoKind; }
+  std::string id() const override { return id_; }
+  bool enabled() const override { return true; }
+  bool set_enabled(bool) override { return true; }
+  TrackState state() const override { return kLive; }
+
+  // VideoTrackInterface
+  void AddOrUpdateSink(webrtc::VideoSinkInterface<webrtc::VideoFrame>* sink,
+                       const webrtc::VideoSinkWants& wants) override {
+    broadcaster_.AddOrUpdateSink(sink, wants);
+  }
+  void RemoveSink(
+      webrtc::VideoSinkInterface<webrtc::VideoFrame>* sink) override {
+    broadcaster_.RemoveSink(sink);
+  }
+  webrtc::VideoTrackSourceInterface* GetSource() const override {
+    return nullptr;
+  }
+
+  void Start() {
+    stop_ = false;
+    thread_ = std::thread([this] { Run(); });
+  }
+  void Stop() {
+    stop_ = true;
+    if (thread_.joinable()) {
+      thread_.join();
+    }
+  }
+  uint64_t GetFramesSent() const { return frames_sent_; }
+
+ private:
+  static constexpr int kFrameCount = 8;
+
+  webrtc::scoped_refptr<webrtc::VideoFrameBuffer> CreateBuffer(int index) {
+    // Moving gradient, different every frame
+    const int w = config_.width;
+    const int h = config_.height;
+    std::vector<uint8_t> argb(static_cast<size_t>(w) * h * 4);
+    for (int y = 0; y < h; y++) {
+      uint8_t* row = argb.data() + static_cast<size_t>(y) * w * 4;
+      for (int x = 0; x < w; x++) {
+        row[x * 4 + 0] = static_cast<uint8_t>(x + index * 16);
+        row[x * 4 + 1] = static_cast<uint8_t>(y + index * 8);
+        row[x * 4 + 2] = static_cast<uint8_t>((x + y) / 2);
+        row[x * 4 + 3] = 255;
+      }
+    }
+    if (config_.nv12) {
+      auto nv12 = webrtc::NV12Buffer::Create(w, h);
+      libyuv::ARGBToNV12(argb.data(), w * 4, nv12->MutableDataY(),
+                         nv12->StrideY(), nv12->MutableDataUV(),
+                         nv12->StrideUV(), w, h);
+      return nv12;
+    }
+    auto i420 = webrtc::I420Buffer::Create(w, h);
+    libyuv::ARGBToI420(argb.data(), w * 4, i420->MutableDataY(),
+                       i420->StrideY(), i420->MutableDataU(), i420->StrideU(),
+                       i420->MutableDataV(), i420->StrideV(), w, h);
+    return i420;
+  }
+
+  void Run() {
+    const auto interval = std::chrono::microseconds(1000000 / config_.fps);
+    auto start = std::chrono::steady_clock::now();
+    auto next = start;
+    uint64_t index = 0;
+    while (!stop_) {
+      auto now = std::chrono::steady_clock::now();
+      broadcaster_.OnFrame(
+          webrtc::VideoFrame::Builder()
+              .set_video_frame_buffer(frames_[index % kFrameCount])
+              .set_rotation(webrtc::kVideoRotation_0)
+              .set_timestamp_us(
+                  std::chrono::duration_cast<std::chrono::microseconds>(
+                      now - start)
+                      .count())
+              .build());
+      index++;
+      frames_sent_++;
+      // Absolute schedule, so that a slow frame does not lower the rate
+      next += interval;
+      std::this_thread::sleep_until(next);
+    }
+  }
+
+  std::string id_;
+  BenchConfig config_;
+  std::vector<webrtc::scoped_refptr<webrtc::VideoFrameBuffer>> frames_;
+  webrtc::VideoBroadcaster broadcaster_;
+  std::thread thread_;
+  std::atomic<bool> stop_{false};
+  std::atomic<uint64_t> frames_sent_{0};
+};
+
+double PerFrameMs(uint64_t total_us, uint64_t frames) {
+  return frames > 0 ? total_us / 1000.0 / frames : 0.0;
+}
+
+}  // namespace
+
+int main(int argc, char* argv[]) {
+  BenchConfig config;
+  std::string format = "i420";
+
+  CLI::App app("momo_renderbench - SDLRenderer benchmark");
+  app.add_option("--width", config.width, "Frame width")
+      ->check(CLI::Range(16, 7680));
+  app.add_option("--height", config.height, "Frame height")
+      ->check(CLI::Range(16, 4320));
+  app.add_option("--fps", config.fps, "Frames per second of each track")
+      ->check(CLI::Range(1, 1000));
+  app.add_option("--tracks", config.tracks, "Number of video tracks")
+      ->check(CLI::Range(1, 16));
+  app.add_option("--format", format, "Frame buffer format")
+      ->check(CLI::IsMember({"i420", "nv12"}));
+  app.add_option("--duration", config.duration, "Duration in seconds")
+      ->check(CLI::Range(1, 3600));
+  app.add_option("--window-width", config.window_width, "Window width")
+      ->check(CLI::Range(16, 7680));
+  app.add_option("--window-height", config.window_height, "Window height")
+      ->check(CLI::Range(16, 4320));
+  app.add_flag("--json", config.json, "Print the result as JSON");
+  app.add_option("--min-fps", config.min_fps,
+                 "Fail if fewer frames per second are uploaded in total");
+  CLI11_PARSE(app, argc, argv);
+  config.nv12 = format == "nv12";
+
+  webrtc::LogMessage::LogToDebug(webrtc::LS_WARNING);
+
+  // Headless by default; SDL_VIDEO_DRIVER etc. in the environment still win.
+  // No vsync, the point is to measure how fast the render path is.
+  SDL_SetHint(SDL_HINT_VIDEO_DRIVER, "offscreen");
+  SDL_SetHint(SDL_HINT_RENDER_DRIVER, "software");
+  SDL_SetHint(SDL_HINT_AUDIO_DRIVER, "dummy");
+  SDL_SetHint(SDL_HINT_RENDER_VSYNC, "0");
+
+  auto renderer = std::make_unique<SDLRenderer>(
+      config.window_width, config.window_height, false);
+  if (renderer->GetWindow() == nullptr) {
+    std::cerr << "Failed to create the SDL window: " << SDL_GetError()
+              << std::endl;
+    return 2;
+  }
+
+  std::vector<webrtc::scoped_refptr<SyntheticVideoTrack>> tracks;
+  for (int i = 0; i < config.tracks; i++) {
+    auto track = webrtc::make_ref_counted<SyntheticVideoTrack>(
+        "bench" + std::to_string(i), config);
+    renderer->AddTrack(track.get());
+    tracks.push_back(track);
+  }
+
+  boost::asio::io_context ioc{1};
+  renderer->SetDispatchFunction([&ioc](std::function<void()> f) {
+    if (ioc.stopped())
+      return;
+    boost::asio::dispatch(ioc.get_executor(), f);
+  });
+
+  // Let the window and the textures settle before measuring
+  boost::asio::steady_timer timer(ioc);
+  SDLRenderer::RenderStats begin;
+  std::vector<uint64_t> sent_begin(tracks.size());
+  std::chrono::steady_clock::time_point begin_time;
+  for (auto& track : tracks) {
+    track->Start();
+  }
+  timer.expires_after(std::chrono::seconds(1));
+  timer.async_wait([&](const boost::system::error_code&) {
+    begin = renderer->GetRenderStats();
+    for (size_t i = 0; i < tracks.size(); i++) {
+      sent_begin[i] = tracks[i]->GetFramesSent();
+    }
+    begin_time = std::chrono::steady_clock::now();
+    timer.expires_after(std::chrono::seconds(config.duration));
+    timer.async_wait([&](const boost::system::error_code&) { ioc.stop(); });
+  });
+  ioc.run();
+
+  const auto end = renderer->GetRenderStats();
+  const double seconds = std::chrono::duration<double>(
+                             std::chrono::steady_clock::now() - begin_time)
+                             .count();
+  uint64_t sent = 0;
+  for (size_t i = 0; i < tracks.size(); i++) {
+    sent += tracks[i]->GetFramesSent() - sent_begin[i];
+  }
+
+  renderer->SetDispatchFunction(nullptr);
+  for (auto& track : tracks) {
+    track->Stop();
+    renderer->RemoveTrack(track.get());
+  }
+  renderer.reset();
+
+  const uint64_t received = end.frames_received - begin.frames_received;
+  const uint64_t uploaded = end.frames_uploaded - begin.frames_uploaded;
+  const uint64_t dropped = end.frames_dropped - begin.frames_dropped;
+  const uint64_t presented = end.frames_presented - begin.frames_presented;
+  const double upload_fps = seconds > 0 ? uploaded / seconds : 0.0;
+  const double present_fps = seconds > 0 ? presented / seconds : 0.0;
+  const double convert_ms =
+      PerFrameMs(end.convert_us - begin.convert_us, received);
+  const double upload_ms = PerFrameMs(end.upload_us - begin.upload_us, uploaded);
+  const double present_ms =
+      PerFrameMs(end.present_us - begin.present_us, presented);
+
+  if (config.json) {
+    boost::json::object result = {
+        {"width", config.width},
+        {"height", config.height},
+        {"fps", config.fps},
+        {"tracks", config.tracks},
+        {"format", format},
+        {"seconds", seconds},
+        {"frames_sent", sent},
+        {"frames_received", received},
+        {"frames_uploaded", uploaded},
+        {"frames_dropped", dropped},
+        {"frames_presented", presented},
+        {"upload_fps", upload_fps},
+        {"present_fps", present_fps},
+        {"convert_ms", convert_ms},
+        {"upload_ms", upload_ms},
+        {"present_ms", present_ms},
+    };
+    std::cout << boost::json::serialize(result) << std::endl;
+  } else {
+    std::printf("%dx%d %s, %d track(s) at %d fps, %.1f s\n", config.width,
+                config.height, format.c_str(), config.tracks, config.fps,
+                seconds);
+    std::printf("  frames   sent %llu received %llu uploaded %llu dropped %llu"
+                " presented %llu\n",
+                (unsigned long long)sent, (unsigned long long)received,
+                (unsigned long long)uploaded, (unsigned long long)dropped,
+                (unsigned long long)presented);
+    std::printf("  rate     upload %.1f fps, present %.1f fps\n", upload_fps,
+                present_fps);
+    std::printf("  per frame convert %.3f ms, upload %.3f ms, present %.3f ms\n",
+                convert_ms, upload_ms, present_ms);
+  }
+
+  if (config.min_fps > 0 && upload_fps < config.min_fps) {
+    std::cerr << "upload rate " << upload_fps << " fps is below --min-fps "
+              << config.min_fps << std::endl;
+    return 1;
+  }
+  return 0;
+}
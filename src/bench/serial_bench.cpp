@@ -0,0 +1,337 @@
+// momo_serialbench: measures the serial bridge (--serial) over a pseudo
+// terminal, no device needed.
+//
+// SerialDataManager opens the slave side of a pty like a serial device. The
+// bench writes timestamped lines into the master side as fast as the pty
+// takes them (or at --rate bytes per second) and takes the messages that
+// would go to the DataChannels, then sends data the other way and reads it
+// back from the master side.
+
+#include <fcntl.h>
+#include <poll.h>
+#include <stdlib.h>
+#include <termios.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+// CLI11
+#include <CLI/CLI.hpp>
+
+// Boost
+#include <boost/asio.hpp>
+#include <boost/json.hpp>
+
+// WebRTC
+#include <rtc_base/logging.h>
+
+#include "serial_data_channel/serial_data_manager.h"
+
+namespace {
+
+struct BenchConfig {
+  int lines = 200000;
+  int line_length = 64;
+  int batch_ms = 0;
+  bool raw = false;
+  // Bytes per second written into the pty (0: as fast as it takes them)
+  int rate = 0;
+  unsigned int baud_rate = 921600;
+  int upstream_kbytes = 16384;
+  int upstream_message_size = 1024;
+  bool json = false;
+};
+
+int64_t NowNs() {
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(
+             std::chrono::steady_clock::now().time_since_epoch())
+      .count();
+}
+
+double Percentile(std::vector<double> values, double p) {
+  if (values.empty()) {
+    return 0.0;
+  }
+  std::sort(values.begin(), values.end());
+  const size_t index = static_cast<size_t>(
+      std::lround(p * static_cast<double>(values.size() - 1)));
+  return values[std::min(index, values.size() - 1)];
+}
+
+bool WriteAll(int fd, const char* data, size_t length) {
+  while (length > 0) {
+    const ssize_t n = ::write(fd, data, length);
+    if (n < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      return false;
+    }
+    data += n;
+    length -= n;
+  }
+  return true;
+}
+
+// Takes the messages of SerialDataManager apart again. Every line starts
+// with the time it was written, in hex
+class LineCounter {
+ public:
+  explicit LineCounter(bool raw) : raw_(raw) {}
+
+  void OnMessage(const webrtc::CopyOnWriteBuffer& data) {
+    const char* p = reinterpret_cast<const char*>(data.data());
+    const char* end = p + data.size();
+    messages_++;
+    bytes_ += data.size();
+    if (raw_) {
+      // Bytes as they were read, the lines end with '\n'
+      partial_.append(p, end);
+      size_t begin = 0;
+      size_t delimiter;
+      while ((delimiter = partial_.find('\n', begin)) != std::string::npos) {
+        OnLine(partial_.data() + begin, delimiter - begin);
+        begin = delimiter + 1;
+      }
+      partial_.erase(0, begin);
+      return;
+    }
+    // Lines joined by '\n'
+    while (true) {
+      const char* delimiter =
+          static_cast<const char*>(std::memchr(p, '\n', end - p));
+      OnLine(p, (delimiter != nullptr ? delimiter : end) - p);
+      if (delimiter == nullptr) {
+        break;
+      }
+      p = delimiter + 1;
+    }
+  }
+
+  uint64_t lines() const { return lines_.load(); }
+  uint64_t messages() const { return messages_; }
+  uint64_t bytes() const { return bytes_; }
+  const std::vector<double>& latencies_us() const { return latencies_us_; }
+
+ private:
+  void OnLine(const char* line, size_t length) {
+    if (length < 16) {
+      return;
+    }
+    const int64_t sent_ns =
+        static_cast<int64_t>(std::strtoull(std::string(line, 16).c_str(),
+                                           nullptr, 16));
+    latencies_us_.push_back((NowNs() - sent_ns) / 1000.0);
+    lines_++;
+  }
+
+  const bool raw_;
+  std::string partial_;
+  std::atomic<uint64_t> lines_{0};
+  uint64_t messages_ = 0;
+  uint64_t bytes_ = 0;
+  std::vector<double> latencies_us_;
+};
+
+}  // namespace
+
+int main(int argc, char* argv[]) {
+  BenchConfig config;
+
+  CLI::App app("momo_serialbench - serial bridge benchmark over a pty");
+  app.add_option("--lines", config.lines, "Lines sent from the device")
+      ->check(CLI::Range(1, 100000000));
+  app.add_option("--line-length", config.line_length,
+                 "Bytes per line, with the newline")
+      ->check(CLI::Range(17, 65536));
+  app.add_option("--batch-ms", config.batch_ms,
+                 "Same as --serial-batch-ms of Momo")
+      ->check(CLI::Range(0, 1000));
+  app.add_flag("--raw", config.raw, "Same as --serial-raw of Momo");
+  app.add_option("--rate", config.rate,
+                 "Bytes per second sent from the device (0: unlimited)")
+      ->check(CLI::Range(0, 1000000000));
+  app.add_option("--baud-rate", config.baud_rate,
+                 "Baud rate set on the pty, which does not limit it");
+  app.add_option("--upstream-kbytes", config.upstream_kbytes,
+                 "KiB sent to the device")
+      ->check(CLI::Range(0, 1048576));
+  app.add_option("--upstream-message-size", config.upstream_message_size,
+                 "Bytes per DataChannel message sent to the device")
+      ->check(CLI::Range(1, 262144));
+  app.add_flag("--json", config.json, "Print the result as JSON");
+  CLI11_PARSE(app, argc, argv);
+
+  webrtc::LogMessage::LogToDebug(webrtc::LS_WARNING);
+
+  const int master = ::posix_openpt(O_RDWR | O_NOCTTY);
+  if (master < 0 || ::grantpt(master) != 0 || ::unlockpt(master) != 0) {
+    std::cerr << "Failed to open a pty: " << std::strerror(errno) << std::endl;
+    return 2;
+  }
+  termios tio;
+  ::tcgetattr(master, &tio);
+  ::cfmakeraw(&tio);
+  ::tcsetattr(master, TCSANOW, &tio);
+
+  boost::asio::io_context ioc{1};
+  auto work_guard = boost::asio::make_work_guard(ioc);
+  SerialDataManagerConfig serial_config;
+  serial_config.device = ::ptsname(master);
+  serial_config.rate = config.baud_rate;
+  serial_config.raw = config.raw;
+  serial_config.batch_ms = config.batch_ms;
+  auto serial = SerialDataManager::Create(ioc, serial_config);
+  if (!serial) {
+    return 2;
+  }
+  LineCounter counter(config.raw);
+  serial->SetFrameHandler(
+      [&counter](const webrtc::CopyOnWriteBuffer& data) {
+        counter.OnMessage(data);
+      });
+  std::thread io_thread([&ioc]() { ioc.run(); });
+
+  // Device -> DataChannel
+  const auto down_begin = std::chrono::steady_clock::now();
+  std::thread device([&]() {
+    std::string line(config.line_length, 'x');
+    line.back() = '\n';
+    for (int i = 0; i < config.lines; i++) {
+      if (config.rate > 0) {
+        const auto due =
+            down_begin + std::chrono::nanoseconds(static_cast<int64_t>(
+                             1e9 * i * config.line_length / config.rate));
+        std::this_thread::sleep_until(due);
+      }
+      char timestamp[17];
+      std::snprintf(timestamp, sizeof(timestamp), "%016llx",
+                    static_cast<unsigned long long>(NowNs()));
+      std::memcpy(&line[0], timestamp, 16);
+      if (!WriteAll(master, line.data(), line.size())) {
+        std::cerr << "Failed to write to the pty: " << std::strerror(errno)
+                  << std::endl;
+        return;
+      }
+    }
+  });
+  device.join();
+  const auto deadline =
+      std::chrono::steady_clock::now() + std::chrono::seconds(5);
+  while (counter.lines() < static_cast<uint64_t>(config.lines) &&
+         std::chrono::steady_clock::now() < deadline) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+  }
+  const double down_seconds = std::chrono::duration<double>(
+                                  std::chrono::steady_clock::now() - down_begin)
+                                  .count();
+
+  // DataChannel -> device
+  const uint64_t upstream_bytes =
+      static_cast<uint64_t>(config.upstream_kbytes) * 1024;
+  uint64_t upstream_received = 0;
+  const auto up_begin = std::chrono::steady_clock::now();
+  std::thread reader([&]() {
+    std::vector<char> buf(64 * 1024);
+    while (upstream_received < upstream_bytes) {
+      pollfd pfd = {master, POLLIN, 0};
+      if (::poll(&pfd, 1, 2000) <= 0) {
+        break;
+      }
+      const ssize_t n = ::read(master, buf.data(), buf.size());
+      if (n <= 0) {
+        break;
+      }
+      upstream_received += n;
+    }
+  });
+  std::vector<uint8_t> message(config.upstream_message_size, 'y');
+  for (uint64_t sent = 0; sent < upstream_bytes; sent += message.size()) {
+    const size_t length =
+        static_cast<size_t>(std::min<uint64_t>(message.size(),
+                                               upstream_bytes - sent));
+    serial->Send(webrtc::CopyOnWriteBuffer(message.data(), length));
+  }
+  reader.join();
+  const double up_seconds = std::chrono::duration<double>(
+                                std::chrono::steady_clock::now() - up_begin)
+                                .count();
+
+  work_guard.reset();
+  ioc.stop();
+  io_thread.join();
+  serial.reset();
+  ::close(master);
+
+  const uint64_t lines = counter.lines();
+  const double lines_per_second = down_seconds > 0 ? lines / down_seconds : 0;
+  const double down_mbps =
+      down_seconds > 0
+          ? lines * config.line_length * 8 / down_seconds / 1000000.0
+          : 0;
+  const double up_mbps = up_seconds > 0 ? upstream_received * 8 / up_seconds /
+                                              1000000.0
+                                        : 0;
+  const double lines_per_message =
+      counter.messages() > 0 ? static_cast<double>(lines) / counter.messages()
+                             : 0;
+  const auto& latencies = counter.latencies_us();
+  const double p50_ms = Percentile(latencies, 0.50) / 1000.0;
+  const double p99_ms = Percentile(latencies, 0.99) / 1000.0;
+  const double max_ms = Percentile(latencies, 1.0) / 1000.0;
+
+  if (config.json) {
+    boost::json::object result = {
+        {"raw", config.raw},
+        {"batch_ms", config.batch_ms},
+        {"line_length", config.line_length},
+        {"rate", config.rate},
+        {"lines_sent", config.lines},
+        {"lines_received", lines},
+        {"messages", counter.messages()},
+        {"lines_per_message", lines_per_message},
+        {"lines_per_second", lines_per_second},
+        {"down_mbps", down_mbps},
+        {"latency_p50_ms", p50_ms},
+        {"latency_p99_ms", p99_ms},
+        {"latency_max_ms", max_ms},
+        {"up_bytes_sent", upstream_bytes},
+        {"up_bytes_received", upstream_received},
+        {"up_mbps", up_mbps},
+    };
+    std::cout << boost::json::serialize(result) << std::endl;
+  } else {
+    std::printf("%s, batch %d ms, %d byte lines, %.1f s\n",
+                config.raw ? "raw" : "line", config.batch_ms,
+                config.line_length, down_seconds);
+    std::printf("  device -> dc lines %llu/%d in %llu messages (%.1f per "
+                "message), %.0f lines/s, %.1f Mbps\n",
+                (unsigned long long)lines, config.lines,
+                (unsigned long long)counter.messages(), lines_per_message,
+                lines_per_second, down_mbps);
+    std::printf("  latency      p50 %.3f ms, p99 %.3f ms, max %.3f ms\n",
+                p50_ms, p99_ms, max_ms);
+    std::printf("  dc -> device %llu/%llu bytes, %.1f Mbps\n",
+                (unsigned long long)upstream_received,
+                (unsigned long long)upstream_bytes, up_mbps);
+  }
+
+  if (lines < static_cast<uint64_t>(config.lines) ||
+      upstream_received < upstream_bytes) {
+    std::cerr << "Not everything arrived" << std::endl;
+    return 1;
+  }
+  return 0;
+}
@@ -1,3 +1,4 @@
+#include <algorithm>
 #include <atomic>
 #include <condition_variable>
 #include <csignal>
@@ -8,6 +9,9 @@
 // Handling of --list-devices option
 #include <vector>
 
+// Boost
+#include <boost/asio/steady_timer.hpp>
+
 // SDL3
 #include <SDL3/SDL_main.h>
 
@@ -16,6 +20,7 @@
 #include <rtc_base/log_sinks.h>
 #include <rtc_base/ref_counted_object.h>
 #include <rtc_base/string_utils.h>
+#include <rtc_base/time_utils.h>
 
 #if defined(USE_SCREEN_CAPTURER)
 #include "rtc/screen_video_capturer.h"
@@ -51,10 +56,12 @@
 
 // Remote control framework (sender overlay / input capture / data channel management)
 #include "remote/common/geometry.h"
+#include "remote/data_channel/bulk_data_manager.h"
 #include "remote/data_channel/input_data_manager.h"
 #include "remote/input_receiver/input_dispatcher.h"
 #include "remote/input_sender/sdl_input_capture.h"
 #include "remote/overlay/overlay_renderer.h"
+#include "remote/overlay/perf_stats_sampler.h"
 #include "remote/proto/parser.h"
 
 #ifdef _WIN32
@@ -65,9 +72,12 @@
 #endif
 
 #include "ayame/ayame_client.h"
+#include "metrics/frame_tracer.h"
+#include "metrics/metrics_registry.h"
 #include "metrics/metrics_server.h"
 // Instantiate overlay and input capture framework
 #include "p2p/p2p_server.h"
+#include "rtc/desktop_adaptation_controller.h"
 #include "rtc/rtc_manager.h"
 #include "sora/sora_client.h"
 #include "sora/sora_server.h"
@@ -91,6 +101,8 @@
 #endif
 
 const size_t kDefaultMaxLogFileSize = 10 * 1024 * 1024;
+// Upper bound of the received audio queue with --low-latency
+const int kLowLatencyAudioTargetMs = 40;
 // Update mapping from current primary video rect to receiver (source) frame size
 
 #if defined(__linux__)
@@ -112,6 +124,7 @@ static void ListVideoDevices() {
 #endif
 
 int RunMomoApp(int argc, char* argv[]) {
+  const int64_t start_ms = webrtc::TimeMillis();
 #ifdef _WIN32
   momo::svc::LogService("RunMomoApp entered, argc=" + std::to_string(argc));
 #endif
@@ -253,7 +266,8 @@ int RunMomoApp(int argc, char* argv[]) {
           auto size = args.GetSize();
           return webrtc::make_ref_counted<ScreenVideoCapturer>(
               sources[0].id, size.width, size.height, args.framerate,
-              args.screen_capture_cursor);
+              args.screen_capture_cursor,
+              args.video_content_profile != "camera");
         }
 #endif
 
@@ -366,6 +380,38 @@ int RunMomoApp(int argc, char* argv[]) {
   // Pass the congestion control algorithm to RTCManager
   rtcm_config.congestion_controller = args.congestion_controller;
 
+  rtcm_config.video_content_profile = args.video_content_profile;
+  rtcm_config.low_latency = args.low_latency;
+  rtcm_config.intra_refresh = args.intra_refresh;
+  rtcm_config.frame_trace = args.frame_trace;
+  // Every P2P viewer has its own connection, encode once for all of them
+  rtcm_config.share_video_encoder = use_p2p;
+  rtcm_config.warm_connection = args.warm_connection;
+  if (args.frame_trace) {
+    FrameTracer::Instance().SetEnabled(true);
+    sora::ScalableVideoTrackSource::SetTraceCallback(
+        [](int64_t timestamp_us, int64_t received_us, int64_t adapted_us,
+           int width, int height) {
+          FrameTraceEvent event;
+          event.timestamp_us = timestamp_us;
+          event.stage = FrameTraceStage::kSourceReceived;
+          event.time_us = received_us;
+          FrameTracer::Instance().Record(event);
+          event.stage = FrameTraceStage::kSourceAdapted;
+          event.time_us = adapted_us;
+          event.width = width;
+          event.height = height;
+          FrameTracer::Instance().Record(event);
+        });
+  }
+  if (args.low_latency) {
+    // What --low-latency changed, so that /metrics shows which profile is used
+    auto& registry = MetricsRegistry::Instance();
+    registry.Set("low_latency", "enabled", 1);
+    registry.Set("low_latency", "playout_delay_ms", 0);
+    registry.Set("low_latency", "audio_fast_accelerate", 1);
+  }
+
 #if defined(USE_FAKE_CAPTURE_DEVICE)
   // When --fake-capture-device is specified, replacing the ADM for the receiver's playback (playout) blocks it.
   // If you need to play audio with reception, maintain the platform ADM.
@@ -404,6 +450,9 @@ int RunMomoApp(int argc, char* argv[]) {
   std::unique_ptr<remote::input_sender::SdlInputCapture> sdl_input_capture;
   // Input DataChannel manager (kept alive)
   std::shared_ptr<remote::data_channel::InputDataManager> input_dm;
+  // Files and clipboard contents ("bulk" DataChannel)
+  auto bulk_dm = std::make_shared<remote::data_channel::BulkDataManager>();
+  bulk_dm->SetReceiveDirectory(args.bulk_dir);
   // Input dispatcher (distributes DataChannel messages to injector/overlay)
   std::unique_ptr<remote::input_receiver::InputDispatcher> input_dispatcher;
   // Receiver (use_sdl=true) does not perform local injection, uses empty injector
@@ -416,8 +465,24 @@ int RunMomoApp(int argc, char* argv[]) {
   std::unique_ptr<remote::platform::windows::CursorMonitorWin> cursor_monitor;
 #endif
   if (args.use_sdl) {
+    // Low latency: tearing is preferred over waiting for the next vblank
+    if (args.low_latency) {
+      SDL_SetHint(SDL_HINT_RENDER_VSYNC, "0");
+    }
     sdl_renderer.reset(new SDLRenderer(args.window_width, args.window_height,
                                        args.fullscreen));
+    int audio_target_latency = args.audio_target_latency;
+    if (args.low_latency) {
+      audio_target_latency =
+          std::min(audio_target_latency, kLowLatencyAudioTargetMs);
+      sdl_renderer->SetRenderOnArrival(true);
+      auto& registry = MetricsRegistry::Instance();
+      registry.Set("low_latency", "vsync", 0);
+      registry.Set("low_latency", "render_on_arrival", 1);
+      registry.Set("low_latency", "audio_target_ms", audio_target_latency);
+      registry.Set("low_latency", "input_motion_coalescing", 1);
+    }
+    sdl_renderer->SetAudioTargetLatency(audio_target_latency);
 
     // Instantiate the overlay and input capture skeleton
     overlay_renderer = std::make_unique<remote::overlay::OverlayRenderer>();
@@ -426,6 +491,7 @@ int RunMomoApp(int argc, char* argv[]) {
 
     // Set SDL window for relative mouse mode (SDL3 requires window pointer)
     sdl_input_capture->SetWindow(sdl_renderer->GetWindow());
+    sdl_input_capture->SetCoalesceMotion(args.low_latency);
 
     // Auto-switch mouse mode based on cursor visibility (FPS game support)
     overlay_renderer->SetMouseModeCallback(
@@ -447,8 +513,15 @@ int RunMomoApp(int argc, char* argv[]) {
     // Register event hooks: first give to the overlay layer (virtual keyboard/toolbar), then distribute to the input capture if not consumed
     sdl_renderer->SetEventHook(
         [rc = sdl_renderer.get(), cap = sdl_input_capture.get(),
-         orptr = overlay_renderer.get()](const SDL_Event& e) {
+         orptr = overlay_renderer.get(),
+         bulk = bulk_dm.get()](const SDL_Event& e) {
+          // A file dropped on the window is sent to the other side
+          if (e.type == SDL_EVENT_DROP_FILE && e.drop.data != nullptr) {
+            bulk->SendFile(e.drop.data);
+            return true;
+          }
           if (orptr && orptr->OnEvent(e)) {
+            cap->FlushMotion();
             return true;  // The overlay layer has been consumed
           }
           // Update the mapping of the current primary video rectangle and the receiver (source) frame size
@@ -471,6 +544,9 @@ int RunMomoApp(int argc, char* argv[]) {
 #ifdef _WIN32
   momo::svc::LogService("RunMomoApp: RTCManager constructed");
 #endif
+  MetricsRegistry::Instance().Set(
+      "startup", "rtc_manager_ms",
+      static_cast<double>(webrtc::TimeMillis() - start_ms));
 
   // Initial selection of audio output device (GUID priority, then index)
   if (!args.no_audio_device) {
@@ -500,9 +576,13 @@ int RunMomoApp(int argc, char* argv[]) {
 
     std::shared_ptr<RTCDataManager> data_manager = nullptr;
     if (!args.serial_device.empty()) {
+      SerialDataManagerConfig serial_config;
+      serial_config.device = args.serial_device;
+      serial_config.rate = args.serial_rate;
+      serial_config.raw = args.serial_raw;
+      serial_config.batch_ms = args.serial_batch_ms;
       data_manager = std::shared_ptr<RTCDataManager>(
-          SerialDataManager::Create(ioc, args.serial_device, args.serial_rate)
-              .release());
+          SerialDataManager::Create(ioc, serial_config).release());
       if (!data_manager) {
         return 1;
       }
@@ -512,6 +592,7 @@ int RunMomoApp(int argc, char* argv[]) {
     // Add input DataChannel manager skeleton (input-reliable / input-rt)
     input_dm = std::make_shared<remote::data_channel::InputDataManager>();
     rtc_manager->AddDataManager(input_dm);
+    rtc_manager->AddDataManager(bulk_dm);
 
     if (args.use_sdl) {
       // Receiver (use_sdl=true): responsible for sending control events, displaying remote cursor/IME, does not perform local injection
@@ -579,6 +660,11 @@ int RunMomoApp(int argc, char* argv[]) {
           std::make_unique<remote::input_receiver::InputDispatcher>(
               &null_injector, nullptr);
 #endif
+      // Answer the viewer's inputPing (input RTT on the performance HUD)
+      input_dispatcher->SetReplySender(
+          [mgr = input_dm](const std::vector<uint8_t>& bytes) {
+            return mgr->SendReliable(bytes);
+          });
       input_dm->SetOnMessage(
           [disp = input_dispatcher.get()](const uint8_t* data, size_t len,
                                           bool is_binary) {
@@ -720,6 +806,65 @@ int RunMomoApp(int argc, char* argv[]) {
           ->Run();
     }
 
+    // Performance HUD: pull stats and ping the input channel once a second,
+    // only while the HUD is shown
+    boost::asio::steady_timer perf_hud_timer(ioc);
+    std::function<void()> schedule_perf_hud;
+    if (overlay_renderer) {
+      auto sampler = std::make_shared<remote::overlay::PerfStatsSampler>(
+          &overlay_renderer->GetPerfHud());
+      schedule_perf_hud = [&, sampler]() {
+        perf_hud_timer.expires_after(std::chrono::seconds(1));
+        perf_hud_timer.async_wait(
+            [&, sampler](const boost::system::error_code& ec) {
+              if (ec) {
+                return;
+              }
+              if (overlay_renderer->GetPerfHud().IsVisible()) {
+                if (stats_collector) {
+                  stats_collector->GetStats(
+                      [sampler](const webrtc::scoped_refptr<
+                                const webrtc::RTCStatsReport>& report) {
+                        sampler->OnReport(report);
+                      });
+                }
+                input_dm->SendReliable(remote::proto::SerializeInputPing(
+                    remote::overlay::PerfHud::NowMs()));
+              }
+              schedule_perf_hud();
+            });
+      };
+      schedule_perf_hud();
+    }
+
+    // --network-adaptation: the same 1 second stats pull, feeding the
+    // controller instead of the HUD
+    boost::asio::steady_timer adaptation_timer(ioc);
+    std::function<void()> schedule_adaptation;
+    if (args.network_adaptation && stats_collector) {
+      auto controller = std::make_shared<DesktopAdaptationController>(
+          rtc_manager.get(), args.framerate);
+      schedule_adaptation = [&, controller]() {
+        adaptation_timer.expires_after(std::chrono::seconds(1));
+        adaptation_timer.async_wait(
+            [&, controller](const boost::system::error_code& ec) {
+              if (ec) {
+                return;
+              }
+              stats_collector->GetStats(
+                  [controller](const webrtc::scoped_refptr<
+                               const webrtc::RTCStatsReport>& report) {
+                    controller->OnReport(report);
+                  });
+              schedule_adaptation();
+            });
+      };
+      schedule_adaptation();
+    }
+
+    MetricsRegistry::Instance().Set(
+        "startup", "ready_ms",
+        static_cast<double>(webrtc::TimeMillis() - start_ms));
     if (sdl_renderer) {
 #ifdef _WIN32
       momo::svc::LogService("RunMomoApp: entering SDL renderer loop");
@@ -745,6 +890,9 @@ int RunMomoApp(int argc, char* argv[]) {
   momo::svc::LogService("RunMomoApp: event loop exited");
 #endif
 
+  // Its channels go away with rtc_manager
+  bulk_dm->Shutdown();
+
   // This order is clean, but not very safe
   sdl_renderer = nullptr;
 
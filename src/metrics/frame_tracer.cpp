@@ -0,0 +1,273 @@
+#include "frame_tracer.h"
+
+#include <algorithm>
+#include <map>
+#include <string>
+#include <vector>
+
+namespace {
+
+// Lanes of the trace, one per stage
+constexpr int kFrameTid = 1;
+constexpr int kCaptureTid = 2;
+constexpr int kSourceTid = 3;
+constexpr int kQueueTid = 4;
+// + layer
+constexpr int kEncodeTid = 10;
+constexpr int kPacketizeTid = 20;
+constexpr int kMaxLayers = 4;
+
+struct TracedLayer {
+  int64_t encode_end_us = -1;
+  int64_t packetize_us = -1;
+  uint32_t size = 0;
+  int width = 0;
+  int height = 0;
+  int qp = -1;
+  bool key_frame = false;
+};
+
+struct TracedFrame {
+  int64_t capture_start_us = -1;
+  int64_t capture_end_us = -1;
+  int64_t received_us = -1;
+  int64_t adapted_us = -1;
+  int64_t encode_start_us = -1;
+  uint32_t rtp_timestamp = 0;
+  int width = 0;
+  int height = 0;
+  std::map<int, TracedLayer> layers;
+};
+
+boost::json::object CompleteEvent(const char* name,
+                                  int tid,
+                                  int64_t begin_us,
+                                  int64_t end_us,
+                                  boost::json::object args) {
+  return {{"name", name},
+          {"cat", "video"},
+          {"ph", "X"},
+          {"pid", 1},
+          {"tid", tid},
+          {"ts", begin_us},
+          {"dur", std::max<int64_t>(0, end_us - begin_us)},
+          {"args", std::move(args)}};
+}
+
+boost::json::object ThreadName(int tid, const std::string& name) {
+  return {{"name", "thread_name"},
+          {"ph", "M"},
+          {"pid", 1},
+          {"tid", tid},
+          {"args", {{"name", name}}}};
+}
+
+}  // namespace
+
+FrameTracer& FrameTracer::Instance() {
+  static FrameTracer instance;
+  return instance;
+}
+
+void FrameTracer::SetEnabled(bool enabled) {
+  enabled_.store(enabled, std::memory_order_relaxed);
+}
+
+void FrameTracer::Write(const FrameTraceEvent& event) {
+  const uint64_t index = next_.fetch_add(1, std::memory_order_relaxed);
+  Slot& slot = slots_[index % kCapacity];
+  // Seqlock style: readers that see the same non-zero sequence before and
+  // after copying the fields got a consistent event
+  slot.sequence.store(0, std::memory_order_relaxed);
+  std::atomic_thread_fence(std::memory_order_release);
+  slot.time_us.store(event.time_us, std::memory_order_relaxed);
+  slot.timestamp_us.store(event.timestamp_us, std::memory_order_relaxed);
+  slot.rtp_timestamp.store(event.rtp_timestamp, std::memory_order_relaxed);
+  slot.size.store(event.size, std::memory_order_relaxed);
+  slot.dimensions.store(
+      (static_cast<uint32_t>(event.width) & 0xffff) << 16 |
+          (static_cast<uint32_t>(event.height) & 0xffff),
+      std::memory_order_relaxed);
+  slot.flags.store(static_cast<uint32_t>(event.stage) |
+                       (static_cast<uint32_t>(event.layer) & 0xff) << 8 |
+                       (event.key_frame ? 1u : 0u) << 16,
+                   std::memory_order_relaxed);
+  slot.qp.store(event.qp, std::memory_order_relaxed);
+  slot.sequence.store(index + 1, std::memory_order_release);
+}
+
+boost::json::object FrameTracer::ToChromeTraceJson() const {
+  // Copy out whatever is consistent right now, oldest first
+  std::vector<FrameTraceEvent> events;
+  const uint64_t end = next_.load(std::memory_order_acquire);
+  const uint64_t begin = end > kCapacity ? end - kCapacity : 0;
+  events.reserve(end - begin);
+  for (uint64_t index = begin; index < end; index++) {
+    const Slot& slot = slots_[index % kCapacity];
+    const uint64_t sequence = slot.sequence.load(std::memory_order_acquire);
+    if (sequence != index + 1) {
+      continue;
+    }
+    FrameTraceEvent event;
+    event.time_us = slot.time_us.load(std::memory_order_relaxed);
+    event.timestamp_us = slot.timestamp_us.load(std::memory_order_relaxed);
+    event.rtp_timestamp = slot.rtp_timestamp.load(std::memory_order_relaxed);
+    event.size = slot.size.load(std::memory_order_relaxed);
+    const uint32_t dimensions = slot.dimensions.load(std::memory_order_relaxed);
+    event.width = static_cast<int>(dimensions >> 16);
+    event.height = static_cast<int>(dimensions & 0xffff);
+    const uint32_t flags = slot.flags.load(std::memory_order_relaxed);
+    event.stage = static_cast<FrameTraceStage>(flags & 0xff);
+    event.layer = static_cast<int>((flags >> 8) & 0xff);
+    event.key_frame = (flags >> 16) & 1;
+    event.qp = slot.qp.load(std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_acquire);
+    if (slot.sequence.load(std::memory_order_relaxed) != sequence) {
+      continue;
+    }
+    events.push_back(event);
+  }
+
+  // The capture side only knows timestamp_us, the encoded side only the RTP
+  // timestamp. kEncodeStart has both.
+  std::map<int64_t, TracedFrame> frames;
+  std::map<uint32_t, int64_t> rtp_to_frame;
+  for (const auto& event : events) {
+    if (event.stage == FrameTraceStage::kEncodeStart) {
+      rtp_to_frame[event.rtp_timestamp] = event.timestamp_us;
+    }
+  }
+  for (const auto& event : events) {
+    int64_t timestamp_us = event.timestamp_us;
+    if (event.stage == FrameTraceStage::kEncodeEnd ||
+        event.stage == FrameTraceStage::kPacketize) {
+      auto it = rtp_to_frame.find(event.rtp_timestamp);
+      if (it == rtp_to_frame.end()) {
+        continue;
+      }
+      timestamp_us = it->second;
+    }
+    TracedFrame& frame = frames[timestamp_us];
+    switch (event.stage) {
+      case FrameTraceStage::kCaptureStart:
+        frame.capture_start_us = event.time_us;
+        break;
+      case FrameTraceStage::kCaptureEnd:
+        frame.capture_end_us = event.time_us;
+        break;
+      case FrameTraceStage::kSourceReceived:
+        frame.received_us = event.time_us;
+        break;
+      case FrameTraceStage::kSourceAdapted:
+        frame.adapted_us = event.time_us;
+        frame.width = event.width;
+        frame.height = event.height;
+        break;
+      case FrameTraceStage::kEncodeStart:
+        frame.encode_start_us = event.time_us;
+        frame.rtp_timestamp = event.rtp_timestamp;
+        if (frame.width == 0) {
+          frame.width = event.width;
+          frame.height = event.height;
+        }
+        break;
+      case FrameTraceStage::kEncodeEnd: {
+        TracedLayer& layer = frame.layers[event.layer];
+        layer.encode_end_us = event.time_us;
+        layer.size = event.size;
+        layer.width = event.width;
+        layer.height = event.height;
+        layer.qp = event.qp;
+        layer.key_frame = event.key_frame;
+        break;
+      }
+      case FrameTraceStage::kPacketize: {
+        TracedLayer& layer = frame.layers[event.layer];
+        // Only the first time the layer reached the packetizer
+        if (layer.packetize_us < 0) {
+          layer.packetize_us = event.time_us;
+        }
+        break;
+      }
+    }
+  }
+
+  boost::json::array trace_events;
+  trace_events.push_back(ThreadName(kFrameTid, "frame"));
+  trace_events.push_back(ThreadName(kCaptureTid, "capture"));
+  trace_events.push_back(ThreadName(kSourceTid, "source"));
+  trace_events.push_back(ThreadName(kQueueTid, "encoder queue"));
+  for (int i = 0; i < kMaxLayers; i++) {
+    trace_events.push_back(
+        ThreadName(kEncodeTid + i, "encode L" + std::to_string(i)));
+    trace_events.push_back(
+        ThreadName(kPacketizeTid + i, "packetize L" + std::to_string(i)));
+  }
+
+  for (const auto& [timestamp_us, frame] : frames) {
+    int64_t first_us = -1;
+    int64_t last_us = -1;
+    auto extend = [&first_us, &last_us](int64_t time_us) {
+      if (time_us < 0) {
+        return;
+      }
+      first_us = first_us < 0 ? time_us : std::min(first_us, time_us);
+      last_us = std::max(last_us, time_us);
+    };
+    extend(frame.capture_start_us);
+    extend(frame.capture_end_us);
+    extend(frame.received_us);
+    extend(frame.adapted_us);
+    extend(frame.encode_start_us);
+
+    if (frame.capture_start_us >= 0 && frame.capture_end_us >= 0) {
+      trace_events.push_back(CompleteEvent("capture", kCaptureTid,
+                                           frame.capture_start_us,
+                                           frame.capture_end_us, {}));
+    }
+    if (frame.received_us >= 0 && frame.adapted_us >= 0) {
+      trace_events.push_back(CompleteEvent(
+          "adapt", kSourceTid, frame.received_us, frame.adapted_us,
+          {{"width", frame.width}, {"height", frame.height}}));
+    }
+    const int64_t ready_us =
+        std::max(frame.capture_end_us, frame.adapted_us);
+    if (ready_us >= 0 && frame.encode_start_us >= 0) {
+      trace_events.push_back(CompleteEvent("queue", kQueueTid, ready_us,
+                                           frame.encode_start_us, {}));
+    }
+    uint64_t total_size = 0;
+    for (const auto& [index, layer] : frame.layers) {
+      const int tid = std::min(index, kMaxLayers - 1);
+      extend(layer.encode_end_us);
+      extend(layer.packetize_us);
+      total_size += layer.size;
+      if (frame.encode_start_us >= 0 && layer.encode_end_us >= 0) {
+        trace_events.push_back(CompleteEvent(
+            layer.key_frame ? "encode (key)" : "encode", kEncodeTid + tid,
+            frame.encode_start_us, layer.encode_end_us,
+            {{"bytes", layer.size},
+             {"key_frame", layer.key_frame},
+             {"qp", layer.qp},
+             {"width", layer.width},
+             {"height", layer.height}}));
+      }
+      if (layer.encode_end_us >= 0 && layer.packetize_us >= 0) {
+        trace_events.push_back(CompleteEvent("packetize", kPacketizeTid + tid,
+                                             layer.encode_end_us,
+                                             layer.packetize_us, {}));
+      }
+    }
+    if (first_us >= 0) {
+      trace_events.push_back(CompleteEvent(
+          "frame", kFrameTid, first_us, last_us,
+          {{"timestamp_us", timestamp_us},
+           {"rtp_timestamp", frame.rtp_timestamp},
+           {"bytes", total_size},
+           {"latency_ms", (last_us - first_us) / 1000.0}}));
+    }
+  }
+
+  return {{"traceEvents", std::move(trace_events)},
+          {"displayTimeUnit", "ms"}};
+}
@@ -0,0 +1,97 @@
+#ifndef FRAME_TRACER_H_
+#define FRAME_TRACER_H_
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+
+// Boost
+#include <boost/json.hpp>
+
+enum class FrameTraceStage : uint8_t {
+  // ScreenVideoCapturer: desktop grab and conversion to I420
+  kCaptureStart,
+  kCaptureEnd,
+  // ScalableVideoTrackSource: frame handed over by a capturer, and delivered
+  // after rotation / scaling
+  kSourceReceived,
+  kSourceAdapted,
+  // AlignedEncoderAdapter: frame handed to the encoder, and each encoded
+  // layer coming back
+  kEncodeStart,
+  kEncodeEnd,
+  // Encoded frame handed to the RTP packetizer of the video sender
+  kPacketize,
+};
+
+struct FrameTraceEvent {
+  FrameTraceStage stage = FrameTraceStage::kCaptureStart;
+  // webrtc::TimeMicros() when the stage was reached
+  int64_t time_us = 0;
+  // VideoFrame::timestamp_us() of the frame, 0 where it is not known
+  int64_t timestamp_us = 0;
+  // RTP timestamp, 0 before the frame reached the encoder
+  uint32_t rtp_timestamp = 0;
+  // Encoded size in bytes
+  uint32_t size = 0;
+  int width = 0;
+  int height = 0;
+  // Simulcast (or spatial) layer of kEncodeEnd and kPacketize
+  int layer = 0;
+  int qp = -1;
+  bool key_frame = false;
+};
+
+// Per-frame timestamps of the send pipeline, from capture through encode to
+// packetization, for attributing latency to a specific stage.
+//
+// Disabled unless --frame-trace is given, Record() is a single relaxed load
+// then. When enabled, the last kCapacity events are kept in a lock-free ring
+// buffer: writers claim a slot with one fetch_add and never wait, the reader
+// (/trace of MetricsServer) skips slots that are being overwritten.
+class FrameTracer {
+ public:
+  static FrameTracer& Instance();
+
+  void SetEnabled(bool enabled);
+  bool IsEnabled() const { return enabled_.load(std::memory_order_relaxed); }
+
+  void Record(const FrameTraceEvent& event) {
+    if (IsEnabled()) {
+      Write(event);
+    }
+  }
+
+  // Chrome trace event format, load it in chrome://tracing or Perfetto.
+  // Events of the same frame are joined by timestamp_us and rtp_timestamp
+  // into one span per stage.
+  boost::json::object ToChromeTraceJson() const;
+
+ private:
+  FrameTracer() = default;
+
+  // 60fps with 3 simulcast layers fills this in about 20 seconds
+  static constexpr size_t kCapacity = 16384;
+
+  struct Slot {
+    // Index of the event + 1, 0 while it is being written
+    std::atomic<uint64_t> sequence{0};
+    std::atomic<int64_t> time_us{0};
+    std::atomic<int64_t> timestamp_us{0};
+    std::atomic<uint32_t> rtp_timestamp{0};
+    std::atomic<uint32_t> size{0};
+    // width << 16 | height
+    std::atomic<uint32_t> dimensions{0};
+    // stage | layer << 8 | key_frame << 16
+    std::atomic<uint32_t> flags{0};
+    std::atomic<int32_t> qp{-1};
+  };
+
+  void Write(const FrameTraceEvent& event);
+
+  std::atomic<bool> enabled_{false};
+  std::atomic<uint64_t> next_{0};
+  std::array<Slot, kCapacity> slots_;
+};
+
+#endif
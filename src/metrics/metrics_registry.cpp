@@ -0,0 +1,70 @@
+#include "metrics_registry.h"
+
+#include <cstdio>
+
+namespace {
+
+// Prometheus metric names only allow [a-zA-Z0-9_:]
+std::string SanitizeName(const std::string& name) {
+  std::string result = name;
+  for (char& c : result) {
+    if (!((c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') ||
+          (c >= '0' && c <= '9') || c == '_')) {
+      c = '_';
+    }
+  }
+  return result;
+}
+
+}  // namespace
+
+MetricsRegistry& MetricsRegistry::Instance() {
+  static MetricsRegistry instance;
+  return instance;
+}
+
+void MetricsRegistry::Set(const std::string& group,
+                          const std::string& name,
+                          double value) {
+  webrtc::MutexLock lock(&mutex_);
+  values_[group][name] = value;
+}
+
+void MetricsRegistry::Add(const std::string& group,
+                          const std::string& name,
+                          double delta) {
+  webrtc::MutexLock lock(&mutex_);
+  values_[group][name] += delta;
+}
+
+void MetricsRegistry::Clear(const std::string& group) {
+  webrtc::MutexLock lock(&mutex_);
+  values_.erase(group);
+}
+
+boost::json::object MetricsRegistry::ToJson() const {
+  webrtc::MutexLock lock(&mutex_);
+  boost::json::object result;
+  for (const auto& group : values_) {
+    boost::json::object obj;
+    for (const auto& value : group.second) {
+      obj[value.first] = value.second;
+    }
+    result[group.first] = std::move(obj);
+  }
+  return result;
+}
+
+std::string MetricsRegistry::ToPrometheus() const {
+  webrtc::MutexLock lock(&mutex_);
+  std::string result;
+  char value[32];
+  for (const auto& group : values_) {
+    const std::string prefix = "momo_" + SanitizeName(group.first) + "_";
+    for (const auto& v : group.second) {
+      std::snprintf(value, sizeof(value), "%.15g", v.second);
+      result += prefix + SanitizeName(v.first) + " " + value + "\n";
+    }
+  }
+  return result;
+}
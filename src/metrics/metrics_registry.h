@@ -0,0 +1,43 @@
+#ifndef METRICS_REGISTRY_H_
+#define METRICS_REGISTRY_H_
+
+#include <map>
+#include <string>
+
+// Boost
+#include <boost/json.hpp>
+
+// WebRTC
+#include <rtc_base/synchronization/mutex.h>
+
+// Process-wide counters and gauges for Momo's own pipeline components
+// (audio playout, encoders, data channels, ...).
+//
+// RTCStatsReport only covers what libwebrtc knows about, so components that
+// live outside of it publish their numbers here, grouped by component name.
+// MetricsSession reports them under the "momo" field of /metrics.
+class MetricsRegistry {
+ public:
+  static MetricsRegistry& Instance();
+
+  // Overwrite the value (gauge)
+  void Set(const std::string& group, const std::string& name, double value);
+  // Add to the value (counter)
+  void Add(const std::string& group, const std::string& name, double delta);
+  // Remove every value of the group (e.g. when the component is destroyed)
+  void Clear(const std::string& group);
+
+  // {"<group>": {"<name>": <value>, ...}, ...}
+  boost::json::object ToJson() const;
+  // One untyped sample "momo_<group>_<name> <value>" per value, in the
+  // Prometheus text exposition format
+  std::string ToPrometheus() const;
+
+ private:
+  MetricsRegistry() = default;
+
+  mutable webrtc::Mutex mutex_;
+  std::map<std::string, std::map<std::string, double>> values_;
+};
+
+#endif
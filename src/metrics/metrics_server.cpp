@@ -10,6 +10,8 @@ MetricsServer::MetricsServer(boost::asio::io_context& ioc,
       socket_(ioc),
       rtc_manager_(rtc_manager),
       stats_collector_(stats_collector),
+      snapshot_(MetricsSnapshot::Create(ioc, stats_collector)),
+      stream_(MetricsStream::Create(snapshot_)),
       config_(config) {
   boost::system::error_code ec;
 
@@ -61,8 +63,8 @@ void MetricsServer::OnAccept(boost::system::error_code ec) {
   }
 
   MetricsSessionConfig config;
-  MetricsSession::Create(ioc_, std::move(socket_), rtc_manager_,
-                         stats_collector_, std::move(config))
+  MetricsSession::Create(ioc_, std::move(socket_), rtc_manager_, snapshot_,
+                         stream_, std::move(config))
       ->Run();
 
   DoAccept();
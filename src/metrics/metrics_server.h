@@ -9,6 +9,8 @@
 #include <boost/system/error_code.hpp>
 
 #include "metrics_session.h"
+#include "metrics_snapshot.h"
+#include "metrics_stream.h"
 #include "rtc/rtc_manager.h"
 #include "stats_collector.h"
 #include "util.h"
@@ -46,6 +48,9 @@ class MetricsServer : public std::enable_shared_from_this<MetricsServer> {
   RTCManager* rtc_manager_;
   MetricsServerConfig config_;
   std::shared_ptr<StatsCollector> stats_collector_;
+  // Shared by every session
+  std::shared_ptr<MetricsSnapshot> snapshot_;
+  std::shared_ptr<MetricsStream> stream_;
 };
 
 #endif
@@ -13,19 +13,23 @@
 #include <codecvt>
 #endif
 
+#include "frame_tracer.h"
+#include "metrics_registry.h"
 #include "momo_version.h"
 #include "util.h"
 
 MetricsSession::MetricsSession(boost::asio::io_context& ioc,
                                boost::asio::ip::tcp::socket socket,
                                RTCManager* rtc_manager,
-                               std::shared_ptr<StatsCollector> stats_collector,
+                               std::shared_ptr<MetricsSnapshot> snapshot,
+                               std::shared_ptr<MetricsStream> stream,
                                MetricsSessionConfig config)
     : ioc_(ioc),
       socket_(std::move(socket)),
       strand_(socket_.get_executor()),
       rtc_manager_(rtc_manager),
-      stats_collector_(stats_collector),
+      snapshot_(std::move(snapshot)),
+      stream_(std::move(stream)),
       config_(std::move(config)) {}
 
 // Start the asynchronous operation
@@ -58,21 +62,54 @@ void MetricsSession::OnRead(boost::system::error_code ec,
     return MOMO_BOOST_ERROR(ec, "read");
 
   if (req_.method() == boost::beast::http::verb::get) {
-    if (req_.target() == "/metrics") {
+    std::string_view target = req_.target();
+    std::string_view query;
+    if (auto pos = target.find('?'); pos != std::string_view::npos) {
+      query = target.substr(pos + 1);
+      target = target.substr(0, pos);
+    }
+    if (target == "/metrics/stream") {
+      // The connection belongs to the stream from now on
+      stream_->Subscribe(std::move(socket_), MetricsStream::ParseFilter(query));
+    } else if (target == "/metrics") {
       std::shared_ptr<MetricsSession> self(shared_from_this());
-      stats_collector_->GetStats(
-          [self](const webrtc::scoped_refptr<const webrtc::RTCStatsReport>&
-                     report) {
-            std::string stats = report ? report->ToJson() : "[]";
-            boost::json::value json_message = {
+      snapshot_->Get(
+          [self](std::shared_ptr<const MetricsSnapshot::Snapshot> snapshot) {
+            // The stats are already JSON, put them in as they are instead of
+            // parsing and serializing them again
+            boost::json::object header = {
                 {"version", MomoVersion::GetClientName()},
                 {"libwebrtc", MomoVersion::GetLibwebrtcName()},
                 {"environment", MomoVersion::GetEnvironmentName()},
-                {"stats", boost::json::parse(stats)}};
-
+                {"momo", MetricsRegistry::Instance().ToJson()}};
+            std::string body = boost::json::serialize(header);
+            body.pop_back();
+            body += ",\"stats\":";
+            body += snapshot->stats_json;
+            body += "}";
             self->SendResponse(
-                CreateOKWithJSON(self->req_, std::move(json_message)));
+                CreateOK(self->req_, "application/json", std::move(body)));
+          });
+    } else if (target == "/metrics/prometheus") {
+      std::shared_ptr<MetricsSession> self(shared_from_this());
+      snapshot_->Get(
+          [self](std::shared_ptr<const MetricsSnapshot::Snapshot> snapshot) {
+            std::string body =
+                "# HELP momo_info Version of Momo\n"
+                "# TYPE momo_info gauge\n"
+                "momo_info{version=\"" +
+                MomoVersion::GetClientName() + "\",libwebrtc=\"" +
+                MomoVersion::GetLibwebrtcName() + "\"} 1\n";
+            body += snapshot->prometheus;
+            body += MetricsRegistry::Instance().ToPrometheus();
+            self->SendResponse(CreateOK(self->req_,
+                                        "text/plain; version=0.0.4",
+                                        std::move(body)));
           });
+    } else if (target == "/trace" &&
+               FrameTracer::Instance().IsEnabled()) {
+      SendResponse(
+          CreateOKWithJSON(req_, FrameTracer::Instance().ToChromeTraceJson()));
     } else {
       SendResponse(Util::NotFound(req_, req_.target()));
     }
@@ -116,3 +153,19 @@ MetricsSession::CreateOKWithJSON(
 
   return res;
 }
+
+boost::beast::http::response<boost::beast::http::string_body>
+MetricsSession::CreateOK(
+    const boost::beast::http::request<boost::beast::http::string_body>& req,
+    const char* content_type,
+    std::string body) {
+  boost::beast::http::response<boost::beast::http::string_body> res{
+      boost::beast::http::status::ok, 11};
+  res.set(boost::beast::http::field::server, BOOST_BEAST_VERSION_STRING);
+  res.set(boost::beast::http::field::content_type, content_type);
+  res.keep_alive(req.keep_alive());
+  res.body() = std::move(body);
+  res.prepare_payload();
+
+  return res;
+}
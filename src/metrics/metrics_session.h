@@ -16,8 +16,9 @@
 #include <boost/beast/http/write.hpp>
 #include <boost/json.hpp>
 
+#include "metrics_snapshot.h"
+#include "metrics_stream.h"
 #include "rtc/rtc_manager.h"
-#include "stats_collector.h"
 #include "util.h"
 
 struct MetricsSessionConfig {};
@@ -27,7 +28,8 @@ class MetricsSession : public std::enable_shared_from_this<MetricsSession> {
   MetricsSession(boost::asio::io_context& ioc,
                  boost::asio::ip::tcp::socket socket,
                  RTCManager* rtc_manager,
-                 std::shared_ptr<StatsCollector> stats_collector,
+                 std::shared_ptr<MetricsSnapshot> snapshot,
+                 std::shared_ptr<MetricsStream> stream,
                  MetricsSessionConfig config);
 
  public:
@@ -35,11 +37,12 @@ class MetricsSession : public std::enable_shared_from_this<MetricsSession> {
       boost::asio::io_context& ioc,
       boost::asio::ip::tcp::socket socket,
       RTCManager* rtc_manager,
-      std::shared_ptr<StatsCollector> stats_collector,
+      std::shared_ptr<MetricsSnapshot> snapshot,
+      std::shared_ptr<MetricsStream> stream,
       MetricsSessionConfig config) {
-    return std::shared_ptr<MetricsSession>(
-        new MetricsSession(ioc, std::move(socket), rtc_manager, stats_collector,
-                           std::move(config)));
+    return std::shared_ptr<MetricsSession>(new MetricsSession(
+        ioc, std::move(socket), rtc_manager, std::move(snapshot),
+        std::move(stream), std::move(config)));
   }
   void Run();
 
@@ -51,6 +54,11 @@ class MetricsSession : public std::enable_shared_from_this<MetricsSession> {
   CreateOKWithJSON(
       const boost::beast::http::request<boost::beast::http::string_body>& req,
       boost::json::value json_message);
+  static boost::beast::http::response<boost::beast::http::string_body>
+  CreateOK(
+      const boost::beast::http::request<boost::beast::http::string_body>& req,
+      const char* content_type,
+      std::string body);
 
   template <class Body, class Fields>
   void SendResponse(boost::beast::http::response<Body, Fields> msg) {
@@ -83,7 +91,8 @@ class MetricsSession : public std::enable_shared_from_this<MetricsSession> {
 
   RTCManager* rtc_manager_;
   MetricsSessionConfig config_;
-  std::shared_ptr<StatsCollector> stats_collector_;
+  std::shared_ptr<MetricsSnapshot> snapshot_;
+  std::shared_ptr<MetricsStream> stream_;
 };
 
 #endif  // METRICS_SESSION_H_
@@ -0,0 +1,327 @@
+#include "metrics_snapshot.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <optional>
+#include <string>
+
+// Boost
+#include <boost/asio/post.hpp>
+
+// WebRTC
+#include <api/stats/rtcstats_objects.h>
+#include <rtc_base/time_utils.h>
+
+namespace {
+
+constexpr int kRefreshIntervalMs = 1000;
+// Stop refreshing when nobody asked for this long
+constexpr int64_t kIdleTimeoutMs = 30000;
+
+const char* const kKinds[] = {"audio", "video"};
+
+int KindIndex(const std::optional<std::string>& kind) {
+  return kind.value_or("") == "video" ? 1 : 0;
+}
+
+std::string FormatValue(double value) {
+  char buf[32];
+  std::snprintf(buf, sizeof(buf), "%.15g", value);
+  return buf;
+}
+
+void AddHeader(std::string* out,
+               const char* name,
+               const char* type,
+               const char* help) {
+  *out += std::string("# HELP ") + name + " " + help + "\n";
+  *out += std::string("# TYPE ") + name + " " + type + "\n";
+}
+
+void AddSample(std::string* out, const char* name, double value) {
+  *out += std::string(name) + " " + FormatValue(value) + "\n";
+}
+
+void AddKindSample(std::string* out,
+                   const char* name,
+                   int kind,
+                   double value) {
+  *out += std::string(name) + "{kind=\"" + kKinds[kind] + "\"} " +
+          FormatValue(value) + "\n";
+}
+
+}  // namespace
+
+MetricsSnapshot::MetricsSnapshot(
+    boost::asio::io_context& ioc,
+    std::shared_ptr<StatsCollector> stats_collector)
+    : ioc_(ioc), timer_(ioc), stats_collector_(std::move(stats_collector)) {}
+
+void MetricsSnapshot::Get(Callback callback) {
+  last_request_ms_ = webrtc::TimeMillis();
+  if (!refreshing_) {
+    refreshing_ = true;
+    ScheduleRefresh();
+  }
+  if (snapshot_) {
+    callback(snapshot_);
+    return;
+  }
+  waiting_.push_back(std::move(callback));
+  Collect();
+}
+
+void MetricsSnapshot::SetListener(Callback listener) {
+  listener_ = std::move(listener);
+  if (listener_ && !refreshing_) {
+    refreshing_ = true;
+    ScheduleRefresh();
+    Collect();
+  }
+}
+
+void MetricsSnapshot::ScheduleRefresh() {
+  timer_.expires_after(std::chrono::milliseconds(kRefreshIntervalMs));
+  timer_.async_wait(
+      [self = shared_from_this()](const boost::system::error_code& ec) {
+        if (ec) {
+          return;
+        }
+        if (!self->listener_ &&
+            webrtc::TimeMillis() - self->last_request_ms_ > kIdleTimeoutMs) {
+          // The next request waits for fresh stats instead of getting these
+          self->refreshing_ = false;
+          self->snapshot_ = nullptr;
+          self->has_prev_ = false;
+          return;
+        }
+        self->Collect();
+        self->ScheduleRefresh();
+      });
+}
+
+void MetricsSnapshot::Collect() {
+  if (collecting_) {
+    return;
+  }
+  collecting_ = true;
+  if (!stats_collector_) {
+    OnReport(nullptr);
+    return;
+  }
+  std::weak_ptr<MetricsSnapshot> weak = shared_from_this();
+  stats_collector_->GetStats(
+      [weak](
+          const webrtc::scoped_refptr<const webrtc::RTCStatsReport>& report) {
+        // Signaling thread
+        if (auto self = weak.lock()) {
+          boost::asio::post(self->ioc_,
+                            [self, report]() { self->OnReport(report); });
+        }
+      });
+}
+
+void MetricsSnapshot::OnReport(
+    const webrtc::scoped_refptr<const webrtc::RTCStatsReport>& report) {
+  collecting_ = false;
+  auto snapshot = std::make_shared<Snapshot>();
+  snapshot->stats_json = report ? report->ToJson() : "[]";
+  snapshot->prometheus = ToPrometheus(report.get());
+  snapshot_ = snapshot;
+
+  auto waiting = std::move(waiting_);
+  waiting_.clear();
+  for (auto& callback : waiting) {
+    callback(snapshot_);
+  }
+  if (listener_) {
+    // The listener may remove itself
+    auto listener = listener_;
+    listener(snapshot_);
+  }
+}
+
+std::string MetricsSnapshot::ToPrometheus(
+    const webrtc::RTCStatsReport* report) {
+  std::string out;
+  if (report == nullptr) {
+    has_prev_ = false;
+    AddHeader(&out, "momo_rtc_connected", "gauge",
+              "Established connections");
+    AddSample(&out, "momo_rtc_connected", 0);
+    return out;
+  }
+
+  Totals now;
+  now.timestamp_us = report->timestamp().us();
+  double sent_fps = 0;
+  double received_fps = 0;
+  double packets_lost[2] = {0, 0};
+  double frames_dropped = 0;
+  double remote_loss[2] = {0, 0};
+  for (const auto* s :
+       report->GetStatsOfType<webrtc::RTCOutboundRtpStreamStats>()) {
+    const int kind = KindIndex(s->kind);
+    now.bytes_sent[kind] += static_cast<double>(s->bytes_sent.value_or(0));
+    if (kind == 1) {
+      now.frames_encoded += static_cast<double>(s->frames_encoded.value_or(0));
+      now.total_encode_time += s->total_encode_time.value_or(0.0);
+      sent_fps = std::max(sent_fps, s->frames_per_second.value_or(0.0));
+    }
+  }
+  for (const auto* s :
+       report->GetStatsOfType<webrtc::RTCInboundRtpStreamStats>()) {
+    const int kind = KindIndex(s->kind);
+    now.bytes_received[kind] +=
+        static_cast<double>(s->bytes_received.value_or(0));
+    now.jitter_buffer_delay[kind] += s->jitter_buffer_delay.value_or(0.0);
+    now.jitter_buffer_emitted_count[kind] +=
+        static_cast<double>(s->jitter_buffer_emitted_count.value_or(0));
+    packets_lost[kind] += static_cast<double>(s->packets_lost.value_or(0));
+    if (kind == 1) {
+      now.frames_decoded += static_cast<double>(s->frames_decoded.value_or(0));
+      now.total_decode_time += s->total_decode_time.value_or(0.0);
+      frames_dropped += static_cast<double>(s->frames_dropped.value_or(0));
+      received_fps =
+          std::max(received_fps, s->frames_per_second.value_or(0.0));
+    }
+  }
+  for (const auto* s :
+       report->GetStatsOfType<webrtc::RTCRemoteInboundRtpStreamStats>()) {
+    const int kind = KindIndex(s->kind);
+    remote_loss[kind] =
+        std::max(remote_loss[kind], s->fraction_lost.value_or(0.0));
+  }
+  int connected = 0;
+  double rtt = -1;
+  double available_outgoing = -1;
+  for (const auto* s :
+       report->GetStatsOfType<webrtc::RTCIceCandidatePairStats>()) {
+    if (!s->nominated.value_or(false) ||
+        s->state.value_or("") != "succeeded") {
+      continue;
+    }
+    connected++;
+    // The worst viewer when several are connected (P2P)
+    rtt = std::max(rtt, s->current_round_trip_time.value_or(-1.0));
+    if (s->available_outgoing_bitrate.has_value()) {
+      available_outgoing = available_outgoing < 0
+                               ? *s->available_outgoing_bitrate
+                               : std::min(available_outgoing,
+                                          *s->available_outgoing_bitrate);
+    }
+  }
+
+  AddHeader(&out, "momo_rtc_connected", "gauge", "Established connections");
+  AddSample(&out, "momo_rtc_connected", connected);
+
+  if (rtt >= 0) {
+    AddHeader(&out, "momo_rtc_rtt_seconds", "gauge",
+              "Round trip time of the selected candidate pair");
+    AddSample(&out, "momo_rtc_rtt_seconds", rtt);
+  }
+  if (available_outgoing >= 0) {
+    AddHeader(&out, "momo_rtc_available_outgoing_bitrate_bps", "gauge",
+              "Send bandwidth estimate");
+    AddSample(&out, "momo_rtc_available_outgoing_bitrate_bps",
+              available_outgoing);
+  }
+
+  // Every sample of a metric has to follow its header
+  AddHeader(&out, "momo_rtc_sent_bytes_total", "counter",
+            "Payload bytes sent");
+  for (int kind = 0; kind < 2; kind++) {
+    AddKindSample(&out, "momo_rtc_sent_bytes_total", kind,
+                  now.bytes_sent[kind]);
+  }
+  AddHeader(&out, "momo_rtc_received_bytes_total", "counter",
+            "Payload bytes received");
+  for (int kind = 0; kind < 2; kind++) {
+    AddKindSample(&out, "momo_rtc_received_bytes_total", kind,
+                  now.bytes_received[kind]);
+  }
+  AddHeader(&out, "momo_rtc_packets_lost_total", "counter",
+            "Packets of the received streams that were lost");
+  for (int kind = 0; kind < 2; kind++) {
+    AddKindSample(&out, "momo_rtc_packets_lost_total", kind,
+                  packets_lost[kind]);
+  }
+  AddHeader(&out, "momo_rtc_remote_loss_ratio", "gauge",
+            "Loss of the sent streams reported by the receiver, 0 to 1");
+  for (int kind = 0; kind < 2; kind++) {
+    AddKindSample(&out, "momo_rtc_remote_loss_ratio", kind,
+                  remote_loss[kind]);
+  }
+
+  AddHeader(&out, "momo_rtc_sent_frames_per_second", "gauge",
+            "Frame rate of the sent video");
+  AddSample(&out, "momo_rtc_sent_frames_per_second", sent_fps);
+  AddHeader(&out, "momo_rtc_received_frames_per_second", "gauge",
+            "Frame rate of the received video");
+  AddSample(&out, "momo_rtc_received_frames_per_second", received_fps);
+  AddHeader(&out, "momo_rtc_frames_encoded_total", "counter",
+            "Video frames encoded");
+  AddSample(&out, "momo_rtc_frames_encoded_total", now.frames_encoded);
+  AddHeader(&out, "momo_rtc_frames_decoded_total", "counter",
+            "Video frames decoded");
+  AddSample(&out, "momo_rtc_frames_decoded_total", now.frames_decoded);
+  AddHeader(&out, "momo_rtc_frames_dropped_total", "counter",
+            "Received video frames dropped before decoding");
+  AddSample(&out, "momo_rtc_frames_dropped_total", frames_dropped);
+
+  // Rates over the time since the previous snapshot
+  if (has_prev_ && now.timestamp_us > prev_.timestamp_us) {
+    const double seconds = (now.timestamp_us - prev_.timestamp_us) / 1e6;
+    AddHeader(&out, "momo_rtc_sent_bitrate_bps", "gauge", "Send bitrate");
+    for (int kind = 0; kind < 2; kind++) {
+      AddKindSample(
+          &out, "momo_rtc_sent_bitrate_bps", kind,
+          std::max(0.0, now.bytes_sent[kind] - prev_.bytes_sent[kind]) * 8 /
+              seconds);
+    }
+    AddHeader(&out, "momo_rtc_received_bitrate_bps", "gauge",
+              "Receive bitrate");
+    for (int kind = 0; kind < 2; kind++) {
+      AddKindSample(&out, "momo_rtc_received_bitrate_bps", kind,
+                    std::max(0.0, now.bytes_received[kind] -
+                                      prev_.bytes_received[kind]) *
+                        8 / seconds);
+    }
+    bool has_jitter_buffer = false;
+    for (int kind = 0; kind < 2; kind++) {
+      const double emitted = now.jitter_buffer_emitted_count[kind] -
+                             prev_.jitter_buffer_emitted_count[kind];
+      if (emitted <= 0) {
+        continue;
+      }
+      if (!has_jitter_buffer) {
+        AddHeader(&out, "momo_rtc_jitter_buffer_delay_seconds", "gauge",
+                  "Average time the received samples or frames waited in "
+                  "the jitter buffer");
+        has_jitter_buffer = true;
+      }
+      AddKindSample(
+          &out, "momo_rtc_jitter_buffer_delay_seconds", kind,
+          (now.jitter_buffer_delay[kind] - prev_.jitter_buffer_delay[kind]) /
+              emitted);
+    }
+    const double encoded = now.frames_encoded - prev_.frames_encoded;
+    if (encoded > 0) {
+      AddHeader(&out, "momo_rtc_encode_time_seconds", "gauge",
+                "Average encode time of a video frame");
+      AddSample(&out, "momo_rtc_encode_time_seconds",
+                (now.total_encode_time - prev_.total_encode_time) / encoded);
+    }
+    const double decoded = now.frames_decoded - prev_.frames_decoded;
+    if (decoded > 0) {
+      AddHeader(&out, "momo_rtc_decode_time_seconds", "gauge",
+                "Average decode time of a video frame");
+      AddSample(&out, "momo_rtc_decode_time_seconds",
+                (now.total_decode_time - prev_.total_decode_time) / decoded);
+    }
+  }
+  prev_ = now;
+  has_prev_ = true;
+  return out;
+}
@@ -0,0 +1,91 @@
+#ifndef METRICS_SNAPSHOT_H_
+#define METRICS_SNAPSHOT_H_
+
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+
+// Boost
+#include <boost/asio/io_context.hpp>
+#include <boost/asio/steady_timer.hpp>
+
+// WebRTC
+#include <api/scoped_refptr.h>
+#include <api/stats/rtc_stats_report.h>
+
+#include "stats_collector.h"
+
+// Stats of the connection shared by every request of the Metrics server.
+//
+// Collecting an RTCStatsReport walks every transport, stream and codec of the
+// connection, too much to do for each scrape of each scraper. The report is
+// taken once a second while the server is being asked (and not at all when it
+// is not), and each request is answered with the latest one, already
+// serialized for /metrics and /metrics/prometheus.
+//
+// Everything runs on the io_context thread, except GetStats whose result is
+// posted back to it.
+class MetricsSnapshot : public std::enable_shared_from_this<MetricsSnapshot> {
+ public:
+  struct Snapshot {
+    // RTCStatsReport::ToJson(), "[]" without a connection
+    std::string stats_json;
+    // Curated gauges and counters in the Prometheus text exposition format
+    std::string prometheus;
+  };
+  using Callback = std::function<void(std::shared_ptr<const Snapshot>)>;
+
+  static std::shared_ptr<MetricsSnapshot> Create(
+      boost::asio::io_context& ioc,
+      std::shared_ptr<StatsCollector> stats_collector) {
+    return std::shared_ptr<MetricsSnapshot>(
+        new MetricsSnapshot(ioc, std::move(stats_collector)));
+  }
+
+  // Calls back immediately with the latest snapshot, or once the first one
+  // has been taken
+  void Get(Callback callback);
+  // Called with every new snapshot. Snapshots keep being taken while it is
+  // set, requested or not. nullptr to remove it.
+  void SetListener(Callback listener);
+
+ private:
+  MetricsSnapshot(boost::asio::io_context& ioc,
+                  std::shared_ptr<StatsCollector> stats_collector);
+
+  // Sums over the streams, to turn the cumulative counters into rates
+  struct Totals {
+    int64_t timestamp_us = 0;
+    double bytes_sent[2] = {0, 0};
+    double bytes_received[2] = {0, 0};
+    double frames_encoded = 0;
+    double total_encode_time = 0;
+    double frames_decoded = 0;
+    double total_decode_time = 0;
+    double jitter_buffer_delay[2] = {0, 0};
+    double jitter_buffer_emitted_count[2] = {0, 0};
+  };
+
+  void Collect();
+  void OnReport(
+      const webrtc::scoped_refptr<const webrtc::RTCStatsReport>& report);
+  void ScheduleRefresh();
+  std::string ToPrometheus(const webrtc::RTCStatsReport* report);
+
+  boost::asio::io_context& ioc_;
+  boost::asio::steady_timer timer_;
+  std::shared_ptr<StatsCollector> stats_collector_;
+
+  std::shared_ptr<const Snapshot> snapshot_;
+  std::vector<Callback> waiting_;
+  Callback listener_;
+  bool collecting_ = false;
+  bool refreshing_ = false;
+  int64_t last_request_ms_ = 0;
+  Totals prev_;
+  bool has_prev_ = false;
+};
+
+#endif
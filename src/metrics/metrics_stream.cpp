@@ -0,0 +1,395 @@
+#include "metrics_stream.h"
+
+#include <algorithm>
+#include <cstdlib>
+#include <deque>
+
+// Boost
+#include <boost/asio/buffer.hpp>
+#include <boost/asio/write.hpp>
+#include <boost/beast/version.hpp>
+
+// WebRTC
+#include <rtc_base/logging.h>
+#include <rtc_base/time_utils.h>
+
+#include "metrics_registry.h"
+
+namespace {
+
+constexpr int kMaxInterval = 60;
+// Events a subscriber may be behind before it is disconnected. The events
+// build on each other, a client that reconnects starts over with a snapshot.
+constexpr size_t kMaxQueuedEvents = 8;
+// Keeps proxies from closing the connection while nothing changes
+constexpr int kHeartbeatSnapshots = 15;
+
+std::string PercentDecode(std::string_view s) {
+  std::string out;
+  for (size_t i = 0; i < s.size(); i++) {
+    if (s[i] == '%' && i + 2 < s.size()) {
+      out += static_cast<char>(
+          std::strtol(std::string(s.substr(i + 1, 2)).c_str(), nullptr, 16));
+      i += 2;
+    } else if (s[i] == '+') {
+      out += ' ';
+    } else {
+      out += s[i];
+    }
+  }
+  return out;
+}
+
+std::set<std::string> SplitList(const std::string& s) {
+  std::set<std::string> out;
+  size_t begin = 0;
+  while (begin <= s.size()) {
+    size_t end = s.find(',', begin);
+    if (end == std::string::npos) {
+      end = s.size();
+    }
+    if (end > begin) {
+      out.insert(s.substr(begin, end - begin));
+    }
+    begin = end + 1;
+  }
+  return out;
+}
+
+std::string TypeOf(const boost::json::object& stats) {
+  const boost::json::value* type = stats.if_contains("type");
+  return type != nullptr && type->is_string()
+             ? std::string(type->as_string())
+             : std::string();
+}
+
+}  // namespace
+
+class MetricsStream::Subscriber
+    : public std::enable_shared_from_this<Subscriber> {
+ public:
+  Subscriber(boost::asio::ip::tcp::socket socket, Filter filter)
+      : socket_(std::move(socket)), filter_(std::move(filter)) {}
+
+  void Start() {
+    Send(std::string("HTTP/1.1 200 OK\r\n"
+                     "Server: ") +
+         BOOST_BEAST_VERSION_STRING +
+         "\r\n"
+         "Content-Type: text/event-stream\r\n"
+         "Cache-Control: no-cache\r\n"
+         "Connection: keep-alive\r\n"
+         "\r\n");
+    DoRead();
+  }
+
+  bool started() const { return started_; }
+  bool closed() const { return closed_; }
+
+  void SendSnapshot(const boost::json::object& state, int64_t timestamp_us) {
+    boost::json::object stats;
+    for (const auto& kv : state) {
+      const auto& obj = kv.value().as_object();
+      if (Selects(TypeOf(obj))) {
+        stats[kv.key()] = SelectFields(obj, true);
+      }
+    }
+    started_ = true;
+    SendEvent("snapshot", {{"timestamp", timestamp_us}, {"stats", stats}});
+  }
+
+  void OnDelta(const boost::json::object& changed,
+               const std::vector<Removed>& removed,
+               const boost::json::object& state,
+               int64_t timestamp_us) {
+    for (const auto& r : removed) {
+      if (Selects(r.type)) {
+        pending_changed_.erase(r.id);
+        pending_removed_.insert(r.id);
+      }
+    }
+    for (const auto& kv : changed) {
+      const auto& current = state.at(kv.key()).as_object();
+      if (!Selects(TypeOf(current))) {
+        continue;
+      }
+      const auto& fields = kv.value().as_object();
+      // A new stats object comes whole, with its type
+      const bool added = fields.contains("type");
+      boost::json::object selected = SelectFields(fields, added);
+      if (selected.empty()) {
+        continue;
+      }
+      pending_removed_.erase(std::string(kv.key()));
+      auto& pending = pending_changed_[kv.key()];
+      if (!pending.is_object()) {
+        pending = boost::json::object();
+      }
+      for (auto& field : selected) {
+        pending.as_object()[field.key()] = std::move(field.value());
+      }
+    }
+
+    if (++snapshots_ < filter_.interval) {
+      return;
+    }
+    snapshots_ = 0;
+    if (pending_changed_.empty() && pending_removed_.empty()) {
+      if (++idle_events_ >=
+          std::max(1, kHeartbeatSnapshots / filter_.interval)) {
+        idle_events_ = 0;
+        Send(":\n\n");
+      }
+      return;
+    }
+    idle_events_ = 0;
+    boost::json::array removed_ids;
+    for (const auto& id : pending_removed_) {
+      removed_ids.push_back(boost::json::string(id));
+    }
+    SendEvent("delta", {{"timestamp", timestamp_us},
+                        {"changed", std::move(pending_changed_)},
+                        {"removed", std::move(removed_ids)}});
+    pending_changed_ = {};
+    pending_removed_.clear();
+  }
+
+ private:
+  bool Selects(const std::string& type) const {
+    return filter_.types.empty() || filter_.types.count(type) != 0;
+  }
+
+  boost::json::object SelectFields(const boost::json::object& stats,
+                                   bool with_type) const {
+    if (filter_.fields.empty()) {
+      return stats;
+    }
+    boost::json::object out;
+    for (const auto& kv : stats) {
+      if ((with_type && kv.key() == "type") ||
+          filter_.fields.count(std::string(kv.key())) != 0) {
+        out[kv.key()] = kv.value();
+      }
+    }
+    return out;
+  }
+
+  void SendEvent(const char* event, const boost::json::object& data) {
+    Send(std::string("event: ") + event +
+         "\ndata: " + boost::json::serialize(data) + "\n\n");
+  }
+
+  void Send(std::string data) {
+    if (closed_) {
+      return;
+    }
+    if (queue_.size() >= kMaxQueuedEvents) {
+      RTC_LOG(LS_WARNING) << "Metrics stream subscriber is too slow, closing";
+      return Close();
+    }
+    queue_.push_back(std::move(data));
+    if (queue_.size() == 1) {
+      DoWrite();
+    }
+  }
+
+  void DoWrite() {
+    boost::asio::async_write(
+        socket_, boost::asio::buffer(queue_.front()),
+        [self = shared_from_this()](boost::system::error_code ec,
+                                    std::size_t) {
+          if (ec) {
+            return self->Close();
+          }
+          self->queue_.pop_front();
+          if (!self->queue_.empty()) {
+            self->DoWrite();
+          }
+        });
+  }
+
+  // The client sends nothing after the request, this only notices when it
+  // goes away
+  void DoRead() {
+    socket_.async_read_some(
+        boost::asio::buffer(read_buffer_),
+        [self = shared_from_this()](boost::system::error_code ec,
+                                    std::size_t) {
+          if (ec) {
+            return self->Close();
+          }
+          self->DoRead();
+        });
+  }
+
+  void Close() {
+    if (closed_) {
+      return;
+    }
+    closed_ = true;
+    boost::system::error_code ec;
+    socket_.shutdown(boost::asio::ip::tcp::socket::shutdown_both, ec);
+    socket_.close(ec);
+  }
+
+  boost::asio::ip::tcp::socket socket_;
+  const Filter filter_;
+  std::deque<std::string> queue_;
+  char read_buffer_[256];
+  bool started_ = false;
+  bool closed_ = false;
+  int snapshots_ = 0;
+  int idle_events_ = 0;
+  boost::json::object pending_changed_;
+  std::set<std::string> pending_removed_;
+};
+
+MetricsStream::MetricsStream(std::shared_ptr<MetricsSnapshot> snapshot)
+    : snapshot_(std::move(snapshot)) {}
+
+MetricsStream::Filter MetricsStream::ParseFilter(std::string_view query) {
+  Filter filter;
+  size_t begin = 0;
+  while (begin < query.size()) {
+    size_t end = query.find('&', begin);
+    if (end == std::string_view::npos) {
+      end = query.size();
+    }
+    std::string_view param = query.substr(begin, end - begin);
+    begin = end + 1;
+
+    const size_t eq = param.find('=');
+    if (eq == std::string_view::npos) {
+      continue;
+    }
+    const std::string_view key = param.substr(0, eq);
+    const std::string value = PercentDecode(param.substr(eq + 1));
+    if (key == "types") {
+      filter.types = SplitList(value);
+    } else if (key == "fields") {
+      filter.fields = SplitList(value);
+    } else if (key == "interval") {
+      filter.interval =
+          std::clamp(std::atoi(value.c_str()), 1, kMaxInterval);
+    }
+  }
+  return filter;
+}
+
+void MetricsStream::Subscribe(boost::asio::ip::tcp::socket socket,
+                              Filter filter) {
+  auto subscriber =
+      std::make_shared<Subscriber>(std::move(socket), std::move(filter));
+  subscriber->Start();
+  if (has_state_) {
+    subscriber->SendSnapshot(state_, timestamp_us_);
+  }
+  subscribers_.push_back(subscriber);
+  if (subscribers_.size() == 1) {
+    std::weak_ptr<MetricsStream> weak = shared_from_this();
+    snapshot_->SetListener(
+        [weak](std::shared_ptr<const MetricsSnapshot::Snapshot> snapshot) {
+          if (auto self = weak.lock()) {
+            self->OnSnapshot(snapshot);
+          }
+        });
+  }
+}
+
+void MetricsStream::OnSnapshot(
+    std::shared_ptr<const MetricsSnapshot::Snapshot> snapshot) {
+  subscribers_.erase(
+      std::remove_if(subscribers_.begin(), subscribers_.end(),
+                     [](const std::shared_ptr<Subscriber>& subscriber) {
+                       return subscriber->closed();
+                     }),
+      subscribers_.end());
+  if (subscribers_.empty()) {
+    snapshot_->SetListener(nullptr);
+    // The next subscriber starts from fresh stats
+    state_ = {};
+    has_state_ = false;
+    return;
+  }
+
+  boost::system::error_code ec;
+  boost::json::value stats = boost::json::parse(snapshot->stats_json, ec);
+  if (ec || !stats.is_array()) {
+    RTC_LOG(LS_WARNING) << "Failed to parse stats: " << ec.message();
+    return;
+  }
+  boost::json::object now;
+  for (auto& v : stats.as_array()) {
+    if (!v.is_object()) {
+      continue;
+    }
+    auto& obj = v.as_object();
+    const boost::json::value* id = obj.if_contains("id");
+    if (id == nullptr || !id->is_string()) {
+      continue;
+    }
+    std::string key(id->as_string());
+    obj.erase("id");
+    // Changes on every snapshot, the event has its own
+    obj.erase("timestamp");
+    now[key] = std::move(obj);
+  }
+  for (auto& group : MetricsRegistry::Instance().ToJson()) {
+    boost::json::object obj = std::move(group.value().as_object());
+    obj["type"] = "momo";
+    now["momo:" + std::string(group.key())] = std::move(obj);
+  }
+  const int64_t timestamp_us = webrtc::TimeUTCMicros();
+
+  if (has_state_) {
+    // Fields that changed since the previous snapshot, a new id comes whole
+    boost::json::object changed;
+    for (const auto& kv : now) {
+      const auto& fields = kv.value().as_object();
+      const boost::json::value* prev = state_.if_contains(kv.key());
+      if (prev == nullptr) {
+        changed[kv.key()] = fields;
+        continue;
+      }
+      const auto& prev_fields = prev->as_object();
+      boost::json::object diff;
+      for (const auto& field : fields) {
+        const boost::json::value* p = prev_fields.if_contains(field.key());
+        if (p == nullptr || *p != field.value()) {
+          diff[field.key()] = field.value();
+        }
+      }
+      // A field that has no value anymore
+      for (const auto& field : prev_fields) {
+        if (!fields.contains(field.key())) {
+          diff[field.key()] = nullptr;
+        }
+      }
+      if (!diff.empty()) {
+        changed[kv.key()] = std::move(diff);
+      }
+    }
+    std::vector<Removed> removed;
+    for (const auto& kv : state_) {
+      if (!now.contains(kv.key())) {
+        removed.push_back(
+            {std::string(kv.key()), TypeOf(kv.value().as_object())});
+      }
+    }
+    state_ = std::move(now);
+    for (auto& subscriber : subscribers_) {
+      if (subscriber->started()) {
+        subscriber->OnDelta(changed, removed, state_, timestamp_us);
+      } else {
+        subscriber->SendSnapshot(state_, timestamp_us);
+      }
+    }
+  } else {
+    state_ = std::move(now);
+    for (auto& subscriber : subscribers_) {
+      subscriber->SendSnapshot(state_, timestamp_us);
+    }
+  }
+  timestamp_us_ = timestamp_us;
+  has_state_ = true;
+}
@@ -0,0 +1,68 @@
+#ifndef METRICS_STREAM_H_
+#define METRICS_STREAM_H_
+
+#include <memory>
+#include <set>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// Boost
+#include <boost/asio/ip/tcp.hpp>
+#include <boost/json.hpp>
+
+#include "metrics_snapshot.h"
+
+// Pushes the stats to the subscribers of /metrics/stream as Server-Sent
+// Events.
+//
+// A subscriber first gets the whole stats ("snapshot" event), then only the
+// fields that changed since ("delta" events). The difference is computed once
+// per snapshot for every subscriber, each of them then only picks the types
+// and fields it asked for.
+//
+// Everything runs on the io_context thread.
+class MetricsStream : public std::enable_shared_from_this<MetricsStream> {
+ public:
+  struct Filter {
+    // Stats types ("outbound-rtp", ..., "momo"), all when empty
+    std::set<std::string> types;
+    // Fields of the stats, all when empty
+    std::set<std::string> fields;
+    // Snapshots between two events
+    int interval = 1;
+  };
+
+  static std::shared_ptr<MetricsStream> Create(
+      std::shared_ptr<MetricsSnapshot> snapshot) {
+    return std::shared_ptr<MetricsStream>(
+        new MetricsStream(std::move(snapshot)));
+  }
+
+  // types=<type>,...&fields=<field>,...&interval=<seconds>
+  static Filter ParseFilter(std::string_view query);
+
+  // Takes over the connection of a /metrics/stream request
+  void Subscribe(boost::asio::ip::tcp::socket socket, Filter filter);
+
+ private:
+  class Subscriber;
+
+  struct Removed {
+    std::string id;
+    std::string type;
+  };
+
+  MetricsStream(std::shared_ptr<MetricsSnapshot> snapshot);
+
+  void OnSnapshot(std::shared_ptr<const MetricsSnapshot::Snapshot> snapshot);
+
+  std::shared_ptr<MetricsSnapshot> snapshot_;
+  std::vector<std::shared_ptr<Subscriber>> subscribers_;
+  // Latest stats and Momo metrics by id, without the id and timestamp fields
+  boost::json::object state_;
+  int64_t timestamp_us_ = 0;
+  bool has_state_ = false;
+};
+
+#endif
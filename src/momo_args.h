@@ -47,9 +47,17 @@ struct MomoArgs {
   int window_width = 640;
   int window_height = 480;
   bool fullscreen = false;
+  // Target depth of the received audio queued for SDL playback
+  int audio_target_latency = 80;
   bool low_latency = false;
   std::string serial_device = "";
   unsigned int serial_rate = 9600;
+  // Forward the serial bytes as they come instead of line by line
+  bool serial_raw = false;
+  // Lines within this time go out as one DataChannel message (0: one each)
+  int serial_batch_ms = 0;
+  // Files received over the "bulk" DataChannel are saved here (empty: refused)
+  std::string bulk_dir = "";
   bool insecure = false;
   bool screen_capture = false;
   bool screen_capture_cursor = false;
@@ -124,6 +132,17 @@ struct MomoArgs {
   // If SQP is unsupported, the implementation will fall back to GCC.
   std::string congestion_controller = "GCC";  // GCC / SQP
 
+  // Encoder tuning for the video content: auto / camera / desktop
+  std::string video_content_profile = "auto";
+  // No periodic key frames, smaller key frames after packet loss
+  bool intra_refresh = false;
+  // Lower the frame rate, then the resolution, from the connection stats
+  bool network_adaptation = false;
+  // A connection with its ICE candidates gathered, waiting for the next session
+  bool warm_connection = false;
+  // Per-frame pipeline timestamps at /trace of the metrics server
+  bool frame_trace = false;
+
   struct Size {
     int width;
     int height;
@@ -1,17 +1,98 @@
 #include "p2p_server.h"
 
+#include <algorithm>
+
+// WebRTC
+#include <rtc_base/logging.h>
+
+#include "metrics/metrics_registry.h"
 #include "util.h"
 
 void P2PServer::GetStats(
     std::function<void(
         const webrtc::scoped_refptr<const webrtc::RTCStatsReport>&)> callback) {
-  if (p2p_session_ && p2p_session_->GetRTCConnection()) {
-    p2p_session_->GetRTCConnection()->GetStats(std::move(callback));
-  } else {
+  auto connections = GetConnections();
+  if (connections.empty()) {
     callback(nullptr);
+    return;
+  }
+  if (connections.size() == 1) {
+    connections[0]->GetStats(std::move(callback));
+    return;
+  }
+
+  // The reports arrive on the signaling thread one by one, merge them when
+  // the last one is in
+  struct Pending {
+    std::mutex mutex;
+    size_t remaining;
+    webrtc::scoped_refptr<webrtc::RTCStatsReport> merged;
+    std::function<void(
+        const webrtc::scoped_refptr<const webrtc::RTCStatsReport>&)>
+        callback;
+  };
+  auto pending = std::make_shared<Pending>();
+  pending->remaining = connections.size();
+  pending->callback = std::move(callback);
+  for (const auto& connection : connections) {
+    connection->GetStats(
+        [pending](
+            const webrtc::scoped_refptr<const webrtc::RTCStatsReport>& report) {
+          std::unique_lock<std::mutex> lock(pending->mutex);
+          if (report) {
+            if (!pending->merged) {
+              pending->merged =
+                  webrtc::RTCStatsReport::Create(report->timestamp());
+            }
+            for (const auto& stats : *report) {
+              if (pending->merged->Get(stats.id()) == nullptr) {
+                pending->merged->AddStats(stats.copy());
+              }
+            }
+          }
+          if (--pending->remaining > 0) {
+            return;
+          }
+          auto merged = std::move(pending->merged);
+          auto callback = std::move(pending->callback);
+          lock.unlock();
+          callback(merged);
+        });
   }
 }
 
+void P2PServer::AddViewer(std::shared_ptr<P2PWebsocketSession> viewer) {
+  std::lock_guard<std::mutex> lock(viewers_mutex_);
+  viewers_.erase(std::remove_if(viewers_.begin(), viewers_.end(),
+                                [](const std::weak_ptr<P2PWebsocketSession>& v) {
+                                  return v.expired();
+                                }),
+                 viewers_.end());
+  viewers_.push_back(viewer);
+  RTC_LOG(LS_INFO) << "P2PServer: " << viewers_.size() << " viewers";
+  MetricsRegistry::Instance().Set("p2p", "viewers",
+                                  static_cast<double>(viewers_.size()));
+}
+
+std::vector<std::shared_ptr<RTCConnection>> P2PServer::GetConnections() {
+  std::vector<std::shared_ptr<RTCConnection>> connections;
+  std::lock_guard<std::mutex> lock(viewers_mutex_);
+  size_t viewers = 0;
+  for (const auto& v : viewers_) {
+    if (auto viewer = v.lock()) {
+      viewers++;
+      if (auto connection = viewer->GetRTCConnection()) {
+        connections.push_back(connection);
+      }
+    }
+  }
+  MetricsRegistry::Instance().Set("p2p", "viewers",
+                                  static_cast<double>(viewers));
+  MetricsRegistry::Instance().Set("p2p", "connected_viewers",
+                                  static_cast<double>(connections.size()));
+  return connections;
+}
+
 P2PServer::P2PServer(boost::asio::io_context& ioc,
                      boost::asio::ip::tcp::endpoint endpoint,
                      RTCManager* rtc_manager,
@@ -21,6 +102,9 @@ P2PServer::P2PServer(boost::asio::io_context& ioc,
       socket_(ioc),
       rtc_manager_(rtc_manager),
       config_(std::move(config)) {
+  config_.assets = std::make_shared<StaticAssetCache>(config_.doc_root);
+  config_.assets->StartPreload();
+
   boost::system::error_code ec;
 
   // Open the acceptor
@@ -55,6 +139,11 @@ P2PServer::P2PServer(boost::asio::io_context& ioc,
 void P2PServer::Run() {
   if (!acceptor_.is_open())
     return;
+  // With --warm-connection, the first viewer does not wait for the
+  // candidates either
+  rtc_manager_->PrepareConnection(
+      P2PWebsocketSessionConfig::Default(config_.no_google_stun)
+          .ToRTCConfiguration());
   DoAccept();
 }
 
@@ -71,9 +160,14 @@ void P2PServer::OnAccept(boost::system::error_code ec) {
   }
 
   P2PSessionConfig config = config_;
-  p2p_session_ =
-      P2PSession::Create(ioc_, std::move(socket_), rtc_manager_, config_);
-  p2p_session_->Run();
+  std::weak_ptr<P2PServer> self = shared_from_this();
+  config.on_viewer = [self](std::shared_ptr<P2PWebsocketSession> viewer) {
+    if (auto server = self.lock()) {
+      server->AddViewer(std::move(viewer));
+    }
+  };
+  P2PSession::Create(ioc_, std::move(socket_), rtc_manager_, std::move(config))
+      ->Run();
 
   DoAccept();
 }
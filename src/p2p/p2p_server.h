@@ -2,7 +2,9 @@
 #define P2P_SERVER_H_
 
 #include <memory>
+#include <mutex>
 #include <string>
+#include <vector>
 
 // Boost
 #include <boost/asio/io_context.hpp>
@@ -34,6 +36,10 @@ class P2PServer : public std::enable_shared_from_this<P2PServer>,
   }
   void Run();
 
+  // Stats of every connected viewer in one report. Stats that each
+  // connection has under the same id (transport, codecs, media source) are
+  // taken from the first viewer; the outbound and remote-inbound RTP stats
+  // have per-connection SSRCs in their ids and are all kept.
   void GetStats(std::function<void(
                     const webrtc::scoped_refptr<const webrtc::RTCStatsReport>&)>
                     callback) override;
@@ -41,6 +47,8 @@ class P2PServer : public std::enable_shared_from_this<P2PServer>,
  private:
   void DoAccept();
   void OnAccept(boost::system::error_code ec);
+  void AddViewer(std::shared_ptr<P2PWebsocketSession> viewer);
+  std::vector<std::shared_ptr<RTCConnection>> GetConnections();
 
  private:
   boost::asio::io_context& ioc_;
@@ -50,7 +58,10 @@ class P2PServer : public std::enable_shared_from_this<P2PServer>,
   RTCManager* rtc_manager_;
   P2PServerConfig config_;
 
-  std::shared_ptr<P2PSession> p2p_session_;
+  // Every browser that opened /ws, each with its own connection sending the
+  // one video track of RTCManager
+  std::mutex viewers_mutex_;
+  std::vector<std::weak_ptr<P2PWebsocketSession>> viewers_;
 };
 
 #endif
@@ -6,6 +6,7 @@
 #include <boost/beast/http/error.hpp>
 #include <boost/beast/http/file_body.hpp>
 #include <boost/beast/http/read.hpp>
+#include <boost/beast/http/span_body.hpp>
 #include <boost/beast/version.hpp>
 #include <boost/beast/websocket/rfc6455.hpp>
 #include <boost/filesystem/path.hpp>
@@ -66,27 +67,13 @@ void P2PSession::OnRead(boost::system::error_code ec,
   // WebSocket upgrade request
   if (req_.target() == "/ws") {
     if (boost::beast::websocket::is_upgrade(req_)) {
-      P2PWebsocketSessionConfig config;
-      config.no_google_stun = config_.no_google_stun;
-      // Default Coturn/STUN servers (until configurable via WebSocket)
-      P2PWebsocketSessionConfig::IceServerConfig stun_server;
-      stun_server.urls = {"stun:36.99.188.173:3479"};
-      config.ice_servers.push_back(stun_server);
-
-      P2PWebsocketSessionConfig::IceServerConfig turn_server_udp;
-      turn_server_udp.urls = {"turn:36.99.188.173:3479?transport=udp"};
-      turn_server_udp.username = "yrxt";
-      turn_server_udp.credential = "x";
-      config.ice_servers.push_back(turn_server_udp);
-
-      P2PWebsocketSessionConfig::IceServerConfig turn_server_tcp;
-      turn_server_tcp.urls = {"turn:36.99.188.173:3479?transport=tcp"};
-      turn_server_tcp.username = "yrxt";
-      turn_server_tcp.credential = "x";
-      config.ice_servers.push_back(turn_server_tcp);
-
+      auto config =
+          P2PWebsocketSessionConfig::Default(config_.no_google_stun);
       ws_session_ = P2PWebsocketSession::Create(
           ioc_, std::move(socket_), rtc_manager_, std::move(config));
+      if (config_.on_viewer) {
+        config_.on_viewer(ws_session_);
+      }
       ws_session_->Run(std::move(req_));
       return;
     } else {
@@ -113,12 +100,21 @@ void P2PSession::HandleRequest() {
       req.target().find("..") != boost::beast::string_view::npos)
     return SendResponse(Util::BadRequest(req, "Illegal request-target"));
 
+  // Ignore the query string (cache busting parameters)
+  std::string target(req.target());
+  target = target.substr(0, target.find('?'));
+  if (target.back() == '/')
+    target += "index.html";
+
+  if (config_.assets) {
+    if (auto asset = config_.assets->Get(target)) {
+      return SendAsset(req, std::move(asset));
+    }
+  }
+
   // Build the path to the requested file
   boost::filesystem::path path =
-      boost::filesystem::path(config_.doc_root) / std::string(req.target());
-
-  if (req.target().back() == '/')
-    path.append("index.html");
+      boost::filesystem::path(config_.doc_root) / target;
 
 #ifdef _WIN32
   path.imbue(
@@ -164,6 +160,54 @@ void P2PSession::HandleRequest() {
   return SendResponse(std::move(res));
 }
 
+void P2PSession::SendAsset(
+    const boost::beast::http::request<boost::beast::http::string_body>& req,
+    std::shared_ptr<const StaticAssetCache::Asset> asset) {
+  namespace http = boost::beast::http;
+  const StaticAssetCache::Variant& variant = StaticAssetCache::Select(
+      *asset, std::string_view(req[http::field::accept_encoding]));
+
+  auto set_headers = [&](auto& res) {
+    res.set(http::field::server, BOOST_BEAST_VERSION_STRING);
+    res.set(http::field::content_type, asset->content_type);
+    res.set(http::field::etag, variant.etag);
+    // The file names are not versioned, so the browser revalidates every
+    // time and gets a 304 while the file did not change
+    res.set(http::field::cache_control, "no-cache");
+    if (asset->variants.size() > 1)
+      res.set(http::field::vary, "Accept-Encoding");
+    if (!variant.encoding.empty())
+      res.set(http::field::content_encoding, variant.encoding);
+    res.keep_alive(req.keep_alive());
+  };
+
+  if (StaticAssetCache::NotModified(
+          variant, std::string_view(req[http::field::if_none_match]))) {
+    http::response<http::empty_body> res{http::status::not_modified,
+                                         req.version()};
+    set_headers(res);
+    return SendResponse(std::move(res));
+  }
+
+  if (req.method() == http::verb::head) {
+    http::response<http::empty_body> res{http::status::ok, req.version()};
+    set_headers(res);
+    res.content_length(variant.data.size());
+    return SendResponse(std::move(res));
+  }
+
+  // The body points into the cached file, which asset_ keeps alive until the
+  // response is written
+  http::response<http::span_body<const char>> res{http::status::ok,
+                                                  req.version()};
+  set_headers(res);
+  res.body() =
+      boost::beast::span<const char>(variant.data.data(), variant.data.size());
+  res.content_length(variant.data.size());
+  asset_ = std::move(asset);
+  return SendResponse(std::move(res));
+}
+
 void P2PSession::OnWrite(boost::system::error_code ec,
                          std::size_t bytes_transferred,
                          bool close) {
@@ -176,6 +220,7 @@ void P2PSession::OnWrite(boost::system::error_code ec,
     return DoClose();
 
   res_ = nullptr;
+  asset_ = nullptr;
 
   DoRead();
 }
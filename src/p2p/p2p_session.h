@@ -16,12 +16,17 @@
 #include <boost/beast/http/write.hpp>
 
 #include "p2p_websocket_session.h"
+#include "static_asset_cache.h"
 #include "rtc/rtc_manager.h"
 #include "util.h"
 
 struct P2PSessionConfig {
   bool no_google_stun = false;
   std::string doc_root;
+  // Files of doc_root in memory, shared by the sessions of a server
+  std::shared_ptr<StaticAssetCache> assets;
+  // Called with every WebSocket session (one per viewer)
+  std::function<void(std::shared_ptr<P2PWebsocketSession>)> on_viewer;
 };
 
 // Class for processing one HTTP request
@@ -48,6 +53,9 @@ class P2PSession : public std::enable_shared_from_this<P2PSession> {
   void OnRead(boost::system::error_code ec, std::size_t bytes_transferred);
 
   void HandleRequest();
+  void SendAsset(
+      const boost::beast::http::request<boost::beast::http::string_body>& req,
+      std::shared_ptr<const StaticAssetCache::Asset> asset);
 
   template <class Body, class Fields>
   void SendResponse(boost::beast::http::response<Body, Fields> msg) {
@@ -78,6 +86,7 @@ class P2PSession : public std::enable_shared_from_this<P2PSession> {
   boost::beast::flat_buffer buffer_;
   boost::beast::http::request<boost::beast::http::string_body> req_;
   std::shared_ptr<void> res_;
+  std::shared_ptr<const StaticAssetCache::Asset> asset_;
 
   RTCManager* rtc_manager_;
   P2PSessionConfig config_;
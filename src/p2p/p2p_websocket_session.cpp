@@ -6,8 +6,56 @@
 #include <boost/beast/websocket/stream.hpp>
 #include <boost/json.hpp>
 
+// WebRTC
+#include <rtc_base/time_utils.h>
+
+#include "metrics/metrics_registry.h"
 #include "util.h"
 
+P2PWebsocketSessionConfig P2PWebsocketSessionConfig::Default(
+    bool no_google_stun) {
+  P2PWebsocketSessionConfig config;
+  config.no_google_stun = no_google_stun;
+  // Default Coturn/STUN servers (until configurable via WebSocket)
+  IceServerConfig stun_server;
+  stun_server.urls = {"stun:36.99.188.173:3479"};
+  config.ice_servers.push_back(stun_server);
+
+  IceServerConfig turn_server_udp;
+  turn_server_udp.urls = {"turn:36.99.188.173:3479?transport=udp"};
+  turn_server_udp.username = "yrxt";
+  turn_server_udp.credential = "x";
+  config.ice_servers.push_back(turn_server_udp);
+
+  IceServerConfig turn_server_tcp;
+  turn_server_tcp.urls = {"turn:36.99.188.173:3479?transport=tcp"};
+  turn_server_tcp.username = "yrxt";
+  turn_server_tcp.credential = "x";
+  config.ice_servers.push_back(turn_server_tcp);
+  return config;
+}
+
+webrtc::PeerConnectionInterface::RTCConfiguration
+P2PWebsocketSessionConfig::ToRTCConfiguration() const {
+  webrtc::PeerConnectionInterface::RTCConfiguration rtc_config;
+  webrtc::PeerConnectionInterface::IceServers servers;
+  for (const auto& server_cfg : ice_servers) {
+    webrtc::PeerConnectionInterface::IceServer ice_server;
+    ice_server.urls = server_cfg.urls;
+    ice_server.username = server_cfg.username;
+    ice_server.password = server_cfg.credential;
+    servers.push_back(std::move(ice_server));
+  }
+
+  if (servers.empty() && !no_google_stun) {
+    webrtc::PeerConnectionInterface::IceServer ice_server;
+    ice_server.uri = "stun:stun.l.google.com:19302";
+    servers.push_back(ice_server);
+  }
+  rtc_config.servers = servers;
+  return rtc_config;
+}
+
 std::shared_ptr<RTCConnection> P2PWebsocketSession::GetRTCConnection() const {
   if (rtc_state_ == webrtc::PeerConnectionInterface::IceConnectionState::
                         kIceConnectionConnected) {
@@ -59,6 +107,7 @@ void P2PWebsocketSession::OnAccept(boost::system::error_code ec) {
   if (ec)
     return MOMO_BOOST_ERROR(ec, "Accept");
 
+  accepted_ms_ = webrtc::TimeMillis();
   DoRead();
 }
 
@@ -100,15 +149,25 @@ void P2PWebsocketSession::OnRead(boost::system::error_code ec,
   if (type == "offer") {
     std::string sdp = recv_message.at("sdp").as_string().c_str();
 
+    const int64_t offer_ms = webrtc::TimeMillis();
+    offer_ms_ = offer_ms;
+    if (accepted_ms_ != 0) {
+      MetricsRegistry::Instance().Set(
+          "session_start", "offer_ms",
+          static_cast<double>(offer_ms - accepted_ms_));
+    }
     connection_ = CreateRTCConnection();
-    connection_->SetOffer(sdp, [this]() {
+    connection_->SetOffer(sdp, [this, offer_ms]() {
       connection_->CreateAnswer(
-          [this](webrtc::SessionDescriptionInterface* desc) {
+          [this, offer_ms](webrtc::SessionDescriptionInterface* desc) {
             std::string sdp;
             desc->ToString(&sdp);
             boost::json::value json_desc = {{"type", "answer"}, {"sdp", sdp}};
             std::string str_desc = boost::json::serialize(json_desc);
             ws_->WriteText(std::move(str_desc));
+            MetricsRegistry::Instance().Set(
+                "session_start", "answer_ms",
+                static_cast<double>(webrtc::TimeMillis() - offer_ms));
           });
     });
   } else if (type == "answer") {
@@ -128,6 +187,17 @@ void P2PWebsocketSession::OnRead(boost::system::error_code ec,
     connection_->AddIceCandidate(sdp_mid, sdp_mlineindex, candidate);
   } else if (type == "close" || type == "bye") {
     connection_ = nullptr;
+  } else if (type == "first_frame") {
+    // Measured by the viewer from its offer to the first frame on screen
+    const boost::json::value* ms = recv_message.as_object().if_contains("ms");
+    if (ms == nullptr || !ms->is_number()) {
+      return;
+    }
+    const double first_frame_ms = ms->to_number<double>();
+    RTC_LOG(LS_INFO) << "First frame shown " << first_frame_ms
+                     << " ms after the offer";
+    MetricsRegistry::Instance().Set("session_start", "first_frame_ms",
+                                    first_frame_ms);
   } else if (type == "register") {
     boost::json::value accept_message = {
         {"type", "accept"},
@@ -141,23 +211,8 @@ void P2PWebsocketSession::OnRead(boost::system::error_code ec,
 }
 
 std::shared_ptr<RTCConnection> P2PWebsocketSession::CreateRTCConnection() {
-  webrtc::PeerConnectionInterface::RTCConfiguration rtc_config;
-  webrtc::PeerConnectionInterface::IceServers servers;
-  for (const auto& server_cfg : config_.ice_servers) {
-    webrtc::PeerConnectionInterface::IceServer ice_server;
-    ice_server.urls = server_cfg.urls;
-    ice_server.username = server_cfg.username;
-    ice_server.password = server_cfg.credential;
-    servers.push_back(std::move(ice_server));
-  }
-
-  if (servers.empty() && !config_.no_google_stun) {
-    webrtc::PeerConnectionInterface::IceServer ice_server;
-    ice_server.uri = "stun:stun.l.google.com:19302";
-    servers.push_back(ice_server);
-  }
-  rtc_config.servers = servers;
-  auto connection = rtc_manager_->CreateConnection(rtc_config, this);
+  auto connection =
+      rtc_manager_->CreateConnection(config_.ToRTCConfiguration(), this);
   rtc_manager_->InitTracks(connection.get(), std::nullopt);
 
   return connection;
@@ -169,6 +224,16 @@ void P2PWebsocketSession::OnIceConnectionStateChange(
                    << Util::IceConnectionStateToString(rtc_state_) << " -> "
                    << Util::IceConnectionStateToString(new_state);
 
+  if (new_state == webrtc::PeerConnectionInterface::IceConnectionState::
+                       kIceConnectionConnected) {
+    // Only the first connection after the offer, not when ICE comes back
+    const int64_t offer_ms = offer_ms_.exchange(0);
+    if (offer_ms != 0) {
+      MetricsRegistry::Instance().Set(
+          "session_start", "ice_connected_ms",
+          static_cast<double>(webrtc::TimeMillis() - offer_ms));
+    }
+  }
   rtc_state_ = new_state;
 }
 
@@ -1,6 +1,8 @@
 #ifndef P2P_WEBSOCKET_SESSION_H_
 #define P2P_WEBSOCKET_SESSION_H_
 
+#include <atomic>
+#include <cstdint>
 #include <cstdlib>
 #include <memory>
 #include <string>
@@ -27,6 +29,11 @@ struct P2PWebsocketSessionConfig {
 
   bool no_google_stun = false;
   std::vector<IceServerConfig> ice_servers;
+
+  // The STUN/TURN servers every viewer gets
+  static P2PWebsocketSessionConfig Default(bool no_google_stun);
+  webrtc::PeerConnectionInterface::RTCConfiguration ToRTCConfiguration()
+      const;
 };
 
 class P2PWebsocketSession
@@ -83,6 +90,11 @@ class P2PWebsocketSession
 
   std::shared_ptr<RTCConnection> connection_;
   webrtc::PeerConnectionInterface::IceConnectionState rtc_state_;
+
+  // For the "session_start" metrics. The ICE state is reported on the
+  // signaling thread.
+  int64_t accepted_ms_ = 0;
+  std::atomic<int64_t> offer_ms_{0};
 };
 
 #endif  // P2P_WEBSOCKET_SESSION_H_
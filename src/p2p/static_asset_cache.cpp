@@ -0,0 +1,313 @@
+#include "static_asset_cache.h"
+
+#include <chrono>
+#include <cstdio>
+#include <fstream>
+#include <iterator>
+
+// Boost
+#include <boost/beast/core/string.hpp>
+#include <boost/filesystem/operations.hpp>
+#include <boost/filesystem/path.hpp>
+
+// WebRTC
+#include <rtc_base/logging.h>
+
+#include "util.h"
+#include "zlib_helper.h"
+
+namespace {
+
+// Larger files, and the files that do not fit in kMaxTotalSize, are not kept
+// and the server sends them from the disk
+constexpr uintmax_t kMaxFileSize = 32 * 1024 * 1024;
+constexpr size_t kMaxTotalSize = 128 * 1024 * 1024;
+constexpr int64_t kRevalidateIntervalMs = 1000;
+constexpr int kMaxPreloadEntries = 1000;
+// Smaller files do not get anything out of compression
+constexpr size_t kMinCompressSize = 256;
+
+int64_t NowMs() {
+  return std::chrono::duration_cast<std::chrono::milliseconds>(
+             std::chrono::steady_clock::now().time_since_epoch())
+      .count();
+}
+
+bool ReadFile(const std::string& file, std::string* data) {
+  std::ifstream ifs(file, std::ios::binary);
+  if (!ifs) {
+    return false;
+  }
+  data->assign(std::istreambuf_iterator<char>(ifs),
+               std::istreambuf_iterator<char>());
+  return !ifs.bad();
+}
+
+// FNV-1a
+std::string MakeETag(const std::string& data, const char* suffix) {
+  uint64_t hash = 14695981039346656037ULL;
+  for (unsigned char c : data) {
+    hash ^= c;
+    hash *= 1099511628211ULL;
+  }
+  char buf[64];
+  std::snprintf(buf, sizeof(buf), "\"%016llx-%zx%s\"",
+                static_cast<unsigned long long>(hash), data.size(), suffix);
+  return buf;
+}
+
+bool IsCompressible(std::string_view content_type) {
+  return content_type.substr(0, 5) == "text/" ||
+         content_type == "application/javascript" ||
+         content_type == "application/json" ||
+         content_type == "application/xml" ||
+         content_type == "application/wasm" || content_type == "image/svg+xml";
+}
+
+std::string_view Trim(std::string_view s) {
+  const size_t begin = s.find_first_not_of(" \t");
+  if (begin == std::string_view::npos) {
+    return {};
+  }
+  return s.substr(begin, s.find_last_not_of(" \t") - begin + 1);
+}
+
+// Calls f with every comma separated item of a header until it returns true
+template <class F>
+bool AnyItem(std::string_view header, F f) {
+  size_t begin = 0;
+  while (begin < header.size()) {
+    size_t end = header.find(',', begin);
+    if (end == std::string_view::npos) {
+      end = header.size();
+    }
+    if (f(Trim(header.substr(begin, end - begin)))) {
+      return true;
+    }
+    begin = end + 1;
+  }
+  return false;
+}
+
+bool Accepts(std::string_view accept_encoding, std::string_view encoding) {
+  return AnyItem(accept_encoding, [encoding](std::string_view item) {
+    const size_t semicolon = item.find(';');
+    const std::string_view name = Trim(item.substr(0, semicolon));
+    if (!boost::beast::iequals(name, encoding) && name != "*") {
+      return false;
+    }
+    if (semicolon == std::string_view::npos) {
+      return true;
+    }
+    // "q=0" refuses the encoding
+    const std::string_view param = Trim(item.substr(semicolon + 1));
+    if (param.substr(0, 2) != "q=") {
+      return true;
+    }
+    return param.substr(2).find_first_not_of("0.") != std::string_view::npos;
+  });
+}
+
+}  // namespace
+
+StaticAssetCache::StaticAssetCache(std::string doc_root)
+    : doc_root_(std::move(doc_root)) {}
+
+StaticAssetCache::~StaticAssetCache() {
+  stopping_ = true;
+  if (preload_thread_.joinable()) {
+    preload_thread_.join();
+  }
+}
+
+void StaticAssetCache::StartPreload() {
+  if (!preload_thread_.joinable()) {
+    preload_thread_ = std::thread([this]() { Preload(); });
+  }
+}
+
+void StaticAssetCache::Preload() {
+  boost::system::error_code ec;
+  const boost::filesystem::path root(doc_root_);
+  boost::filesystem::recursive_directory_iterator it(root, ec), end;
+  if (ec) {
+    RTC_LOG(LS_WARNING) << "Failed to list " << doc_root_ << ": "
+                        << ec.message();
+    return;
+  }
+  // The document root defaults to the current directory, which may be
+  // anything: only web files are loaded, and only so many entries visited
+  int count = 0;
+  int visited = 0;
+  for (; it != end && visited < kMaxPreloadEntries; it.increment(ec)) {
+    if (ec || stopping_) {
+      break;
+    }
+    visited++;
+    const std::string name = it->path().filename().string();
+    if (!name.empty() && name[0] == '.') {
+      it.disable_recursion_pending();
+      continue;
+    }
+    if (!boost::filesystem::is_regular_file(it->status()) ||
+        Util::MimeType(name) == "application/text") {
+      continue;
+    }
+    const std::string path =
+        "/" + boost::filesystem::relative(it->path(), root, ec).generic_string();
+    if (!ec && Get(path)) {
+      count++;
+    }
+  }
+  std::lock_guard<std::mutex> lock(mutex_);
+  RTC_LOG(LS_INFO) << "Loaded " << count << " files of " << doc_root_
+                   << " (" << total_size_ << " bytes)";
+}
+
+std::shared_ptr<const StaticAssetCache::Asset> StaticAssetCache::Get(
+    const std::string& path) {
+  const int64_t now_ms = NowMs();
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto it = entries_.find(path);
+    if (it != entries_.end() &&
+        now_ms - it->second.checked_ms < kRevalidateIntervalMs) {
+      return it->second.asset;
+    }
+  }
+
+  const std::string file =
+      (boost::filesystem::path(doc_root_) / path).string();
+  boost::system::error_code ec;
+  const bool regular = boost::filesystem::is_regular_file(file, ec);
+  const std::time_t mtime = boost::filesystem::last_write_time(file, ec);
+  const uintmax_t size = ec ? 0 : boost::filesystem::file_size(file, ec);
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto it = entries_.find(path);
+    if (ec || !regular) {
+      if (it != entries_.end()) {
+        total_size_ -= it->second.memory;
+        entries_.erase(it);
+      }
+      return nullptr;
+    }
+    if (it != entries_.end() && it->second.mtime == mtime &&
+        it->second.size == size) {
+      it->second.checked_ms = now_ms;
+      return it->second.asset;
+    }
+    // The file as it is takes at least its size, so a file that cannot fit
+    // is not even read
+    const size_t kept = it != entries_.end() ? it->second.memory : 0;
+    if (size > kMaxFileSize || total_size_ - kept + size > kMaxTotalSize) {
+      Store(path, nullptr, mtime, size, 0, now_ms);
+      return nullptr;
+    }
+  }
+
+  // Read and compress without holding the lock
+  auto asset = Load(file, mtime);
+  if (!asset) {
+    return nullptr;
+  }
+  size_t memory = 0;
+  for (const auto& variant : asset->variants) {
+    memory += variant.data.size();
+  }
+
+  std::lock_guard<std::mutex> lock(mutex_);
+  auto it = entries_.find(path);
+  const size_t kept = it != entries_.end() ? it->second.memory : 0;
+  // With its compressed variants the file may not fit after all
+  if (total_size_ - kept + memory > kMaxTotalSize) {
+    asset = nullptr;
+    memory = 0;
+  }
+  Store(path, asset, mtime, size, memory, now_ms);
+  return asset;
+}
+
+void StaticAssetCache::Store(const std::string& path,
+                             std::shared_ptr<const Asset> asset,
+                             std::time_t mtime,
+                             uintmax_t size,
+                             size_t memory,
+                             int64_t now_ms) {
+  Entry& entry = entries_[path];
+  total_size_ -= entry.memory;
+  entry.asset = std::move(asset);
+  entry.mtime = mtime;
+  entry.size = size;
+  entry.memory = memory;
+  entry.checked_ms = now_ms;
+  total_size_ += memory;
+}
+
+std::shared_ptr<const StaticAssetCache::Asset> StaticAssetCache::Load(
+    const std::string& file,
+    std::time_t mtime) {
+  auto asset = std::make_shared<Asset>();
+  std::string data;
+  if (!ReadFile(file, &data)) {
+    return nullptr;
+  }
+  asset->content_type = std::string(Util::MimeType(file));
+
+  // Precompressed variants, unless they are older than the file
+  auto read_precompressed = [&](const char* ext, std::string* out) {
+    const std::string precompressed = file + ext;
+    boost::system::error_code ec;
+    const std::time_t t = boost::filesystem::last_write_time(precompressed, ec);
+    return !ec && t >= mtime && ReadFile(precompressed, out);
+  };
+  Variant br{"br", "", ""};
+  if (read_precompressed(".br", &br.data)) {
+    br.etag = MakeETag(br.data, "-br");
+    asset->variants.push_back(std::move(br));
+  }
+  Variant gzip{"gzip", "", ""};
+  if (read_precompressed(".gz", &gzip.data)) {
+    gzip.etag = MakeETag(gzip.data, "-gz");
+    asset->variants.push_back(std::move(gzip));
+  } else if (data.size() >= kMinCompressSize &&
+             IsCompressible(asset->content_type)) {
+    try {
+      gzip.data = ZlibHelper::Gzip(data);
+    } catch (const std::exception&) {
+      RTC_LOG(LS_WARNING) << "Failed to compress " << file;
+      gzip.data.clear();
+    }
+    // Not worth the decompression when it hardly got smaller
+    if (!gzip.data.empty() && gzip.data.size() < data.size() * 9 / 10) {
+      gzip.etag = MakeETag(data, "-gz");
+      asset->variants.push_back(std::move(gzip));
+    }
+  }
+  Variant identity{"", MakeETag(data, ""), std::move(data)};
+  asset->variants.push_back(std::move(identity));
+  return asset;
+}
+
+const StaticAssetCache::Variant& StaticAssetCache::Select(
+    const Asset& asset,
+    std::string_view accept_encoding) {
+  for (const auto& variant : asset.variants) {
+    if (variant.encoding.empty() ||
+        Accepts(accept_encoding, variant.encoding)) {
+      return variant;
+    }
+  }
+  return asset.variants.back();
+}
+
+bool StaticAssetCache::NotModified(const Variant& variant,
+                                   std::string_view if_none_match) {
+  return AnyItem(if_none_match, [&variant](std::string_view etag) {
+    // Weak comparison, as for GET
+    if (etag.substr(0, 2) == "W/") {
+      etag = etag.substr(2);
+    }
+    return etag == "*" || etag == variant.etag;
+  });
+}
@@ -0,0 +1,87 @@
+#ifndef STATIC_ASSET_CACHE_H_
+#define STATIC_ASSET_CACHE_H_
+
+#include <atomic>
+#include <cstdint>
+#include <ctime>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+// Files of the P2P document root kept in memory, with their compressed
+// variants, so that opening the page reads no file and sends the smallest
+// encoding the browser accepts.
+//
+// The gzip variant is made when a file is loaded. A brotli (or gzip) variant
+// is taken from a precompressed "<file>.br" ("<file>.gz") next to the file
+// when there is one. A file is read again when its time or size changed,
+// which is checked at most once a second. A file that is too large to be kept
+// is remembered as such, so that it is not read on every request.
+class StaticAssetCache {
+ public:
+  struct Variant {
+    // "" for the file as it is
+    std::string encoding;
+    std::string etag;
+    std::string data;
+  };
+  struct Asset {
+    std::string content_type;
+    // Best encoding first, the file as it is last
+    std::vector<Variant> variants;
+  };
+
+  explicit StaticAssetCache(std::string doc_root);
+  ~StaticAssetCache();
+
+  // Loads the web files of the document root on a thread of the cache, so
+  // that the server does not wait for them to start
+  void StartPreload();
+
+  // The file at the request path ("/p2p.html"), nullptr if it does not exist
+  // or is too large to be kept in memory
+  std::shared_ptr<const Asset> Get(const std::string& path);
+
+  // The smallest variant allowed by the Accept-Encoding header
+  static const Variant& Select(const Asset& asset,
+                               std::string_view accept_encoding);
+  // Whether the If-None-Match header matches the variant
+  static bool NotModified(const Variant& variant,
+                          std::string_view if_none_match);
+
+ private:
+  struct Entry {
+    std::shared_ptr<const Asset> asset;
+    std::time_t mtime = 0;
+    uintmax_t size = 0;
+    // Bytes of every variant
+    size_t memory = 0;
+    int64_t checked_ms = 0;
+  };
+
+  void Preload();
+  std::shared_ptr<const Asset> Load(const std::string& file,
+                                    std::time_t mtime);
+  // Called with mutex_ held, asset is nullptr for a file sent from the disk
+  void Store(const std::string& path,
+             std::shared_ptr<const Asset> asset,
+             std::time_t mtime,
+             uintmax_t size,
+             size_t memory,
+             int64_t now_ms);
+
+  const std::string doc_root_;
+
+  std::mutex mutex_;
+  std::map<std::string, Entry> entries_;
+  size_t total_size_ = 0;
+
+  std::atomic<bool> stopping_{false};
+  std::thread preload_thread_;
+};
+
+#endif
@@ -0,0 +1,1139 @@
+// Description: "bulk" DataChannel for files and clipboard contents, kept apart
+// from the input channels so that a large transfer does not hold up input.
+//
+// Control messages are JSON text, the data goes in binary chunks:
+//   -> {"type":"bulkOffer","tid":1,"hash":"<sha256>","kind":"file",
+//       "name":"a.txt","size":N,"chunk":16384}
+//   <- {"type":"bulkAccept","tid":1,"offset":M}  M: bytes the receiver has
+//   -> chunk: tid (u32, big endian), offset (u64, big endian), data
+//   <- {"type":"bulkAck","tid":1,"offset":M}     M: bytes written so far
+//   -> {"type":"bulkEnd","tid":1}
+//   <- {"type":"bulkResult","tid":1,"ok":true}   or "ok":false,"error":"..."
+//   -> {"type":"bulkCancel","tid":1}
+// The tid is chosen by the sending side. The sender of a file keeps at most
+// kHighWatermark sent beyond the last bulkAck, so that a receiver whose disk
+// is slower than the link does not pile up chunks. A file whose transfer
+// broke off is kept in the receive directory as .momo-<hash>.part, and the
+// next offer of the same content continues from there.
+
+#ifndef REMOTE_DATA_CHANNEL_BULK_DATA_MANAGER_H_
+#define REMOTE_DATA_CHANNEL_BULK_DATA_MANAGER_H_
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
+#include <deque>
+#include <fstream>
+#include <functional>
+#include <iterator>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include <boost/filesystem/operations.hpp>
+#include <boost/filesystem/path.hpp>
+
+#include <api/data_channel_interface.h>
+#include <openssl/sha.h>
+#include <rtc_base/copy_on_write_buffer.h>
+#include <rtc_base/logging.h>
+#include <rtc_base/synchronization/mutex.h>
+#include <rtc_base/time_utils.h>
+
+#include "metrics/metrics_registry.h"
+#include "remote/proto/parser.h"
+#include "rtc/rtc_data_manager.h"
+
+namespace remote {
+namespace data_channel {
+
+struct BulkTransferResult {
+  bool incoming{false};
+  // "file" or "clipboard"
+  std::string kind;
+  // File name, or MIME type of the clipboard contents
+  std::string name;
+  // Where an incoming file was saved
+  std::string path;
+  uint64_t size{0};
+  // Bytes the receiver already had from an earlier attempt
+  uint64_t resumed{0};
+  // From the accept to the last chunk (incoming) or to the receiver's result
+  double seconds{0};
+  bool ok{false};
+  std::string error;
+};
+
+namespace detail {
+
+class Sha256 {
+ public:
+  Sha256() { SHA256_Init(&ctx_); }
+  void Update(const void* data, size_t size) {
+    SHA256_Update(&ctx_, data, size);
+  }
+  std::string HexDigest() {
+    uint8_t md[SHA256_DIGEST_LENGTH];
+    SHA256_Final(md, &ctx_);
+    static const char kHex[] = "0123456789abcdef";
+    std::string hex;
+    for (uint8_t b : md) {
+      hex.push_back(kHex[b >> 4]);
+      hex.push_back(kHex[b & 15]);
+    }
+    return hex;
+  }
+
+ private:
+  SHA256_CTX ctx_;
+};
+
+// Quotes and control characters are not escaped by the JSON of this channel
+inline std::string SanitizeName(std::string name) {
+  for (char& c : name) {
+    if (c == '"' || c == '\\' || static_cast<unsigned char>(c) < 0x20) {
+      c = '_';
+    }
+  }
+  return name;
+}
+
+inline bool IsSha256Hex(const std::string& s) {
+  return s.size() == 64 &&
+         s.find_first_not_of("0123456789abcdef") == std::string::npos;
+}
+
+// Runs the posted tasks in order on a thread started by the first one
+class TaskThread {
+ public:
+  ~TaskThread() { Stop(); }
+
+  void Post(std::function<void()> task) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (stopping_) {
+      return;
+    }
+    tasks_.push_back(std::move(task));
+    if (!thread_.joinable()) {
+      thread_ = std::thread([this] { Run(); });
+    }
+    cv_.notify_one();
+  }
+
+  // The tasks that did not run yet are dropped
+  void Stop() {
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      stopping_ = true;
+    }
+    cv_.notify_all();
+    if (thread_.joinable()) {
+      thread_.join();
+    }
+  }
+
+ private:
+  void Run() {
+    while (true) {
+      std::function<void()> task;
+      {
+        std::unique_lock<std::mutex> lock(mutex_);
+        cv_.wait(lock, [this] { return stopping_ || !tasks_.empty(); });
+        if (stopping_) {
+          return;
+        }
+        task = std::move(tasks_.front());
+        tasks_.pop_front();
+      }
+      task();
+    }
+  }
+
+  std::mutex mutex_;
+  std::condition_variable cv_;
+  std::deque<std::function<void()>> tasks_;
+  bool stopping_{false};
+  std::thread thread_;
+};
+
+}  // namespace detail
+
+// Transfers go over the first open "bulk" channel. Files are read ahead by
+// at most kHighWatermark and written chunk by chunk, so files of any size are
+// never in memory as a whole. The channel's buffered amount is kept between
+// kLowWatermark and kHighWatermark, and the channel is created with a very
+// low priority: an input message waits behind at most one chunk.
+//
+// The disk is only touched on threads of their own, as the channel's thread
+// delivers the input channels too: one reads and writes the chunks, the other
+// hashes and checks whole files without holding up the first.
+class BulkDataManager : public RTCDataManager {
+ public:
+  static constexpr const char* kLabel = "bulk";
+  // Small enough that a chunk takes ~13 ms at 10 Mbps, the longest an input
+  // message on another channel waits for it
+  static constexpr size_t kChunkSize = 16 * 1024;
+  static constexpr size_t kMaxChunkSize = 256 * 1024;
+  static constexpr uint64_t kHighWatermark = 1024 * 1024;
+  static constexpr uint64_t kLowWatermark = 256 * 1024;
+  // The receiver acks each time it has written this much more
+  static constexpr uint64_t kAckInterval = kLowWatermark;
+  // Clipboard contents are kept in memory, the ones being received take at
+  // most this much together
+  static constexpr uint64_t kMaxClipboardSize = 64 * 1024 * 1024;
+
+  using OnClipboard =
+      std::function<void(const std::string& mime, std::string data)>;
+  using OnTransferDone = std::function<void(const BulkTransferResult&)>;
+
+  BulkDataManager() = default;
+  ~BulkDataManager() { Shutdown(); }
+
+  // Stops the threads and lets go of the channels. The channels call into
+  // the threads of the PeerConnectionFactory, so this has to run before the
+  // RTCManager is destroyed
+  void Shutdown() {
+    stopping_ = true;
+    hasher_.Stop();
+    disk_.Stop();
+    std::vector<std::unique_ptr<Channel>> channels;
+    WithLock([&] { channels.swap(channels_); });
+    for (auto& ch : channels) {
+      ch->dc->UnregisterObserver();
+    }
+  }
+
+  // Incoming files are saved here; without it, file offers are declined
+  void SetReceiveDirectory(std::string dir) {
+    webrtc::MutexLock lock(&lock_);
+    receive_dir_ = std::move(dir);
+  }
+  // Without it, clipboard offers are declined
+  void SetOnClipboard(OnClipboard cb) {
+    webrtc::MutexLock lock(&lock_);
+    on_clipboard_ = std::move(cb);
+  }
+  void SetOnTransferDone(OnTransferDone cb) {
+    webrtc::MutexLock lock(&lock_);
+    on_done_ = std::move(cb);
+  }
+
+  // Returns at once, the file is offered when it has been hashed and a
+  // channel is open. Return value: transfer id, 0 if there is no such file
+  uint32_t SendFile(const std::string& path) {
+    boost::system::error_code ec;
+    const uint64_t size = boost::filesystem::file_size(path, ec);
+    if (ec) {
+      RTC_LOG(LS_WARNING) << "Cannot send " << path << ": " << ec.message();
+      return 0;
+    }
+    uint32_t tid = 0;
+    WithLock([&] {
+      tid = next_tid_++;
+      Outgoing& t = outgoing_[tid];
+      t.kind = "file";
+      t.name = detail::SanitizeName(
+          boost::filesystem::path(path).filename().string());
+      t.path = path;
+      t.size = size;
+      PublishLocked();
+    });
+    hasher_.Post([this, tid, path] {
+      detail::Sha256 sha;
+      const bool read = HashFile(path, &sha);
+      const std::string hash = sha.HexDigest();
+      auto file = std::make_shared<std::ifstream>(path, std::ios::binary);
+      WithLock([&] {
+        auto it = outgoing_.find(tid);
+        if (it == outgoing_.end()) {
+          return;
+        }
+        Outgoing& t = it->second;
+        if (!read || !*file) {
+          FinishOutgoingLocked(tid, false, "failed to read " + path);
+          return;
+        }
+        t.file = std::move(file);
+        t.hash = hash;
+        OfferLocked(tid, t);
+      });
+    });
+    return tid;
+  }
+
+  // Return value: transfer id, 0 if the contents are too large
+  uint32_t SendClipboard(const std::string& mime, std::string data) {
+    if (data.size() > kMaxClipboardSize) {
+      return 0;
+    }
+    detail::Sha256 sha;
+    sha.Update(data.data(), data.size());
+    uint32_t tid = 0;
+    WithLock([&] {
+      tid = next_tid_++;
+      Outgoing& t = outgoing_[tid];
+      t.kind = "clipboard";
+      t.name = detail::SanitizeName(mime);
+      t.size = data.size();
+      t.data = std::make_shared<const std::string>(std::move(data));
+      t.hash = sha.HexDigest();
+      OfferLocked(tid, t);
+      PublishLocked();
+    });
+    return tid;
+  }
+
+  void Cancel(uint32_t tid) {
+    WithLock([&] {
+      auto it = outgoing_.find(tid);
+      if (it == outgoing_.end()) {
+        return;
+      }
+      if (Channel* ch = FindChannelLocked(it->second.channel)) {
+        std::ostringstream os;
+        os << "{\"type\":\"bulkCancel\",\"tid\":" << tid << "}";
+        SendTextLocked(ch, os.str());
+      }
+      FinishOutgoingLocked(tid, false, "cancelled");
+    });
+  }
+
+  void OnDataChannel(
+      webrtc::scoped_refptr<webrtc::DataChannelInterface> dc) override {
+    if (dc->label() != kLabel) {
+      return;
+    }
+    Channel* ch = nullptr;
+    std::vector<std::unique_ptr<Channel>> closed;
+    WithLock([&] {
+      // Channels of connections that are gone
+      auto it = std::stable_partition(
+          channels_.begin(), channels_.end(),
+          [](const std::unique_ptr<Channel>& c) {
+            return c->dc->state() != webrtc::DataChannelInterface::kClosed;
+          });
+      std::move(it, channels_.end(), std::back_inserter(closed));
+      channels_.erase(it, channels_.end());
+      auto channel = std::make_unique<Channel>();
+      channel->id = next_channel_id_++;
+      channel->dc = dc;
+      channel->observer = std::make_unique<ChannelObserver>(this, channel.get());
+      ch = channel.get();
+      channels_.push_back(std::move(channel));
+    });
+    for (auto& c : closed) {
+      c->dc->UnregisterObserver();
+    }
+    // May deliver queued messages right away, so not under the lock
+    dc->RegisterObserver(ch->observer.get());
+    OnChannelStateChange(ch);
+  }
+
+ private:
+  struct Channel;
+
+  class ChannelObserver : public webrtc::DataChannelObserver {
+   public:
+    ChannelObserver(BulkDataManager* manager, Channel* channel)
+        : manager_(manager), channel_(channel) {}
+    void OnStateChange() override { manager_->OnChannelStateChange(channel_); }
+    void OnMessage(const webrtc::DataBuffer& buffer) override {
+      manager_->OnChannelMessage(channel_, buffer);
+    }
+    void OnBufferedAmountChange(uint64_t previous_amount) override {
+      (void)previous_amount;
+      manager_->OnChannelBufferedAmountChange(channel_);
+    }
+
+   private:
+    BulkDataManager* manager_;
+    Channel* channel_;
+  };
+
+  struct Channel {
+    uint64_t id{0};
+    webrtc::scoped_refptr<webrtc::DataChannelInterface> dc;
+    std::unique_ptr<ChannelObserver> observer;
+    bool open{false};
+  };
+
+  struct Outgoing {
+    std::string kind;
+    std::string name;
+    std::string path;
+    std::string hash;
+    uint64_t size{0};
+    std::shared_ptr<const std::string> data;
+    // Only used on the disk thread, which puts the chunks in ready
+    std::shared_ptr<std::ifstream> file;
+    std::deque<webrtc::CopyOnWriteBuffer> ready;
+    uint64_t ready_bytes{0};
+    // Offset of the next chunk to read
+    uint64_t read_next{0};
+    bool reading{false};
+    // Changes when reading starts over, older reads are dropped
+    uint64_t read_epoch{0};
+    // Channel id, 0 while waiting for a channel
+    uint64_t channel{0};
+    bool accepted{false};
+    bool ended{false};
+    uint64_t next{0};
+    // Bytes the receiver has written
+    uint64_t acked{0};
+    uint64_t resumed{0};
+    int64_t started_ms{0};
+  };
+
+  struct Incoming {
+    std::string kind;
+    std::string name;
+    std::string hash;
+    uint64_t size{0};
+    std::string part_path;
+    // Only used on the disk thread, nullptr until it is open
+    std::shared_ptr<std::ofstream> file;
+    std::string data;
+    uint64_t received{0};
+    // Bytes written to the file, and how many of them were acked
+    uint64_t written{0};
+    uint64_t acked{0};
+    uint64_t resumed{0};
+    int64_t started_ms{0};
+  };
+  // (channel id, tid)
+  using IncomingKey = std::pair<uint64_t, uint32_t>;
+
+  static constexpr size_t kChunkHeaderSize = 12;
+
+  // Runs f under the lock, then the callbacks it queued without it
+  template <class F>
+  void WithLock(F f) {
+    std::vector<std::function<void()>> callbacks;
+    {
+      webrtc::MutexLock lock(&lock_);
+      f();
+      callbacks.swap(callbacks_);
+    }
+    for (auto& cb : callbacks) {
+      cb();
+    }
+  }
+
+  void OnChannelStateChange(Channel* ch) {
+    WithLock([&] {
+      const auto state = ch->dc->state();
+      if (state == webrtc::DataChannelInterface::kOpen && !ch->open) {
+        ch->open = true;
+        for (auto& [tid, t] : outgoing_) {
+          if (t.channel == 0 && !t.hash.empty()) {
+            OfferLocked(tid, t);
+          }
+        }
+      } else if (state != webrtc::DataChannelInterface::kOpen && ch->open) {
+        ch->open = false;
+        OnChannelClosedLocked(ch);
+      }
+    });
+  }
+
+  void OnChannelClosedLocked(Channel* ch) {
+    // Partly received files stay on the disk for the next offer
+    for (auto it = incoming_.begin(); it != incoming_.end();) {
+      if (it->first.first == ch->id) {
+        ReleaseLocked(it->second);
+        CloseFileLocked(std::move(it->second.file));
+        it = incoming_.erase(it);
+      } else {
+        ++it;
+      }
+    }
+    // Offered again on the next open channel, the receiver says where to go
+    // on from
+    for (auto& [tid, t] : outgoing_) {
+      if (t.channel != ch->id) {
+        continue;
+      }
+      t.channel = 0;
+      t.accepted = false;
+      t.ended = false;
+      if (!t.hash.empty()) {
+        OfferLocked(tid, t);
+      }
+    }
+    PublishLocked();
+  }
+
+  void OnChannelMessage(Channel* ch, const webrtc::DataBuffer& buffer) {
+    WithLock([&] {
+      if (buffer.binary) {
+        OnChunkLocked(ch, buffer.data);
+        return;
+      }
+      std::string_view s(buffer.data.data<char>(), buffer.data.size());
+      // Numbers the peer got wrong come back as nullopt, see JsonGetInt64
+      auto type = proto::JsonGetType(s);
+      auto tid = proto::JsonGetInt64(s, "tid");
+      if (!type || !tid || *tid < 0 || *tid > UINT32_MAX) {
+        return;
+      }
+      const uint32_t id = static_cast<uint32_t>(*tid);
+      if (*type == "bulkOffer") {
+        OnOfferLocked(ch, id, s);
+      } else if (*type == "bulkAccept") {
+        OnAcceptLocked(ch, id, proto::JsonGetInt64(s, "offset").value_or(-1));
+      } else if (*type == "bulkAck") {
+        OnAckLocked(ch, id, proto::JsonGetInt64(s, "offset").value_or(-1));
+      } else if (*type == "bulkEnd") {
+        OnEndLocked(ch, id);
+      } else if (*type == "bulkResult") {
+        auto it = outgoing_.find(id);
+        if (it != outgoing_.end() && it->second.channel == ch->id) {
+          FinishOutgoingLocked(id, proto::JsonGetBool(s, "ok").value_or(false),
+                               proto::JsonGetString(s, "error").value_or(""));
+        }
+      } else if (*type == "bulkCancel") {
+        FailIncomingLocked({ch->id, id}, "cancelled by the sender", false);
+      }
+    });
+  }
+
+  void OnChannelBufferedAmountChange(Channel* ch) {
+    WithLock([&] {
+      if (ch->open && ch->dc->buffered_amount() <= kLowWatermark) {
+        PumpLocked(ch);
+      }
+    });
+  }
+
+  // Sending side
+
+  void OfferLocked(uint32_t tid, Outgoing& t) {
+    Channel* ch = nullptr;
+    for (auto& c : channels_) {
+      if (c->open) {
+        ch = c.get();
+        break;
+      }
+    }
+    if (ch == nullptr) {
+      return;
+    }
+    t.channel = ch->id;
+    std::ostringstream os;
+    os << "{\"type\":\"bulkOffer\",\"tid\":" << tid << ",\"hash\":\""
+       << t.hash << "\",\"kind\":\"" << t.kind << "\",\"name\":\"" << t.name
+       << "\",\"size\":" << t.size << ",\"chunk\":" << kChunkSize << "}";
+    SendTextLocked(ch, os.str());
+  }
+
+  void OnAcceptLocked(Channel* ch, uint32_t tid, int64_t offset) {
+    auto it = outgoing_.find(tid);
+    if (it == outgoing_.end() || it->second.channel != ch->id) {
+      return;
+    }
+    Outgoing& t = it->second;
+    if (offset < 0 || static_cast<uint64_t>(offset) > t.size) {
+      FinishOutgoingLocked(tid, false, "invalid offset");
+      return;
+    }
+    t.ready.clear();
+    t.ready_bytes = 0;
+    t.read_next = offset;
+    t.reading = false;
+    t.read_epoch++;
+    t.next = offset;
+    t.acked = offset;
+    t.resumed = offset;
+    t.accepted = true;
+    t.started_ms = webrtc::TimeMillis();
+    MetricsRegistry::Instance().Add("bulk", "resumed_bytes",
+                                    static_cast<double>(offset));
+    PumpLocked(ch);
+  }
+
+  void OnAckLocked(Channel* ch, uint32_t tid, int64_t offset) {
+    auto it = outgoing_.find(tid);
+    if (it == outgoing_.end() || it->second.channel != ch->id ||
+        !it->second.accepted) {
+      return;
+    }
+    Outgoing& t = it->second;
+    if (offset < 0 || static_cast<uint64_t>(offset) > t.next) {
+      return;
+    }
+    t.acked = std::max(t.acked, static_cast<uint64_t>(offset));
+    PumpLocked(ch);
+  }
+
+  // Sends chunks until the channel has kHighWatermark buffered, or a file
+  // has kHighWatermark that the receiver did not ack yet
+  void PumpLocked(Channel* ch) {
+    uint64_t sent = 0;
+    for (auto& [tid, t] : outgoing_) {
+      if (t.channel != ch->id || !t.accepted || t.ended) {
+        continue;
+      }
+      while (t.next < t.size && ch->dc->buffered_amount() < kHighWatermark &&
+             (t.data || t.next - t.acked < kHighWatermark)) {
+        webrtc::CopyOnWriteBuffer chunk;
+        if (t.data) {
+          const size_t n = static_cast<size_t>(
+              std::min<uint64_t>(kChunkSize, t.size - t.next));
+          chunk = MakeChunk(tid, t.next, n);
+          std::copy(t.data->data() + t.next, t.data->data() + t.next + n,
+                    chunk.MutableData() + kChunkHeaderSize);
+        } else if (!t.ready.empty()) {
+          chunk = std::move(t.ready.front());
+          t.ready.pop_front();
+          t.ready_bytes -= chunk.size() - kChunkHeaderSize;
+        } else {
+          // Not read yet, sent when it is
+          break;
+        }
+        if (!ch->dc->Send(webrtc::DataBuffer(chunk, true))) {
+          // The channel is closing, the transfer is offered again
+          MetricsRegistry::Instance().Add("bulk", "sent_bytes",
+                                          static_cast<double>(sent));
+          return;
+        }
+        t.next += chunk.size() - kChunkHeaderSize;
+        sent += chunk.size() - kChunkHeaderSize;
+      }
+      ReadAheadLocked(tid, t);
+      if (t.next < t.size) {
+        // Window full, the rest goes when it drains
+        break;
+      }
+      std::ostringstream os;
+      os << "{\"type\":\"bulkEnd\",\"tid\":" << tid << "}";
+      SendTextLocked(ch, os.str());
+      t.ended = true;
+    }
+    if (sent > 0) {
+      MetricsRegistry::Instance().Add("bulk", "sent_bytes",
+                                      static_cast<double>(sent));
+    }
+  }
+
+  // Reads up to kHighWatermark of chunks on the disk thread
+  void ReadAheadLocked(uint32_t tid, Outgoing& t) {
+    if (!t.file || t.reading || t.read_next >= t.size ||
+        t.ready_bytes >= kHighWatermark) {
+      return;
+    }
+    const uint64_t offset = t.read_next;
+    const uint64_t length =
+        std::min(kHighWatermark - t.ready_bytes, t.size - offset);
+    t.reading = true;
+    disk_.Post([this, tid, file = t.file, offset, length,
+                epoch = t.read_epoch] {
+      std::vector<webrtc::CopyOnWriteBuffer> chunks;
+      file->clear();
+      file->seekg(offset);
+      bool ok = true;
+      for (uint64_t done = 0; done < length;) {
+        const size_t n =
+            static_cast<size_t>(std::min<uint64_t>(kChunkSize, length - done));
+        webrtc::CopyOnWriteBuffer chunk = MakeChunk(tid, offset + done, n);
+        if (!file->read(
+                reinterpret_cast<char*>(chunk.MutableData() + kChunkHeaderSize),
+                n)) {
+          ok = false;
+          break;
+        }
+        chunks.push_back(std::move(chunk));
+        done += n;
+      }
+      WithLock([&] {
+        auto it = outgoing_.find(tid);
+        if (it == outgoing_.end() || it->second.read_epoch != epoch) {
+          return;
+        }
+        Outgoing& t = it->second;
+        t.reading = false;
+        Channel* ch = FindChannelLocked(t.channel);
+        if (!ok) {
+          if (ch != nullptr) {
+            std::ostringstream os;
+            os << "{\"type\":\"bulkCancel\",\"tid\":" << tid << "}";
+            SendTextLocked(ch, os.str());
+          }
+          FinishOutgoingLocked(tid, false, "failed to read the file");
+          return;
+        }
+        for (auto& chunk : chunks) {
+          t.read_next += chunk.size() - kChunkHeaderSize;
+          t.ready_bytes += chunk.size() - kChunkHeaderSize;
+          t.ready.push_back(std::move(chunk));
+        }
+        if (ch != nullptr && t.accepted) {
+          PumpLocked(ch);
+        }
+      });
+    });
+  }
+
+  // Header of the chunk, with room for n bytes of data after it
+  static webrtc::CopyOnWriteBuffer MakeChunk(uint32_t tid,
+                                             uint64_t offset,
+                                             size_t n) {
+    webrtc::CopyOnWriteBuffer chunk(kChunkHeaderSize + n);
+    uint8_t* p = chunk.MutableData();
+    for (int i = 0; i < 4; i++) {
+      p[i] = static_cast<uint8_t>(tid >> (24 - 8 * i));
+    }
+    for (int i = 0; i < 8; i++) {
+      p[4 + i] = static_cast<uint8_t>(offset >> (56 - 8 * i));
+    }
+    return chunk;
+  }
+
+  void FinishOutgoingLocked(uint32_t tid,
+                            bool ok,
+                            const std::string& error) {
+    auto it = outgoing_.find(tid);
+    if (it == outgoing_.end()) {
+      return;
+    }
+    const Outgoing& t = it->second;
+    BulkTransferResult r;
+    r.kind = t.kind;
+    r.name = t.name;
+    r.path = t.path;
+    r.size = t.size;
+    r.resumed = t.resumed;
+    r.ok = ok;
+    r.error = error;
+    if (t.started_ms > 0) {
+      r.seconds = (webrtc::TimeMillis() - t.started_ms) / 1000.0;
+    }
+    outgoing_.erase(it);
+    Done(r);
+  }
+
+  // Receiving side
+
+  void OnOfferLocked(Channel* ch, uint32_t tid, std::string_view s) {
+    Incoming in;
+    in.kind = proto::JsonGetString(s, "kind").value_or("");
+    in.name = proto::JsonGetString(s, "name").value_or("");
+    in.hash = proto::JsonGetString(s, "hash").value_or("");
+    const int64_t size = proto::JsonGetInt64(s, "size").value_or(-1);
+    const int64_t chunk = proto::JsonGetInt64(s, "chunk").value_or(0);
+    const IncomingKey key{ch->id, tid};
+    if (!detail::IsSha256Hex(in.hash) || size < 0 || chunk <= 0 ||
+        static_cast<uint64_t>(chunk) > kMaxChunkSize ||
+        (in.kind != "file" && in.kind != "clipboard")) {
+      SendResultLocked(ch, tid, false, "invalid offer");
+      return;
+    }
+    for (const auto& [k, other] : incoming_) {
+      if (other.hash == in.hash) {
+        SendResultLocked(ch, tid, false, "already being received");
+        return;
+      }
+    }
+    in.size = static_cast<uint64_t>(size);
+
+    if (in.kind == "clipboard") {
+      if (!on_clipboard_) {
+        SendResultLocked(ch, tid, false, "clipboard contents are not accepted");
+        return;
+      }
+      if (in.size > kMaxClipboardSize) {
+        SendResultLocked(ch, tid, false, "too large");
+        return;
+      }
+      if (clipboard_bytes_ + in.size > kMaxClipboardSize) {
+        SendResultLocked(ch, tid, false, "too many clipboard transfers");
+        return;
+      }
+      clipboard_bytes_ += in.size;
+      in.data.reserve(in.size);
+      incoming_[key] = std::move(in);
+      AcceptIncomingLocked(key, 0);
+      return;
+    }
+    if (receive_dir_.empty()) {
+      SendResultLocked(ch, tid, false, "files are not accepted");
+      return;
+    }
+    in.part_path = (boost::filesystem::path(receive_dir_) /
+                    (".momo-" + in.hash + ".part"))
+                       .string();
+    // Accepted when the file is open, until then it only holds the hash
+    incoming_[key] = in;
+    PublishLocked();
+    disk_.Post([this, key, chunk, in = std::move(in),
+                receive_dir = receive_dir_] {
+      boost::system::error_code ec;
+      boost::filesystem::create_directories(receive_dir, ec);
+      // Goes on after the last whole chunk of an earlier attempt
+      uint64_t offset = 0;
+      const uint64_t have = boost::filesystem::file_size(in.part_path, ec);
+      if (!ec) {
+        offset = std::min(have, in.size) / chunk * chunk;
+        if (offset != have) {
+          boost::filesystem::resize_file(in.part_path, offset, ec);
+          if (ec) {
+            offset = 0;
+            boost::filesystem::remove(in.part_path, ec);
+          }
+        }
+      }
+      auto file = std::make_shared<std::ofstream>(
+          in.part_path, std::ios::binary | (offset > 0 ? std::ios::app
+                                                       : std::ios::trunc));
+      WithLock([&] {
+        auto it = incoming_.find(key);
+        if (it == incoming_.end() || it->second.file) {
+          // Cancelled or the channel closed meanwhile
+          return;
+        }
+        if (!*file) {
+          FailIncomingLocked(key, "failed to create the file", true);
+          return;
+        }
+        it->second.file = std::move(file);
+        AcceptIncomingLocked(key, offset);
+      });
+    });
+  }
+
+  void AcceptIncomingLocked(const IncomingKey& key, uint64_t offset) {
+    Incoming& in = incoming_[key];
+    in.received = offset;
+    in.written = offset;
+    in.acked = offset;
+    in.resumed = offset;
+    in.started_ms = webrtc::TimeMillis();
+    if (offset > 0) {
+      RTC_LOG(LS_INFO) << "Resuming " << in.name << " at " << offset;
+    }
+    if (Channel* ch = FindChannelLocked(key.first)) {
+      std::ostringstream os;
+      os << "{\"type\":\"bulkAccept\",\"tid\":" << key.second
+         << ",\"offset\":" << offset << "}";
+      SendTextLocked(ch, os.str());
+    }
+    PublishLocked();
+  }
+
+  void OnChunkLocked(Channel* ch, const webrtc::CopyOnWriteBuffer& data) {
+    if (data.size() < kChunkHeaderSize) {
+      return;
+    }
+    const uint8_t* p = data.data();
+    uint32_t tid = 0;
+    for (int i = 0; i < 4; i++) {
+      tid = (tid << 8) | p[i];
+    }
+    uint64_t offset = 0;
+    for (int i = 0; i < 8; i++) {
+      offset = (offset << 8) | p[4 + i];
+    }
+    const IncomingKey key{ch->id, tid};
+    auto it = incoming_.find(key);
+    if (it == incoming_.end()) {
+      return;
+    }
+    Incoming& in = it->second;
+    const size_t n = data.size() - kChunkHeaderSize;
+    // The channel is ordered, a gap means something went wrong
+    if (offset != in.received || in.received + n > in.size ||
+        (in.kind == "file" && !in.file)) {
+      FailIncomingLocked(key, "unexpected chunk", true);
+      return;
+    }
+    const char* payload = reinterpret_cast<const char*>(p + kChunkHeaderSize);
+    if (in.kind == "clipboard") {
+      in.data.append(payload, n);
+    } else {
+      disk_.Post([this, key, file = in.file, data] {
+        if (!*file) {
+          // Already failed
+          return;
+        }
+        const size_t n = data.size() - kChunkHeaderSize;
+        file->write(
+            reinterpret_cast<const char*>(data.data()) + kChunkHeaderSize, n);
+        const bool ok = static_cast<bool>(*file);
+        WithLock([&] {
+          auto it = incoming_.find(key);
+          if (it == incoming_.end() || it->second.file != file) {
+            return;
+          }
+          if (!ok) {
+            FailIncomingLocked(key, "failed to write the file", true);
+            return;
+          }
+          OnWrittenLocked(key, it->second, n);
+        });
+      });
+    }
+    in.received += n;
+    MetricsRegistry::Instance().Add("bulk", "received_bytes",
+                                    static_cast<double>(n));
+  }
+
+  // Lets the sender go on once the chunks are on the disk
+  void OnWrittenLocked(const IncomingKey& key, Incoming& in, size_t n) {
+    in.written += n;
+    if (in.written - in.acked < kAckInterval && in.written < in.size) {
+      return;
+    }
+    in.acked = in.written;
+    if (Channel* ch = FindChannelLocked(key.first)) {
+      std::ostringstream os;
+      os << "{\"type\":\"bulkAck\",\"tid\":" << key.second
+         << ",\"offset\":" << in.written << "}";
+      SendTextLocked(ch, os.str());
+    }
+  }
+
+  void OnEndLocked(Channel* ch, uint32_t tid) {
+    const IncomingKey key{ch->id, tid};
+    auto it = incoming_.find(key);
+    if (it == incoming_.end()) {
+      return;
+    }
+    if (it->second.received != it->second.size ||
+        (it->second.kind == "file" && !it->second.file)) {
+      FailIncomingLocked(key, "incomplete", true);
+      return;
+    }
+    auto in = std::make_shared<Incoming>(std::move(it->second));
+    incoming_.erase(it);
+    const uint64_t channel_id = ch->id;
+    const std::string receive_dir = receive_dir_;
+    const double seconds = (webrtc::TimeMillis() - in->started_ms) / 1000.0;
+    if (in->kind == "clipboard") {
+      hasher_.Post([this, in, channel_id, tid, receive_dir, seconds] {
+        CheckIncoming(in, channel_id, tid, receive_dir, seconds, true);
+      });
+      return;
+    }
+    // Closed after the writes of the chunks, which were posted before, then
+    // read back once to check it
+    disk_.Post([this, in, channel_id, tid, receive_dir, seconds] {
+      in->file->close();
+      const bool written = !in->file->fail();
+      hasher_.Post([this, in, channel_id, tid, receive_dir, seconds, written] {
+        CheckIncoming(in, channel_id, tid, receive_dir, seconds, written);
+      });
+    });
+  }
+
+  // On the hashing thread
+  void CheckIncoming(std::shared_ptr<Incoming> in,
+                     uint64_t channel_id,
+                     uint32_t tid,
+                     const std::string& receive_dir,
+                     double seconds,
+                     bool written) {
+    detail::Sha256 sha;
+    bool read = written;
+    if (in->kind == "clipboard") {
+      sha.Update(in->data.data(), in->data.size());
+    } else if (read) {
+      read = HashFile(in->part_path, &sha);
+    }
+    const bool match = read && sha.HexDigest() == in->hash;
+
+    BulkTransferResult r;
+    r.incoming = true;
+    r.kind = in->kind;
+    r.name = in->name;
+    r.size = in->size;
+    r.resumed = in->resumed;
+    r.seconds = seconds;
+    boost::system::error_code ec;
+    if (!match) {
+      r.error = "the content does not match its hash";
+      if (!in->part_path.empty()) {
+        boost::filesystem::remove(in->part_path, ec);
+      }
+    } else if (in->kind == "file") {
+      r.path = UniquePath(receive_dir, in->name);
+      boost::filesystem::rename(in->part_path, r.path, ec);
+      if (ec) {
+        r.error = "failed to move the file: " + ec.message();
+      }
+    }
+    r.ok = r.error.empty();
+    WithLock([&] {
+      ReleaseLocked(*in);
+      if (Channel* c = FindChannelLocked(channel_id)) {
+        SendResultLocked(c, tid, r.ok, r.error);
+      }
+      if (r.ok && in->kind == "clipboard" && on_clipboard_) {
+        callbacks_.push_back([cb = on_clipboard_, mime = in->name,
+                              data = std::move(in->data)]() mutable {
+          cb(mime, std::move(data));
+        });
+      }
+      Done(r);
+    });
+  }
+
+  void FailIncomingLocked(const IncomingKey& key,
+                          const std::string& error,
+                          bool reply) {
+    auto it = incoming_.find(key);
+    if (it == incoming_.end()) {
+      return;
+    }
+    Incoming& in = it->second;
+    ReleaseLocked(in);
+    CloseFileLocked(std::move(in.file));
+    if (reply) {
+      if (Channel* ch = FindChannelLocked(key.first)) {
+        SendResultLocked(ch, key.second, false, error);
+      }
+    }
+    BulkTransferResult r;
+    r.incoming = true;
+    r.kind = in.kind;
+    r.name = in.name;
+    r.size = in.size;
+    r.resumed = in.resumed;
+    r.error = error;
+    incoming_.erase(it);
+    Done(r);
+  }
+
+  void SendResultLocked(Channel* ch,
+                        uint32_t tid,
+                        bool ok,
+                        const std::string& error) {
+    std::ostringstream os;
+    os << "{\"type\":\"bulkResult\",\"tid\":" << tid
+       << ",\"ok\":" << (ok ? "true" : "false");
+    if (!ok) {
+      os << ",\"error\":\"" << detail::SanitizeName(error) << "\"";
+    }
+    os << "}";
+    SendTextLocked(ch, os.str());
+  }
+
+  // Helpers
+
+  void SendTextLocked(Channel* ch, const std::string& text) {
+    if (ch->open) {
+      ch->dc->Send(webrtc::DataBuffer(text));
+    }
+  }
+
+  void ReleaseLocked(const Incoming& in) {
+    if (in.kind == "clipboard") {
+      clipboard_bytes_ -= in.size;
+    }
+  }
+
+  // Closing flushes the file, which is left to the disk thread too
+  void CloseFileLocked(std::shared_ptr<std::ofstream> file) {
+    if (file) {
+      disk_.Post([file] { file->close(); });
+    }
+  }
+
+  Channel* FindChannelLocked(uint64_t id) {
+    for (auto& c : channels_) {
+      if (c->id == id && c->open) {
+        return c.get();
+      }
+    }
+    return nullptr;
+  }
+
+  void Done(const BulkTransferResult& r) {
+    RTC_LOG(LS_INFO) << (r.incoming ? "Received " : "Sent ") << r.kind << " "
+                     << r.name << " (" << r.size << " bytes, " << r.resumed
+                     << " resumed) "
+                     << (r.ok ? "in " + std::to_string(r.seconds) + " s"
+                              : "failed: " + r.error);
+    auto& metrics = MetricsRegistry::Instance();
+    metrics.Add("bulk", r.ok ? "completed" : "failed", 1);
+    if (r.ok && r.seconds > 0) {
+      metrics.Set("bulk", "last_mbps",
+                  (r.size - r.resumed) * 8 / r.seconds / 1000000.0);
+    }
+    if (on_done_) {
+      callbacks_.push_back([cb = on_done_, r]() { cb(r); });
+    }
+    PublishLocked();
+  }
+
+  void PublishLocked() {
+    MetricsRegistry::Instance().Set(
+        "bulk", "transfers",
+        static_cast<double>(outgoing_.size() + incoming_.size()));
+  }
+
+  bool HashFile(const std::string& path, detail::Sha256* sha) {
+    std::ifstream ifs(path, std::ios::binary);
+    if (!ifs) {
+      return false;
+    }
+    std::vector<char> buf(1024 * 1024);
+    while (!stopping_) {
+      ifs.read(buf.data(), buf.size());
+      if (ifs.gcount() > 0) {
+        sha->Update(buf.data(), static_cast<size_t>(ifs.gcount()));
+      }
+      if (!ifs) {
+        return ifs.eof();
+      }
+    }
+    return false;
+  }
+
+  // "name", or "name (1)" and so on if it is taken
+  static std::string UniquePath(const std::string& dir,
+                                const std::string& name) {
+    std::string file = boost::filesystem::path(name).filename().string();
+    if (file.empty() || file == "." || file == "..") {
+      file = "file";
+    }
+    const boost::filesystem::path base = boost::filesystem::path(dir) / file;
+    boost::filesystem::path path = base;
+    for (int i = 1; boost::filesystem::exists(path); i++) {
+      path = base.parent_path() / (base.stem().string() + " (" +
+                                   std::to_string(i) + ")" +
+                                   base.extension().string());
+    }
+    return path.string();
+  }
+
+  webrtc::Mutex lock_;
+  std::vector<std::unique_ptr<Channel>> channels_;
+  uint64_t next_channel_id_{1};
+  std::map<uint32_t, Outgoing> outgoing_;
+  uint32_t next_tid_{1};
+  std::map<IncomingKey, Incoming> incoming_;
+  // Sizes of the clipboard contents being received or checked
+  uint64_t clipboard_bytes_{0};
+  std::string receive_dir_;
+  OnClipboard on_clipboard_;
+  OnTransferDone on_done_;
+  std::vector<std::function<void()>> callbacks_;
+
+  std::atomic<bool> stopping_{false};
+  // Chunks, and opening and closing the files of incoming transfers
+  detail::TaskThread disk_;
+  // Hashing and checking whole files
+  detail::TaskThread hasher_;
+};
+
+}  // namespace data_channel
+}  // namespace remote
+
+#endif  // REMOTE_DATA_CHANNEL_BULK_DATA_MANAGER_H_
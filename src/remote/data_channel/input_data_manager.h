@@ -4,6 +4,7 @@
 #ifndef REMOTE_DATA_CHANNEL_INPUT_DATA_MANAGER_H_
 #define REMOTE_DATA_CHANNEL_INPUT_DATA_MANAGER_H_
 
+#include <functional>
 #include <memory>
 #include <vector>
 #include <string>
@@ -12,6 +13,8 @@
 #include <rtc_base/synchronization/mutex.h>
 #include <rtc_base/copy_on_write_buffer.h>
 
+#include "metrics/metrics_registry.h"
+#include "remote/data_channel/input_send_queue.h"
 #include "rtc/rtc_data_manager.h"
 
 namespace remote {
@@ -19,6 +22,7 @@ namespace data_channel {
 
 // Listen and manage input-related DataChannel
 // To avoid modifying the build script, use header-only minimal implementation
+// Sending is paced by the buffered amount of each channel, see InputSendQueue
 class InputDataManager : public RTCDataManager, public webrtc::DataChannelObserver {
  public:
   InputDataManager() = default;
@@ -29,40 +33,40 @@ class InputDataManager : public RTCDataManager, public webrtc::DataChannelObserv
     webrtc::MutexLock lock(&lock_);
     const std::string label = dc->label();
     if (label == "input-reliable") {
-      reliable_ = dc;
-      reliable_->RegisterObserver(this);
+      reliable_.dc = dc;
+      reliable_.queue.Clear();
+      reliable_.dc->RegisterObserver(this);
     } else if (label == "input-rt") {
-      rt_ = dc;
-      rt_->RegisterObserver(this);
+      rt_.dc = dc;
+      rt_.queue.Clear();
+      rt_.dc->RegisterObserver(this);
     }
+    PublishQueueLocked();
   }
 
   // Send reliable message
   bool SendReliable(const std::vector<uint8_t>& bytes) {
     webrtc::MutexLock lock(&lock_);
-    if (!reliable_ || reliable_->state() != webrtc::DataChannelInterface::kOpen) {
-      return false;
-    }
-    std::string s(reinterpret_cast<const char*>(bytes.data()), bytes.size());
-    webrtc::DataBuffer buf(webrtc::CopyOnWriteBuffer(s), reliable_binary_);
-    reliable_->Send(buf);
-    return true;
+    return SendLocked(reliable_, reliable_binary_, bytes);
   }
 
   // Send low-latency message
   bool SendRt(const std::vector<uint8_t>& bytes) {
     webrtc::MutexLock lock(&lock_);
-    if (!rt_ || rt_->state() != webrtc::DataChannelInterface::kOpen) {
-      return false;
-    }
-    std::string s(reinterpret_cast<const char*>(bytes.data()), bytes.size());
-    webrtc::DataBuffer buf(webrtc::CopyOnWriteBuffer(s), rt_binary_);
-    rt_->Send(buf);
-    return true;
+    return SendLocked(rt_, rt_binary_, bytes);
   }
 
-  // DataChannelObserver interface (initial only placeholder)
-  void OnStateChange() override {}
+  // DataChannelObserver interface
+  void OnStateChange() override {
+    webrtc::MutexLock lock(&lock_);
+    // Queued input is stale once the channel is gone
+    for (Channel* ch : {&reliable_, &rt_}) {
+      if (ch->dc && ch->dc->state() != webrtc::DataChannelInterface::kOpen) {
+        ch->queue.Clear();
+      }
+    }
+    PublishQueueLocked();
+  }
   void OnMessage(const webrtc::DataBuffer& buffer) override {
     auto cb = on_message_;
     if (cb) {
@@ -70,8 +74,12 @@ class InputDataManager : public RTCDataManager, public webrtc::DataChannelObserv
       cb(buffer.data.cdata(), buffer.data.size(), buffer.binary);
     }
   }
+  // Shared by both channels, which does not say which one drained
   void OnBufferedAmountChange(uint64_t previous_amount) override {
     (void)previous_amount;
+    webrtc::MutexLock lock(&lock_);
+    DrainLocked(reliable_, reliable_binary_);
+    DrainLocked(rt_, rt_binary_);
   }
 
   // Set message callback (reliable and low-latency temporarily shared)
@@ -85,9 +93,82 @@ class InputDataManager : public RTCDataManager, public webrtc::DataChannelObserv
   void SetBinaryBoth(bool v) { reliable_binary_ = v; rt_binary_ = v; }
 
  private:
+  // Bytes the channel may buffer before messages wait in the queue, where
+  // they can still be reordered and superseded. Sending resumes when the
+  // buffer is down to kLowWatermark.
+  static constexpr uint64_t kHighWatermark = 64 * 1024;
+  static constexpr uint64_t kLowWatermark = 16 * 1024;
+
+  struct Channel {
+    webrtc::scoped_refptr<webrtc::DataChannelInterface> dc;
+    InputSendQueue queue;
+  };
+
+  bool SendLocked(Channel& ch, bool binary, const std::vector<uint8_t>& bytes) {
+    if (!ch.dc || ch.dc->state() != webrtc::DataChannelInterface::kOpen) {
+      return false;
+    }
+    const InputMessageInfo info = ClassifyInputMessage(bytes.data(), bytes.size());
+    // The only copy of the message
+    webrtc::CopyOnWriteBuffer data(bytes.data(), bytes.size());
+    if (ch.queue.empty() && ch.dc->buffered_amount() < kHighWatermark) {
+      ch.queue.Track(info);
+      return ch.dc->Send(webrtc::DataBuffer(data, binary));
+    }
+    // Refused when the queue is full of messages that cannot be left out,
+    // the caller sees that the input was not sent
+    const bool queued = ch.queue.Push(info, std::move(data));
+    if (queued) {
+      MetricsRegistry::Instance().Add("input", "queued_messages", 1);
+    }
+    PublishQueueLocked();
+    return queued;
+  }
+
+  void DrainLocked(Channel& ch, bool binary) {
+    if (!ch.dc || ch.queue.empty() ||
+        ch.dc->buffered_amount() > kLowWatermark) {
+      return;
+    }
+    while (ch.dc->buffered_amount() < kHighWatermark) {
+      auto data = ch.queue.Pop();
+      if (!data) {
+        break;
+      }
+      if (!ch.dc->Send(webrtc::DataBuffer(*data, binary))) {
+        ch.queue.Clear();
+        break;
+      }
+    }
+    PublishQueueLocked();
+  }
+
+  void PublishQueueLocked() {
+    auto& metrics = MetricsRegistry::Instance();
+    metrics.Set("input", "send_queue_messages",
+                static_cast<double>(reliable_.queue.size() + rt_.queue.size()));
+    metrics.Set("input", "send_queue_bytes",
+                static_cast<double>(reliable_.queue.bytes() + rt_.queue.bytes()));
+    for (Channel* ch : {&reliable_, &rt_}) {
+      const auto counters = ch->queue.TakeCounters();
+      if (counters.superseded > 0) {
+        metrics.Add("input", "superseded_messages",
+                    static_cast<double>(counters.superseded));
+      }
+      if (counters.dropped > 0) {
+        metrics.Add("input", "dropped_messages",
+                    static_cast<double>(counters.dropped));
+      }
+      if (counters.refused > 0) {
+        metrics.Add("input", "refused_messages",
+                    static_cast<double>(counters.refused));
+      }
+    }
+  }
+
   webrtc::Mutex lock_;
-  webrtc::scoped_refptr<webrtc::DataChannelInterface> reliable_;
-  webrtc::scoped_refptr<webrtc::DataChannelInterface> rt_;
+  Channel reliable_;
+  Channel rt_;
   std::function<void(const uint8_t*, size_t, bool)> on_message_;
   bool reliable_binary_{false};
   bool rt_binary_{false};
@@ -0,0 +1,352 @@
+// Description: Send queue of one input DataChannel, used while the channel has
+// more buffered than InputDataManager allows. Key presses, buttons, the wheel
+// and relative moves go out in the order they came, an absolute move is sent
+// after the ones that came before it, and cursor images and IME state go
+// last. A queued absolute move, cursor image or IME state is replaced in place
+// by a newer one.
+
+#ifndef REMOTE_DATA_CHANNEL_INPUT_SEND_QUEUE_H_
+#define REMOTE_DATA_CHANNEL_INPUT_SEND_QUEUE_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <optional>
+#include <string_view>
+
+#include <rtc_base/copy_on_write_buffer.h>
+
+#include "remote/proto/parser.h"
+
+namespace remote {
+namespace data_channel {
+
+enum class InputMessageKind {
+  kKeyboard,
+  kMouseAbs,
+  kMouseRel,
+  kMouseWheel,
+  kCursorImage,
+  kImeState,
+  kGamepad,
+  kOther,
+};
+
+struct InputMessageInfo {
+  InputMessageKind kind{InputMessageKind::kOther};
+  // Button mask of a mouseAbs message
+  std::optional<uint32_t> buttons;
+};
+
+namespace detail {
+
+// Protobuf varint, returns false past the end
+inline bool ReadVarint(const uint8_t*& p, const uint8_t* end, uint64_t& out) {
+  out = 0;
+  for (int shift = 0; p < end && shift < 64; shift += 7) {
+    const uint8_t b = *p++;
+    out |= static_cast<uint64_t>(b & 0x7f) << shift;
+    if ((b & 0x80) == 0) {
+      return true;
+    }
+  }
+  return false;
+}
+
+// Finds a field of a protobuf message, returns its varint value or the
+// range of its length delimited payload
+inline bool FindPbField(const uint8_t* p,
+                        const uint8_t* end,
+                        uint32_t field,
+                        uint64_t* varint,
+                        const uint8_t** begin_out,
+                        const uint8_t** end_out) {
+  while (p < end) {
+    uint64_t tag;
+    if (!ReadVarint(p, end, tag)) {
+      return false;
+    }
+    const uint32_t wire_type = static_cast<uint32_t>(tag & 7);
+    const bool match = (tag >> 3) == field;
+    uint64_t v = 0;
+    switch (wire_type) {
+      case 0:
+        if (!ReadVarint(p, end, v)) {
+          return false;
+        }
+        if (match && varint != nullptr) {
+          *varint = v;
+          return true;
+        }
+        break;
+      case 1:
+        p += 8;
+        break;
+      case 2:
+        if (!ReadVarint(p, end, v) || v > static_cast<uint64_t>(end - p)) {
+          return false;
+        }
+        if (match && begin_out != nullptr) {
+          *begin_out = p;
+          *end_out = p + v;
+          return true;
+        }
+        p += v;
+        break;
+      case 5:
+        p += 4;
+        break;
+      default:
+        return false;
+    }
+  }
+  return false;
+}
+
+}  // namespace detail
+
+// Looks at the type of a serialized message, JSON ({"type":"mouseAbs",...})
+// or the protobuf Envelope of remote_input.proto
+inline InputMessageInfo ClassifyInputMessage(const uint8_t* data, size_t size) {
+  InputMessageInfo info;
+  if (size == 0) {
+    return info;
+  }
+  if (data[0] == '{') {
+    std::string_view s(reinterpret_cast<const char*>(data), size);
+    // The type comes first, the rest may be a large cursor image
+    auto type = proto::JsonGetType(s.substr(0, 64));
+    if (!type) {
+      return info;
+    }
+    if (*type == "keyboard") {
+      info.kind = InputMessageKind::kKeyboard;
+    } else if (*type == "mouseAbs") {
+      info.kind = InputMessageKind::kMouseAbs;
+      if (auto buttons = proto::JsonGetInt64(s, "buttons")) {
+        info.buttons = static_cast<uint32_t>(*buttons);
+      }
+    } else if (*type == "mouseRel") {
+      info.kind = InputMessageKind::kMouseRel;
+    } else if (*type == "mouseWheel") {
+      info.kind = InputMessageKind::kMouseWheel;
+    } else if (*type == "cursorImage") {
+      info.kind = InputMessageKind::kCursorImage;
+    } else if (*type == "imeState") {
+      info.kind = InputMessageKind::kImeState;
+    } else if (*type == "gamepadXInput") {
+      info.kind = InputMessageKind::kGamepad;
+    }
+    return info;
+  }
+
+  // Envelope: the field number of the payload is the message type
+  const uint8_t* p = data;
+  const uint8_t* end = data + size;
+  uint64_t tag;
+  if (!detail::ReadVarint(p, end, tag) || (tag & 7) != 2) {
+    return info;
+  }
+  switch (tag >> 3) {
+    case 1:
+      info.kind = InputMessageKind::kKeyboard;
+      break;
+    case 2: {
+      info.kind = InputMessageKind::kMouseAbs;
+      uint64_t len;
+      if (!detail::ReadVarint(p, end, len) ||
+          len > static_cast<uint64_t>(end - p)) {
+        break;
+      }
+      // MouseAbs.btns (3) -> Buttons.bits (1), absent when 0
+      const uint8_t* btns_begin = nullptr;
+      const uint8_t* btns_end = nullptr;
+      uint64_t bits = 0;
+      if (detail::FindPbField(p, p + len, 3, nullptr, &btns_begin,
+                              &btns_end)) {
+        detail::FindPbField(btns_begin, btns_end, 1, &bits, nullptr, nullptr);
+      }
+      info.buttons = static_cast<uint32_t>(bits);
+      break;
+    }
+    case 3:
+      info.kind = InputMessageKind::kMouseRel;
+      break;
+    case 4:
+      info.kind = InputMessageKind::kMouseWheel;
+      break;
+    case 5:
+      info.kind = InputMessageKind::kCursorImage;
+      break;
+    case 6:
+      info.kind = InputMessageKind::kImeState;
+      break;
+    case 7:
+      info.kind = InputMessageKind::kGamepad;
+      break;
+    default:
+      break;
+  }
+  return info;
+}
+
+class InputSendQueue {
+ public:
+  // Messages kept at most. Beyond that the queued absolute moves, cursor
+  // images and IME states are dropped, and when there are none the new
+  // message is refused
+  static constexpr size_t kMaxMessages = 256;
+
+  struct Counters {
+    uint64_t superseded{0};
+    uint64_t dropped{0};
+    uint64_t refused{0};
+  };
+
+  // Called for every message sent on the channel, queued or not, to tell
+  // button changes from moves
+  void Track(const InputMessageInfo& info) {
+    if (info.kind == InputMessageKind::kMouseAbs && info.buttons) {
+      last_buttons_ = info.buttons;
+    }
+  }
+
+  // Returns false when the message is refused
+  bool Push(const InputMessageInfo& info, webrtc::CopyOnWriteBuffer data) {
+    const bool move = info.kind == InputMessageKind::kMouseAbs &&
+                      info.buttons && info.buttons == last_buttons_;
+    const bool button_change =
+        info.kind == InputMessageKind::kMouseAbs && !move;
+
+    // Key presses, buttons, the wheel and relative moves keep their order:
+    // relative moves add up, none of them can be left out or sent after a
+    // later click
+    Priority priority = Priority::kEdge;
+    bool supersedes = false;
+    if (move) {
+      priority = Priority::kMove;
+      supersedes = true;
+    } else if (info.kind == InputMessageKind::kCursorImage ||
+               info.kind == InputMessageKind::kImeState) {
+      priority = Priority::kStatus;
+      supersedes = true;
+    }
+
+    auto& queue = queues_[static_cast<int>(priority)];
+    if (supersedes) {
+      for (auto& entry : queue) {
+        if (entry.supersedable && entry.kind == info.kind) {
+          bytes_ -= entry.data.size();
+          bytes_ += data.size();
+          entry.data = std::move(data);
+          counters_.superseded++;
+          Track(info);
+          return true;
+        }
+      }
+    }
+    auto& moves = queues_[static_cast<int>(Priority::kMove)];
+    if (button_change) {
+      // Carries the position too, a queued older position would move the
+      // pointer back while the button is held
+      for (auto it = moves.begin(); it != moves.end();) {
+        if (it->supersedable && it->kind == InputMessageKind::kMouseAbs) {
+          bytes_ -= it->data.size();
+          it = moves.erase(it);
+          counters_.superseded++;
+        } else {
+          ++it;
+        }
+      }
+    }
+    if (size() >= kMaxMessages && !DropOne()) {
+      counters_.refused++;
+      return false;
+    }
+    if (priority == Priority::kEdge) {
+      // A wheel or key message goes where the pointer was when it came, so
+      // the queued absolute move goes first and is no longer replaced
+      for (auto& entry : moves) {
+        entry.supersedable = false;
+        queue.push_back(std::move(entry));
+      }
+      moves.clear();
+    }
+    Track(info);
+    bytes_ += data.size();
+    queue.push_back(Entry{info.kind, supersedes, std::move(data)});
+    return true;
+  }
+
+  // The most important message, oldest first
+  std::optional<webrtc::CopyOnWriteBuffer> Pop() {
+    for (auto& queue : queues_) {
+      if (!queue.empty()) {
+        webrtc::CopyOnWriteBuffer data = std::move(queue.front().data);
+        queue.pop_front();
+        bytes_ -= data.size();
+        return data;
+      }
+    }
+    return std::nullopt;
+  }
+
+  void Clear() {
+    for (auto& queue : queues_) {
+      queue.clear();
+    }
+    bytes_ = 0;
+    last_buttons_.reset();
+  }
+
+  bool empty() const { return size() == 0; }
+  size_t size() const {
+    size_t n = 0;
+    for (const auto& queue : queues_) {
+      n += queue.size();
+    }
+    return n;
+  }
+  size_t bytes() const { return bytes_; }
+  // Counts since the last call
+  Counters TakeCounters() {
+    Counters c = counters_;
+    counters_ = {};
+    return c;
+  }
+
+ private:
+  enum class Priority { kEdge = 0, kMove = 1, kStatus = 2 };
+  static constexpr int kPriorities = 3;
+
+  // Drops the oldest message that a newer one would replace, the status
+  // first. Returns false when there is none
+  bool DropOne() {
+    for (Priority priority : {Priority::kStatus, Priority::kMove}) {
+      auto& queue = queues_[static_cast<int>(priority)];
+      if (!queue.empty()) {
+        bytes_ -= queue.front().data.size();
+        queue.pop_front();
+        counters_.dropped++;
+        return true;
+      }
+    }
+    return false;
+  }
+
+  struct Entry {
+    InputMessageKind kind;
+    bool supersedable;
+    webrtc::CopyOnWriteBuffer data;
+  };
+
+  std::deque<Entry> queues_[kPriorities];
+  size_t bytes_{0};
+  std::optional<uint32_t> last_buttons_;
+  Counters counters_;
+};
+
+}  // namespace data_channel
+}  // namespace remote
+
+#endif  // REMOTE_DATA_CHANNEL_INPUT_SEND_QUEUE_H_
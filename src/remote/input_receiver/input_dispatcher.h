@@ -6,13 +6,16 @@
 
 #include <cstddef>
 #include <cstdint>
+#include <functional>
 #include <string>
 #include <string_view>
 
 #include <rtc_base/logging.h>
 
+#include "metrics/metrics_registry.h"
 #include "remote/proto/messages.h"
 #include "remote/proto/parser.h"
+#include "remote/proto/serializer.h"
 #include "remote/overlay/overlay_renderer.h"
 #include "remote/input_receiver/input_injector.h"
 #include <SDL3/SDL_keycode.h>
@@ -60,12 +63,37 @@ class InputDispatcher {
   InputDispatcher(IInputInjector* inj, overlay::OverlayRenderer* overlay)
       : injector_(inj), overlay_(overlay) {}
 
+  // Used to answer requests from the peer (e.g. inputPing)
+  using ReplySender = std::function<bool(const std::vector<uint8_t>&)>;
+  void SetReplySender(ReplySender s) { reply_ = std::move(s); }
+
   // Process data received from DataChannel (expected to be JSON text)
   void OnMessage(const uint8_t* data, size_t len) {
     if (len == 0 || data == nullptr) return;
     std::string_view sv(reinterpret_cast<const char*>(data), len);
     auto type = proto::JsonGetType(sv);
     if (!type) return;
+    if (*type == "inputPing") {
+      // Controlled side: echo the timestamp back as soon as possible
+      auto ts = proto::JsonGetInt64(sv, "ts");
+      if (ts && reply_) {
+        reply_(proto::SerializeInputPong(*ts));
+      }
+      return;
+    }
+    if (*type == "inputPong") {
+      // Viewer side: the timestamp was taken from PerfHud::NowMs when pinging
+      auto ts = proto::JsonGetInt64(sv, "ts");
+      if (ts) {
+        const double rtt_ms =
+            static_cast<double>(overlay::PerfHud::NowMs() - *ts);
+        MetricsRegistry::Instance().Set("input", "rtt_ms", rtt_ms);
+        if (overlay_) {
+          overlay_->GetPerfHud().Push(overlay::PerfMetric::kInputRttMs, rtt_ms);
+        }
+      }
+      return;
+    }
     if (*type == "cursorImage") {
       if (overlay_) {
         proto::CursorImageMsg ci;
@@ -151,7 +179,8 @@ class InputDispatcher {
   // Same entry: select the parsing path based on the binary flag
   void OnMessageEither(const uint8_t* data, size_t len, bool is_binary) {
 #ifdef REMOTE_USE_PROTOBUF
-    if (is_binary) {
+    // inputPing/inputPong are JSON only, even on a binary channel
+    if (is_binary && !(len > 0 && data[0] == '{')) {
       // Try to parse protobuf Envelope
       ParseProtoEnvelope(data, len);
       return;
@@ -231,6 +260,7 @@ class InputDispatcher {
  private:
   IInputInjector* injector_;
   overlay::OverlayRenderer* overlay_;
+  ReplySender reply_{};
 };
 
 }  // namespace input_receiver
@@ -56,34 +56,52 @@ class SdlInputCapture {
     }
   }
 
+  // Merge the mouse motion events of one SDL event batch (polled once per
+  // rendered frame) into a single message (--low-latency).
+  // Any other event flushes the merged motion first, so the order is kept.
+  void SetCoalesceMotion(bool enable) {
+    coalesce_motion_ = enable;
+    if (!enable) {
+      FlushMotion();
+    }
+  }
+
+  // Send the merged motion now (e.g. when the overlay consumed an event)
+  void FlushMotion() {
+    if (!pending_motion_.valid) {
+      return;
+    }
+    PendingMotion m = pending_motion_;
+    pending_motion_ = PendingMotion{};
+    SendMotion(m.x, m.y, m.xrel, m.yrel, m.state);
+  }
+
   // Extract mouse/keyboard from SDL events, assemble protocol messages
   // Current skeleton, serialization/sending carried by the callbacks provided by SetSenders
   void Pump(const SDL_Event& ev) {
+    if (coalesce_motion_) {
+      if (ev.type == SDL_EVENT_MOUSE_MOTION) {
+        // Latest position, accumulated deltas
+        pending_motion_.valid = true;
+        pending_motion_.x = ev.motion.x;
+        pending_motion_.y = ev.motion.y;
+        pending_motion_.xrel += ev.motion.xrel;
+        pending_motion_.yrel += ev.motion.yrel;
+        pending_motion_.state = ev.motion.state;
+        // More motion is queued in this batch, send once it is drained
+        if (SDL_HasEvent(SDL_EVENT_MOUSE_MOTION)) {
+          return;
+        }
+      }
+      FlushMotion();
+      if (ev.type == SDL_EVENT_MOUSE_MOTION) {
+        return;
+      }
+    }
     switch (ev.type) {
       case SDL_EVENT_MOUSE_MOTION: {
-        // Collect button states
-        proto::Buttons btns{};
-        btns.bits = ev.motion.state;  // SDL3: button mask
-        if (mode_ == MouseMode::Absolute) {
-          auto abs = mapper_.MakeAbs(static_cast<float>(ev.motion.x), static_cast<float>(ev.motion.y), btns);
-          if (abs) {
-            // Use protobuf first, if not available, fall back to JSON
-            auto pb = proto::PbSerializeMouseAbs(*abs);
-            if (!pb.empty()) { if (reliable_) reliable_(pb); }
-            else { auto js = proto::SerializeMouseAbs(*abs); if (reliable_) reliable_(js); }
-          } else {
-            // Fall back to sending relative displacement, ensuring still controllable
-            auto rel = mapper_.MakeRel(static_cast<float>(ev.motion.xrel), static_cast<float>(ev.motion.yrel), btns, 0);
-            auto pb = proto::PbSerializeMouseRel(rel);
-            if (!pb.empty()) { if (rt_) rt_(pb); }
-            else { auto js = proto::SerializeMouseRel(rel); if (rt_) rt_(js); }
-          }
-        } else {
-          auto rel = mapper_.MakeRel(static_cast<float>(ev.motion.xrel), static_cast<float>(ev.motion.yrel), btns, 0);
-          auto pb = proto::PbSerializeMouseRel(rel);
-          if (!pb.empty()) { if (rt_) rt_(pb); }
-          else { auto js = proto::SerializeMouseRel(rel); if (rt_) rt_(js); }
-        }
+        SendMotion(ev.motion.x, ev.motion.y, ev.motion.xrel, ev.motion.yrel,
+                   ev.motion.state);
         break;
       }
       case SDL_EVENT_MOUSE_BUTTON_DOWN:
@@ -154,11 +172,48 @@ class SdlInputCapture {
   }
 
  private:
+  struct PendingMotion {
+    bool valid{false};
+    float x{0.0f};
+    float y{0.0f};
+    float xrel{0.0f};
+    float yrel{0.0f};
+    uint32_t state{0};
+  };
+
+  void SendMotion(float x, float y, float xrel, float yrel, uint32_t state) {
+    // Collect button states
+    proto::Buttons btns{};
+    btns.bits = state;  // SDL3: button mask
+    if (mode_ == MouseMode::Absolute) {
+      auto abs = mapper_.MakeAbs(x, y, btns);
+      if (abs) {
+        // Use protobuf first, if not available, fall back to JSON
+        auto pb = proto::PbSerializeMouseAbs(*abs);
+        if (!pb.empty()) { if (reliable_) reliable_(pb); }
+        else { auto js = proto::SerializeMouseAbs(*abs); if (reliable_) reliable_(js); }
+      } else {
+        // Fall back to sending relative displacement, ensuring still controllable
+        auto rel = mapper_.MakeRel(xrel, yrel, btns, 0);
+        auto pb = proto::PbSerializeMouseRel(rel);
+        if (!pb.empty()) { if (rt_) rt_(pb); }
+        else { auto js = proto::SerializeMouseRel(rel); if (rt_) rt_(js); }
+      }
+    } else {
+      auto rel = mapper_.MakeRel(xrel, yrel, btns, 0);
+      auto pb = proto::PbSerializeMouseRel(rel);
+      if (!pb.empty()) { if (rt_) rt_(pb); }
+      else { auto js = proto::SerializeMouseRel(rel); if (rt_) rt_(js); }
+    }
+  }
+
   MouseMode mode_{MouseMode::Absolute};
   MouseMapper mapper_{};
   ReliableSender reliable_{};
   RtSender rt_{};
   SDL_Window* window_{nullptr};
+  bool coalesce_motion_{false};
+  PendingMotion pending_motion_{};
 };
 
 }  // namespace input_sender
@@ -11,6 +11,7 @@
 #include <string>
 #include <vector>
 
+#include "remote/overlay/perf_hud.h"
 #include "remote/overlay/virtual_keyboard_full.h"
 #include "remote/proto/messages.h"
 #include "remote/proto/protobuf_serializer.h"
@@ -82,6 +83,7 @@ class OverlayRenderer {
       }
     }
 
+    perf_hud_.Render(r);
     DrawToolbar(r);
     if (keyboard_visible_) {
       vk_full_.SetSender(reliable_);
@@ -123,6 +125,7 @@ class OverlayRenderer {
   void SetKeyboardOpacity(float a) { vk_full_.SetOpacity(a); }
   void ToggleKeyboardVisibility() { keyboard_visible_ = !keyboard_visible_; }
   bool IsKeyboardVisible() const { return keyboard_visible_; }
+  PerfHud& GetPerfHud() { return perf_hud_; }
 
 #ifdef REMOTE_WITH_SDL_TTF
   bool ConfigureTooltipFont(const std::string& font_path, int pt_size) {
@@ -231,6 +234,9 @@ class OverlayRenderer {
   // Keyboard
   VirtualKeyboardFull vk_full_{};
 
+  // Performance HUD
+  PerfHud perf_hud_{};
+
   // Top toolbar
   bool toolbar_pinned_{false};
   bool toolbar_hover_{false};
@@ -245,6 +251,7 @@ class OverlayRenderer {
   SDL_FRect toolbar_btn_copy_{};
   SDL_FRect toolbar_btn_paste_{};
   SDL_FRect toolbar_btn_cad_{};
+  SDL_FRect toolbar_btn_hud_{};
   SDL_FRect toolbar_trigger_area_{};
   SDL_FRect toolbar_buttons_area_{};
 
@@ -298,6 +305,7 @@ class OverlayRenderer {
       toolbar_btn_copy_ = {};
       toolbar_btn_paste_ = {};
       toolbar_btn_cad_ = {};
+      toolbar_btn_hud_ = {};
 
       // Button background (flat golden)
       SDL_SetRenderDrawColor(r, 218, 165, 32, 240);
@@ -326,7 +334,7 @@ class OverlayRenderer {
     // Button group (including background)
     const float btn_size = 26.0f;        // Button size
     const float btn_spacing = 6.0f;      // Button spacing
-    const float total_btn_count = 9.0f;  // Button count
+    const float total_btn_count = 10.0f;  // Button count
     const float total_width =
         total_btn_count * btn_size + (total_btn_count - 1) * btn_spacing;
     const float group_padding = 8.0f;
@@ -377,6 +385,8 @@ class OverlayRenderer {
     SDL_FRect btn_paste{btn_x, btn_y, btn_size, btn_size};
     btn_x += btn_size + btn_spacing;
     SDL_FRect btn_cad{btn_x, btn_y, btn_size, btn_size};
+    btn_x += btn_size + btn_spacing;
+    SDL_FRect btn_hud{btn_x, btn_y, btn_size, btn_size};
     const float ime_x = group_rect.x + group_rect.w - group_padding - ime_width;
 
     // Draw button background (with gradient effect)
@@ -410,6 +420,10 @@ class OverlayRenderer {
     draw_button_bg(btn_copy, 120, 160, 140);      // Cyan green
     draw_button_bg(btn_paste, 160, 130, 160);     // Lavender
     draw_button_bg(btn_cad, 180, 100, 100);       // Crimson
+    if (perf_hud_.IsVisible())
+      draw_button_bg(btn_hud, 90, 150, 110);      // Active: green
+    else
+      draw_button_bg(btn_hud, 110, 120, 140);     // Slate
 
     // Simple icons (white, clearly visible)
     auto draw_line = [&](float x1, float y1, float x2, float y2) {
@@ -499,6 +513,14 @@ class OverlayRenderer {
     draw_line(cx + 7, cy - 2, cx + 7, cy + 2);  // D right middle
     draw_line(cx + 7, cy + 2, cx + 4, cy + 4);  // D right bottom
 
+    // Performance HUD: small bar chart
+    cx = btn_hud.x + btn_size / 2.0f;
+    cy = btn_hud.y + btn_size / 2.0f;
+    draw_line(cx - 7, cy + 6, cx + 7, cy + 6);  // Axis
+    fill_rect(SDL_FRect{cx - 6, cy + 1, 3, 5});
+    fill_rect(SDL_FRect{cx - 1, cy - 6, 3, 12});
+    fill_rect(SDL_FRect{cx + 4, cy - 2, 3, 8});
+
     toolbar_btn_pin_ = btn_pin;
     toolbar_btn_minimize_ = btn_minimize;
     toolbar_btn_full_ = btn_full;
@@ -508,6 +530,7 @@ class OverlayRenderer {
     toolbar_btn_copy_ = btn_copy;
     toolbar_btn_paste_ = btn_paste;
     toolbar_btn_cad_ = btn_cad;
+    toolbar_btn_hud_ = btn_hud;
 
     // IME indicator (placed on the right side of the menu bar, not blocking the buttons)
     SDL_FRect ime{ime_x, btn_y, ime_width, btn_size};
@@ -579,6 +602,10 @@ class OverlayRenderer {
       SendComboCtrlAltDel();
       return true;
     }
+    if (inside(toolbar_btn_hud_, x, y)) {
+      perf_hud_.ToggleVisible();
+      return true;
+    }
     // Click outside the menu is transparent
     return false;
   }
@@ -0,0 +1,325 @@
+// Description: On-screen performance HUD (receiving side).
+// Plots decode / network / render / input timings as small sparklines so that
+// the user can tell where a bad session is spending its time.
+// Text is drawn from a 5x7 glyph atlas texture (one SDL_RenderTexture per
+// character) and each sparkline is a single SDL_RenderLines call.
+
+#ifndef REMOTE_OVERLAY_PERF_HUD_H_
+#define REMOTE_OVERLAY_PERF_HUD_H_
+
+#include <SDL3/SDL.h>
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <mutex>
+#include <vector>
+
+namespace remote {
+namespace overlay {
+
+enum class PerfMetric : int {
+  kDecodeMs = 0,        // Average decode time per frame
+  kJitterBufferMs,      // Average jitter buffer delay per frame
+  kFramesDropped,       // Frames dropped per second
+  kRttMs,               // Network round trip time (ICE candidate pair)
+  kBitrateKbps,         // Receive bitrate
+  kPacketLossPercent,   // Receive packet loss
+  kFrameTimeMs,         // Render loop frame time (worst in the interval)
+  kInputRttMs,          // Input DataChannel round trip time (ping/pong)
+  kCount,
+};
+
+class PerfHud {
+ public:
+  // Samples kept per metric (one per second for the stats based ones)
+  static constexpr int kHistory = 120;
+
+  PerfHud() = default;
+  ~PerfHud() { ReleaseAtlas(); }
+  PerfHud(const PerfHud&) = delete;
+  PerfHud& operator=(const PerfHud&) = delete;
+
+  // Time base used by the input ping/pong (milliseconds, monotonic)
+  static int64_t NowMs() { return static_cast<int64_t>(SDL_GetTicks()); }
+
+  void SetVisible(bool v) { visible_ = v; }
+  bool IsVisible() const { return visible_; }
+  void ToggleVisible() { visible_ = !visible_; }
+
+  // Add a sample (can be called from any thread)
+  void Push(PerfMetric m, double value) {
+    const int idx = static_cast<int>(m);
+    if (idx < 0 || idx >= static_cast<int>(PerfMetric::kCount))
+      return;
+    std::lock_guard<std::mutex> lock(mutex_);
+    Series& s = series_[idx];
+    s.values[s.head] = static_cast<float>(std::max(0.0, value));
+    s.head = (s.head + 1) % kHistory;
+    s.count = std::min(s.count + 1, kHistory);
+  }
+
+  // Call every frame from the render thread (after the video frame)
+  void Render(SDL_Renderer* r) {
+    if (!visible_) {
+      // Do not count the hidden period as a long frame
+      last_frame_ns_ = 0;
+      return;
+    }
+    SampleFrameTime();
+    EnsureAtlas(r);
+
+    const float scale = 2.0f;
+    const float char_w = kCellW * scale;
+    const float row_h = kCellH * scale + 6.0f;
+    const float padding = 8.0f;
+    const float label_w = 9 * char_w;
+    const float value_w = 7 * char_w;
+    const float spark_w = static_cast<float>(kHistory);
+    const float spark_h = row_h - 6.0f;
+    const int rows = static_cast<int>(PerfMetric::kCount);
+
+    const float x0 = 8.0f;
+    const float y0 = 52.0f;
+    SDL_FRect panel{x0, y0, padding * 3 + label_w + value_w + spark_w,
+                    padding * 2 + rows * row_h - 6.0f};
+    SDL_SetRenderDrawBlendMode(r, SDL_BLENDMODE_BLEND);
+    SDL_SetRenderDrawColor(r, 20, 22, 30, 190);
+    SDL_RenderFillRect(r, &panel);
+    SDL_SetRenderDrawColor(r, 70, 72, 90, 255);
+    SDL_RenderRect(r, &panel);
+
+    // Copy the history under the lock, draw without it
+    std::array<Series, static_cast<size_t>(PerfMetric::kCount)> snapshot;
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      snapshot = series_;
+    }
+
+    char value[16];
+    for (int i = 0; i < rows; ++i) {
+      const RowStyle& style = kRows[i];
+      const Series& s = snapshot[i];
+      const float y = y0 + padding + i * row_h;
+      float x = x0 + padding;
+
+      DrawText(r, x, y, scale, style.label, 200, 200, 210);
+      x += label_w + padding;
+
+      if (s.count > 0) {
+        float latest = s.values[(s.head + kHistory - 1) % kHistory];
+        std::snprintf(value, sizeof(value), latest >= 100.0f ? "%.0f" : "%.1f",
+                      latest);
+      } else {
+        std::snprintf(value, sizeof(value), "-");
+      }
+      DrawText(r, x, y, scale, value, style.r, style.g, style.b);
+      x += value_w + padding;
+
+      SDL_FRect spark{x, y - 2.0f, spark_w, spark_h};
+      SDL_SetRenderDrawColor(r, 40, 42, 54, 200);
+      SDL_RenderFillRect(r, &spark);
+      DrawSparkline(r, spark, s, style);
+    }
+  }
+
+ private:
+  struct Series {
+    std::array<float, kHistory> values{};
+    int head{0};
+    int count{0};
+  };
+
+  struct RowStyle {
+    const char* label;
+    // Lower bound of the vertical scale, so that noise does not look like a spike
+    float min_scale;
+    Uint8 r, g, b;
+  };
+
+  // Colors group the rows by bottleneck: decode (orange), network (blue),
+  // render (green), input (purple)
+  static constexpr RowStyle kRows[static_cast<int>(PerfMetric::kCount)] = {
+      {"DECODE MS", 10.0f, 240, 170, 90},
+      {"JITTER MS", 50.0f, 110, 170, 240},
+      {"DROP/S", 5.0f, 240, 170, 90},
+      {"RTT MS", 50.0f, 110, 170, 240},
+      {"KBPS", 500.0f, 110, 170, 240},
+      {"LOSS %", 2.0f, 110, 170, 240},
+      {"FRAME MS", 20.0f, 120, 210, 120},
+      {"INPUT MS", 50.0f, 190, 140, 230},
+  };
+
+  static constexpr int kCellW = 6;  // 5 pixels + 1 spacing
+  static constexpr int kCellH = 8;  // 7 pixels + 1 spacing
+  static constexpr const char* kAtlasChars =
+      " 0123456789.%/:-ABCDEFGHIJKLMNOPQRSTUVWXYZ";
+
+  // 5x7 glyphs, '#' is a lit pixel
+  static const char* const* Glyph(char c) {
+    static const char* const kSpace[7] = {"     ", "     ", "     ", "     ",
+                                          "     ", "     ", "     "};
+    static const char* const kGlyphs[][8] = {
+        {"0", " ### ", "#   #", "#  ##", "# # #", "##  #", "#   #", " ### "},
+        {"1", "  #  ", " ##  ", "  #  ", "  #  ", "  #  ", "  #  ", " ### "},
+        {"2", " ### ", "#   #", "    #", "   # ", "  #  ", " #   ", "#####"},
+        {"3", "#####", "   # ", "  #  ", "   # ", "    #", "#   #", " ### "},
+        {"4", "   # ", "  ## ", " # # ", "#  # ", "#####", "   # ", "   # "},
+        {"5", "#####", "#    ", "#### ", "    #", "    #", "#   #", " ### "},
+        {"6", "  ## ", " #   ", "#    ", "#### ", "#   #", "#   #", " ### "},
+        {"7", "#####", "    #", "   # ", "  #  ", " #   ", " #   ", " #   "},
+        {"8", " ### ", "#   #", "#   #", " ### ", "#   #", "#   #", " ### "},
+        {"9", " ### ", "#   #", "#   #", " ####", "    #", "   # ", " ##  "},
+        {".", "     ", "     ", "     ", "     ", "     ", " ##  ", " ##  "},
+        {"%", "##   ", "##  #", "   # ", "  #  ", " #   ", "#  ##", "   ##"},
+        {"/", "     ", "    #", "   # ", "  #  ", " #   ", "#    ", "     "},
+        {":", "     ", " ##  ", " ##  ", "     ", " ##  ", " ##  ", "     "},
+        {"-", "     ", "     ", "     ", "#####", "     ", "     ", "     "},
+        {"A", " ### ", "#   #", "#   #", "#####", "#   #", "#   #", "#   #"},
+        {"B", "#### ", "#   #", "#   #", "#### ", "#   #", "#   #", "#### "},
+        {"C", " ### ", "#   #", "#    ", "#    ", "#    ", "#   #", " ### "},
+        {"D", "#### ", "#   #", "#   #", "#   #", "#   #", "#   #", "#### "},
+        {"E", "#####", "#    ", "#    ", "#### ", "#    ", "#    ", "#####"},
+        {"F", "#####", "#    ", "#    ", "#### ", "#    ", "#    ", "#    "},
+        {"G", " ### ", "#   #", "#    ", "# ###", "#   #", "#   #", " ####"},
+        {"H", "#   #", "#   #", "#   #", "#####", "#   #", "#   #", "#   #"},
+        {"I", " ### ", "  #  ", "  #  ", "  #  ", "  #  ", "  #  ", " ### "},
+        {"J", "  ###", "   # ", "   # ", "   # ", "   # ", "#  # ", " ##  "},
+        {"K", "#   #", "#  # ", "# #  ", "##   ", "# #  ", "#  # ", "#   #"},
+        {"L", "#    ", "#    ", "#    ", "#    ", "#    ", "#    ", "#####"},
+        {"M", "#   #", "## ##", "# # #", "# # #", "#   #", "#   #", "#   #"},
+        {"N", "#   #", "#   #", "##  #", "# # #", "#  ##", "#   #", "#   #"},
+        {"O", " ### ", "#   #", "#   #", "#   #", "#   #", "#   #", " ### "},
+        {"P", "#### ", "#   #", "#   #", "#### ", "#    ", "#    ", "#    "},
+        {"Q", " ### ", "#   #", "#   #", "#   #", "# # #", "#  # ", " ## #"},
+        {"R", "#### ", "#   #", "#   #", "#### ", "# #  ", "#  # ", "#   #"},
+        {"S", " ####", "#    ", "#    ", " ### ", "    #", "    #", "#### "},
+        {"T", "#####", "  #  ", "  #  ", "  #  ", "  #  ", "  #  ", "  #  "},
+        {"U", "#   #", "#   #", "#   #", "#   #", "#   #", "#   #", " ### "},
+        {"V", "#   #", "#   #", "#   #", "#   #", "#   #", " # # ", "  #  "},
+        {"W", "#   #", "#   #", "#   #", "# # #", "# # #", "# # #", " # # "},
+        {"X", "#   #", "#   #", " # # ", "  #  ", " # # ", "#   #", "#   #"},
+        {"Y", "#   #", "#   #", " # # ", "  #  ", "  #  ", "  #  ", "  #  "},
+        {"Z", "#####", "    #", "   # ", "  #  ", " #   ", "#    ", "#####"},
+    };
+    for (const auto& g : kGlyphs) {
+      if (g[0][0] == c)
+        return &g[1];
+    }
+    return kSpace;
+  }
+
+  // Bake every glyph into one small texture (once per renderer)
+  void EnsureAtlas(SDL_Renderer* r) {
+    if (atlas_ && atlas_renderer_ == r)
+      return;
+    ReleaseAtlas();
+    const int count = static_cast<int>(std::strlen(kAtlasChars));
+    const int w = count * kCellW;
+    const int h = kCellH;
+    std::vector<uint32_t> pixels(static_cast<size_t>(w) * h, 0);
+    for (int i = 0; i < count; ++i) {
+      const char* const* rows = Glyph(kAtlasChars[i]);
+      for (int y = 0; y < 7; ++y) {
+        for (int x = 0; x < 5; ++x) {
+          if (rows[y][x] == '#')
+            pixels[static_cast<size_t>(y) * w + i * kCellW + x] = 0xFFFFFFFFu;
+        }
+      }
+    }
+    atlas_ = SDL_CreateTexture(r, SDL_PIXELFORMAT_RGBA32,
+                               SDL_TEXTUREACCESS_STATIC, w, h);
+    if (!atlas_)
+      return;
+    SDL_UpdateTexture(atlas_, nullptr, pixels.data(), w * 4);
+    SDL_SetTextureBlendMode(atlas_, SDL_BLENDMODE_BLEND);
+    SDL_SetTextureScaleMode(atlas_, SDL_SCALEMODE_NEAREST);
+    atlas_renderer_ = r;
+  }
+
+  void ReleaseAtlas() {
+    if (atlas_) {
+      SDL_DestroyTexture(atlas_);
+      atlas_ = nullptr;
+    }
+    atlas_renderer_ = nullptr;
+  }
+
+  void DrawText(SDL_Renderer* r, float x, float y, float scale,
+                const char* text, Uint8 cr, Uint8 cg, Uint8 cb) {
+    if (!atlas_)
+      return;
+    SDL_SetTextureColorMod(atlas_, cr, cg, cb);
+    for (const char* p = text; *p; ++p) {
+      const char* hit = std::strchr(kAtlasChars, *p);
+      if (hit && *p != ' ') {
+        const float index = static_cast<float>(hit - kAtlasChars);
+        SDL_FRect src{index * kCellW, 0.0f, static_cast<float>(kCellW),
+                      static_cast<float>(kCellH)};
+        SDL_FRect dst{x, y, kCellW * scale, kCellH * scale};
+        SDL_RenderTexture(r, atlas_, &src, &dst);
+      }
+      x += kCellW * scale;
+    }
+  }
+
+  void DrawSparkline(SDL_Renderer* r,
+                     const SDL_FRect& area,
+                     const Series& s,
+                     const RowStyle& style) {
+    if (s.count < 2)
+      return;
+    float top = style.min_scale;
+    for (int i = 0; i < s.count; ++i) {
+      top = std::max(top, s.values[(s.head + kHistory - s.count + i) % kHistory]);
+    }
+    // Newest sample on the right edge
+    points_.resize(s.count);
+    const float x_right = area.x + area.w - 1.0f;
+    for (int i = 0; i < s.count; ++i) {
+      float v = s.values[(s.head + kHistory - s.count + i) % kHistory];
+      points_[i].x = x_right - static_cast<float>(s.count - 1 - i);
+      points_[i].y = area.y + area.h - 1.0f - (v / top) * (area.h - 2.0f);
+    }
+    SDL_SetRenderDrawColor(r, style.r, style.g, style.b, 255);
+    SDL_RenderLines(r, points_.data(), static_cast<int>(points_.size()));
+  }
+
+  // Report the worst frame of each second, a single long frame is what the
+  // user perceives as a stutter
+  void SampleFrameTime() {
+    const uint64_t now = SDL_GetTicksNS();
+    if (last_frame_ns_ != 0) {
+      const double frame_ms = (now - last_frame_ns_) / 1000000.0;
+      frame_time_max_ms_ = std::max(frame_time_max_ms_, frame_ms);
+      if (now - frame_window_start_ns_ >= 1000000000ull) {
+        Push(PerfMetric::kFrameTimeMs, frame_time_max_ms_);
+        frame_time_max_ms_ = 0.0;
+        frame_window_start_ns_ = now;
+      }
+    } else {
+      frame_window_start_ns_ = now;
+      frame_time_max_ms_ = 0.0;
+    }
+    last_frame_ns_ = now;
+  }
+
+  std::atomic<bool> visible_{false};
+  std::mutex mutex_;
+  std::array<Series, static_cast<size_t>(PerfMetric::kCount)> series_{};
+
+  // Render thread only
+  SDL_Texture* atlas_{nullptr};
+  SDL_Renderer* atlas_renderer_{nullptr};
+  std::vector<SDL_FPoint> points_;
+  uint64_t last_frame_ns_{0};
+  uint64_t frame_window_start_ns_{0};
+  double frame_time_max_ms_{0.0};
+};
+
+}  // namespace overlay
+}  // namespace remote
+
+#endif  // REMOTE_OVERLAY_PERF_HUD_H_
@@ -0,0 +1,115 @@
+// Description: Turns periodic RTCStatsReport snapshots into PerfHud samples.
+// Most of the interesting stats are cumulative counters, so every value pushed
+// to the HUD is the delta between two consecutive reports.
+
+#ifndef REMOTE_OVERLAY_PERF_STATS_SAMPLER_H_
+#define REMOTE_OVERLAY_PERF_STATS_SAMPLER_H_
+
+#include <algorithm>
+#include <cstdint>
+#include <mutex>
+
+// WebRTC
+#include <api/scoped_refptr.h>
+#include <api/stats/rtc_stats_report.h>
+#include <api/stats/rtcstats_objects.h>
+
+#include "remote/overlay/perf_hud.h"
+
+namespace remote {
+namespace overlay {
+
+class PerfStatsSampler {
+ public:
+  explicit PerfStatsSampler(PerfHud* hud) : hud_(hud) {}
+
+  // Called from the GetStats callback (signaling thread)
+  void OnReport(
+      const webrtc::scoped_refptr<const webrtc::RTCStatsReport>& report) {
+    if (!report || !hud_)
+      return;
+    Totals now;
+    now.timestamp_us = report->timestamp().us();
+    for (const auto* in :
+         report->GetStatsOfType<webrtc::RTCInboundRtpStreamStats>()) {
+      now.bytes_received += static_cast<double>(in->bytes_received.value_or(0));
+      now.packets_received +=
+          static_cast<double>(in->packets_received.value_or(0));
+      now.packets_lost += static_cast<double>(in->packets_lost.value_or(0));
+      if (in->kind.value_or("") != "video")
+        continue;
+      now.frames_decoded += static_cast<double>(in->frames_decoded.value_or(0));
+      now.total_decode_time += in->total_decode_time.value_or(0.0);
+      now.jitter_buffer_delay += in->jitter_buffer_delay.value_or(0.0);
+      now.jitter_buffer_emitted_count +=
+          static_cast<double>(in->jitter_buffer_emitted_count.value_or(0));
+      now.frames_dropped += static_cast<double>(in->frames_dropped.value_or(0));
+    }
+
+    // RTT of the selected candidate pair is not cumulative
+    for (const auto* pair :
+         report->GetStatsOfType<webrtc::RTCIceCandidatePairStats>()) {
+      if (pair->nominated.value_or(false) &&
+          pair->state.value_or("") == "succeeded" &&
+          pair->current_round_trip_time.has_value()) {
+        hud_->Push(PerfMetric::kRttMs, *pair->current_round_trip_time * 1000.0);
+        break;
+      }
+    }
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (has_prev_ && now.timestamp_us > prev_.timestamp_us) {
+      const double seconds = (now.timestamp_us - prev_.timestamp_us) / 1e6;
+      const double decoded = now.frames_decoded - prev_.frames_decoded;
+      if (decoded > 0) {
+        hud_->Push(PerfMetric::kDecodeMs,
+                   (now.total_decode_time - prev_.total_decode_time) * 1000.0 /
+                       decoded);
+      }
+      const double emitted =
+          now.jitter_buffer_emitted_count - prev_.jitter_buffer_emitted_count;
+      if (emitted > 0) {
+        hud_->Push(PerfMetric::kJitterBufferMs,
+                   (now.jitter_buffer_delay - prev_.jitter_buffer_delay) *
+                       1000.0 / emitted);
+      }
+      hud_->Push(PerfMetric::kFramesDropped,
+                 (now.frames_dropped - prev_.frames_dropped) / seconds);
+      hud_->Push(PerfMetric::kBitrateKbps,
+                 (now.bytes_received - prev_.bytes_received) * 8.0 / 1000.0 /
+                     seconds);
+      const double received = now.packets_received - prev_.packets_received;
+      const double lost = now.packets_lost - prev_.packets_lost;
+      if (received + lost > 0) {
+        hud_->Push(PerfMetric::kPacketLossPercent,
+                   100.0 * std::max(0.0, lost) / (received + lost));
+      }
+    }
+    prev_ = now;
+    has_prev_ = true;
+  }
+
+ private:
+  // Sum over all inbound streams (video-only fields only count video)
+  struct Totals {
+    int64_t timestamp_us{0};
+    double bytes_received{0};
+    double packets_received{0};
+    double packets_lost{0};
+    double frames_decoded{0};
+    double total_decode_time{0};
+    double jitter_buffer_delay{0};
+    double jitter_buffer_emitted_count{0};
+    double frames_dropped{0};
+  };
+
+  PerfHud* hud_;
+  std::mutex mutex_;
+  Totals prev_;
+  bool has_prev_{false};
+};
+
+}  // namespace overlay
+}  // namespace remote
+
+#endif  // REMOTE_OVERLAY_PERF_STATS_SAMPLER_H_
@@ -8,6 +8,9 @@
 #include <string_view>
 #include <optional>
 #include <cctype>
+#include <charconv>
+#include <cstdint>
+#include <system_error>
 
 #include "remote/proto/messages.h"
 #include "remote/proto/base64.h"
@@ -26,16 +29,29 @@ inline std::optional<std::string> JsonGetString(std::string_view s, std::string_
   return std::string(s.substr(p, q - p));
 }
 
-// Extract the integer value of the specified key from the JSON text
-inline std::optional<int> JsonGetInt(std::string_view s, std::string_view key) {
+// Extract the integer value of the specified key from the JSON text.
+// The value comes from the peer: a malformed or out of range number is nullopt, never an exception
+template <class T>
+inline std::optional<T> JsonGetInteger(std::string_view s, std::string_view key) {
   std::string pattern = std::string("\"") + std::string(key) + std::string("\":");
   size_t p = s.find(pattern);
   if (p == std::string::npos) return std::nullopt;
   p += pattern.size();
   size_t q = p;
   while (q < s.size() && (isdigit(static_cast<unsigned char>(s[q])) || s[q]=='-')) q++;
-  if (q == p) return std::nullopt;
-  return std::stoi(std::string(s.substr(p, q - p)));
+  T value{};
+  auto [end, ec] = std::from_chars(s.data() + p, s.data() + q, value);
+  if (ec != std::errc() || end != s.data() + q) return std::nullopt;
+  return value;
+}
+
+inline std::optional<int> JsonGetInt(std::string_view s, std::string_view key) {
+  return JsonGetInteger<int>(s, key);
+}
+
+// Extract the 64-bit integer value of the specified key from the JSON text
+inline std::optional<int64_t> JsonGetInt64(std::string_view s, std::string_view key) {
+  return JsonGetInteger<int64_t>(s, key);
 }
 
 // Extract the boolean value of the specified key from the JSON text
@@ -4,6 +4,7 @@
 #ifndef REMOTE_PROTO_SERIALIZER_H_
 #define REMOTE_PROTO_SERIALIZER_H_
 
+#include <cstdint>
 #include <sstream>
 #include <vector>
 #include <string>
@@ -89,6 +90,22 @@ inline std::vector<uint8_t> SerializeGamepadXInput(uint16_t buttons, float lx, f
   return std::vector<uint8_t>(s.begin(), s.end());
 }
 
+// Input channel round trip measurement: the controlled side echoes "ts" back
+// unchanged in an inputPong, so only the viewer's clock is involved
+inline std::vector<uint8_t> SerializeInputPing(int64_t ts_ms) {
+  std::ostringstream os;
+  os << "{\"type\":\"inputPing\",\"ts\":" << ts_ms << "}";
+  auto s = os.str();
+  return std::vector<uint8_t>(s.begin(), s.end());
+}
+
+inline std::vector<uint8_t> SerializeInputPong(int64_t ts_ms) {
+  std::ostringstream os;
+  os << "{\"type\":\"inputPong\",\"ts\":" << ts_ms << "}";
+  auto s = os.str();
+  return std::vector<uint8_t>(s.begin(), s.end());
+}
+
 }  // namespace proto
 }  // namespace remote
 
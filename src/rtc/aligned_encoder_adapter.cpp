@@ -1,6 +1,99 @@
 #include "aligned_encoder_adapter.h"
 
+// WebRTC
+#include <api/make_ref_counted.h>
+#include <api/video/i420_buffer.h>
+#include <api/video/nv12_buffer.h>
+#include <common_video/include/video_frame_buffer.h>
 #include <rtc_base/logging.h>
+#include <rtc_base/time_utils.h>
+#include <third_party/libyuv/include/libyuv.h>
+
+#include "metrics/frame_tracer.h"
+#include "metrics/metrics_registry.h"
+
+namespace {
+
+const char kMetricsGroup[] = "aligned_encoder";
+// Frames in flight in the encoder that may each hold a pooled buffer
+constexpr size_t kMaxPooledBuffers = 8;
+constexpr int64_t kPublishIntervalMs = 1000;
+
+// Cropped view of an NV12 buffer. WebRTC only has Wrap* helpers for the planar
+// formats.
+class WrappedNV12Buffer : public webrtc::NV12BufferInterface {
+ public:
+  WrappedNV12Buffer(webrtc::scoped_refptr<webrtc::VideoFrameBuffer> owner,
+                    int width,
+                    int height,
+                    const uint8_t* data_y,
+                    int stride_y,
+                    const uint8_t* data_uv,
+                    int stride_uv)
+      : owner_(std::move(owner)),
+        width_(width),
+        height_(height),
+        data_y_(data_y),
+        stride_y_(stride_y),
+        data_uv_(data_uv),
+        stride_uv_(stride_uv) {}
+
+  int width() const override { return width_; }
+  int height() const override { return height_; }
+  const uint8_t* DataY() const override { return data_y_; }
+  const uint8_t* DataUV() const override { return data_uv_; }
+  int StrideY() const override { return stride_y_; }
+  int StrideUV() const override { return stride_uv_; }
+
+  webrtc::scoped_refptr<webrtc::I420BufferInterface> ToI420() override {
+    auto i420 = webrtc::I420Buffer::Create(width_, height_);
+    libyuv::NV12ToI420(data_y_, stride_y_, data_uv_, stride_uv_,
+                       i420->MutableDataY(), i420->StrideY(),
+                       i420->MutableDataU(), i420->StrideU(),
+                       i420->MutableDataV(), i420->StrideV(), width_, height_);
+    return i420;
+  }
+
+ private:
+  const webrtc::scoped_refptr<webrtc::VideoFrameBuffer> owner_;
+  const int width_;
+  const int height_;
+  const uint8_t* const data_y_;
+  const int stride_y_;
+  const uint8_t* const data_uv_;
+  const int stride_uv_;
+};
+
+// Crop without copying the pixels, nullptr if the buffer type does not allow
+// it (native buffers etc.). Offsets must be even.
+webrtc::scoped_refptr<webrtc::VideoFrameBuffer> WrapCrop(
+    const webrtc::scoped_refptr<webrtc::VideoFrameBuffer>& buffer,
+    int offset_x,
+    int offset_y,
+    int width,
+    int height) {
+  if (buffer->type() == webrtc::VideoFrameBuffer::Type::kI420) {
+    const webrtc::I420BufferInterface* src = buffer->GetI420();
+    return webrtc::WrapI420Buffer(
+        width, height,
+        src->DataY() + offset_y * src->StrideY() + offset_x, src->StrideY(),
+        src->DataU() + offset_y / 2 * src->StrideU() + offset_x / 2,
+        src->StrideU(),
+        src->DataV() + offset_y / 2 * src->StrideV() + offset_x / 2,
+        src->StrideV(), [buffer] {});
+  }
+  if (buffer->type() == webrtc::VideoFrameBuffer::Type::kNV12) {
+    const webrtc::NV12BufferInterface* src = buffer->GetNV12();
+    return webrtc::make_ref_counted<WrappedNV12Buffer>(
+        buffer, width, height,
+        src->DataY() + offset_y * src->StrideY() + offset_x, src->StrideY(),
+        src->DataUV() + offset_y / 2 * src->StrideUV() + offset_x,
+        src->StrideUV());
+  }
+  return nullptr;
+}
+
+}  // namespace
 
 static int Align(int size, int alignment) {
   return size - (size % alignment);
@@ -12,7 +105,10 @@ AlignedEncoderAdapter::AlignedEncoderAdapter(
     int vertical_alignment)
     : encoder_(encoder),
       horizontal_alignment_(horizontal_alignment),
-      vertical_alignment_(vertical_alignment) {}
+      vertical_alignment_(vertical_alignment),
+      width_(0),
+      height_(0),
+      buffer_pool_(false, kMaxPooledBuffers) {}
 
 void AlignedEncoderAdapter::SetFecControllerOverride(
     webrtc::FecControllerOverride* fec_controller_override) {
@@ -40,7 +136,46 @@ int AlignedEncoderAdapter::InitEncode(
 int AlignedEncoderAdapter::Encode(
     const webrtc::VideoFrame& input_image,
     const std::vector<webrtc::VideoFrameType>* frame_types) {
+  auto& tracer = FrameTracer::Instance();
+  if (tracer.IsEnabled()) {
+    FrameTraceEvent event;
+    event.stage = FrameTraceStage::kEncodeStart;
+    event.time_us = webrtc::TimeMicros();
+    event.timestamp_us = input_image.timestamp_us();
+    event.rtp_timestamp = input_image.rtp_timestamp();
+    event.width = width_;
+    event.height = height_;
+    tracer.Record(event);
+  }
+
   auto frame = input_image;
+  if (frame.width() == width_ && frame.height() == height_) {
+    passthrough_frames_++;
+    PublishMetrics();
+    return encoder_->Encode(frame, frame_types);
+  }
+
+  auto buffer = frame.video_frame_buffer();
+  // Usual case: the encoder was initialized with this frame size, rounded
+  // down to the alignment. Only the edges have to go, no scaling.
+  if (Align(frame.width(), horizontal_alignment_) == width_ &&
+      Align(frame.height(), vertical_alignment_) == height_) {
+    // Even offsets keep the chroma planes in step with the luma plane
+    int crop_x = ((frame.width() - width_) / 2) & ~1;
+    int crop_y = ((frame.height() - height_) / 2) & ~1;
+    if (auto cropped = WrapCrop(buffer, crop_x, crop_y, width_, height_)) {
+      wrapped_frames_++;
+      if (frame.has_update_rect()) {
+        frame.set_update_rect(frame.update_rect().ScaleWithFrame(
+            frame.width(), frame.height(), crop_x, crop_y, width_, height_,
+            width_, height_));
+      }
+      frame.set_video_frame_buffer(cropped);
+      PublishMetrics();
+      return encoder_->Encode(frame, frame_types);
+    }
+  }
+
   auto frame_ratio = (double)frame.width() / frame.height();
   auto target_ratio = (double)width_ / height_;
   int crop_width;
@@ -54,27 +189,98 @@ int AlignedEncoderAdapter::Encode(
     crop_width = frame.width();
     crop_height = (int)(crop_width / target_ratio);
   }
-  auto crop_x = (frame.width() - crop_width) / 2;
-  auto crop_y = (frame.height() - crop_height) / 2;
+  auto crop_x = ((frame.width() - crop_width) / 2) & ~1;
+  auto crop_y = ((frame.height() - crop_height) / 2) & ~1;
   // RTC_LOG(LS_INFO) << "type=" << frame.video_frame_buffer()->type()
   //                  << " crop_x=" << crop_x << " crop_y=" << crop_y
   //                  << " crop_width=" << crop_width
   //                  << " crop_height=" << crop_height << " width_=" << width_
   //                  << " height_=" << height_ << " frame_width=" << frame.width()
   //                  << " frame_height=" << frame.height();
-  if (crop_x != 0 || crop_y != 0 || frame.width() != width_ ||
-      frame.height() != height_) {
-    auto buffer = frame.video_frame_buffer()->CropAndScale(
-        crop_x / 2, crop_y / 2, crop_width, crop_height, width_, height_);
-    frame.set_video_frame_buffer(buffer);
+
+  // Scaling needs a copy, reuse the buffers of the previous frames
+  webrtc::scoped_refptr<webrtc::VideoFrameBuffer> scaled;
+  if (buffer->type() == webrtc::VideoFrameBuffer::Type::kI420) {
+    if (auto dst = buffer_pool_.CreateI420Buffer(width_, height_)) {
+      dst->CropAndScaleFrom(*buffer->GetI420(), crop_x, crop_y, crop_width,
+                            crop_height);
+      scaled = dst;
+    }
+  } else if (buffer->type() == webrtc::VideoFrameBuffer::Type::kNV12) {
+    if (auto dst = buffer_pool_.CreateNV12Buffer(width_, height_)) {
+      dst->CropAndScaleFrom(*buffer->GetNV12(), crop_x, crop_y, crop_width,
+                            crop_height);
+      scaled = dst;
+    }
   }
+  if (scaled) {
+    pooled_copies_++;
+  } else {
+    // Native buffers, or every pooled buffer is still held by the encoder
+    scaled = buffer->CropAndScale(crop_x, crop_y, crop_width, crop_height,
+                                  width_, height_);
+    allocations_++;
+  }
+  if (frame.has_update_rect()) {
+    frame.set_update_rect(frame.update_rect().ScaleWithFrame(
+        frame.width(), frame.height(), crop_x, crop_y, crop_width, crop_height,
+        width_, height_));
+  }
+  frame.set_video_frame_buffer(scaled);
+  PublishMetrics();
 
   return encoder_->Encode(frame, frame_types);
 }
 
+void AlignedEncoderAdapter::PublishMetrics() {
+  int64_t now = webrtc::TimeMillis();
+  if (now - last_publish_ms_ < kPublishIntervalMs) {
+    return;
+  }
+  last_publish_ms_ = now;
+
+  // Several adapters may exist (one per simulcast layer), so add the deltas
+  auto& registry = MetricsRegistry::Instance();
+  registry.Add(kMetricsGroup, "passthrough_frames", passthrough_frames_);
+  registry.Add(kMetricsGroup, "wrapped_frames", wrapped_frames_);
+  registry.Add(kMetricsGroup, "pooled_copies", pooled_copies_);
+  registry.Add(kMetricsGroup, "allocations", allocations_);
+  passthrough_frames_ = 0;
+  wrapped_frames_ = 0;
+  pooled_copies_ = 0;
+  allocations_ = 0;
+}
+
 int AlignedEncoderAdapter::RegisterEncodeCompleteCallback(
     webrtc::EncodedImageCallback* callback) {
-  return encoder_->RegisterEncodeCompleteCallback(callback);
+  callback_ = callback;
+  return encoder_->RegisterEncodeCompleteCallback(callback ? this : nullptr);
+}
+
+webrtc::EncodedImageCallback::Result AlignedEncoderAdapter::OnEncodedImage(
+    const webrtc::EncodedImage& encoded_image,
+    const webrtc::CodecSpecificInfo* codec_specific_info) {
+  auto& tracer = FrameTracer::Instance();
+  if (tracer.IsEnabled()) {
+    FrameTraceEvent event;
+    event.stage = FrameTraceStage::kEncodeEnd;
+    event.time_us = webrtc::TimeMicros();
+    event.rtp_timestamp = encoded_image.RtpTimestamp();
+    event.size = static_cast<uint32_t>(encoded_image.size());
+    event.width = encoded_image._encodedWidth;
+    event.height = encoded_image._encodedHeight;
+    event.layer = encoded_image.SimulcastIndex().value_or(
+        encoded_image.SpatialIndex().value_or(0));
+    event.qp = encoded_image.qp_;
+    event.key_frame =
+        encoded_image._frameType == webrtc::VideoFrameType::kVideoFrameKey;
+    tracer.Record(event);
+  }
+  return callback_->OnEncodedImage(encoded_image, codec_specific_info);
+}
+
+void AlignedEncoderAdapter::OnDroppedFrame(DropReason reason) {
+  callback_->OnDroppedFrame(reason);
 }
 void AlignedEncoderAdapter::SetRates(const RateControlParameters& parameters) {
   encoder_->SetRates(parameters);
@@ -1,6 +1,8 @@
 #ifndef ALIGNED_ENCODER_ADAPTER_H_
 #define ALIGNED_ENCODER_ADAPTER_H_
 
+#include <cstdint>
+
 #include <absl/types/optional.h>
 #include <api/fec_controller_override.h>
 #include <api/sequence_checker.h>
@@ -8,12 +10,26 @@
 #include <api/video_codecs/video_encoder.h>
 #include <api/video_codecs/video_encoder_factory.h>
 #include <common_video/framerate_controller.h>
+#include <common_video/include/video_frame_buffer_pool.h>
 #include <modules/video_coding/include/video_codec_interface.h>
 #include <rtc_base/experiments/encoder_info_settings.h>
 #include <rtc_base/system/no_unique_address.h>
 #include <rtc_base/system/rtc_export.h>
 
-class AlignedEncoderAdapter : public webrtc::VideoEncoder {
+// Crops (and scales if needed) every frame to the size the encoder was
+// initialized with, which is rounded down to the given alignment.
+//
+// Cropping a few rows or columns does not need a copy: I420 and NV12 frames
+// are passed to the encoder as a view of the original planes with adjusted
+// pointers. A copy is only made when the frame also has to be scaled, into a
+// pooled buffer. The number of frames handled each way is published under
+// "aligned_encoder" in MetricsRegistry. The update rect of the frame (the
+// area the capturer reported as changed) is moved along with the crop.
+//
+// Every encoder created by MomoVideoEncoderFactory is wrapped by this adapter,
+// so it also stamps encode start and each encoded layer for FrameTracer.
+class AlignedEncoderAdapter : public webrtc::VideoEncoder,
+                              public webrtc::EncodedImageCallback {
  public:
   AlignedEncoderAdapter(std::shared_ptr<webrtc::VideoEncoder> encoder,
                         int horizontal_alignment,
@@ -35,12 +51,29 @@ class AlignedEncoderAdapter : public webrtc::VideoEncoder {
 
   EncoderInfo GetEncoderInfo() const override;
 
+  // EncodedImageCallback
+  Result OnEncodedImage(
+      const webrtc::EncodedImage& encoded_image,
+      const webrtc::CodecSpecificInfo* codec_specific_info) override;
+  void OnDroppedFrame(DropReason reason) override;
+
  private:
   std::shared_ptr<webrtc::VideoEncoder> encoder_;
+  webrtc::EncodedImageCallback* callback_ = nullptr;
   int horizontal_alignment_;
   int vertical_alignment_;
   int width_;
   int height_;
+
+  void PublishMetrics();
+
+  webrtc::VideoFrameBufferPool buffer_pool_;
+  // Since the last PublishMetrics
+  uint64_t passthrough_frames_ = 0;
+  uint64_t wrapped_frames_ = 0;
+  uint64_t pooled_copies_ = 0;
+  uint64_t allocations_ = 0;
+  int64_t last_publish_ms_ = 0;
 };
 
-#endif
\ No newline at end of file
+#endif
@@ -0,0 +1,152 @@
+#include "desktop_adaptation_controller.h"
+
+#include <algorithm>
+#include <string>
+
+// WebRTC
+#include <api/stats/rtcstats_objects.h>
+#include <rtc_base/logging.h>
+
+#include "metrics/metrics_registry.h"
+#include "rtc_manager.h"
+
+namespace {
+
+constexpr char kMetricsGroup[] = "network_adaptation";
+
+}  // namespace
+
+DesktopAdaptationController::DesktopAdaptationController(RTCManager* manager,
+                                                         int max_framerate)
+    : manager_(manager), policy_({max_framerate}) {
+  const auto& levels = policy_.levels();
+  const auto& last = levels.back();
+  RTC_LOG(LS_INFO) << "DesktopAdaptation: " << levels.size()
+                   << " levels, from " << levels.front().max_framerate
+                   << "fps down to " << last.max_framerate << "fps at 1/"
+                   << last.scale_resolution_down_by << " resolution";
+}
+
+void DesktopAdaptationController::OnReport(
+    const webrtc::scoped_refptr<const webrtc::RTCStatsReport>& report) {
+  if (!report) {
+    return;
+  }
+
+  AdaptationSample sample;
+  Totals now;
+  now.timestamp_us = report->timestamp().us();
+  bool has_video = false;
+  for (const auto* out :
+       report->GetStatsOfType<webrtc::RTCOutboundRtpStreamStats>()) {
+    if (out->kind.value_or("") != "video") {
+      continue;
+    }
+    has_video = true;
+    now.streams++;
+    now.bytes_sent += static_cast<double>(out->bytes_sent.value_or(0));
+    now.frames_encoded += static_cast<double>(out->frames_encoded.value_or(0));
+    now.total_encode_time += out->total_encode_time.value_or(0.0);
+    if (out->frames_per_second.has_value()) {
+      sample.fps = std::max(sample.fps, *out->frames_per_second);
+    }
+    const std::string reason = out->quality_limitation_reason.value_or("");
+    sample.bandwidth_limited |= reason == "bandwidth";
+    sample.cpu_limited |= reason == "cpu";
+  }
+  if (!has_video) {
+    // Not sending video (yet)
+    return;
+  }
+
+  for (const auto* pair :
+       report->GetStatsOfType<webrtc::RTCIceCandidatePairStats>()) {
+    if (pair->nominated.value_or(false) &&
+        pair->state.value_or("") == "succeeded") {
+      if (pair->current_round_trip_time.has_value()) {
+        sample.rtt_ms = *pair->current_round_trip_time * 1000.0;
+      }
+      if (pair->available_outgoing_bitrate.has_value()) {
+        sample.available_bitrate_bps = *pair->available_outgoing_bitrate;
+      }
+      break;
+    }
+  }
+  for (const auto* remote :
+       report->GetStatsOfType<webrtc::RTCRemoteInboundRtpStreamStats>()) {
+    if (remote->kind.value_or("") == "video" &&
+        remote->fraction_lost.has_value()) {
+      sample.loss_fraction =
+          std::max(sample.loss_fraction, *remote->fraction_lost);
+    }
+  }
+
+  std::lock_guard<std::mutex> lock(mutex_);
+  if (start_us_ < 0) {
+    start_us_ = now.timestamp_us;
+  }
+  sample.time_s = (now.timestamp_us - start_us_) / 1e6;
+  if (has_prev_ && (now.bytes_sent < prev_.bytes_sent ||
+                    now.streams != prev_.streams)) {
+    // The counters restarted or another viewer connected: a new connection,
+    // whose sender has none of the limits applied yet
+    has_prev_ = false;
+    pending_ = true;
+  }
+  if (has_prev_ && now.timestamp_us > prev_.timestamp_us) {
+    const double seconds = (now.timestamp_us - prev_.timestamp_us) / 1e6;
+    sample.sent_bitrate_bps =
+        (now.bytes_sent - prev_.bytes_sent) * 8.0 / seconds;
+    const double encoded = now.frames_encoded - prev_.frames_encoded;
+    if (encoded > 0) {
+      sample.encode_ms =
+          (now.total_encode_time - prev_.total_encode_time) * 1000.0 /
+          encoded;
+    }
+  }
+  prev_ = now;
+  has_prev_ = true;
+
+  RTC_LOG(LS_INFO) << "DesktopAdaptation sample: "
+                   << boost::json::serialize(sample.ToJson());
+
+  const AdaptationDecision decision = policy_.OnSample(sample);
+  if (decision.changed) {
+    RTC_LOG(LS_INFO) << "DesktopAdaptation: level=" << decision.level
+                     << " scale=" << decision.scale_resolution_down_by
+                     << " max_fps=" << decision.max_framerate
+                     << " max_bitrate="
+                     << (decision.max_bitrate_bps
+                             ? std::to_string(*decision.max_bitrate_bps)
+                             : std::string("none"))
+                     << (decision.reason.empty() ? "" : " (")
+                     << decision.reason
+                     << (decision.reason.empty() ? "" : ")");
+  }
+  if (decision.changed || pending_) {
+    pending_ = !manager_->SetVideoLimits(decision.scale_resolution_down_by,
+                                         decision.max_framerate,
+                                         decision.max_bitrate_bps);
+  }
+
+  auto& registry = MetricsRegistry::Instance();
+  registry.Set(kMetricsGroup, "level", decision.level);
+  registry.Set(kMetricsGroup, "scale_resolution_down_by",
+               decision.scale_resolution_down_by);
+  registry.Set(kMetricsGroup, "max_framerate", decision.max_framerate);
+  registry.Set(kMetricsGroup, "max_bitrate_kbps",
+               decision.max_bitrate_bps ? *decision.max_bitrate_bps / 1000.0
+                                        : 0.0);
+  registry.Set(kMetricsGroup, "applied", pending_ ? 0 : 1);
+  registry.Set(kMetricsGroup, "rtt_ms", sample.rtt_ms);
+  registry.Set(kMetricsGroup, "loss_percent",
+               sample.loss_fraction < 0 ? -1.0 : sample.loss_fraction * 100);
+  registry.Set(kMetricsGroup, "available_kbps",
+               sample.available_bitrate_bps < 0
+                   ? -1.0
+                   : sample.available_bitrate_bps / 1000.0);
+  registry.Set(kMetricsGroup, "encode_ms", sample.encode_ms);
+  if (decision.changed) {
+    registry.Add(kMetricsGroup, "changes", 1);
+  }
+}
@@ -0,0 +1,50 @@
+#ifndef DESKTOP_ADAPTATION_CONTROLLER_H_
+#define DESKTOP_ADAPTATION_CONTROLLER_H_
+
+#include <cstdint>
+#include <mutex>
+
+// WebRTC
+#include <api/scoped_refptr.h>
+#include <api/stats/rtc_stats_report.h>
+
+#include "desktop_adaptation_policy.h"
+
+class RTCManager;
+
+// --network-adaptation: feeds the stats of the connection to
+// DesktopAdaptationPolicy once a second and applies its decisions to the
+// video sender of RTCManager.
+//
+// Every sample is logged as "DesktopAdaptation sample: {json}", so the log of
+// a session can be replayed with momo_adaptreplay.
+class DesktopAdaptationController {
+ public:
+  DesktopAdaptationController(RTCManager* manager, int max_framerate);
+
+  // Called from the GetStats callback (signaling thread)
+  void OnReport(
+      const webrtc::scoped_refptr<const webrtc::RTCStatsReport>& report);
+
+ private:
+  // Cumulative counters of the outbound video
+  struct Totals {
+    int64_t timestamp_us = 0;
+    // Outbound video streams, one per connection in P2P mode
+    int streams = 0;
+    double bytes_sent = 0;
+    double frames_encoded = 0;
+    double total_encode_time = 0;
+  };
+
+  RTCManager* manager_;
+  std::mutex mutex_;
+  DesktopAdaptationPolicy policy_;
+  int64_t start_us_ = -1;
+  Totals prev_;
+  bool has_prev_ = false;
+  // The sender rejected the last limits (not negotiated yet, or simulcast)
+  bool pending_ = true;
+};
+
+#endif
@@ -0,0 +1,231 @@
+#include "desktop_adaptation_policy.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace {
+
+// Loss reported by the receiver
+constexpr double kLossHealthy = 0.02;
+constexpr double kLossOverloaded = 0.05;
+constexpr double kLossSevere = 0.15;
+// Rise of the RTT over the lowest one of the last kRttWindow seconds, i.e.
+// how much is queued on the path
+constexpr double kRttRiseHealthyMs = 50.0;
+constexpr double kRttRiseOverloadedMs = 150.0;
+constexpr double kRttRiseSevereMs = 400.0;
+constexpr size_t kRttWindow = 30;
+// Share of the frame interval the encoder may take
+constexpr double kEncodeBudget = 0.8;
+
+// Hysteresis: seconds in a row before going down / up a level, and the time
+// after any change before going down / up again. The stats lag the change by
+// a receiver report or two, only severe conditions skip the hold when going
+// down.
+constexpr int kDegradeSamples = 2;
+constexpr int kUpgradeSamples = 8;
+constexpr double kDegradeHoldS = 3.0;
+constexpr double kUpgradeHoldS = 10.0;
+
+// While the link loses packets the encoder is kept below the estimate
+constexpr double kBitrateCapRatio = 0.9;
+constexpr int kMinBitrateCapBps = 150000;
+
+// Frame rates of the levels at full resolution, then the resolution goes
+// down at the lowest frame rate
+constexpr int kFramerateSteps[] = {30, 20, 15, 10, 5};
+constexpr double kScaleSteps[] = {1.5, 2.0};
+
+double GetNumber(const boost::json::object& obj, const char* key) {
+  const boost::json::value* v = obj.if_contains(key);
+  if (v == nullptr || !v->is_number()) {
+    return -1.0;
+  }
+  return v->to_number<double>();
+}
+
+bool GetBool(const boost::json::object& obj, const char* key) {
+  const boost::json::value* v = obj.if_contains(key);
+  return v != nullptr && v->is_bool() && v->as_bool();
+}
+
+}  // namespace
+
+boost::json::object AdaptationSample::ToJson() const {
+  return {{"t", time_s},
+          {"rtt_ms", rtt_ms},
+          {"available_bps", available_bitrate_bps},
+          {"loss", loss_fraction},
+          {"sent_bps", sent_bitrate_bps},
+          {"encode_ms", encode_ms},
+          {"fps", fps},
+          {"bandwidth_limited", bandwidth_limited},
+          {"cpu_limited", cpu_limited}};
+}
+
+std::optional<AdaptationSample> AdaptationSample::FromJson(
+    const boost::json::value& v) {
+  if (!v.is_object()) {
+    return std::nullopt;
+  }
+  const auto& obj = v.as_object();
+  if (!obj.contains("t")) {
+    return std::nullopt;
+  }
+  AdaptationSample sample;
+  sample.time_s = GetNumber(obj, "t");
+  sample.rtt_ms = GetNumber(obj, "rtt_ms");
+  sample.available_bitrate_bps = GetNumber(obj, "available_bps");
+  sample.loss_fraction = GetNumber(obj, "loss");
+  sample.sent_bitrate_bps = GetNumber(obj, "sent_bps");
+  sample.encode_ms = GetNumber(obj, "encode_ms");
+  sample.fps = GetNumber(obj, "fps");
+  sample.bandwidth_limited = GetBool(obj, "bandwidth_limited");
+  sample.cpu_limited = GetBool(obj, "cpu_limited");
+  return sample;
+}
+
+DesktopAdaptationPolicy::DesktopAdaptationPolicy(
+    DesktopAdaptationPolicyConfig config)
+    : config_(config) {
+  const int max_framerate = std::max(1, config_.max_framerate);
+  levels_.push_back({1.0, max_framerate});
+  for (int fps : kFramerateSteps) {
+    if (fps < levels_.back().max_framerate) {
+      levels_.push_back({1.0, fps});
+    }
+  }
+  const int floor = levels_.back().max_framerate;
+  for (double scale : kScaleSteps) {
+    levels_.push_back({scale, floor});
+  }
+  previous_ = MakeDecision();
+}
+
+DesktopAdaptationPolicy::Condition DesktopAdaptationPolicy::Classify(
+    const AdaptationSample& sample,
+    std::string* reason) {
+  double rtt_rise = 0.0;
+  if (sample.rtt_ms >= 0) {
+    rtts_.push_back(sample.rtt_ms);
+    if (rtts_.size() > kRttWindow) {
+      rtts_.pop_front();
+    }
+    rtt_rise = sample.rtt_ms - *std::min_element(rtts_.begin(), rtts_.end());
+  }
+  const double loss = std::max(0.0, sample.loss_fraction);
+
+  if (loss >= kLossSevere) {
+    *reason = "severe loss";
+    return Condition::kSevere;
+  }
+  if (rtt_rise >= kRttRiseSevereMs) {
+    *reason = "severe rtt rise";
+    return Condition::kSevere;
+  }
+  if (loss >= kLossOverloaded) {
+    *reason = "loss";
+    return Condition::kOverloaded;
+  }
+  if (rtt_rise >= kRttRiseOverloadedMs) {
+    *reason = "rtt rise";
+    return Condition::kOverloaded;
+  }
+  if (sample.bandwidth_limited) {
+    *reason = "bandwidth limited";
+    return Condition::kOverloaded;
+  }
+  const int fps = levels_[level_].max_framerate;
+  if (sample.cpu_limited ||
+      (sample.encode_ms > 0 && sample.encode_ms > kEncodeBudget * 1000 / fps)) {
+    *reason = "encoder overloaded";
+    return Condition::kOverloaded;
+  }
+  if (loss < kLossHealthy && rtt_rise < kRttRiseHealthyMs) {
+    return Condition::kHealthy;
+  }
+  return Condition::kNormal;
+}
+
+AdaptationDecision DesktopAdaptationPolicy::OnSample(
+    const AdaptationSample& sample) {
+  std::string reason;
+  const Condition condition = Classify(sample, &reason);
+
+  if (sample.loss_fraction >= kLossOverloaded &&
+      sample.available_bitrate_bps > 0) {
+    max_bitrate_bps_ = std::max(
+        kMinBitrateCapBps,
+        static_cast<int>(sample.available_bitrate_bps * kBitrateCapRatio));
+  }
+
+  switch (condition) {
+    case Condition::kSevere:
+      bad_samples_ = kDegradeSamples;
+      good_samples_ = 0;
+      break;
+    case Condition::kOverloaded:
+      bad_samples_++;
+      good_samples_ = 0;
+      break;
+    case Condition::kNormal:
+      bad_samples_ = 0;
+      good_samples_ = 0;
+      break;
+    case Condition::kHealthy:
+      bad_samples_ = 0;
+      good_samples_++;
+      break;
+  }
+
+  const int last_level = static_cast<int>(levels_.size()) - 1;
+  std::string change;
+  if (bad_samples_ >= kDegradeSamples &&
+      (condition == Condition::kSevere ||
+       sample.time_s - last_change_s_ >= kDegradeHoldS)) {
+    bad_samples_ = 0;
+    if (level_ < last_level) {
+      level_++;
+      last_change_s_ = sample.time_s;
+      change = "down: " + reason;
+    }
+  } else if (good_samples_ >= kUpgradeSamples) {
+    // The link has been fine for a while, the loss cap is no longer needed
+    max_bitrate_bps_.reset();
+    if (level_ > 0 && sample.time_s - last_change_s_ >= kUpgradeHoldS) {
+      // The next level needs proportionally more bits, only go up if the
+      // estimate has room for them
+      const Level& current = levels_[level_];
+      const Level& next = levels_[level_ - 1];
+      const double ratio = (static_cast<double>(next.max_framerate) /
+                            current.max_framerate) *
+                           std::pow(current.scale_resolution_down_by /
+                                        next.scale_resolution_down_by,
+                                    2.0);
+      if (sample.available_bitrate_bps < 0 || sample.sent_bitrate_bps < 0 ||
+          sample.sent_bitrate_bps * ratio <= sample.available_bitrate_bps) {
+        level_--;
+        last_change_s_ = sample.time_s;
+        good_samples_ = 0;
+        change = "up";
+      }
+    }
+  }
+
+  AdaptationDecision decision = MakeDecision();
+  decision.changed =
+      decision.level != previous_.level ||
+      decision.max_bitrate_bps != previous_.max_bitrate_bps;
+  decision.reason = change;
+  previous_ = decision;
+  return decision;
+}
+
+AdaptationDecision DesktopAdaptationPolicy::MakeDecision() const {
+  AdaptationDecision decision;
+  decision.level = level_;
+  decision.scale_resolution_down_by = levels_[level_].scale_resolution_down_by;
+  decision.max_framerate = levels_[level_].max_framerate;
+  decision.max_bitrate_bps = max_bitrate_bps_;
+  return decision;
+}
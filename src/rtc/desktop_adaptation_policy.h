@@ -0,0 +1,90 @@
+#ifndef DESKTOP_ADAPTATION_POLICY_H_
+#define DESKTOP_ADAPTATION_POLICY_H_
+
+#include <deque>
+#include <optional>
+#include <string>
+#include <vector>
+
+// Boost
+#include <boost/json.hpp>
+
+// One second of network and encoder state, taken from RTCStatsReport.
+// Negative values are unknown.
+struct AdaptationSample {
+  // Seconds since the controller started
+  double time_s = 0.0;
+  // Selected candidate pair
+  double rtt_ms = -1.0;
+  double available_bitrate_bps = -1.0;
+  // Reported by the receiver (remote-inbound-rtp), 0.0 - 1.0
+  double loss_fraction = -1.0;
+  // Outbound video over the last second
+  double sent_bitrate_bps = -1.0;
+  double encode_ms = -1.0;
+  double fps = -1.0;
+  // quality_limitation_reason of the outbound video
+  bool bandwidth_limited = false;
+  bool cpu_limited = false;
+
+  boost::json::object ToJson() const;
+  static std::optional<AdaptationSample> FromJson(const boost::json::value& v);
+};
+
+struct AdaptationDecision {
+  int level = 0;
+  double scale_resolution_down_by = 1.0;
+  int max_framerate = 0;
+  // Only capped while the link loses packets
+  std::optional<int> max_bitrate_bps;
+  // The limits differ from the previous decision
+  bool changed = false;
+  // Why the level changed (empty if it did not)
+  std::string reason;
+};
+
+struct DesktopAdaptationPolicyConfig {
+  // Frame rate at level 0
+  int max_framerate = 30;
+};
+
+// Decides how far to lower the frame rate and the resolution of a remote
+// desktop stream from once-a-second stats samples.
+//
+// Text has to stay readable, so the frame rate goes first and the resolution
+// only when the frame rate is at its floor. Levels go down after a couple of
+// bad seconds and up only after a longer period of good ones, so a short loss
+// burst does not make the picture flicker between sizes.
+//
+// No I/O and no WebRTC types, so that recorded samples can be replayed
+// (momo_adaptreplay).
+class DesktopAdaptationPolicy {
+ public:
+  explicit DesktopAdaptationPolicy(DesktopAdaptationPolicyConfig config);
+
+  AdaptationDecision OnSample(const AdaptationSample& sample);
+
+  struct Level {
+    double scale_resolution_down_by;
+    int max_framerate;
+  };
+  const std::vector<Level>& levels() const { return levels_; }
+
+ private:
+  enum class Condition { kSevere, kOverloaded, kNormal, kHealthy };
+  Condition Classify(const AdaptationSample& sample, std::string* reason);
+  AdaptationDecision MakeDecision() const;
+
+  DesktopAdaptationPolicyConfig config_;
+  std::vector<Level> levels_;
+  int level_ = 0;
+  int bad_samples_ = 0;
+  int good_samples_ = 0;
+  double last_change_s_ = -1e9;
+  std::optional<int> max_bitrate_bps_;
+  // Recent RTTs, the lowest one is the RTT of an idle link
+  std::deque<double> rtts_;
+  AdaptationDecision previous_;
+};
+
+#endif
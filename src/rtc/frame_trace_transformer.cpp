@@ -0,0 +1,50 @@
+#include "frame_trace_transformer.h"
+
+// WebRTC
+#include <rtc_base/time_utils.h>
+
+#include "metrics/frame_tracer.h"
+
+void FrameTraceTransformer::Transform(
+    std::unique_ptr<webrtc::TransformableFrameInterface> transformable_frame) {
+  webrtc::scoped_refptr<webrtc::TransformedFrameCallback> sink;
+  {
+    webrtc::MutexLock lock(&mutex_);
+    auto it = sinks_.find(transformable_frame->GetSsrc());
+    if (it != sinks_.end()) {
+      sink = it->second;
+    }
+  }
+  if (!sink) {
+    return;
+  }
+
+  auto& tracer = FrameTracer::Instance();
+  if (tracer.IsEnabled()) {
+    auto* video_frame =
+        static_cast<webrtc::TransformableVideoFrameInterface*>(
+            transformable_frame.get());
+    FrameTraceEvent event;
+    event.stage = FrameTraceStage::kPacketize;
+    event.time_us = webrtc::TimeMicros();
+    event.rtp_timestamp = video_frame->GetTimestamp();
+    event.size = static_cast<uint32_t>(video_frame->GetData().size());
+    event.layer = video_frame->Metadata().GetSimulcastIdx();
+    event.key_frame = video_frame->IsKeyFrame();
+    tracer.Record(event);
+  }
+  sink->OnTransformedFrame(std::move(transformable_frame));
+}
+
+void FrameTraceTransformer::RegisterTransformedFrameSinkCallback(
+    webrtc::scoped_refptr<webrtc::TransformedFrameCallback> callback,
+    uint32_t ssrc) {
+  webrtc::MutexLock lock(&mutex_);
+  sinks_[ssrc] = std::move(callback);
+}
+
+void FrameTraceTransformer::UnregisterTransformedFrameSinkCallback(
+    uint32_t ssrc) {
+  webrtc::MutexLock lock(&mutex_);
+  sinks_.erase(ssrc);
+}
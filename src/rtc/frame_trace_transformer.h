@@ -0,0 +1,35 @@
+#ifndef FRAME_TRACE_TRANSFORMER_H_
+#define FRAME_TRACE_TRANSFORMER_H_
+
+#include <cstdint>
+#include <map>
+#include <memory>
+
+// WebRTC
+#include <api/frame_transformer_interface.h>
+#include <api/scoped_refptr.h>
+#include <rtc_base/synchronization/mutex.h>
+
+// Encoder to packetizer transformer of the video sender that leaves the
+// frames untouched and only stamps FrameTraceStage::kPacketize. There is no
+// hook for the first RTP packet on the wire, this is the last point before
+// the packets go to the pacer.
+//
+// Only installed with --frame-trace, since a transformer moves packetization
+// to a task of its own.
+class FrameTraceTransformer : public webrtc::FrameTransformerInterface {
+ public:
+  void Transform(std::unique_ptr<webrtc::TransformableFrameInterface>
+                     transformable_frame) override;
+  void RegisterTransformedFrameSinkCallback(
+      webrtc::scoped_refptr<webrtc::TransformedFrameCallback> callback,
+      uint32_t ssrc) override;
+  void UnregisterTransformedFrameSinkCallback(uint32_t ssrc) override;
+
+ private:
+  webrtc::Mutex mutex_;
+  std::map<uint32_t, webrtc::scoped_refptr<webrtc::TransformedFrameCallback>>
+      sinks_;
+};
+
+#endif
@@ -0,0 +1,123 @@
+#include "ice_recovery.h"
+
+#include <chrono>
+
+// WebRTC
+#include <rtc_base/logging.h>
+#include <rtc_base/time_utils.h>
+
+#include "metrics/metrics_registry.h"
+
+namespace {
+
+// Time ICE gets to come back by itself before it is restarted
+constexpr int kRestartDelayMs = 1000;
+// Time the restart gets before giving up on the connection
+constexpr int kRestartTimeoutMs = 5000;
+
+}  // namespace
+
+IceRecovery::IceRecovery(boost::asio::io_context& ioc,
+                         RestartIce restart_ice,
+                         GiveUp give_up)
+    : timer_(ioc),
+      restart_ice_(std::move(restart_ice)),
+      give_up_(std::move(give_up)) {}
+
+void IceRecovery::OnIceConnectionStateChange(
+    webrtc::PeerConnectionInterface::IceConnectionState new_state) {
+  using IceState = webrtc::PeerConnectionInterface::IceConnectionState;
+  switch (new_state) {
+    case IceState::kIceConnectionConnected:
+    case IceState::kIceConnectionCompleted:
+      OnRecovered();
+      break;
+    case IceState::kIceConnectionDisconnected:
+      if (state_ != State::kConnected) {
+        break;
+      }
+      RTC_LOG(LS_INFO) << "ICE disconnected, waiting " << kRestartDelayMs
+                       << " ms before restarting it";
+      MetricsRegistry::Instance().Add("ice_recovery", "disconnects", 1);
+      disconnected_ms_ = webrtc::TimeMillis();
+      state_ = State::kWaiting;
+      timer_.expires_after(std::chrono::milliseconds(kRestartDelayMs));
+      timer_.async_wait([this](const boost::system::error_code& ec) {
+        if (ec) {
+          return;
+        }
+        Restart();
+      });
+      break;
+    case IceState::kIceConnectionFailed:
+      if (state_ == State::kConnected) {
+        MetricsRegistry::Instance().Add("ice_recovery", "disconnects", 1);
+        disconnected_ms_ = webrtc::TimeMillis();
+        Restart();
+      } else if (state_ == State::kWaiting) {
+        // No point in waiting any longer
+        Restart();
+      } else {
+        // The restart, or the connection made by the full reconnect, failed
+        Fail();
+      }
+      break;
+    default:
+      break;
+  }
+}
+
+void IceRecovery::Reset() {
+  timer_.cancel();
+  if (state_ != State::kGaveUp) {
+    state_ = State::kConnected;
+  }
+}
+
+void IceRecovery::Restart() {
+  timer_.cancel();
+  state_ = State::kRestarting;
+  if (restart_ice_()) {
+    RTC_LOG(LS_INFO) << "Restarting ICE";
+    MetricsRegistry::Instance().Add("ice_recovery", "ice_restarts", 1);
+  } else {
+    RTC_LOG(LS_INFO) << "ICE restart is not possible, waiting for ICE";
+  }
+  timer_.expires_after(std::chrono::milliseconds(kRestartTimeoutMs));
+  timer_.async_wait([this](const boost::system::error_code& ec) {
+    if (ec) {
+      return;
+    }
+    Fail();
+  });
+}
+
+void IceRecovery::Fail() {
+  timer_.cancel();
+  RTC_LOG(LS_WARNING) << "ICE did not recover in "
+                      << webrtc::TimeMillis() - disconnected_ms_
+                      << " ms, reconnecting";
+  MetricsRegistry::Instance().Add("ice_recovery", "full_reconnects", 1);
+  state_ = State::kGaveUp;
+  give_up_();
+}
+
+void IceRecovery::OnRecovered() {
+  timer_.cancel();
+  if (state_ == State::kConnected) {
+    return;
+  }
+  const double elapsed_ms =
+      static_cast<double>(webrtc::TimeMillis() - disconnected_ms_);
+  auto& metrics = MetricsRegistry::Instance();
+  if (state_ == State::kGaveUp) {
+    RTC_LOG(LS_INFO) << "Reconnected " << elapsed_ms
+                     << " ms after ICE was disconnected";
+    metrics.Set("ice_recovery", "last_reconnect_ms", elapsed_ms);
+  } else {
+    RTC_LOG(LS_INFO) << "ICE recovered in " << elapsed_ms << " ms";
+    metrics.Add("ice_recovery", "recovered", 1);
+    metrics.Set("ice_recovery", "last_recovery_ms", elapsed_ms);
+  }
+  state_ = State::kConnected;
+}
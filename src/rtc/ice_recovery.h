@@ -0,0 +1,62 @@
+#ifndef ICE_RECOVERY_H_
+#define ICE_RECOVERY_H_
+
+#include <cstdint>
+#include <functional>
+
+// Boost
+#include <boost/asio/io_context.hpp>
+#include <boost/asio/steady_timer.hpp>
+
+// WebRTC
+#include <api/peer_connection_interface.h>
+
+// Tries to bring back a connection whose ICE got disconnected before the
+// signaling client tears it down and connects again from scratch.
+//
+//   connected --disconnected--> waiting --kRestartDelayMs--> restarting
+//   restarting --kRestartTimeoutMs or failed--> gave up (full reconnect)
+//
+// While waiting, ICE may come back by itself (e.g. after a Wi-Fi handover,
+// with continual gathering). Then the ICE restart is asked for, if the
+// client can make one, and the signaling connection is kept. Only when that
+// does not bring the connection back either does the client do what it did
+// before, a full reconnect.
+//
+// The time from the disconnection to the connection being back, by ICE
+// restart or full reconnect, is published under "ice_recovery" in the
+// MetricsRegistry.
+//
+// Must be used on the io_context thread.
+class IceRecovery {
+ public:
+  // Returns false if no ICE restart can be made, recovery then only waits
+  using RestartIce = std::function<bool()>;
+  using GiveUp = std::function<void()>;
+
+  IceRecovery(boost::asio::io_context& ioc,
+              RestartIce restart_ice,
+              GiveUp give_up);
+
+  void OnIceConnectionStateChange(
+      webrtc::PeerConnectionInterface::IceConnectionState new_state);
+  // The connection is going away. A full reconnect still in progress keeps
+  // being timed until the next connection is up.
+  void Reset();
+
+ private:
+  enum class State { kConnected, kWaiting, kRestarting, kGaveUp };
+
+  void Restart();
+  void Fail();
+  void OnRecovered();
+
+  boost::asio::steady_timer timer_;
+  RestartIce restart_ice_;
+  GiveUp give_up_;
+
+  State state_ = State::kConnected;
+  int64_t disconnected_ms_ = 0;
+};
+
+#endif
@@ -62,6 +62,9 @@ MomoVideoDecoderFactory::MomoVideoDecoderFactory(
 std::vector<webrtc::SdpVideoFormat>
 MomoVideoDecoderFactory::GetSupportedFormats() const {
   std::vector<webrtc::SdpVideoFormat> supported_codecs;
+  // WebRTC asks for the formats again and again while negotiating, the
+  // hardware is only probed once (VideoCodecInfo::Get())
+  const VideoCodecInfo& info = VideoCodecInfo::Get();
 
   auto add_vp8 = [&supported_codecs]() {
     supported_codecs.push_back(webrtc::SdpVideoFormat(webrtc::kVp8CodecName));
@@ -98,52 +101,46 @@ MomoVideoDecoderFactory::GetSupportedFormats() const {
 
 #if defined(USE_NVCODEC_ENCODER)
   if (config_.vp8_decoder == VideoCodecInfo::Type::NVIDIA &&
-      sora::NvCodecVideoDecoder::IsSupported(config_.cuda_context,
-                                             sora::CudaVideoCodec::VP8)) {
+      VideoCodecInfo::Has(info.vp8_decoders, VideoCodecInfo::Type::NVIDIA)) {
     add_vp8();
   }
   if (config_.vp9_decoder == VideoCodecInfo::Type::NVIDIA &&
-      sora::NvCodecVideoDecoder::IsSupported(config_.cuda_context,
-                                             sora::CudaVideoCodec::VP9)) {
+      VideoCodecInfo::Has(info.vp9_decoders, VideoCodecInfo::Type::NVIDIA)) {
     add_vp9();
   }
   if (config_.av1_decoder == VideoCodecInfo::Type::NVIDIA &&
-      sora::NvCodecVideoDecoder::IsSupported(config_.cuda_context,
-                                             sora::CudaVideoCodec::AV1)) {
+      VideoCodecInfo::Has(info.av1_decoders, VideoCodecInfo::Type::NVIDIA)) {
     add_av1();
   }
   if (config_.h264_decoder == VideoCodecInfo::Type::NVIDIA &&
-      sora::NvCodecVideoDecoder::IsSupported(config_.cuda_context,
-                                             sora::CudaVideoCodec::H264)) {
+      VideoCodecInfo::Has(info.h264_decoders, VideoCodecInfo::Type::NVIDIA)) {
     add_h264();
   }
   if (config_.h265_decoder == VideoCodecInfo::Type::NVIDIA &&
-      sora::NvCodecVideoDecoder::IsSupported(config_.cuda_context,
-                                             sora::CudaVideoCodec::H265)) {
+      VideoCodecInfo::Has(info.h265_decoders, VideoCodecInfo::Type::NVIDIA)) {
     add_h265();
   }
 #endif
 
 #if defined(USE_VPL_ENCODER)
-  auto session = sora::VplSession::Create();
   if (config_.vp8_decoder == VideoCodecInfo::Type::Intel &&
-      sora::VplVideoDecoder::IsSupported(session, webrtc::kVideoCodecVP8)) {
+      VideoCodecInfo::Has(info.vp8_decoders, VideoCodecInfo::Type::Intel)) {
     add_vp8();
   }
   if (config_.vp9_decoder == VideoCodecInfo::Type::Intel &&
-      sora::VplVideoDecoder::IsSupported(session, webrtc::kVideoCodecVP9)) {
+      VideoCodecInfo::Has(info.vp9_decoders, VideoCodecInfo::Type::Intel)) {
     add_vp9();
   }
   if (config_.av1_decoder == VideoCodecInfo::Type::Intel &&
-      sora::VplVideoDecoder::IsSupported(session, webrtc::kVideoCodecAV1)) {
+      VideoCodecInfo::Has(info.av1_decoders, VideoCodecInfo::Type::Intel)) {
     add_av1();
   }
   if (config_.h264_decoder == VideoCodecInfo::Type::Intel &&
-      sora::VplVideoDecoder::IsSupported(session, webrtc::kVideoCodecH264)) {
+      VideoCodecInfo::Has(info.h264_decoders, VideoCodecInfo::Type::Intel)) {
     add_h264();
   }
   if (config_.h265_decoder == VideoCodecInfo::Type::Intel &&
-      sora::VplVideoDecoder::IsSupported(session, webrtc::kVideoCodecH265)) {
+      VideoCodecInfo::Has(info.h265_decoders, VideoCodecInfo::Type::Intel)) {
     add_h265();
   }
 #endif
@@ -156,23 +153,23 @@ MomoVideoDecoderFactory::GetSupportedFormats() const {
 
 #if defined(USE_JETSON_ENCODER)
   if (config_.vp8_decoder == VideoCodecInfo::Type::Jetson &&
-      sora::JetsonVideoDecoder::IsSupported(webrtc::kVideoCodecVP8)) {
+      VideoCodecInfo::Has(info.vp8_decoders, VideoCodecInfo::Type::Jetson)) {
     add_vp8();
   }
   if (config_.vp9_decoder == VideoCodecInfo::Type::Jetson &&
-      sora::JetsonVideoDecoder::IsSupported(webrtc::kVideoCodecVP9)) {
+      VideoCodecInfo::Has(info.vp9_decoders, VideoCodecInfo::Type::Jetson)) {
     add_vp9();
   }
   if (config_.av1_decoder == VideoCodecInfo::Type::Jetson &&
-      sora::JetsonVideoDecoder::IsSupported(webrtc::kVideoCodecAV1)) {
+      VideoCodecInfo::Has(info.av1_decoders, VideoCodecInfo::Type::Jetson)) {
     add_av1();
   }
   if (config_.h264_decoder == VideoCodecInfo::Type::Jetson &&
-      sora::JetsonVideoDecoder::IsSupported(webrtc::kVideoCodecH264)) {
+      VideoCodecInfo::Has(info.h264_decoders, VideoCodecInfo::Type::Jetson)) {
     add_h264();
   }
   if (config_.h265_decoder == VideoCodecInfo::Type::Jetson &&
-      sora::JetsonVideoDecoder::IsSupported(webrtc::kVideoCodecH265)) {
+      VideoCodecInfo::Has(info.h265_decoders, VideoCodecInfo::Type::Jetson)) {
     add_h265();
   }
 #endif
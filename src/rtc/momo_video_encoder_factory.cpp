@@ -41,24 +41,59 @@
 
 #include "sora/open_h264_video_encoder.h"
 
+#include "metrics/metrics_registry.h"
 #include "rtc/aligned_encoder_adapter.h"
 
+namespace {
+
+// InitEncode of OpenH264 runs again on every resolution change,
+// renegotiation and new connection; the warm pool should make most of them
+// cheap
+void ReportOpenH264Init(const sora::OpenH264InitStats& stats) {
+  const char kMetricsGroup[] = "openh264";
+  auto& registry = MetricsRegistry::Instance();
+  registry.Add(kMetricsGroup, "init_count", 1);
+  registry.Set(kMetricsGroup, "last_init_ms", stats.init_us / 1000.0);
+  registry.Add(kMetricsGroup, "total_init_ms", stats.init_us / 1000.0);
+  registry.Add(kMetricsGroup, "reused_encoders", stats.reused_encoders);
+  registry.Add(kMetricsGroup, "created_encoders", stats.created_encoders);
+  // Published by the encoder in use, hardware encoders keep their settings
+  if (stats.low_latency) {
+    registry.Set("low_latency", "encoder_frame_skip", stats.frame_skip ? 1 : 0);
+    registry.Set("low_latency", "encoder_max_gop_seconds",
+                 stats.max_gop_seconds);
+    registry.Set("low_latency", "encoder_ref_frames", stats.ref_frames);
+  }
+}
+
+}  // namespace
+
 MomoVideoEncoderFactory::MomoVideoEncoderFactory(
     const MomoVideoEncoderFactoryConfig& config)
     : config_(config) {
 #if defined(__APPLE__)
   video_encoder_factory_ = CreateObjCEncoderFactory();
 #endif
+  if (!config.openh264.empty()) {
+    sora::SetOpenH264InitCallback(ReportOpenH264Init);
+  }
   if (config.simulcast) {
     auto config2 = config;
     config2.simulcast = false;
+    config2.share_encoder = false;
     internal_encoder_factory_.reset(new MomoVideoEncoderFactory(config2));
   }
+  if (config.share_encoder) {
+    shared_encoders_ = std::make_shared<SharedEncoderRegistry>();
+  }
 }
 
 std::vector<webrtc::SdpVideoFormat>
 MomoVideoEncoderFactory::GetSupportedFormats() const {
   std::vector<webrtc::SdpVideoFormat> supported_codecs;
+  // WebRTC asks for the formats again and again while negotiating, the
+  // hardware is only probed once (VideoCodecInfo::Get())
+  const VideoCodecInfo& info = VideoCodecInfo::Get();
 
   auto add_vp8 = [&supported_codecs]() {
     supported_codecs.push_back(webrtc::SdpVideoFormat(webrtc::kVp8CodecName));
@@ -95,52 +130,46 @@ MomoVideoEncoderFactory::GetSupportedFormats() const {
 
 #if defined(USE_NVCODEC_ENCODER)
   if (config_.vp8_encoder == VideoCodecInfo::Type::NVIDIA &&
-      sora::NvCodecVideoEncoder::IsSupported(config_.cuda_context,
-                                             sora::CudaVideoCodec::VP8)) {
+      VideoCodecInfo::Has(info.vp8_encoders, VideoCodecInfo::Type::NVIDIA)) {
     add_vp8();
   }
   if (config_.vp9_encoder == VideoCodecInfo::Type::NVIDIA &&
-      sora::NvCodecVideoEncoder::IsSupported(config_.cuda_context,
-                                             sora::CudaVideoCodec::VP9)) {
+      VideoCodecInfo::Has(info.vp9_encoders, VideoCodecInfo::Type::NVIDIA)) {
     add_vp9();
   }
   if (config_.av1_encoder == VideoCodecInfo::Type::NVIDIA &&
-      sora::NvCodecVideoEncoder::IsSupported(config_.cuda_context,
-                                             sora::CudaVideoCodec::AV1)) {
+      VideoCodecInfo::Has(info.av1_encoders, VideoCodecInfo::Type::NVIDIA)) {
     add_av1();
   }
   if (config_.h264_encoder == VideoCodecInfo::Type::NVIDIA &&
-      sora::NvCodecVideoEncoder::IsSupported(config_.cuda_context,
-                                             sora::CudaVideoCodec::H264)) {
+      VideoCodecInfo::Has(info.h264_encoders, VideoCodecInfo::Type::NVIDIA)) {
     add_h264();
   }
   if (config_.h265_encoder == VideoCodecInfo::Type::NVIDIA &&
-      sora::NvCodecVideoEncoder::IsSupported(config_.cuda_context,
-                                             sora::CudaVideoCodec::H265)) {
+      VideoCodecInfo::Has(info.h265_encoders, VideoCodecInfo::Type::NVIDIA)) {
     add_h265();
   }
 #endif
 
 #if defined(USE_VPL_ENCODER)
-  auto session = sora::VplSession::Create();
   if (config_.vp8_encoder == VideoCodecInfo::Type::Intel &&
-      sora::VplVideoEncoder::IsSupported(session, webrtc::kVideoCodecVP8)) {
+      VideoCodecInfo::Has(info.vp8_encoders, VideoCodecInfo::Type::Intel)) {
     add_vp8();
   }
   if (config_.vp9_encoder == VideoCodecInfo::Type::Intel &&
-      sora::VplVideoEncoder::IsSupported(session, webrtc::kVideoCodecVP9)) {
+      VideoCodecInfo::Has(info.vp9_encoders, VideoCodecInfo::Type::Intel)) {
     add_vp9();
   }
   if (config_.av1_encoder == VideoCodecInfo::Type::Intel &&
-      sora::VplVideoEncoder::IsSupported(session, webrtc::kVideoCodecAV1)) {
+      VideoCodecInfo::Has(info.av1_encoders, VideoCodecInfo::Type::Intel)) {
     add_av1();
   }
   if (config_.h264_encoder == VideoCodecInfo::Type::Intel &&
-      sora::VplVideoEncoder::IsSupported(session, webrtc::kVideoCodecH264)) {
+      VideoCodecInfo::Has(info.h264_encoders, VideoCodecInfo::Type::Intel)) {
     add_h264();
   }
   if (config_.h265_encoder == VideoCodecInfo::Type::Intel &&
-      sora::VplVideoEncoder::IsSupported(session, webrtc::kVideoCodecH265)) {
+      VideoCodecInfo::Has(info.h265_encoders, VideoCodecInfo::Type::Intel)) {
     add_h265();
   }
 #endif
@@ -153,23 +182,23 @@ MomoVideoEncoderFactory::GetSupportedFormats() const {
 
 #if defined(USE_JETSON_ENCODER)
   if (config_.vp8_encoder == VideoCodecInfo::Type::Jetson &&
-      sora::JetsonVideoEncoder::IsSupported(webrtc::kVideoCodecVP8)) {
+      VideoCodecInfo::Has(info.vp8_encoders, VideoCodecInfo::Type::Jetson)) {
     add_vp8();
   }
   if (config_.vp9_encoder == VideoCodecInfo::Type::Jetson &&
-      sora::JetsonVideoEncoder::IsSupported(webrtc::kVideoCodecVP9)) {
+      VideoCodecInfo::Has(info.vp9_encoders, VideoCodecInfo::Type::Jetson)) {
     add_vp9();
   }
   if (config_.av1_encoder == VideoCodecInfo::Type::Jetson &&
-      sora::JetsonVideoEncoder::IsSupported(webrtc::kVideoCodecAV1)) {
+      VideoCodecInfo::Has(info.av1_encoders, VideoCodecInfo::Type::Jetson)) {
     add_av1();
   }
   if (config_.h264_encoder == VideoCodecInfo::Type::Jetson &&
-      sora::JetsonVideoEncoder::IsSupported(webrtc::kVideoCodecH264)) {
+      VideoCodecInfo::Has(info.h264_encoders, VideoCodecInfo::Type::Jetson)) {
     add_h264();
   }
   if (config_.h265_encoder == VideoCodecInfo::Type::Jetson &&
-      sora::JetsonVideoEncoder::IsSupported(webrtc::kVideoCodecH265)) {
+      VideoCodecInfo::Has(info.h265_encoders, VideoCodecInfo::Type::Jetson)) {
     add_h265();
   }
 #endif
@@ -236,6 +265,17 @@ MomoVideoEncoderFactory::GetSupportedFormats() const {
 std::unique_ptr<webrtc::VideoEncoder> MomoVideoEncoderFactory::Create(
     const webrtc::Environment& env,
     const webrtc::SdpVideoFormat& format) {
+  if (shared_encoders_) {
+    // Encoders are created again after the first one of the group is gone,
+    // so the environment has to be kept
+    return std::make_unique<SharedVideoEncoder>(
+        shared_encoders_, format, [this, env, format]() {
+          return WithSimulcast(
+              format, [this, &env](const webrtc::SdpVideoFormat& format) {
+                return CreateInternal(env, format);
+              });
+        });
+  }
   return WithSimulcast(format,
                        [this, &env](const webrtc::SdpVideoFormat& format) {
                          return CreateInternal(env, format);
@@ -299,11 +339,13 @@ std::unique_ptr<webrtc::VideoEncoder> MomoVideoEncoderFactory::CreateInternal(
   }
   if (is_h264 && config_.h264_encoder == VideoCodecInfo::Type::NVIDIA) {
     return sora::NvCodecVideoEncoder::Create(config_.cuda_context,
-                                             sora::CudaVideoCodec::H264);
+                                             sora::CudaVideoCodec::H264,
+                                             config_.intra_refresh);
   }
   if (is_h265 && config_.h265_encoder == VideoCodecInfo::Type::NVIDIA) {
     return sora::NvCodecVideoEncoder::Create(config_.cuda_context,
-                                             sora::CudaVideoCodec::H265);
+                                             sora::CudaVideoCodec::H265,
+                                             config_.intra_refresh);
   }
 #endif
 
@@ -380,7 +422,16 @@ std::unique_ptr<webrtc::VideoEncoder> MomoVideoEncoderFactory::CreateInternal(
     return webrtc::CreateLibaomAv1Encoder(env);
   }
   if (is_h264 && config_.h264_encoder == VideoCodecInfo::Type::Software) {
-    return sora::CreateOpenH264VideoEncoder(format, config_.openh264);
+    sora::OpenH264VideoEncoderConfig openh264_config;
+    openh264_config.openh264 = config_.openh264;
+    openh264_config.low_latency = config_.low_latency;
+    openh264_config.intra_refresh = config_.intra_refresh;
+    if (config_.content_profile == "camera") {
+      openh264_config.content_profile = sora::OpenH264ContentProfile::kCamera;
+    } else if (config_.content_profile == "desktop") {
+      openh264_config.content_profile = sora::OpenH264ContentProfile::kDesktop;
+    }
+    return sora::CreateOpenH264VideoEncoder(format, openh264_config);
   }
   // if (is_h265 && config_.h265_encoder == VideoCodecInfo::Type::Software) {
   //   return nullptr;
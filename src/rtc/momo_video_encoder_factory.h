@@ -10,6 +10,7 @@
 #include <api/video_codecs/video_encoder.h>
 #include <api/video_codecs/video_encoder_factory.h>
 
+#include "shared_video_encoder.h"
 #include "video_codec_info.h"
 
 #if defined(USE_NVCODEC_ENCODER)
@@ -32,12 +33,19 @@ struct MomoVideoEncoderFactoryConfig {
   std::shared_ptr<sora::CudaContext> cuda_context;
 #endif
   std::string openh264;
+  // auto / camera / desktop (--video-content-profile)
+  std::string content_profile = "auto";
+  bool low_latency = false;
+  bool intra_refresh = false;
+  // Wrap the encoders in SharedVideoEncoder
+  bool share_encoder = false;
 };
 
 class MomoVideoEncoderFactory : public webrtc::VideoEncoderFactory {
   MomoVideoEncoderFactoryConfig config_;
   std::unique_ptr<webrtc::VideoEncoderFactory> video_encoder_factory_;
   std::unique_ptr<MomoVideoEncoderFactory> internal_encoder_factory_;
+  std::shared_ptr<SharedEncoderRegistry> shared_encoders_;
 
  public:
   MomoVideoEncoderFactory(const MomoVideoEncoderFactoryConfig& config);
@@ -14,6 +14,10 @@ RTCDataManager* PeerConnectionObserver::DataManager() {
   return data_manager_;
 }
 
+void PeerConnectionObserver::SetSender(RTCMessageSender* sender) {
+  sender_ = sender;
+}
+
 void PeerConnectionObserver::OnDataChannel(
     webrtc::scoped_refptr<webrtc::DataChannelInterface> data_channel) {
   if (data_manager_ != nullptr) {
@@ -17,6 +17,9 @@ class PeerConnectionObserver : public webrtc::PeerConnectionObserver {
   ~PeerConnectionObserver();
 
   RTCDataManager* DataManager();
+  // Sender of a connection made before its session, see
+  // RTCManager::PrepareConnection. Must be called on the signaling thread.
+  void SetSender(RTCMessageSender* sender);
 
  private:
   void OnSignalingChange(
@@ -2,6 +2,7 @@
 
 // WebRTC
 #include <api/peer_connection_interface.h>
+#include <api/priority.h>
 #include <api/scoped_refptr.h>
 #include <rtc_base/ref_counted_object.h>
 
@@ -115,10 +116,15 @@ RTCConnection::~RTCConnection() {
   connection_->Close();
 }
 
+void RTCConnection::Attach(RTCMessageSender* sender) {
+  sender_ = sender;
+  observer_->SetSender(sender);
+}
+
 void RTCConnection::CreateOffer(OnCreateSuccessFunc on_success,
                                 OnCreateFailureFunc on_failure) {
   // CreateOffer is only done by Ayame, so we create DataChannels in the Offer case here
-  // Since Momo does not ReOffer, this is not a problem
+  // The offers of ICE restarts are made by RestartIce(), which does not create them again
   RTCDataManager* data_manager = observer_->DataManager();
   if (data_manager != nullptr) {
     webrtc::DataChannelInit config;
@@ -133,6 +139,7 @@ void RTCConnection::CreateOffer(OnCreateSuccessFunc on_success,
     // Reliable channel: ordered + reliable
     webrtc::DataChannelInit input_rel_cfg;
     input_rel_cfg.ordered = true;
+    input_rel_cfg.priority = webrtc::PriorityValue(webrtc::Priority::kHigh);
     auto dc_rel = connection_->CreateDataChannelOrError("input-reliable", &input_rel_cfg);
     if (!dc_rel.ok()) {
       RTC_LOG(LS_ERROR) << "CreateDataChannel(input-reliable) failed: "
@@ -144,6 +151,7 @@ void RTCConnection::CreateOffer(OnCreateSuccessFunc on_success,
     webrtc::DataChannelInit input_rt_cfg;
     input_rt_cfg.ordered = false;
     input_rt_cfg.maxRetransmits = 0;
+    input_rt_cfg.priority = webrtc::PriorityValue(webrtc::Priority::kHigh);
     auto dc_rt = connection_->CreateDataChannelOrError("input-rt", &input_rt_cfg);
     if (!dc_rt.ok()) {
       RTC_LOG(LS_ERROR) << "CreateDataChannel(input-rt) failed: "
@@ -151,6 +159,18 @@ void RTCConnection::CreateOffer(OnCreateSuccessFunc on_success,
     } else {
       data_manager->OnDataChannel(dc_rt.MoveValue());
     }
+    // Files and clipboard contents: ordered + reliable, yields to the input
+    // channels where the SCTP stack schedules by priority
+    webrtc::DataChannelInit bulk_cfg;
+    bulk_cfg.ordered = true;
+    bulk_cfg.priority = webrtc::PriorityValue(webrtc::Priority::kVeryLow);
+    auto dc_bulk = connection_->CreateDataChannelOrError("bulk", &bulk_cfg);
+    if (!dc_bulk.ok()) {
+      RTC_LOG(LS_ERROR) << "CreateDataChannel(bulk) failed: "
+                        << dc_bulk.error().message();
+    } else {
+      data_manager->OnDataChannel(dc_bulk.MoveValue());
+    }
   }
 
   using RTCOfferAnswerOptions =
@@ -179,6 +199,32 @@ void RTCConnection::CreateOffer(OnCreateSuccessFunc on_success,
       options);
 }
 
+void RTCConnection::RestartIce(OnCreateSuccessFunc on_success,
+                                OnCreateFailureFunc on_failure) {
+  using RTCOfferAnswerOptions =
+      webrtc::PeerConnectionInterface::RTCOfferAnswerOptions;
+  RTCOfferAnswerOptions options = RTCOfferAnswerOptions();
+  options.offer_to_receive_video =
+      RTCOfferAnswerOptions::kOfferToReceiveMediaTrue;
+  options.offer_to_receive_audio =
+      RTCOfferAnswerOptions::kOfferToReceiveMediaTrue;
+  options.ice_restart = true;
+
+  auto with_set_local_desc = [this, on_success = std::move(on_success)](
+                                 webrtc::SessionDescriptionInterface* desc) {
+    connection_->SetLocalDescription(
+        SetSessionDescriptionThunk::Create(nullptr, nullptr).get(), desc);
+    if (on_success) {
+      on_success(desc);
+    }
+  };
+  connection_->CreateOffer(
+      CreateSessionDescriptionThunk::Create(std::move(with_set_local_desc),
+                                            std::move(on_failure))
+          .get(),
+      options);
+}
+
 void RTCConnection::SetOffer(const std::string sdp,
                              OnSetSuccessFunc on_success,
                              OnSetFailureFunc on_failure) {
@@ -206,6 +252,7 @@ void RTCConnection::CreateAnswer(OnCreateSuccessFunc on_success,
   if (data_manager != nullptr) {
     webrtc::DataChannelInit input_rel_cfg;
     input_rel_cfg.ordered = true;
+    input_rel_cfg.priority = webrtc::PriorityValue(webrtc::Priority::kHigh);
     auto dc_rel = connection_->CreateDataChannelOrError("input-reliable", &input_rel_cfg);
     if (!dc_rel.ok()) {
       RTC_LOG(LS_ERROR) << "CreateDataChannel(input-reliable) failed: "
@@ -216,6 +263,7 @@ void RTCConnection::CreateAnswer(OnCreateSuccessFunc on_success,
     webrtc::DataChannelInit input_rt_cfg;
     input_rt_cfg.ordered = false;
     input_rt_cfg.maxRetransmits = 0;
+    input_rt_cfg.priority = webrtc::PriorityValue(webrtc::Priority::kHigh);
     auto dc_rt = connection_->CreateDataChannelOrError("input-rt", &input_rt_cfg);
     if (!dc_rt.ok()) {
       RTC_LOG(LS_ERROR) << "CreateDataChannel(input-rt) failed: "
@@ -223,6 +271,16 @@ void RTCConnection::CreateAnswer(OnCreateSuccessFunc on_success,
     } else {
       data_manager->OnDataChannel(dc_rt.MoveValue());
     }
+    webrtc::DataChannelInit bulk_cfg;
+    bulk_cfg.ordered = true;
+    bulk_cfg.priority = webrtc::PriorityValue(webrtc::Priority::kVeryLow);
+    auto dc_bulk = connection_->CreateDataChannelOrError("bulk", &bulk_cfg);
+    if (!dc_bulk.ok()) {
+      RTC_LOG(LS_ERROR) << "CreateDataChannel(bulk) failed: "
+                        << dc_bulk.error().message();
+    } else {
+      data_manager->OnDataChannel(dc_bulk.MoveValue());
+    }
   }
 
   auto with_set_local_desc = [this, on_success = std::move(on_success)](
@@ -510,3 +568,13 @@ webrtc::scoped_refptr<webrtc::PeerConnectionInterface>
 RTCConnection::GetConnection() const {
   return connection_;
 }
+
+void RTCConnection::SetVideoSender(
+    webrtc::scoped_refptr<webrtc::RtpSenderInterface> video_sender) {
+  video_sender_ = video_sender;
+}
+
+webrtc::scoped_refptr<webrtc::RtpSenderInterface>
+RTCConnection::GetVideoSender() const {
+  return video_sender_;
+}
@@ -17,6 +17,10 @@ class RTCConnection {
         connection_(connection) {}
   ~RTCConnection();
 
+  // Hands a connection made ahead of its session to the session's sender.
+  // Must be called on the signaling thread.
+  void Attach(RTCMessageSender* sender);
+
   typedef std::function<void(webrtc::SessionDescriptionInterface*)>
       OnCreateSuccessFunc;
   typedef std::function<void(webrtc::RTCError)> OnCreateFailureFunc;
@@ -26,6 +30,10 @@ class RTCConnection {
 
   void CreateOffer(OnCreateSuccessFunc on_success = nullptr,
                    OnCreateFailureFunc on_failure = nullptr);
+  // Offer with new ICE credentials for the existing connection, without
+  // creating the data channels again
+  void RestartIce(OnCreateSuccessFunc on_success = nullptr,
+                  OnCreateFailureFunc on_failure = nullptr);
   void SetOffer(const std::string sdp,
                 OnSetSuccessFunc on_success = nullptr,
                 OnSetFailureFunc on_failure = nullptr);
@@ -52,6 +60,11 @@ class RTCConnection {
 
   webrtc::scoped_refptr<webrtc::PeerConnectionInterface> GetConnection() const;
 
+  // Sender of the local video track, set by RTCManager::InitTracks
+  void SetVideoSender(
+      webrtc::scoped_refptr<webrtc::RtpSenderInterface> video_sender);
+  webrtc::scoped_refptr<webrtc::RtpSenderInterface> GetVideoSender() const;
+
  private:
   webrtc::scoped_refptr<webrtc::MediaStreamInterface> GetLocalStream();
   webrtc::scoped_refptr<webrtc::AudioTrackInterface> GetLocalAudioTrack();
@@ -67,6 +80,7 @@ class RTCConnection {
   webrtc::scoped_refptr<webrtc::PeerConnectionInterface> connection_;
   std::vector<webrtc::RtpEncodingParameters> encodings_;
   std::string mid_;
+  webrtc::scoped_refptr<webrtc::RtpSenderInterface> video_sender_;
 };
 
 #endif
@@ -1,5 +1,6 @@
 #include "rtc_manager.h"
 
+#include <algorithm>
 #include <iostream>
 
 // WebRTC
@@ -8,6 +9,7 @@
 #include <api/audio_codecs/builtin_audio_decoder_factory.h>
 #include <api/audio_codecs/builtin_audio_encoder_factory.h>
 #include <api/create_peerconnection_factory.h>
+#include <api/make_ref_counted.h>
 #include <modules/audio_processing/include/audio_processing.h>
 
 #if defined(USE_FAKE_CAPTURE_DEVICE)
@@ -27,8 +29,11 @@
 #include <pc/video_track_source_proxy.h>
 #include <rtc_base/logging.h>
 #include <rtc_base/ssl_adapter.h>
+#include <rtc_base/time_utils.h>
 #include <system_wrappers/include/field_trial.h>
 
+#include "frame_trace_transformer.h"
+#include "metrics/metrics_registry.h"
 #include "momo_video_decoder_factory.h"
 #include "momo_video_encoder_factory.h"
 #include "peer_connection_observer.h"
@@ -80,7 +85,7 @@ RTCManager::RTCManager(
     cc = "GCC";
   }
 
-  std::string trials;
+  std::string& trials = field_trials_;
   if (cc == "SQP") {
     // Field trials settings for SQP
     trials += "WebRTC-Bwe-InjectedCongestionController/Enabled/";
@@ -90,8 +95,16 @@ RTCManager::RTCManager(
     // GCC is the default, so no explicit specification is needed, but for logging
     RTC_LOG(LS_INFO) << "Using GCC congestion control (default)";
   }
+  if (config_.low_latency) {
+    // Render received video as soon as it is decoded instead of smoothing it
+    // with the jitter buffer's target delay
+    trials += "WebRTC-ForcePlayoutDelay/min_ms:0,max_ms:0/";
+    trials += "WebRTC-ZeroPlayoutDelay/min_pacing:0ms/";
+    RTC_LOG(LS_INFO) << "Low latency playout enabled";
+  }
 
-  // Initialize field trials globally (this method is used in WebRTC m138)
+  // Initialize field trials globally (this method is used in WebRTC m138).
+  // WebRTC keeps the pointer, so the string is a member.
   if (!trials.empty()) {
     webrtc::field_trial::InitFieldTrialsFromString(trials.c_str());
   }
@@ -146,6 +159,10 @@ RTCManager::RTCManager(
     ec.cuda_context = cf.cuda_context;
 #endif
     ec.openh264 = cf.openh264;
+    ec.content_profile = cf.video_content_profile;
+    ec.low_latency = cf.low_latency;
+    ec.intra_refresh = cf.intra_refresh;
+    ec.share_encoder = cf.share_video_encoder;
     dependencies.video_encoder_factory =
         std::unique_ptr<webrtc::VideoEncoderFactory>(
             absl::make_unique<MomoVideoEncoderFactory>(ec));
@@ -223,7 +240,10 @@ RTCManager::RTCManager(
     video_track_ =
         factory_->CreateVideoTrack(video_source, Util::GenerateRandomChars());
     if (video_track_) {
-      if (config_.fixed_resolution) {
+      video_track_source_ = video_track_source;
+      // kText makes WebRTC encode in screensharing mode
+      if (config_.fixed_resolution ||
+          config_.video_content_profile == "desktop") {
         video_track_->set_content_hint(
             webrtc::VideoTrackInterface::ContentHint::kText);
       }
@@ -233,9 +253,22 @@ RTCManager::RTCManager(
   }
 }
 
+namespace {
+
+// Older warm connections may have gathered their candidates on a network
+// that is gone
+constexpr int64_t kMaxWarmConnectionAgeMs = 5 * 60 * 1000;
+
+}  // namespace
+
 RTCManager::~RTCManager() {
+  // Tasks of PrepareConnection still queued do nothing
+  signaling_thread_->BlockingCall([this]() {
+    stopping_ = true;
+    warm_connection_ = nullptr;
+  });
   config_.create_adm = nullptr;
-  video_sender_ = nullptr;
+  video_track_source_ = nullptr;
   audio_track_ = nullptr;
   video_track_ = nullptr;
   context_ = nullptr;
@@ -276,7 +309,96 @@ class RawCryptString : public webrtc::revive::CryptStringImpl {
 std::shared_ptr<RTCConnection> RTCManager::CreateConnection(
     webrtc::PeerConnectionInterface::RTCConfiguration rtc_config,
     RTCMessageSender* sender) {
-  rtc_config.sdp_semantics = webrtc::SdpSemantics::kUnifiedPlan;
+  ApplyConfig(&rtc_config);
+
+  std::shared_ptr<RTCConnection> rtc_connection;
+  if (config_.warm_connection) {
+    rtc_connection = signaling_thread_->BlockingCall(
+        [this, &rtc_config, sender]() -> std::shared_ptr<RTCConnection> {
+          std::shared_ptr<RTCConnection> conn = std::move(warm_connection_);
+          warm_connection_ = nullptr;
+          if (!conn) {
+            return nullptr;
+          }
+          if (!(warm_config_ == rtc_config)) {
+            RTC_LOG(LS_INFO) << "The warm connection was made for other ICE "
+                                "servers, creating a new one";
+            return nullptr;
+          }
+          if (webrtc::TimeMillis() - warm_created_ms_ >
+              kMaxWarmConnectionAgeMs) {
+            RTC_LOG(LS_INFO) << "The warm connection is too old, creating a "
+                                "new one";
+            return nullptr;
+          }
+          conn->Attach(sender);
+          return conn;
+        });
+    MetricsRegistry::Instance().Add("warm_connection",
+                                    rtc_connection ? "used" : "cold", 1);
+  }
+  if (!rtc_connection) {
+    rtc_connection = CreatePeerConnection(rtc_config, sender);
+    if (!rtc_connection) {
+      return nullptr;
+    }
+  }
+  // For the next session
+  PrepareConnection(rtc_config);
+
+  {
+    std::lock_guard<std::mutex> lock(connections_mutex_);
+    connections_.erase(
+        std::remove_if(connections_.begin(), connections_.end(),
+                       [](const std::weak_ptr<RTCConnection>& c) {
+                         return c.expired();
+                       }),
+        connections_.end());
+    connections_.push_back(rtc_connection);
+  }
+  return rtc_connection;
+}
+
+void RTCManager::PrepareConnection(
+    webrtc::PeerConnectionInterface::RTCConfiguration rtc_config) {
+  if (!config_.warm_connection) {
+    return;
+  }
+  ApplyConfig(&rtc_config);
+  signaling_thread_->PostTask([this, rtc_config = std::move(rtc_config)]() {
+    if (stopping_) {
+      return;
+    }
+    const int64_t start_ms = webrtc::TimeMillis();
+    warm_connection_ = CreatePeerConnection(rtc_config, nullptr);
+    warm_config_ = rtc_config;
+    warm_created_ms_ = webrtc::TimeMillis();
+    if (warm_connection_) {
+      MetricsRegistry::Instance().Set(
+          "warm_connection", "create_ms",
+          static_cast<double>(warm_created_ms_ - start_ms));
+    }
+  });
+}
+
+void RTCManager::ApplyConfig(
+    webrtc::PeerConnectionInterface::RTCConfiguration* rtc_config) {
+  rtc_config->sdp_semantics = webrtc::SdpSemantics::kUnifiedPlan;
+  if (config_.low_latency) {
+    // Let NetEq drop queued audio quickly after a burst
+    rtc_config->audio_jitter_buffer_fast_accelerate = true;
+  }
+  if (config_.warm_connection) {
+    // Gathers the candidates when the connection is created instead of when
+    // the local description is set
+    rtc_config->ice_candidate_pool_size =
+        std::max(rtc_config->ice_candidate_pool_size, 1);
+  }
+}
+
+std::shared_ptr<RTCConnection> RTCManager::CreatePeerConnection(
+    const webrtc::PeerConnectionInterface::RTCConfiguration& rtc_config,
+    RTCMessageSender* sender) {
   std::unique_ptr<PeerConnectionObserver> observer(
       new PeerConnectionObserver(sender, receiver_, &data_manager_dispatcher_));
   webrtc::PeerConnectionDependencies dependencies(observer.get());
@@ -332,6 +454,20 @@ std::shared_ptr<RTCConnection> RTCManager::CreateConnection(
                                          connection.value());
 }
 
+std::vector<webrtc::scoped_refptr<webrtc::RtpSenderInterface>>
+RTCManager::GetVideoSenders() {
+  std::vector<webrtc::scoped_refptr<webrtc::RtpSenderInterface>> senders;
+  std::lock_guard<std::mutex> lock(connections_mutex_);
+  for (const auto& c : connections_) {
+    if (auto conn = c.lock()) {
+      if (auto sender = conn->GetVideoSender()) {
+        senders.push_back(sender);
+      }
+    }
+  }
+  return senders;
+}
+
 void RTCManager::InitTracks(RTCConnection* conn,
                             const std::optional<std::string>& direction) {
   if (direction.has_value() && *direction != "sendrecv" &&
@@ -361,7 +497,13 @@ void RTCManager::InitTracks(RTCConnection* conn,
       webrtc::RTCErrorOr<webrtc::scoped_refptr<webrtc::RtpSenderInterface>>
           video_add_result = connection->AddTrack(video_track_, {stream_id});
       if (video_add_result.ok()) {
-        video_sender_ = video_add_result.value();
+        auto video_sender = video_add_result.value();
+        if (config_.frame_trace) {
+          video_sender->SetEncoderToPacketizerFrameTransformer(
+              webrtc::make_ref_counted<FrameTraceTransformer>());
+        }
+        std::lock_guard<std::mutex> lock(connections_mutex_);
+        conn->SetVideoSender(video_sender);
       } else {
         RTC_LOG(LS_WARNING) << __FUNCTION__ << ": Cannot add video_track_";
       }
@@ -405,13 +547,49 @@ void RTCManager::InitTracks(RTCConnection* conn,
 }
 
 void RTCManager::SetParameters() {
-  if (!video_sender_) {
-    return;
+  for (const auto& video_sender : GetVideoSenders()) {
+    webrtc::RtpParameters parameters = video_sender->GetParameters();
+    parameters.degradation_preference = config_.GetPriority();
+    video_sender->SetParameters(parameters);
+  }
+}
+
+bool RTCManager::SetVideoLimits(double scale_resolution_down_by,
+                                int max_framerate,
+                                std::optional<int> max_bitrate_bps) {
+  auto video_senders = GetVideoSenders();
+  if (video_senders.empty()) {
+    return false;
+  }
+
+  bool applied = true;
+  for (const auto& video_sender : video_senders) {
+    webrtc::RtpParameters parameters = video_sender->GetParameters();
+    // Simulcast layers have their own scales and rates, leave them to WebRTC
+    if (parameters.encodings.size() != 1) {
+      applied = false;
+      continue;
+    }
+    auto& encoding = parameters.encodings[0];
+    encoding.scale_resolution_down_by = scale_resolution_down_by;
+    encoding.max_framerate = max_framerate;
+    encoding.max_bitrate_bps = max_bitrate_bps;
+    auto error = video_sender->SetParameters(parameters);
+    if (!error.ok()) {
+      RTC_LOG(LS_WARNING) << __FUNCTION__ << ": Failed to set parameters: "
+                          << error.message();
+      applied = false;
+    }
+  }
+  if (!applied) {
+    return false;
   }
 
-  webrtc::RtpParameters parameters = video_sender_->GetParameters();
-  parameters.degradation_preference = config_.GetPriority();
-  video_sender_->SetParameters(parameters);
+  // The encoder would drop the extra frames anyway, do not capture them
+  if (video_track_source_) {
+    video_track_source_->SetMaxFramerate(max_framerate);
+  }
+  return true;
 }
 
 webrtc::scoped_refptr<webrtc::PeerConnectionFactoryInterface>
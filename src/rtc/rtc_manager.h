@@ -2,6 +2,10 @@
 #define RTC_MANAGER_H_
 
 #include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <vector>
 
 // WebRTC
 #include <api/environment/environment_factory.h>
@@ -99,6 +103,30 @@ struct RTCManagerConfig {
   // Select the congestion control algorithm (GCC / SQP)
   std::string congestion_controller = "GCC";
 
+  // Tuning of the encoders for the video content (auto / camera / desktop).
+  // "desktop" also marks the video track as text content.
+  std::string video_content_profile = "auto";
+
+  // --low-latency: zero playout delay on received streams and the low latency
+  // profile of the software encoders
+  bool low_latency = false;
+
+  // --intra-refresh: no periodic IDR frames; NVENC refreshes with intra
+  // blocks, OpenH264 keeps the key frames sent after loss small
+  bool intra_refresh = false;
+
+  // --frame-trace: stamp the packetization of each encoded frame for
+  // FrameTracer
+  bool frame_trace = false;
+
+  // Connections that negotiate the same codec at the same resolution share
+  // one encoder (P2P mode, where every viewer has its own connection)
+  bool share_video_encoder = false;
+
+  // --warm-connection: keep a connection with its ICE candidates gathered
+  // for the next session
+  bool warm_connection = false;
+
   std::function<webrtc::scoped_refptr<webrtc::AudioDeviceModule>()> create_adm;
 };
 
@@ -113,9 +141,22 @@ class RTCManager {
   std::shared_ptr<RTCConnection> CreateConnection(
       webrtc::PeerConnectionInterface::RTCConfiguration rtc_config,
       RTCMessageSender* sender);
+  // With --warm-connection, creates a connection in the background for the
+  // next CreateConnection with the same configuration. CreateConnection
+  // calls this by itself for the session after it.
+  void PrepareConnection(
+      webrtc::PeerConnectionInterface::RTCConfiguration rtc_config);
   void InitTracks(RTCConnection* conn,
                   const std::optional<std::string>& direction);
+  // Applied to the video senders of every live connection
   void SetParameters();
+  // Resolution scale, frame rate and bitrate cap of the video senders, for
+  // --network-adaptation. Also caps the frame rate of the video source.
+  // Return value: false without a video sender, with simulcast, or if any of
+  // the senders rejected the limits
+  bool SetVideoLimits(double scale_resolution_down_by,
+                      int max_framerate,
+                      std::optional<int> max_bitrate_bps);
 
   webrtc::scoped_refptr<webrtc::PeerConnectionFactoryInterface> GetFactory()
       const;
@@ -133,7 +174,7 @@ class RTCManager {
   webrtc::scoped_refptr<webrtc::ConnectionContext> context_;
   webrtc::scoped_refptr<webrtc::AudioTrackInterface> audio_track_;
   webrtc::scoped_refptr<webrtc::VideoTrackInterface> video_track_;
-  webrtc::scoped_refptr<webrtc::RtpSenderInterface> video_sender_;
+  webrtc::scoped_refptr<sora::ScalableVideoTrackSource> video_track_source_;
   std::unique_ptr<webrtc::Thread> network_thread_;
   std::unique_ptr<webrtc::Thread> worker_thread_;
   std::unique_ptr<webrtc::Thread> signaling_thread_;
@@ -142,6 +183,27 @@ class RTCManager {
   RTCDataManagerDispatcher data_manager_dispatcher_;
   // Keep the AudioDeviceModule for dynamic switching
   webrtc::scoped_refptr<webrtc::AudioDeviceModule> adm_;
+  // Passed to InitFieldTrialsFromString, which does not copy it
+  std::string field_trials_;
+
+  void ApplyConfig(
+      webrtc::PeerConnectionInterface::RTCConfiguration* rtc_config);
+  std::shared_ptr<RTCConnection> CreatePeerConnection(
+      const webrtc::PeerConnectionInterface::RTCConfiguration& rtc_config,
+      RTCMessageSender* sender);
+
+  // The connection made by PrepareConnection. Only used on the signaling
+  // thread.
+  std::shared_ptr<RTCConnection> warm_connection_;
+  webrtc::PeerConnectionInterface::RTCConfiguration warm_config_;
+  int64_t warm_created_ms_ = 0;
+  bool stopping_ = false;
+
+  // Video senders of the connections that are still alive
+  std::vector<webrtc::scoped_refptr<webrtc::RtpSenderInterface>>
+  GetVideoSenders();
+  std::mutex connections_mutex_;
+  std::vector<std::weak_ptr<RTCConnection>> connections_;
 };
 
 #endif
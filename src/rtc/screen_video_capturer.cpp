@@ -9,6 +9,9 @@
 
 #include <stdint.h>
 
+#include <algorithm>
+#include <cmath>
+
 #include <iostream>
 #include <memory>
 #include <cstring>
@@ -24,6 +27,8 @@
 #include <rtc_base/time_utils.h>
 #include <third_party/libyuv/include/libyuv.h>
 
+#include "metrics/frame_tracer.h"
+#include "metrics/metrics_registry.h"
 #include "native_buffer.h"
 
 const std::string ScreenVideoCapturer::GetSourceListString() {
@@ -60,14 +65,16 @@ ScreenVideoCapturer::ScreenVideoCapturer(
     size_t max_width,
     size_t max_height,
     size_t target_fps,
-    bool include_cursor)
+    bool include_cursor,
+    bool screencast)
     : sora::ScalableVideoTrackSource(sora::ScalableVideoTrackSourceConfig()),
       max_width_(max_width),
       max_height_(max_height),
       requested_frame_duration_((int)(1000.0f / target_fps)),
       max_cpu_consumption_percentage_(50),
       quit_(false),
-      include_cursor_(include_cursor) {
+      include_cursor_(include_cursor),
+      screencast_(screencast) {
   auto options = CreateDesktopCaptureOptions();
   std::unique_ptr<webrtc::DesktopCapturer> screen_capturer(
       //webrtc::DesktopCapturer::CreateWindowCapturer(options));
@@ -127,12 +134,17 @@ void ScreenVideoCapturer::CaptureThread(void* obj) {
   }
 }
 
+void ScreenVideoCapturer::SetMaxFramerate(int max_framerate) {
+  min_frame_duration_ = max_framerate > 0 ? 1000 / max_framerate : 0;
+}
+
 bool ScreenVideoCapturer::CaptureProcess() {
   if (quit_) {
     return false;
   }
 
   int64_t started_time = webrtc::TimeMillis();
+  capture_started_us_ = webrtc::TimeMicros();
 
   if (capturer_) {
     capturer_->CaptureFrame();
@@ -169,9 +181,26 @@ bool ScreenVideoCapturer::CaptureProcess() {
   }
 
   int last_capture_duration = (int)(webrtc::TimeMillis() - started_time);
+
+  // Share of the time the capture thread is busy grabbing and converting
+  const int64_t now_us = webrtc::TimeMicros();
+  capture_busy_us_ += now_us - capture_started_us_;
+  captures_++;
+  if (stats_started_us_ == 0) {
+    stats_started_us_ = capture_started_us_;
+  } else if (now_us - stats_started_us_ >= webrtc::kNumMicrosecsPerSec) {
+    auto& registry = MetricsRegistry::Instance();
+    registry.Set("screen_capture", "capture_ms",
+                 capture_busy_us_ / 1000.0 / captures_);
+    registry.Set("screen_capture", "cpu_percent",
+                 100.0 * capture_busy_us_ / (now_us - stats_started_us_));
+    stats_started_us_ = now_us;
+    capture_busy_us_ = 0;
+    captures_ = 0;
+  }
   int capture_period =
-      std::max((last_capture_duration * 100) / max_cpu_consumption_percentage_,
-               requested_frame_duration_);
+      std::max({(last_capture_duration * 100) / max_cpu_consumption_percentage_,
+                requested_frame_duration_, min_frame_duration_.load()});
   int delta_time = capture_period - last_capture_duration;
   if (delta_time > 0) {
     webrtc::Thread::SleepMs(delta_time);
@@ -222,6 +251,17 @@ void ScreenVideoCapturer::OnCaptureResult(
     return;
   }
 
+  // Bounding box of what changed since the previous frame, in source
+  // coordinates. Everything after a size change.
+  webrtc::DesktopRect damage;
+  bool full_damage = !previous_frame_size_.equals(frame->size());
+  if (!full_damage) {
+    for (webrtc::DesktopRegion::Iterator it(frame->updated_region());
+         !it.IsAtEnd(); it.Advance()) {
+      damage.UnionWith(it.rect());
+    }
+  }
+
   if (!previous_frame_size_.equals(frame->size())) {
     output_frame_.reset();
     capture_width_ = frame->size().width();
@@ -257,6 +297,10 @@ void ScreenVideoCapturer::OnCaptureResult(
       webrtc::I420Buffer::Create(output_size.width(), output_size.height()));
   dst_buffer->InitializeData();
 
+  // The damage in output coordinates
+  webrtc::VideoFrame::UpdateRect update_rect{0, 0, output_size.width(),
+                                             output_size.height()};
+
   if (frame->size().width() <= 2 || frame->size().height() <= 1) {
   } else {
     const int32_t frame_width = frame->size().width();
@@ -302,6 +346,18 @@ void ScreenVideoCapturer::OnCaptureResult(
                         output_rect.height(), libyuv::kFilterBox);
       output_data = output_frame_->data();
       output_stride = output_frame_->stride();
+      if (!full_damage) {
+        // One more pixel on each side for the box filter
+        const double sx =
+            (double)output_rect.width() / (double)frame->size().width();
+        const double sy =
+            (double)output_rect.height() / (double)frame->size().height();
+        damage = webrtc::DesktopRect::MakeLTRB(
+            output_rect.left() + (int)(damage.left() * sx) - 1,
+            output_rect.top() + (int)(damage.top() * sy) - 1,
+            output_rect.left() + (int)std::ceil(damage.right() * sx) + 1,
+            output_rect.top() + (int)std::ceil(damage.bottom() * sy) + 1);
+      }
     } else {
       output_data = frame->data();
       output_stride = frame->stride();
@@ -317,6 +373,20 @@ void ScreenVideoCapturer::OnCaptureResult(
       RTC_LOG(LS_ERROR) << "ConvertToI420 Failed";
       return;
     }
+    if (!full_damage) {
+      // Even, so that the chroma planes are covered too
+      damage.IntersectWith(webrtc::DesktopRect::MakeSize(output_size));
+      if (damage.is_empty()) {
+        update_rect = webrtc::VideoFrame::UpdateRect{0, 0, 0, 0};
+      } else {
+        const int left = damage.left() & ~1;
+        const int top = damage.top() & ~1;
+        update_rect = webrtc::VideoFrame::UpdateRect{
+            left, top,
+            std::min(output_size.width(), (damage.right() + 1) & ~1) - left,
+            std::min(output_size.height(), (damage.bottom() + 1) & ~1) - top};
+      }
+    }
     //for (uint32_t y = 0; y < output_size.height(); y++) {
     //  memcpy(native_buffer->MutableData() + y * native_buffer->width() * 4,
     //         output_data + y * output_stride, native_buffer->width() * 4);
@@ -328,6 +398,20 @@ void ScreenVideoCapturer::OnCaptureResult(
                                         .set_timestamp_rtp(0)
                                         .set_timestamp_ms(webrtc::TimeMillis())
                                         .set_rotation(webrtc::kVideoRotation_0)
+                                        .set_update_rect(update_rect)
                                         .build();
+  auto& tracer = FrameTracer::Instance();
+  if (tracer.IsEnabled()) {
+    FrameTraceEvent event;
+    event.timestamp_us = captureFrame.timestamp_us();
+    event.stage = FrameTraceStage::kCaptureStart;
+    event.time_us = capture_started_us_;
+    tracer.Record(event);
+    event.stage = FrameTraceStage::kCaptureEnd;
+    event.time_us = webrtc::TimeMicros();
+    event.width = captureFrame.width();
+    event.height = captureFrame.height();
+    tracer.Record(event);
+  }
   ScalableVideoTrackSource::OnFrame(captureFrame);
 }
@@ -1,6 +1,7 @@
 #ifndef SCREEN_VIDEO_CAPTURER_H_
 #define SCREEN_VIDEO_CAPTURER_H_
 
+#include <atomic>
 #include <memory>
 #include <vector>
 
@@ -21,9 +22,18 @@ class ScreenVideoCapturer : public sora::ScalableVideoTrackSource,
                       size_t max_width,
                       size_t max_height,
                       size_t target_fps,
-                      bool include_cursor);
+                      bool include_cursor,
+                      bool screencast);
   ~ScreenVideoCapturer();
 
+  // Lets WebRTC encode in screensharing mode, which selects the desktop
+  // content profile of the encoders with --video-content-profile auto.
+  // false with --video-content-profile camera
+  bool is_screencast() const override { return screencast_; }
+
+  // Frames go to OnFrame without the adapter, so capture less often instead
+  void SetMaxFramerate(int max_framerate) override;
+
  private:
   static void CaptureThread(void* obj);
   bool CaptureProcess();
@@ -36,6 +46,8 @@ class ScreenVideoCapturer : public sora::ScalableVideoTrackSource,
   size_t capture_width_;
   size_t capture_height_;
   int requested_frame_duration_;
+  // 1000 / SetMaxFramerate(), 0 without a cap
+  std::atomic<int> min_frame_duration_{0};
   int max_cpu_consumption_percentage_;
   webrtc::DesktopSize previous_frame_size_;
   std::unique_ptr<webrtc::DesktopFrame> output_frame_;
@@ -43,6 +55,13 @@ class ScreenVideoCapturer : public sora::ScalableVideoTrackSource,
   std::unique_ptr<webrtc::DesktopCapturer> capturer_;
   std::atomic<bool> quit_;
   bool include_cursor_{false};
+  bool screencast_{true};
+  // webrtc::TimeMicros() when the current CaptureFrame() started
+  int64_t capture_started_us_ = 0;
+  // Time spent capturing since stats_started_us_, published once a second
+  int64_t stats_started_us_ = 0;
+  int64_t capture_busy_us_ = 0;
+  int captures_ = 0;
 };
 
 #endif  // SCREEN_VIDEO_CAPTURER_H_
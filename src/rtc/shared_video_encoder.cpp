@@ -0,0 +1,362 @@
+#include "shared_video_encoder.h"
+
+#include <algorithm>
+
+// WebRTC
+#include <api/video_codecs/scalability_mode.h>
+#include <modules/video_coding/include/video_error_codes.h>
+#include <rtc_base/logging.h>
+
+#include "metrics/metrics_registry.h"
+
+namespace {
+
+const char kMetricsGroup[] = "shared_encoder";
+
+// Everything the encoder is initialized with that differs between
+// connections sending the same track
+std::string MakeKey(const std::string& format,
+                    const webrtc::VideoCodec& codec) {
+  std::string key = format;
+  key += " " + std::to_string(codec.width) + "x" +
+         std::to_string(codec.height);
+  key += " mode=" + std::to_string(static_cast<int>(codec.mode));
+  key += " streams=" + std::to_string(codec.numberOfSimulcastStreams);
+  for (int i = 0; i < codec.numberOfSimulcastStreams; i++) {
+    key += " " + std::to_string(codec.simulcastStream[i].width) + "x" +
+           std::to_string(codec.simulcastStream[i].height);
+  }
+  if (auto mode = codec.GetScalabilityMode()) {
+    key += " " + std::string(webrtc::ScalabilityModeToString(*mode));
+  }
+  return key;
+}
+
+}  // namespace
+
+SharedEncoderGroup::SharedEncoderGroup(
+    std::string key,
+    std::unique_ptr<webrtc::VideoEncoder> encoder)
+    : key_(std::move(key)), encoder_(std::move(encoder)) {}
+
+SharedEncoderGroup::~SharedEncoderGroup() {
+  std::lock_guard<std::mutex> lock(encoder_mutex_);
+  encoder_->RegisterEncodeCompleteCallback(nullptr);
+  encoder_->Release();
+}
+
+int SharedEncoderGroup::InitEncode(
+    const webrtc::VideoCodec* codec_settings,
+    const webrtc::VideoEncoder::Settings& settings) {
+  std::lock_guard<std::mutex> lock(encoder_mutex_);
+  encoder_->RegisterEncodeCompleteCallback(this);
+  return encoder_->InitEncode(codec_settings, settings);
+}
+
+void SharedEncoderGroup::Join(SharedVideoEncoder* member) {
+  {
+    std::lock_guard<std::mutex> lock(members_mutex_);
+    members_.push_back(member);
+  }
+  // The new connection can only start decoding at a key frame
+  std::lock_guard<std::mutex> lock(encoder_mutex_);
+  key_frame_pending_ = true;
+}
+
+void SharedEncoderGroup::Leave(SharedVideoEncoder* member) {
+  {
+    std::lock_guard<std::mutex> lock(members_mutex_);
+    members_.erase(std::remove(members_.begin(), members_.end(), member),
+                   members_.end());
+  }
+  std::lock_guard<std::mutex> lock(encoder_mutex_);
+  if (rates_.erase(member) > 0) {
+    ApplyRates();
+  }
+}
+
+void SharedEncoderGroup::SetCallback(SharedVideoEncoder* member,
+                                     webrtc::EncodedImageCallback* callback) {
+  std::lock_guard<std::mutex> lock(members_mutex_);
+  member->callback_ = callback;
+}
+
+size_t SharedEncoderGroup::members() {
+  std::lock_guard<std::mutex> lock(members_mutex_);
+  return members_.size();
+}
+
+int SharedEncoderGroup::Encode(
+    const webrtc::VideoFrame& frame,
+    const std::vector<webrtc::VideoFrameType>* frame_types) {
+  bool key_frame = false;
+  if (frame_types != nullptr) {
+    key_frame = std::any_of(frame_types->begin(), frame_types->end(),
+                            [](webrtc::VideoFrameType type) {
+                              return type ==
+                                     webrtc::VideoFrameType::kVideoFrameKey;
+                            });
+  }
+
+  std::lock_guard<std::mutex> lock(encoder_mutex_);
+  if (frame.timestamp_us() <= last_timestamp_us_) {
+    // Every connection gets the same frames from the track, this one has been
+    // encoded for another connection already
+    key_frame_pending_ |= key_frame;
+    MetricsRegistry::Instance().Add(kMetricsGroup, "shared_frames", 1);
+    return WEBRTC_VIDEO_CODEC_OK;
+  }
+  last_timestamp_us_ = frame.timestamp_us();
+
+  if (!key_frame && !key_frame_pending_) {
+    return encoder_->Encode(frame, frame_types);
+  }
+  key_frame_pending_ = false;
+  std::vector<webrtc::VideoFrameType> key_frame_types(
+      frame_types != nullptr && !frame_types->empty() ? frame_types->size()
+                                                      : 1,
+      webrtc::VideoFrameType::kVideoFrameKey);
+  return encoder_->Encode(frame, &key_frame_types);
+}
+
+void SharedEncoderGroup::SetRates(
+    SharedVideoEncoder* member,
+    const webrtc::VideoEncoder::RateControlParameters& parameters) {
+  std::lock_guard<std::mutex> lock(encoder_mutex_);
+  rates_[member] = parameters;
+  ApplyRates();
+}
+
+void SharedEncoderGroup::ApplyRates() {
+  // The lowest target of the connections that are sending at all; a paused
+  // connection must not pause the others
+  const webrtc::VideoEncoder::RateControlParameters* lowest = nullptr;
+  for (const auto& [member, rates] : rates_) {
+    if (rates.bitrate.get_sum_bps() == 0) {
+      continue;
+    }
+    if (lowest == nullptr ||
+        rates.bitrate.get_sum_bps() < lowest->bitrate.get_sum_bps()) {
+      lowest = &rates;
+    }
+  }
+  if (lowest == nullptr) {
+    if (rates_.empty()) {
+      return;
+    }
+    lowest = &rates_.begin()->second;
+  }
+  if (applied_rates_ && *applied_rates_ == *lowest) {
+    return;
+  }
+  applied_rates_ = *lowest;
+  encoder_->SetRates(*lowest);
+}
+
+void SharedEncoderGroup::OnPacketLossRateUpdate(float packet_loss_rate) {
+  std::lock_guard<std::mutex> lock(encoder_mutex_);
+  encoder_->OnPacketLossRateUpdate(packet_loss_rate);
+}
+
+void SharedEncoderGroup::OnRttUpdate(int64_t rtt_ms) {
+  std::lock_guard<std::mutex> lock(encoder_mutex_);
+  encoder_->OnRttUpdate(rtt_ms);
+}
+
+void SharedEncoderGroup::OnLossNotification(
+    const webrtc::VideoEncoder::LossNotification& loss_notification) {
+  std::lock_guard<std::mutex> lock(encoder_mutex_);
+  encoder_->OnLossNotification(loss_notification);
+}
+
+webrtc::VideoEncoder::EncoderInfo SharedEncoderGroup::GetEncoderInfo() {
+  std::lock_guard<std::mutex> lock(encoder_mutex_);
+  return encoder_->GetEncoderInfo();
+}
+
+webrtc::EncodedImageCallback::Result SharedEncoderGroup::OnEncodedImage(
+    const webrtc::EncodedImage& encoded_image,
+    const webrtc::CodecSpecificInfo* codec_specific_info) {
+  std::lock_guard<std::mutex> lock(members_mutex_);
+  Result result(Result::OK);
+  for (auto* member : members_) {
+    if (member->callback_ == nullptr) {
+      continue;
+    }
+    auto r = member->callback_->OnEncodedImage(encoded_image,
+                                               codec_specific_info);
+    if (r.error != Result::OK) {
+      result = r;
+    }
+  }
+  return result;
+}
+
+void SharedEncoderGroup::OnDroppedFrame(DropReason reason) {
+  std::lock_guard<std::mutex> lock(members_mutex_);
+  for (auto* member : members_) {
+    if (member->callback_ != nullptr) {
+      member->callback_->OnDroppedFrame(reason);
+    }
+  }
+}
+
+std::shared_ptr<SharedEncoderGroup> SharedEncoderRegistry::Join(
+    const std::string& key,
+    SharedVideoEncoder* member,
+    std::unique_ptr<webrtc::VideoEncoder>* encoder,
+    const webrtc::VideoCodec* codec_settings,
+    const webrtc::VideoEncoder::Settings& settings,
+    int* error) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  std::shared_ptr<SharedEncoderGroup> group;
+  auto it = groups_.find(key);
+  if (it != groups_.end()) {
+    group = it->second.lock();
+  }
+  if (group) {
+    RTC_LOG(LS_INFO) << "SharedVideoEncoder: joined " << key << " ("
+                     << group->members() + 1 << " connections)";
+  } else {
+    group = std::make_shared<SharedEncoderGroup>(key, std::move(*encoder));
+    *error = group->InitEncode(codec_settings, settings);
+    if (*error != WEBRTC_VIDEO_CODEC_OK) {
+      return nullptr;
+    }
+    groups_[key] = group;
+    RTC_LOG(LS_INFO) << "SharedVideoEncoder: created " << key;
+  }
+  group->Join(member);
+  *error = WEBRTC_VIDEO_CODEC_OK;
+  PublishMetrics();
+  return group;
+}
+
+void SharedEncoderRegistry::Leave(std::shared_ptr<SharedEncoderGroup> group,
+                                  SharedVideoEncoder* member) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  group->Leave(member);
+  // The last one out releases the encoder
+  group.reset();
+  PublishMetrics();
+}
+
+void SharedEncoderRegistry::PublishMetrics() {
+  int encoders = 0;
+  size_t connections = 0;
+  for (auto it = groups_.begin(); it != groups_.end();) {
+    if (auto group = it->second.lock()) {
+      encoders++;
+      connections += group->members();
+      ++it;
+    } else {
+      it = groups_.erase(it);
+    }
+  }
+  auto& registry = MetricsRegistry::Instance();
+  registry.Set(kMetricsGroup, "encoders", encoders);
+  registry.Set(kMetricsGroup, "connections", static_cast<double>(connections));
+}
+
+SharedVideoEncoder::SharedVideoEncoder(
+    std::shared_ptr<SharedEncoderRegistry> registry,
+    const webrtc::SdpVideoFormat& format,
+    CreateEncoder create)
+    : registry_(std::move(registry)),
+      format_(format.ToString()),
+      create_(std::move(create)),
+      encoder_(create_()) {}
+
+SharedVideoEncoder::~SharedVideoEncoder() {
+  Release();
+}
+
+void SharedVideoEncoder::SetFecControllerOverride(
+    webrtc::FecControllerOverride* fec_controller_override) {
+  // Belongs to one connection, the shared encoder outlives it
+}
+
+int SharedVideoEncoder::Release() {
+  if (group_) {
+    registry_->Leave(std::move(group_), this);
+    group_ = nullptr;
+  }
+  if (encoder_) {
+    return encoder_->Release();
+  }
+  return WEBRTC_VIDEO_CODEC_OK;
+}
+
+int SharedVideoEncoder::InitEncode(
+    const webrtc::VideoCodec* codec_settings,
+    const webrtc::VideoEncoder::Settings& settings) {
+  Release();
+  if (!encoder_) {
+    // Taken over by a group that has been released since
+    encoder_ = create_();
+    if (!encoder_) {
+      return WEBRTC_VIDEO_CODEC_ERROR;
+    }
+  }
+  int error = WEBRTC_VIDEO_CODEC_OK;
+  group_ = registry_->Join(MakeKey(format_, *codec_settings), this, &encoder_,
+                           codec_settings, settings, &error);
+  if (group_) {
+    group_->SetCallback(this, callback_);
+  }
+  return error;
+}
+
+int SharedVideoEncoder::Encode(
+    const webrtc::VideoFrame& frame,
+    const std::vector<webrtc::VideoFrameType>* frame_types) {
+  if (!group_) {
+    return WEBRTC_VIDEO_CODEC_UNINITIALIZED;
+  }
+  return group_->Encode(frame, frame_types);
+}
+
+int SharedVideoEncoder::RegisterEncodeCompleteCallback(
+    webrtc::EncodedImageCallback* callback) {
+  if (group_) {
+    group_->SetCallback(this, callback);
+  } else {
+    callback_ = callback;
+  }
+  return WEBRTC_VIDEO_CODEC_OK;
+}
+
+void SharedVideoEncoder::SetRates(const RateControlParameters& parameters) {
+  if (group_) {
+    group_->SetRates(this, parameters);
+  }
+}
+
+void SharedVideoEncoder::OnPacketLossRateUpdate(float packet_loss_rate) {
+  if (group_) {
+    group_->OnPacketLossRateUpdate(packet_loss_rate);
+  }
+}
+
+void SharedVideoEncoder::OnRttUpdate(int64_t rtt_ms) {
+  if (group_) {
+    group_->OnRttUpdate(rtt_ms);
+  }
+}
+
+void SharedVideoEncoder::OnLossNotification(
+    const LossNotification& loss_notification) {
+  if (group_) {
+    group_->OnLossNotification(loss_notification);
+  }
+}
+
+webrtc::VideoEncoder::EncoderInfo SharedVideoEncoder::GetEncoderInfo() const {
+  if (group_) {
+    return group_->GetEncoderInfo();
+  }
+  if (encoder_) {
+    return encoder_->GetEncoderInfo();
+  }
+  return EncoderInfo();
+}
@@ -0,0 +1,145 @@
+#ifndef SHARED_VIDEO_ENCODER_H_
+#define SHARED_VIDEO_ENCODER_H_
+
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <vector>
+
+// WebRTC
+#include <api/video/video_frame.h>
+#include <api/video_codecs/sdp_video_format.h>
+#include <api/video_codecs/video_encoder.h>
+
+class SharedVideoEncoder;
+
+// One real encoder and the SharedVideoEncoders whose connections get its
+// output.
+class SharedEncoderGroup : public webrtc::EncodedImageCallback {
+ public:
+  SharedEncoderGroup(std::string key,
+                     std::unique_ptr<webrtc::VideoEncoder> encoder);
+  ~SharedEncoderGroup() override;
+
+  int InitEncode(const webrtc::VideoCodec* codec_settings,
+                 const webrtc::VideoEncoder::Settings& settings);
+  void Join(SharedVideoEncoder* member);
+  void Leave(SharedVideoEncoder* member);
+  void SetCallback(SharedVideoEncoder* member,
+                   webrtc::EncodedImageCallback* callback);
+  int Encode(const webrtc::VideoFrame& frame,
+             const std::vector<webrtc::VideoFrameType>* frame_types);
+  void SetRates(SharedVideoEncoder* member,
+                const webrtc::VideoEncoder::RateControlParameters& parameters);
+  void OnPacketLossRateUpdate(float packet_loss_rate);
+  void OnRttUpdate(int64_t rtt_ms);
+  void OnLossNotification(
+      const webrtc::VideoEncoder::LossNotification& loss_notification);
+  webrtc::VideoEncoder::EncoderInfo GetEncoderInfo();
+
+  const std::string& key() const { return key_; }
+  size_t members();
+
+  // EncodedImageCallback
+  Result OnEncodedImage(
+      const webrtc::EncodedImage& encoded_image,
+      const webrtc::CodecSpecificInfo* codec_specific_info) override;
+  void OnDroppedFrame(DropReason reason) override;
+
+ private:
+  // Caller holds encoder_mutex_
+  void ApplyRates();
+
+  const std::string key_;
+
+  std::mutex encoder_mutex_;
+  std::unique_ptr<webrtc::VideoEncoder> encoder_;
+  // Newest frame handed to the encoder, older or equal ones were encoded
+  // already for another member
+  int64_t last_timestamp_us_ = -1;
+  // A member asked for a key frame for a frame that was already encoded
+  bool key_frame_pending_ = false;
+  std::map<SharedVideoEncoder*, webrtc::VideoEncoder::RateControlParameters>
+      rates_;
+  std::optional<webrtc::VideoEncoder::RateControlParameters> applied_rates_;
+
+  // Separate from encoder_mutex_: encoders call back from their own threads
+  std::mutex members_mutex_;
+  std::vector<SharedVideoEncoder*> members_;
+};
+
+// Groups the encoders created by one MomoVideoEncoderFactory by codec,
+// resolution and mode.
+class SharedEncoderRegistry {
+ public:
+  // Joins the group of the key, creating it with the encoder of the member
+  // (moved out of *encoder) if there is none. nullptr if the encoder failed
+  // to initialize.
+  std::shared_ptr<SharedEncoderGroup> Join(
+      const std::string& key,
+      SharedVideoEncoder* member,
+      std::unique_ptr<webrtc::VideoEncoder>* encoder,
+      const webrtc::VideoCodec* codec_settings,
+      const webrtc::VideoEncoder::Settings& settings,
+      int* error);
+  void Leave(std::shared_ptr<SharedEncoderGroup> group,
+             SharedVideoEncoder* member);
+
+ private:
+  void PublishMetrics();
+
+  std::mutex mutex_;
+  std::map<std::string, std::weak_ptr<SharedEncoderGroup>> groups_;
+};
+
+// Encoder of one connection. Connections that send the same video with the
+// same codec at the same resolution get the output of one real encoder, each
+// frame is encoded once no matter how many viewers there are.
+//
+// The real encoder runs at the lowest target bitrate of the connections, and
+// a key frame requested by any of them is sent to all of them. Every
+// connection receives every encoded frame, which delta frames need to be
+// decodable, so a viewer on a slow link slows down the others rather than
+// dropping frames on its own.
+class SharedVideoEncoder : public webrtc::VideoEncoder {
+ public:
+  using CreateEncoder = std::function<std::unique_ptr<webrtc::VideoEncoder>()>;
+
+  SharedVideoEncoder(std::shared_ptr<SharedEncoderRegistry> registry,
+                     const webrtc::SdpVideoFormat& format,
+                     CreateEncoder create);
+  ~SharedVideoEncoder() override;
+
+  void SetFecControllerOverride(
+      webrtc::FecControllerOverride* fec_controller_override) override;
+  int Release() override;
+  int InitEncode(const webrtc::VideoCodec* codec_settings,
+                 const webrtc::VideoEncoder::Settings& settings) override;
+  int Encode(const webrtc::VideoFrame& frame,
+             const std::vector<webrtc::VideoFrameType>* frame_types) override;
+  int RegisterEncodeCompleteCallback(
+      webrtc::EncodedImageCallback* callback) override;
+  void SetRates(const RateControlParameters& parameters) override;
+  void OnPacketLossRateUpdate(float packet_loss_rate) override;
+  void OnRttUpdate(int64_t rtt_ms) override;
+  void OnLossNotification(const LossNotification& loss_notification) override;
+  EncoderInfo GetEncoderInfo() const override;
+
+ private:
+  friend class SharedEncoderGroup;
+
+  const std::shared_ptr<SharedEncoderRegistry> registry_;
+  const std::string format_;
+  CreateEncoder create_;
+  // Encoder of this member until it founds a group (which takes it over)
+  std::unique_ptr<webrtc::VideoEncoder> encoder_;
+  std::shared_ptr<SharedEncoderGroup> group_;
+  // Guarded by SharedEncoderGroup::members_mutex_ while in a group
+  webrtc::EncodedImageCallback* callback_ = nullptr;
+};
+
+#endif
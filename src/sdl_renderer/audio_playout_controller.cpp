@@ -0,0 +1,164 @@
+#include "audio_playout_controller.h"
+
+#include <algorithm>
+#include <cmath>
+
+// WebRTC
+#include <rtc_base/logging.h>
+
+#include "metrics/metrics_registry.h"
+
+namespace {
+
+const char kMetricsGroup[] = "audio_playout";
+
+// Smoothing factor of the queued depth (applied once per audio chunk, i.e.
+// roughly every 10ms). Short spikes from bursty delivery are ignored.
+constexpr double kQueuedSmoothing = 0.05;
+// Queue depth around the target that is considered "converged"
+constexpr double kDeadbandRatio = 0.15;
+constexpr double kMinDeadbandMs = 5.0;
+// Speed correction reached when the error is as large as the target itself
+constexpr double kRatioGain = 0.05;
+// How fast the applied ratio follows the desired one
+constexpr float kRatioSmoothing = 0.1f;
+// Avoid calling into SDL for changes that nobody can hear
+constexpr float kMinRatioStep = 0.002f;
+constexpr uint64_t kPublishIntervalMs = 250;
+
+}  // namespace
+
+AudioPlayoutController::AudioPlayoutController(
+    SDL_AudioStream* stream,
+    int bytes_per_second,
+    AudioPlayoutControllerConfig config)
+    : stream_(stream),
+      bytes_per_second_(bytes_per_second),
+      config_(config),
+      target_latency_ms_(config.target_latency_ms) {
+  RTC_LOG(LS_INFO) << __FUNCTION__
+                   << ": target_latency_ms=" << config_.target_latency_ms
+                   << " max_latency_ms=" << config_.max_latency_ms;
+  MetricsRegistry::Instance().Set(kMetricsGroup, "target_ms",
+                                  config_.target_latency_ms);
+}
+
+AudioPlayoutController::~AudioPlayoutController() {
+  MetricsRegistry::Instance().Clear(kMetricsGroup);
+}
+
+void AudioPlayoutController::SetTargetLatency(int target_latency_ms) {
+  target_latency_ms_ = std::max(1, target_latency_ms);
+  MetricsRegistry::Instance().Set(kMetricsGroup, "target_ms",
+                                  target_latency_ms_);
+}
+
+int AudioPlayoutController::GetTargetLatency() const {
+  return target_latency_ms_;
+}
+
+double AudioPlayoutController::QueuedMs() const {
+  int queued = SDL_GetAudioStreamQueued(stream_);
+  if (queued < 0 || bytes_per_second_ <= 0) {
+    return 0.0;
+  }
+  return static_cast<double>(queued) * 1000.0 / bytes_per_second_;
+}
+
+bool AudioPlayoutController::OnAudioData(size_t byte_count) {
+  const double queued_ms = QueuedMs();
+  const int target_ms = target_latency_ms_;
+  const int max_ms = config_.max_latency_ms > 0
+                         ? config_.max_latency_ms
+                         : std::max(200, target_ms * 4);
+
+  if (started_ && queued_ms == 0.0) {
+    underruns_++;
+  }
+  started_ = true;
+
+  // Way too much audio is queued (e.g. after a long network stall).
+  // Speed correction alone would take seconds, so drop incoming audio until
+  // the queue has drained to the target.
+  if (queued_ms > max_ms) {
+    if (!draining_) {
+      RTC_LOG(LS_INFO) << __FUNCTION__ << ": queued " << queued_ms
+                       << "ms exceeds " << max_ms << "ms, draining";
+    }
+    draining_ = true;
+  }
+  if (draining_ && queued_ms <= target_ms) {
+    draining_ = false;
+    smoothed_queued_ms_ = queued_ms;
+  }
+
+  bool accept = !draining_;
+  if (!accept) {
+    dropped_bytes_ += byte_count;
+  } else {
+    UpdateFrequencyRatio(queued_ms);
+  }
+
+  PublishMetrics(queued_ms);
+  return accept;
+}
+
+void AudioPlayoutController::UpdateFrequencyRatio(double queued_ms) {
+  if (smoothed_queued_ms_ < 0.0) {
+    smoothed_queued_ms_ = queued_ms;
+  } else {
+    smoothed_queued_ms_ += (queued_ms - smoothed_queued_ms_) * kQueuedSmoothing;
+  }
+
+  const double target_ms = target_latency_ms_;
+  const double deadband = std::max(kMinDeadbandMs, target_ms * kDeadbandRatio);
+  const double error = smoothed_queued_ms_ - target_ms;
+
+  float desired = 1.0f;
+  if (std::abs(error) > deadband) {
+    // Proportional to the error outside of the deadband, so that the ratio
+    // returns to exactly 1.0 once we have converged.
+    double outside = error > 0 ? error - deadband : error + deadband;
+    desired = static_cast<float>(1.0 + kRatioGain * outside / target_ms);
+    desired = std::clamp(desired, config_.max_slowdown, config_.max_speedup);
+  }
+
+  ratio_ += (desired - ratio_) * kRatioSmoothing;
+  if (desired == 1.0f && std::abs(ratio_ - 1.0f) < kMinRatioStep) {
+    ratio_ = 1.0f;
+  }
+
+  if (ratio_ != applied_ratio_ &&
+      (std::abs(ratio_ - applied_ratio_) >= kMinRatioStep || ratio_ == 1.0f)) {
+    if (!SDL_SetAudioStreamFrequencyRatio(stream_, ratio_)) {
+      RTC_LOG(LS_WARNING) << __FUNCTION__
+                          << ": SDL_SetAudioStreamFrequencyRatio failed: "
+                          << SDL_GetError();
+      return;
+    }
+    applied_ratio_ = ratio_;
+    ratio_changes_++;
+  }
+}
+
+void AudioPlayoutController::PublishMetrics(double queued_ms) {
+  uint64_t now = SDL_GetTicks();
+  if (now - last_publish_ms_ < kPublishIntervalMs) {
+    return;
+  }
+  last_publish_ms_ = now;
+
+  auto& registry = MetricsRegistry::Instance();
+  registry.Set(kMetricsGroup, "queued_ms", queued_ms);
+  registry.Set(kMetricsGroup, "smoothed_queued_ms",
+               std::max(0.0, smoothed_queued_ms_));
+  registry.Set(kMetricsGroup, "frequency_ratio", applied_ratio_);
+  registry.Set(kMetricsGroup, "frequency_ratio_changes", ratio_changes_);
+  registry.Set(kMetricsGroup, "dropped_ms",
+               bytes_per_second_ > 0
+                   ? static_cast<double>(dropped_bytes_) * 1000.0 /
+                         bytes_per_second_
+                   : 0.0);
+  registry.Set(kMetricsGroup, "underruns", underruns_);
+  registry.Set(kMetricsGroup, "draining", draining_ ? 1 : 0);
+}
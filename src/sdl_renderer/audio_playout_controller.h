@@ -0,0 +1,69 @@
+#ifndef AUDIO_PLAYOUT_CONTROLLER_H_
+#define AUDIO_PLAYOUT_CONTROLLER_H_
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+// SDL
+#include <SDL3/SDL.h>
+
+struct AudioPlayoutControllerConfig {
+  // Amount of audio we want to keep queued in the SDL audio stream
+  int target_latency_ms = 80;
+  // If the queue grows beyond this, incoming audio is dropped until it is back
+  // at the target. 0 means 4 times the target (at least 200ms).
+  int max_latency_ms = 0;
+  // Limits of the playback speed correction.
+  // Keep them close to 1.0 so that the pitch shift is not audible.
+  float max_speedup = 1.05f;
+  float max_slowdown = 0.97f;
+};
+
+// Keeps the depth of the SDL audio stream close to the target latency.
+//
+// Audio handed to SDL_PutAudioStreamData just accumulates in the stream, so
+// after a network hiccup the extra latency would never drain.
+// This controller monitors SDL_GetAudioStreamQueued and converges to the target
+// by slightly changing the playback speed (SDL_SetAudioStreamFrequencyRatio),
+// and drops incoming audio only when the queue is far beyond the limit.
+//
+// OnAudioData is called from the WebRTC audio thread.
+class AudioPlayoutController {
+ public:
+  AudioPlayoutController(SDL_AudioStream* stream,
+                         int bytes_per_second,
+                         AudioPlayoutControllerConfig config);
+  ~AudioPlayoutController();
+
+  // Call before queueing byte_count bytes into the stream.
+  // Returns false if the data should be dropped.
+  bool OnAudioData(size_t byte_count);
+
+  void SetTargetLatency(int target_latency_ms);
+  int GetTargetLatency() const;
+
+ private:
+  double QueuedMs() const;
+  void UpdateFrequencyRatio(double queued_ms);
+  void PublishMetrics(double queued_ms);
+
+  SDL_AudioStream* stream_;
+  int bytes_per_second_;
+  AudioPlayoutControllerConfig config_;
+  std::atomic<int> target_latency_ms_;
+
+  // The following are only touched from the audio thread
+  double smoothed_queued_ms_ = -1.0;
+  float ratio_ = 1.0f;
+  float applied_ratio_ = 1.0f;
+  bool draining_ = false;
+  bool started_ = false;
+  uint64_t last_publish_ms_ = 0;
+
+  uint64_t dropped_bytes_ = 0;
+  uint64_t ratio_changes_ = 0;
+  uint64_t underruns_ = 0;
+};
+
+#endif
@@ -9,6 +9,7 @@
 #include <vector>
 
 // WebRTC
+#include <api/units/time_delta.h>
 #include <api/video/i420_buffer.h>
 #include <rtc_base/logging.h>
 #include <third_party/libyuv/include/libyuv/convert_from.h>
@@ -23,6 +24,7 @@ constexpr Uint32 kIdleFrameIntervalMs = 16;    // ~60 FPS when waiting for frame
 
 SDLRenderer::SDLRenderer(int width, int height, bool fullscreen)
     : running_(true),
+      headless_(false),
       window_(nullptr),
       renderer_(nullptr),
       dispatch_(nullptr),
@@ -58,8 +60,19 @@ SDLRenderer::SDLRenderer(int width, int height, bool fullscreen)
                      << ": Audio subsystem initialized successfully";
   }
 
+  // The offscreen/dummy drivers have neither OpenGL nor a keyboard to hook,
+  // the software renderer is used instead
+  const char* video_driver = SDL_GetCurrentVideoDriver();
+  headless_ = video_driver != nullptr &&
+              (SDL_strcmp(video_driver, "offscreen") == 0 ||
+               SDL_strcmp(video_driver, "dummy") == 0);
+  SDL_WindowFlags window_flags = SDL_WINDOW_RESIZABLE;
+  if (!headless_) {
+    window_flags |= SDL_WINDOW_OPENGL;
+  }
+
   window_ = SDL_CreateWindow("Momo WebRTC Native Client", width_, height_,
-                             SDL_WINDOW_OPENGL | SDL_WINDOW_RESIZABLE);
+                             window_flags);
   if (window_ == nullptr) {
     RTC_LOG(LS_ERROR) << __FUNCTION__ << ": SDL_CreateWindow failed "
                       << SDL_GetError();
@@ -152,6 +165,14 @@ SDLRenderer::SDLRenderer(int width, int height, bool fullscreen)
                 << ": Failed to set audio device gain: " << SDL_GetError();
           }
 
+          AudioPlayoutControllerConfig playout_config;
+          audio_playout_ = std::make_unique<AudioPlayoutController>(
+              audio_stream_,
+              SDLRenderer::kAudioSampleRate *
+                  static_cast<int>(SDLRenderer::kAudioChannels) *
+                  static_cast<int>(sizeof(int16_t)),
+              playout_config);
+
           if (SDL_ResumeAudioDevice(audio_device_)) {
             RTC_LOG(LS_INFO)
                 << __FUNCTION__
@@ -171,14 +192,17 @@ SDLRenderer::SDLRenderer(int width, int height, bool fullscreen)
   }
 
   // Initialize keyboard hook for system key interception
-  keyboard_hook_->Initialize();
-  keyboard_hook_->SetSDLWindow(window_);
+  if (!headless_) {
+    keyboard_hook_->Initialize();
+    keyboard_hook_->SetSDLWindow(window_);
+  }
 
   thread_ = SDL_CreateThread(SDLRenderer::RenderThreadExec, "Render", this);
 }
 
 SDLRenderer::~SDLRenderer() {
   running_ = false;
+  frame_event_.Set();
 
   // Shutdown keyboard hook
   if (keyboard_hook_) {
@@ -186,6 +210,7 @@ SDLRenderer::~SDLRenderer() {
   }
 
   // Clean up audio
+  audio_playout_.reset();
   if (audio_stream_) {
     SDL_DestroyAudioStream(audio_stream_);
     audio_stream_ = nullptr;
@@ -222,6 +247,39 @@ void SDLRenderer::SetFullScreen(bool fullscreen) {
   }
 }
 
+void SDLRenderer::SetAudioTargetLatency(int target_latency_ms) {
+  if (audio_playout_) {
+    audio_playout_->SetTargetLatency(target_latency_ms);
+  }
+}
+
+void SDLRenderer::SetRenderOnArrival(bool enable) {
+  render_on_arrival_ = enable;
+  frame_event_.Set();
+}
+
+SDLRenderer::RenderStats SDLRenderer::GetRenderStats() const {
+  RenderStats stats;
+  stats.frames_received = frames_received_.load();
+  stats.frames_uploaded = frames_uploaded_.load();
+  stats.frames_dropped = frames_dropped_.load();
+  stats.frames_presented = frames_presented_.load();
+  stats.convert_us = convert_us_.load();
+  stats.upload_us = upload_us_.load();
+  stats.present_us = present_us_.load();
+  return stats;
+}
+
+void SDLRenderer::PutAudioData(const void* data, int byte_count) {
+  if (audio_playout_ && !audio_playout_->OnAudioData(byte_count)) {
+    return;
+  }
+  if (!SDL_PutAudioStreamData(audio_stream_, data, byte_count)) {
+    RTC_LOG(LS_ERROR) << __FUNCTION__ << ": SDL_PutAudioStreamData failed: "
+                      << SDL_GetError();
+  }
+}
+
 void SDLRenderer::PollEvent() {
   SDL_Event e;
   // Call it from the main thread
@@ -333,6 +391,7 @@ int SDLRenderer::RenderThread() {
           SDL_SetTextureBlendMode(cache.texture, SDL_BLENDMODE_BLEND);
           cache.width = width;
           cache.height = height;
+          cache.uploaded_seq = 0;
         }
 
         uint8_t* src_pixels = sink->GetImage();
@@ -340,23 +399,35 @@ int SDLRenderer::RenderThread() {
           continue;
         }
 
-        void* dst_pixels = nullptr;
-        int dst_pitch = 0;
-        if (SDL_LockTexture(cache.texture, nullptr, &dst_pixels, &dst_pitch) != 0) {
-          SDL_FlushRenderer(renderer_);
-          if (SDL_LockTexture(cache.texture, nullptr, &dst_pixels, &dst_pitch) != 0) {
-            RTC_LOG(LS_ERROR) << __FUNCTION__
-                              << ": SDL_LockTexture failed " << SDL_GetError();
-            continue;
+        // The texture keeps its contents, only upload when a new frame arrived
+        const uint64_t frame_seq = sink->GetFrameSequence();
+        if (frame_seq != cache.uploaded_seq) {
+          const uint64_t upload_start_ns = SDL_GetTicksNS();
+          void* dst_pixels = nullptr;
+          int dst_pitch = 0;
+          if (!SDL_LockTexture(cache.texture, nullptr, &dst_pixels, &dst_pitch)) {
+            SDL_FlushRenderer(renderer_);
+            if (!SDL_LockTexture(cache.texture, nullptr, &dst_pixels, &dst_pitch)) {
+              RTC_LOG(LS_ERROR) << __FUNCTION__
+                                << ": SDL_LockTexture failed " << SDL_GetError();
+              continue;
+            }
           }
-        }
 
-        const int src_stride = width * 4;
-        uint8_t* dst = static_cast<uint8_t*>(dst_pixels);
-        for (int row = 0; row < height; ++row) {
-          std::memcpy(dst + row * dst_pitch, src_pixels + row * src_stride, src_stride);
+          const int src_stride = width * 4;
+          uint8_t* dst = static_cast<uint8_t*>(dst_pixels);
+          for (int row = 0; row < height; ++row) {
+            std::memcpy(dst + row * dst_pitch, src_pixels + row * src_stride, src_stride);
+          }
+          SDL_UnlockTexture(cache.texture);
+
+          if (cache.uploaded_seq != 0 && frame_seq > cache.uploaded_seq + 1) {
+            frames_dropped_ += frame_seq - cache.uploaded_seq - 1;
+          }
+          cache.uploaded_seq = frame_seq;
+          frames_uploaded_++;
+          upload_us_ += (SDL_GetTicksNS() - upload_start_ns) / 1000;
         }
-        SDL_UnlockTexture(cache.texture);
 
         SDL_FRect image_rect = {0, 0, static_cast<float>(width), static_cast<float>(height)};
         SDL_FRect draw_rect = {static_cast<float>(sink->GetOffsetX()),
@@ -379,7 +450,10 @@ int SDLRenderer::RenderThread() {
         overlay_render_cb_(renderer_);
         drew_frame = true;
       }
+      const uint64_t present_start_ns = SDL_GetTicksNS();
       SDL_RenderPresent(renderer_);
+      frames_presented_++;
+      present_us_ += (SDL_GetTicksNS() - present_start_ns) / 1000;
 
       for (auto it = sink_textures_.begin(); it != sink_textures_.end();) {
         bool exists = std::any_of(
@@ -402,6 +476,15 @@ int SDLRenderer::RenderThread() {
       }
     }
     duration = SDL_GetTicks() - start_time;
+    if (render_on_arrival_ && has_sinks) {
+      // Wake up as soon as the next frame is converted. The timeout keeps
+      // overlays and event polling alive while the video is still.
+      if (duration < kIdleFrameIntervalMs) {
+        frame_event_.Wait(
+            webrtc::TimeDelta::Millis(kIdleFrameIntervalMs - duration));
+      }
+      continue;
+    }
     const Uint32 target_interval = drew_frame
                                        ? kActiveFrameIntervalMs
                                        : (has_sinks ? kActiveFrameIntervalMs
@@ -437,7 +520,8 @@ SDLRenderer::Sink::Sink(SDLRenderer* renderer,
       input_height_(0),
       scaled_(false),
       width_(0),
-      height_(0) {
+      height_(0),
+      frame_seq_(0) {
   track_->AddOrUpdateSink(this, webrtc::VideoSinkWants());
 }
 
@@ -451,6 +535,7 @@ void SDLRenderer::Sink::OnFrame(const webrtc::VideoFrame& frame) {
   if (frame.width() == 0 || frame.height() == 0)
     return;
   webrtc::MutexLock lock(GetMutex());
+  const uint64_t convert_start_ns = SDL_GetTicksNS();
   if (outline_changed_ || frame.width() != input_width_ ||
       frame.height() != input_height_) {
     int width, height;
@@ -498,6 +583,10 @@ void SDLRenderer::Sink::OnFrame(const webrtc::VideoFrame& frame) {
       buffer_if->StrideU(), buffer_if->DataV(), buffer_if->StrideV(),
       image_.get(), (scaled_ ? width_ : input_width_) * 4, buffer_if->width(),
       buffer_if->height(), libyuv::FOURCC_ARGB);
+  frame_seq_++;
+  renderer_->frames_received_++;
+  renderer_->convert_us_ += (SDL_GetTicksNS() - convert_start_ns) / 1000;
+  renderer_->frame_event_.Set();
 }
 
 void SDLRenderer::Sink::SetOutlineRect(int x, int y, int width, int height) {
@@ -559,6 +648,10 @@ uint8_t* SDLRenderer::Sink::GetImage() {
   return image_.get();
 }
 
+uint64_t SDLRenderer::Sink::GetFrameSequence() {
+  return frame_seq_;
+}
+
 void SDLRenderer::SetOutlines() {
   float window_aspect = (float)width_ / (float)height_;
   bool window_is_wide = window_aspect > ((STD_ASPECT + WIDE_ASPECT) / 2.0);
@@ -846,10 +939,7 @@ void SDLRenderer::AudioSink::OnData(const void* audio_data,
     // Already the target format, so just stream it
     const int byte_count = static_cast<int>(
         samples_per_channel * number_of_channels * sizeof(int16_t));
-    if (!SDL_PutAudioStreamData(renderer_->audio_stream_, input, byte_count)) {
-      RTC_LOG(LS_ERROR) << __FUNCTION__ << ": SDL_PutAudioStreamData failed: "
-                        << SDL_GetError();
-    }
+    renderer_->PutAudioData(input, byte_count);
   } else {
     // If the sample rate or number of channels are different, convert it
     std::vector<int16_t> converted_data;
@@ -903,20 +993,12 @@ void SDLRenderer::AudioSink::OnData(const void* audio_data,
 
       const int byte_count =
           static_cast<int>(converted_data.size() * sizeof(int16_t));
-      if (!SDL_PutAudioStreamData(renderer_->audio_stream_,
-                                  converted_data.data(), byte_count)) {
-        RTC_LOG(LS_ERROR) << __FUNCTION__ << ": SDL_PutAudioStreamData failed: "
-                          << SDL_GetError();
-      }
+      renderer_->PutAudioData(converted_data.data(), byte_count);
     } else {
       // If only channel conversion is needed, do it
       const int byte_count = static_cast<int>(
           samples_per_channel * SDLRenderer::kAudioChannels * sizeof(int16_t));
-      if (!SDL_PutAudioStreamData(renderer_->audio_stream_, channel_converted,
-                                  byte_count)) {
-        RTC_LOG(LS_ERROR) << __FUNCTION__ << ": SDL_PutAudioStreamData failed: "
-                          << SDL_GetError();
-      }
+      renderer_->PutAudioData(channel_converted, byte_count);
     }
   }
 }
@@ -2,6 +2,7 @@
 #define SDL_RENDERER_H_
 
 #include <array>
+#include <atomic>
 #include <cstdint>
 #include <functional>
 #include <memory>
@@ -22,8 +23,10 @@
 #include <api/video/video_sink_interface.h>
 #include <modules/audio_processing/include/audio_processing.h>
 #include <rtc/video_track_receiver.h>
+#include <rtc_base/event.h>
 #include <rtc_base/synchronization/mutex.h>
 
+#include "audio_playout_controller.h"
 // Keyboard hook for system-level key interception
 #include "keyboard_hook.h"
 
@@ -74,6 +77,25 @@ class SDLRenderer : public VideoTrackReceiver {
   bool IsFullScreen();
   void SetFullScreen(bool fullscreen);
 
+  // Target depth of the received audio kept queued for playback
+  void SetAudioTargetLatency(int target_latency_ms);
+
+  // Present as soon as a new frame arrives instead of on a fixed interval
+  // (--low-latency). Pair it with SDL_HINT_RENDER_VSYNC "0".
+  void SetRenderOnArrival(bool enable);
+
+  // Cumulative counters of the video render path
+  struct RenderStats {
+    uint64_t frames_received = 0;   // Frames delivered to the sinks
+    uint64_t frames_uploaded = 0;   // Frames copied into a texture
+    uint64_t frames_dropped = 0;    // Frames replaced before they were uploaded
+    uint64_t frames_presented = 0;  // SDL_RenderPresent calls
+    uint64_t convert_us = 0;        // Scale / I420 / ARGB conversion
+    uint64_t upload_us = 0;         // Texture lock and copy
+    uint64_t present_us = 0;        // SDL_RenderPresent
+  };
+  RenderStats GetRenderStats() const;
+
  protected:
   static constexpr int kAudioSampleRate = 48000;
   static constexpr size_t kAudioChannels = 2;
@@ -99,6 +121,8 @@ class SDLRenderer : public VideoTrackReceiver {
     int GetWidth();
     int GetHeight();
     uint8_t* GetImage();
+    // Incremented for every converted frame
+    uint64_t GetFrameSequence();
 
    private:
     SDLRenderer* renderer_;
@@ -118,6 +142,7 @@ class SDLRenderer : public VideoTrackReceiver {
     int offset_y_;
     int width_;
     int height_;
+    uint64_t frame_seq_;
   };
 
   // Audio sink for receiving audio frames
@@ -140,6 +165,8 @@ class SDLRenderer : public VideoTrackReceiver {
  private:
   void PollEvent();
   void DrawHomageText(SDL_Renderer* renderer);
+  // Queue audio to the SDL stream through the playout controller
+  void PutAudioData(const void* data, int byte_count);
 
   webrtc::Mutex sinks_lock_;
   typedef std::vector<
@@ -150,9 +177,13 @@ class SDLRenderer : public VideoTrackReceiver {
     SDL_Texture* texture{nullptr};
     int width{0};
     int height{0};
+    // Frame sequence currently in the texture (0: nothing uploaded yet)
+    uint64_t uploaded_seq{0};
   };
   std::unordered_map<Sink*, CachedTexture> sink_textures_;
   std::atomic<bool> running_;
+  // Running on the offscreen/dummy video driver (benchmarks, CI)
+  bool headless_;
   SDL_Thread* thread_;
   SDL_Window* window_;
   SDL_Renderer* renderer_;
@@ -174,6 +205,20 @@ class SDLRenderer : public VideoTrackReceiver {
   AudioTrackSinkVector audio_sinks_;
   SDL_AudioDeviceID audio_device_;
   SDL_AudioStream* audio_stream_;
+  std::unique_ptr<AudioPlayoutController> audio_playout_;
+
+  // RenderStats counters (updated from the decoder and render threads)
+  std::atomic<uint64_t> frames_received_{0};
+  std::atomic<uint64_t> frames_uploaded_{0};
+  std::atomic<uint64_t> frames_dropped_{0};
+  std::atomic<uint64_t> frames_presented_{0};
+  std::atomic<uint64_t> convert_us_{0};
+  std::atomic<uint64_t> upload_us_{0};
+  std::atomic<uint64_t> present_us_{0};
+
+  std::atomic<bool> render_on_arrival_{false};
+  // Signaled by the sinks for every converted frame
+  webrtc::Event frame_event_;
 
   // Keyboard hook manager for system key interception
   std::unique_ptr<sdl_hook::KeyboardHookManager> keyboard_hook_;
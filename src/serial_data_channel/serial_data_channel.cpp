@@ -22,17 +22,13 @@ void SerialDataChannel::OnStateChange() {
 }
 
 void SerialDataChannel::OnMessage(const webrtc::DataBuffer& buffer) {
-  const uint8_t* data = buffer.data.data<uint8_t>();
-  size_t length = buffer.data.size();
-
-  serial_data_manager_->Send(data, length);
+  serial_data_manager_->Send(buffer.data);
 }
 
-void SerialDataChannel::Send(uint8_t* data, size_t length) {
+void SerialDataChannel::Send(const webrtc::CopyOnWriteBuffer& data) {
   if (data_channel_->state() != webrtc::DataChannelInterface::kOpen) {
     return;
   }
-  webrtc::CopyOnWriteBuffer buffer(data, length);
-  webrtc::DataBuffer data_buffer(buffer, true);
+  webrtc::DataBuffer data_buffer(data, true);
   data_channel_->Send(data_buffer);
 }
@@ -15,7 +15,7 @@ class SerialDataChannel : public webrtc::DataChannelObserver {
       webrtc::scoped_refptr<webrtc::DataChannelInterface> data_channel);
   ~SerialDataChannel();
 
-  void Send(uint8_t* data, size_t length);
+  void Send(const webrtc::CopyOnWriteBuffer& data);
 
   void OnStateChange() override;
   void OnMessage(const webrtc::DataBuffer& buffer) override;
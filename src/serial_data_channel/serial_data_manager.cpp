@@ -3,6 +3,8 @@
 
 #include "serial_data_manager.h"
 
+#include <algorithm>
+#include <chrono>
 #include <functional>
 #include <iostream>
 
@@ -12,19 +14,33 @@
 // WebRTC
 #include <rtc_base/log_sinks.h>
 
-// Boost
-#include <boost/asio/post.hpp>
+#include "metrics/metrics_registry.h"
+
+namespace {
 
-#define SERIAL_TX_BUFFER_SIZE 16
-#define SERIAL_RX_BUFFER_SIZE 256
+// A line longer than this is sent in pieces
+constexpr size_t kReadBufferSize = 64 * 1024;
+// Grows when the DataChannels send faster than the device takes it
+constexpr size_t kWriteBufferSize = 16 * 1024;
+// Batches are sent before they get larger than this, every browser takes a
+// message of this size
+constexpr size_t kMaxMessageSize = 16 * 1024;
 
-SerialDataManager::SerialDataManager(boost::asio::io_context& ioc)
-    : serial_port_(ioc), read_buffer_size_(SERIAL_RX_BUFFER_SIZE) {
+}  // namespace
+
+SerialDataManager::SerialDataManager(boost::asio::io_context& ioc,
+                                     SerialDataManagerConfig config)
+    : config_(std::move(config)),
+      serial_port_(ioc),
+      read_buffer_(kReadBufferSize),
+      flush_timer_(ioc),
+      write_buffer_(kWriteBufferSize) {
   post_ = [&ioc](std::function<void()> f) {
     if (ioc.stopped())
       return;
     boost::asio::post(ioc, f);
   };
+  batch_.reserve(kMaxMessageSize);
 }
 
 SerialDataManager::~SerialDataManager() {
@@ -35,6 +51,7 @@ SerialDataManager::~SerialDataManager() {
     }
   }
 
+  flush_timer_.cancel();
   DoCloseSerial();
 }
 
@@ -97,14 +114,17 @@ bool SerialDataManager::Connect(std::string device, unsigned int rate) {
     return false;
   }
 
-  read_buffer_.reset(new uint8_t[read_buffer_size_]);
   post_(std::bind(&SerialDataManager::DoRead, this));
   return true;
 }
 
-void SerialDataManager::Send(const uint8_t* data, size_t length) {
-  std::vector<uint8_t> v(data, data + length);
-  post_(std::bind(&SerialDataManager::StartWrite, this, std::move(v)));
+void SerialDataManager::Send(webrtc::CopyOnWriteBuffer data) {
+  post_([this, data = std::move(data)]() { StartWrite(data); });
+}
+
+void SerialDataManager::SetFrameHandler(FrameHandler handler) {
+  webrtc::MutexLock lock(&channels_lock_);
+  frame_handler_ = std::move(handler);
 }
 
 void SerialDataManager::DoCloseSerial() {
@@ -120,8 +140,9 @@ void SerialDataManager::DoRead() {
   if (!serial_port_.is_open()) {
     return;
   }
+  auto span = read_buffer_.WritableSpan();
   serial_port_.async_read_some(
-      boost::asio::buffer(read_buffer_.get(), read_buffer_size_),
+      boost::asio::buffer(span.first, span.second),
       std::bind(&SerialDataManager::OnRead, this, std::placeholders::_1,
                 std::placeholders::_2));
 }
@@ -134,60 +155,157 @@ void SerialDataManager::OnRead(const boost::system::error_code& error,
     DoCloseSerial();
     return;
   }
-  read_line_buffer_.insert(read_line_buffer_.end(), read_buffer_.get(),
-                           read_buffer_.get() + bytes_transferred);
+  read_buffer_.Commit(bytes_transferred);
+  MetricsRegistry::Instance().Add("serial", "read_bytes", bytes_transferred);
   {
     webrtc::MutexLock lock(&channels_lock_);
-    SendLineFromSerial();
+    if (config_.raw) {
+      AppendRaw();
+    } else {
+      ScanLines();
+    }
+    if (!batch_.empty() || batch_lines_ > 0) {
+      ScheduleFlush();
+    }
   }
   DoRead();
 }
 
-void SerialDataManager::SendLineFromSerial() {
-  auto delimiter_iterator =
-      std::find(read_line_buffer_.begin(), read_line_buffer_.end(), '\n');
-  if (delimiter_iterator != read_line_buffer_.end()) {
-    size_t delimiter_index =
-        std::distance(read_line_buffer_.begin(), delimiter_iterator);
-    for (SerialDataChannel* serial_data_channel : serial_data_channels_) {
-      serial_data_channel->Send(read_line_buffer_.data(), delimiter_index);
+void SerialDataManager::ScanLines() {
+  // Only the bytes that came in since the last call are searched
+  size_t delimiter;
+  while ((delimiter = read_buffer_.Find('\n', scan_offset_)) !=
+         SerialRingBuffer::npos) {
+    AppendLine(delimiter);
+    read_buffer_.Consume(delimiter + 1);
+    scan_offset_ = 0;
+  }
+  scan_offset_ = read_buffer_.size();
+  if (read_buffer_.available() == 0) {
+    // No room left to read the rest of the line into
+    AppendLine(read_buffer_.size());
+    read_buffer_.Consume(read_buffer_.size());
+    scan_offset_ = 0;
+    MetricsRegistry::Instance().Add("serial", "split_lines", 1);
+  }
+}
+
+void SerialDataManager::AppendLine(size_t length) {
+  // Lines are counted rather than bytes, an empty line is a line too
+  if (batch_lines_ > 0 && batch_.size() + 1 + length > kMaxMessageSize) {
+    Flush();
+  }
+  if (batch_lines_ > 0) {
+    batch_.push_back('\n');
+  }
+  read_buffer_.CopyTo(0, length, &batch_);
+  batch_lines_++;
+  if (config_.batch_ms == 0) {
+    Flush();
+  }
+}
+
+void SerialDataManager::AppendRaw() {
+  while (!read_buffer_.empty()) {
+    const size_t length =
+        std::min(read_buffer_.size(), kMaxMessageSize - batch_.size());
+    read_buffer_.CopyTo(0, length, &batch_);
+    read_buffer_.Consume(length);
+    if (batch_.size() >= kMaxMessageSize) {
+      Flush();
+    }
+  }
+}
+
+void SerialDataManager::ScheduleFlush() {
+  if (config_.batch_ms == 0) {
+    Flush();
+    return;
+  }
+  if (flush_scheduled_) {
+    return;
+  }
+  // The first bytes of the batch wait at most batch_ms
+  flush_scheduled_ = true;
+  flush_timer_.expires_after(std::chrono::milliseconds(config_.batch_ms));
+  flush_timer_.async_wait([this](const boost::system::error_code& ec) {
+    if (ec) {
+      return;
     }
-    read_line_buffer_.erase(read_line_buffer_.begin(), delimiter_iterator + 1);
-    SendLineFromSerial();
+    webrtc::MutexLock lock(&channels_lock_);
+    flush_scheduled_ = false;
+    Flush();
+  });
+}
+
+void SerialDataManager::Flush() {
+  if (flush_scheduled_) {
+    flush_timer_.cancel();
+    flush_scheduled_ = false;
+  }
+  // A single empty line is sent as an empty message, as it always was
+  if (batch_.empty() && batch_lines_ == 0) {
+    return;
+  }
+  // One buffer shared by every DataChannel
+  webrtc::CopyOnWriteBuffer buffer(batch_.data(), batch_.size());
+  auto& metrics = MetricsRegistry::Instance();
+  metrics.Add("serial", "messages", 1);
+  metrics.Add("serial", "lines", batch_lines_);
+  batch_.clear();
+  batch_lines_ = 0;
+  for (SerialDataChannel* serial_data_channel : serial_data_channels_) {
+    serial_data_channel->Send(buffer);
+  }
+  if (frame_handler_) {
+    frame_handler_(buffer);
   }
 }
 
-void SerialDataManager::StartWrite(std::vector<uint8_t> v) {
+void SerialDataManager::StartWrite(webrtc::CopyOnWriteBuffer data) {
   if (!serial_port_.is_open()) {
     return;
   }
-  bool empty = write_buffer_.empty();
-  write_buffer_.insert(write_buffer_.end(), v.begin(), v.end());
-  if (empty && !write_buffer_.empty()) {
+  // The device is writing from the buffer, growing it would free the bytes
+  // under the write. What does not fit waits until the write is over
+  if (writing_ &&
+      (!write_pending_.empty() || data.size() > write_buffer_.available())) {
+    write_pending_.insert(write_pending_.end(), data.data(),
+                          data.data() + data.size());
+    return;
+  }
+  write_buffer_.Append(data.data(), data.size());
+  if (!writing_ && !write_buffer_.empty()) {
     DoWrite();
   }
 }
 
 void SerialDataManager::DoWrite() {
-  if (write_buffer_.size() < SERIAL_TX_BUFFER_SIZE) {
-    write_length_ = write_buffer_.size();
-  } else {
-    write_length_ = SERIAL_TX_BUFFER_SIZE;
-  }
-  async_write(
-      serial_port_, boost::asio::buffer(write_buffer_.data(), write_length_),
-      std::bind(&SerialDataManager::OnWrite, this, std::placeholders::_1));
+  // As much as the device driver takes at once
+  auto span = write_buffer_.ReadableSpan();
+  writing_ = true;
+  serial_port_.async_write_some(
+      boost::asio::buffer(span.first, span.second),
+      std::bind(&SerialDataManager::OnWrite, this, std::placeholders::_1,
+                std::placeholders::_2));
 }
 
-void SerialDataManager::OnWrite(const boost::system::error_code& error) {
+void SerialDataManager::OnWrite(const boost::system::error_code& error,
+                                size_t bytes_transferred) {
+  writing_ = false;
+  if (!write_pending_.empty()) {
+    write_buffer_.Append(write_pending_.data(), write_pending_.size());
+    write_pending_.clear();
+  }
   if (error) {
     RTC_LOG(LS_ERROR) << __FUNCTION__
                       << " async_write failed  error :" << error;
     DoCloseSerial();
     return;
   }
-  write_buffer_.erase(write_buffer_.begin(),
-                      write_buffer_.begin() + write_length_);
+  write_buffer_.Consume(bytes_transferred);
+  MetricsRegistry::Instance().Add("serial", "written_bytes",
+                                  bytes_transferred);
   if (write_buffer_.empty()) {
     return;
   }
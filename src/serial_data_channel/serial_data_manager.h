@@ -1,61 +1,98 @@
 #ifndef SERIAL_DATA_MANAGER_H_
 #define SERIAL_DATA_MANAGER_H_
 
+#include <functional>
 #include <memory>
+#include <string>
 #include <vector>
 
 // Boost
 #include <boost/asio.hpp>
 
 // WebRTC
+#include <rtc_base/copy_on_write_buffer.h>
 #include <rtc_base/synchronization/mutex.h>
 
 #include "rtc/rtc_data_manager.h"
 #include "serial_data_channel.h"
+#include "serial_ring_buffer.h"
 
 class SerialDataChannel;
 
+struct SerialDataManagerConfig {
+  std::string device;
+  unsigned int rate = 9600;
+  // false: one DataChannel message per line, without the '\n'
+  // true: the bytes as they come from the device
+  bool raw = false;
+  // Lines (or raw bytes) that come within this time are sent as one message,
+  // lines joined by '\n'. 0 sends every line (every read) right away
+  int batch_ms = 0;
+};
+
 class SerialDataManager : public RTCDataManager {
  public:
-  static std::unique_ptr<SerialDataManager> Create(boost::asio::io_context& ioc,
-                                                   std::string device,
-                                                   unsigned int rate) {
-    std::unique_ptr<SerialDataManager> data_manager(new SerialDataManager(ioc));
-    if (!data_manager->Connect(device, rate)) {
+  // Gets every message sent to the DataChannels, used by momo_serialbench
+  using FrameHandler = std::function<void(const webrtc::CopyOnWriteBuffer&)>;
+
+  static std::unique_ptr<SerialDataManager> Create(
+      boost::asio::io_context& ioc,
+      SerialDataManagerConfig config) {
+    std::unique_ptr<SerialDataManager> data_manager(
+        new SerialDataManager(ioc, config));
+    if (!data_manager->Connect(config.device, config.rate)) {
       return nullptr;
     }
     return data_manager;
   }
   ~SerialDataManager();
 
-  void Send(const uint8_t* data, size_t length);
+  void Send(webrtc::CopyOnWriteBuffer data);
+  void SetFrameHandler(FrameHandler handler);
 
   void OnDataChannel(webrtc::scoped_refptr<webrtc::DataChannelInterface>
                          data_channel) override;
   void OnClosed(SerialDataChannel* serial_data_channel);
 
  private:
-  SerialDataManager(boost::asio::io_context& ioc);
+  SerialDataManager(boost::asio::io_context& ioc,
+                    SerialDataManagerConfig config);
   bool Connect(std::string device, unsigned int rate);
   void DoCloseSerial();
   void DoRead();
   void OnRead(const boost::system::error_code& error, size_t bytes_transferred);
-  void SendLineFromSerial();
-  void StartWrite(std::vector<uint8_t> v);
+  void ScanLines();
+  void AppendLine(size_t length);
+  void AppendRaw();
+  void ScheduleFlush();
+  void Flush();
+  void StartWrite(webrtc::CopyOnWriteBuffer data);
   void DoWrite();
-  void OnWrite(const boost::system::error_code& error);
+  void OnWrite(const boost::system::error_code& error,
+               size_t bytes_transferred);
 
+  SerialDataManagerConfig config_;
   boost::asio::serial_port serial_port_;
   std::function<void(std::function<void()>)> post_;
   webrtc::Mutex channels_lock_;
   std::vector<SerialDataChannel*> serial_data_channels_;
+  FrameHandler frame_handler_;
 
-  std::unique_ptr<uint8_t[]> read_buffer_;
-  size_t read_buffer_size_;
-  std::vector<uint8_t> read_line_buffer_;
+  // Read from the device. In line mode a line longer than the buffer is sent
+  // in pieces
+  SerialRingBuffer read_buffer_;
+  // Where the search for '\n' goes on, the bytes before it have none
+  size_t scan_offset_ = 0;
+  // Next DataChannel message
+  std::vector<uint8_t> batch_;
+  size_t batch_lines_ = 0;
+  boost::asio::steady_timer flush_timer_;
+  bool flush_scheduled_ = false;
 
-  std::vector<uint8_t> write_buffer_;
-  size_t write_length_;
+  SerialRingBuffer write_buffer_;
+  bool writing_ = false;
+  // Sent while writing_ and larger than the free space of write_buffer_
+  std::vector<uint8_t> write_pending_;
 };
 
 #endif
@@ -0,0 +1,117 @@
+#ifndef SERIAL_RING_BUFFER_H_
+#define SERIAL_RING_BUFFER_H_
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <utility>
+#include <vector>
+
+// Byte ring buffer between the serial port and the DataChannels.
+// Reading and writing only move the offsets, so a burst does not shift the
+// bytes that are still waiting. Grow() makes room for more, keeping the
+// content but not the storage: no span may be in use across it.
+class SerialRingBuffer {
+ public:
+  static constexpr size_t npos = static_cast<size_t>(-1);
+
+  explicit SerialRingBuffer(size_t capacity)
+      : data_(new uint8_t[capacity]), capacity_(capacity) {}
+
+  size_t size() const { return size_; }
+  size_t capacity() const { return capacity_; }
+  size_t available() const { return capacity_ - size_; }
+  bool empty() const { return size_ == 0; }
+
+  // Contiguous free space after the content, to read into. Commit() the
+  // bytes that were put there
+  std::pair<uint8_t*, size_t> WritableSpan() {
+    const size_t end = (head_ + size_) % capacity_;
+    const size_t length =
+        end >= head_ && size_ < capacity_ ? capacity_ - end : head_ - end;
+    return {data_.get() + end, std::min(length, available())};
+  }
+  void Commit(size_t length) { size_ += length; }
+
+  // Contiguous content from the start, to write from. Consume() the bytes
+  // that were taken
+  std::pair<const uint8_t*, size_t> ReadableSpan() const {
+    return {data_.get() + head_, std::min(size_, capacity_ - head_)};
+  }
+  void Consume(size_t length) {
+    head_ = (head_ + length) % capacity_;
+    size_ -= length;
+    if (size_ == 0) {
+      // Keeps the next read in one piece
+      head_ = 0;
+    }
+  }
+
+  // Appends, growing the buffer if it does not fit
+  void Append(const uint8_t* data, size_t length) {
+    if (length > available()) {
+      Grow(std::max(capacity_ * 2, size_ + length));
+    }
+    while (length > 0) {
+      auto span = WritableSpan();
+      const size_t n = std::min(span.second, length);
+      std::memcpy(span.first, data, n);
+      Commit(n);
+      data += n;
+      length -= n;
+    }
+  }
+
+  // Offset of the first byte c at or after offset, npos if there is none
+  size_t Find(uint8_t c, size_t offset) const {
+    while (offset < size_) {
+      const size_t pos = (head_ + offset) % capacity_;
+      const size_t length = std::min(size_ - offset, capacity_ - pos);
+      const void* found = std::memchr(data_.get() + pos, c, length);
+      if (found != nullptr) {
+        return offset + (static_cast<const uint8_t*>(found) -
+                         (data_.get() + pos));
+      }
+      offset += length;
+    }
+    return npos;
+  }
+
+  // Appends length bytes from offset to out
+  void CopyTo(size_t offset, size_t length, std::vector<uint8_t>* out) const {
+    while (length > 0) {
+      const size_t pos = (head_ + offset) % capacity_;
+      const size_t n = std::min(length, capacity_ - pos);
+      out->insert(out->end(), data_.get() + pos, data_.get() + pos + n);
+      offset += n;
+      length -= n;
+    }
+  }
+
+  void Grow(size_t capacity) {
+    if (capacity <= capacity_) {
+      return;
+    }
+    std::unique_ptr<uint8_t[]> data(new uint8_t[capacity]);
+    size_t copied = 0;
+    while (copied < size_) {
+      const size_t pos = (head_ + copied) % capacity_;
+      const size_t n = std::min(size_ - copied, capacity_ - pos);
+      std::memcpy(data.get() + copied, data_.get() + pos, n);
+      copied += n;
+    }
+    data_ = std::move(data);
+    capacity_ = capacity;
+    head_ = 0;
+  }
+
+ private:
+  std::unique_ptr<uint8_t[]> data_;
+  size_t capacity_;
+  size_t head_ = 0;
+  size_t size_ = 0;
+};
+
+#endif
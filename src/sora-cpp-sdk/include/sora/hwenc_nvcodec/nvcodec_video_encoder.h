@@ -14,9 +14,12 @@ class NvCodecVideoEncoder : public webrtc::VideoEncoder {
  public:
   static bool IsSupported(std::shared_ptr<CudaContext> cuda_context,
                           CudaVideoCodec codec);
+  // intra_refresh: H.264/H.265 refresh the picture with intra blocks spread
+  // over several frames instead of relying on periodic IDR frames
   static std::unique_ptr<NvCodecVideoEncoder> Create(
       std::shared_ptr<CudaContext> cuda_context,
-      CudaVideoCodec codec);
+      CudaVideoCodec codec,
+      bool intra_refresh = false);
 };
 
 }  // namespace sora
@@ -1,6 +1,7 @@
 #ifndef SORA_OPEN_H264_VIDEO_ENCODER_H_
 #define SORA_OPEN_H264_VIDEO_ENCODER_H_
 
+#include <cstdint>
 #include <memory>
 #include <string>
 
@@ -10,9 +11,55 @@
 
 namespace sora {
 
+// How the encoder is tuned for the kind of video it gets
+enum class OpenH264ContentProfile {
+  // Desktop when WebRTC encodes in screensharing mode, camera otherwise
+  kAuto,
+  kCamera,
+  // Remote desktop: long-term references, scene change and background
+  // detection, no adaptive quantization and a QP range that keeps text sharp
+  kDesktop,
+};
+
+struct OpenH264VideoEncoderConfig {
+  // Path of the OpenH264 shared library
+  std::string openh264;
+  OpenH264ContentProfile content_profile = OpenH264ContentProfile::kAuto;
+  // Trade quality for latency: single reference frame, frame skipping to keep
+  // the bitrate constant, and a key frame at least every 2 seconds
+  bool low_latency = false;
+  // No periodic IDR frames, and key frames requested after loss are coded
+  // with a reduced size budget, with further requests coalesced until the
+  // picture has been refreshed
+  bool intra_refresh = false;
+};
+
+// Reported after every successful InitEncode
+struct OpenH264InitStats {
+  int64_t init_us = 0;
+  // Layer encoders taken initialized from the warm pool of released ones,
+  // and layer encoders that had to be created and initialized
+  int reused_encoders = 0;
+  int created_encoders = 0;
+  // Settings of the low latency profile as applied to the largest layer,
+  // only filled in when low_latency is set
+  bool low_latency = false;
+  bool frame_skip = false;
+  // 0: no periodic key frames
+  double max_gop_seconds = 0;
+  // 0: chosen by OpenH264 (desktop profile)
+  int ref_frames = 0;
+};
+using OpenH264InitCallback = void (*)(const OpenH264InitStats& stats);
+// Process-wide, for metrics; nullptr to disable
+void SetOpenH264InitCallback(OpenH264InitCallback callback);
+
 std::unique_ptr<webrtc::VideoEncoder> CreateOpenH264VideoEncoder(
     const webrtc::SdpVideoFormat& format,
     std::string openh264);
+std::unique_ptr<webrtc::VideoEncoder> CreateOpenH264VideoEncoder(
+    const webrtc::SdpVideoFormat& format,
+    OpenH264VideoEncoderConfig config);
 
 }  // namespace sora
 
@@ -11,12 +11,14 @@
 #define SORA_SCALABLE_VIDEO_TRACK_SOURCE_H_
 
 #include <stddef.h>
+#include <cstdint>
 #include <functional>
 #include <optional>
 
 // WebRTC
 #include <api/media_stream_interface.h>
 #include <api/video/video_frame.h>
+#include <common_video/include/video_frame_buffer_pool.h>
 #include <media/base/adapted_video_track_source.h>
 #include <rtc_base/timestamp_aligner.h>
 
@@ -37,9 +39,28 @@ class ScalableVideoTrackSource : public webrtc::AdaptedVideoTrackSource {
   bool remote() const override;
   bool OnCapturedFrame(const webrtc::VideoFrame& frame);
 
+  // Called for every frame OnCapturedFrame delivers, with the timestamp_us
+  // the frame is delivered with, when it was received and when rotation and
+  // scaling were done (webrtc::TimeMicros()). For frame tracing, process-wide
+  // so that every capturer is covered; nullptr to disable.
+  using TraceCallback = void (*)(int64_t timestamp_us,
+                                 int64_t received_us,
+                                 int64_t adapted_us,
+                                 int width,
+                                 int height);
+  static void SetTraceCallback(TraceCallback callback);
+
+  // Caps the frame rate the source delivers at, 0 removes the cap. Applied by
+  // the adapter of OnCapturedFrame; capturers that pace themselves override
+  // it to capture less often instead.
+  virtual void SetMaxFramerate(int max_framerate);
+
  private:
   ScalableVideoTrackSourceConfig config_;
   webrtc::TimestampAligner timestamp_aligner_;
+  // Rotated and scaled frames. I420 and NV12 frames keep their format, so
+  // that an NV12 capturer feeding an NV12 encoder is never converted here.
+  webrtc::VideoFrameBufferPool buffer_pool_;
 };
 
 }  // namespace sora
@@ -2,6 +2,7 @@
 
 #include "sora/hwenc_nvcodec/nvcodec_video_encoder.h"
 
+#include <algorithm>
 #include <cstddef>
 #include <cstdint>
 #include <memory>
@@ -67,6 +68,11 @@ namespace sora {
 const int kLowH264QpThreshold = 34;
 const int kHighH264QpThreshold = 40;
 
+// Intra refresh: every 2 seconds the whole picture is coded as intra blocks,
+// spread over the frames of half a second instead of a single IDR frame
+const int kIntraRefreshPeriodSeconds = 2;
+const int kIntraRefreshFramesDivisor = 2;
+
 struct nal_entry {
   size_t offset;
   size_t size;
@@ -79,7 +85,8 @@ using Microsoft::WRL::ComPtr;
 class NvCodecVideoEncoderImpl : public NvCodecVideoEncoder {
  public:
   NvCodecVideoEncoderImpl(std::shared_ptr<CudaContext> cuda_context,
-                          CudaVideoCodec codec);
+                          CudaVideoCodec codec,
+                          bool intra_refresh);
   ~NvCodecVideoEncoderImpl() override;
 
   static bool IsSupported(std::shared_ptr<CudaContext> cuda_context,
@@ -104,7 +111,8 @@ class NvCodecVideoEncoderImpl : public NvCodecVideoEncoder {
       int height,
       int framerate,
       int target_bitrate_bps,
-      int max_bitrate_bps
+      int max_bitrate_bps,
+      bool intra_refresh
 #ifdef _WIN32
       ,
       ID3D11Device* id3d11_device,
@@ -131,6 +139,7 @@ class NvCodecVideoEncoderImpl : public NvCodecVideoEncoder {
 
   std::shared_ptr<CudaContext> cuda_context_;
   CudaVideoCodec codec_;
+  bool intra_refresh_;
   std::unique_ptr<NvEncoder> nv_encoder_;
 #ifdef _WIN32
   Microsoft::WRL::ComPtr<ID3D11Device> id3d11_device_;
@@ -157,8 +166,12 @@ class NvCodecVideoEncoderImpl : public NvCodecVideoEncoder {
 
 NvCodecVideoEncoderImpl::NvCodecVideoEncoderImpl(
     std::shared_ptr<CudaContext> cuda_context,
-    CudaVideoCodec codec)
-    : cuda_context_(cuda_context), codec_(codec), bitrate_adjuster_(0.5, 0.95) {
+    CudaVideoCodec codec,
+    bool intra_refresh)
+    : cuda_context_(cuda_context),
+      codec_(codec),
+      intra_refresh_(intra_refresh),
+      bitrate_adjuster_(0.5, 0.95) {
 #ifdef _WIN32
   ComPtr<IDXGIFactory1> idxgi_factory;
   RTC_CHECK(!FAILED(CreateDXGIFactory1(__uuidof(IDXGIFactory1),
@@ -505,14 +518,15 @@ webrtc::VideoEncoder::EncoderInfo NvCodecVideoEncoderImpl::GetEncoderInfo()
 
 int32_t NvCodecVideoEncoderImpl::InitNvEnc() {
 #ifdef _WIN32
-  nv_encoder_ = CreateEncoder(
-      codec_, width_, height_, framerate_, target_bitrate_bps_,
-      max_bitrate_bps_, id3d11_device_.Get(), id3d11_texture_.GetAddressOf());
+  nv_encoder_ = CreateEncoder(codec_, width_, height_, framerate_,
+                              target_bitrate_bps_, max_bitrate_bps_,
+                              intra_refresh_, id3d11_device_.Get(),
+                              id3d11_texture_.GetAddressOf());
 #endif
 #ifdef __linux__
   nv_encoder_ =
       CreateEncoder(codec_, width_, height_, framerate_, target_bitrate_bps_,
-                    max_bitrate_bps_, cuda_.get(), is_nv12_);
+                    max_bitrate_bps_, intra_refresh_, cuda_.get(), is_nv12_);
 #endif
 
   if (nv_encoder_ == nullptr) {
@@ -546,7 +560,8 @@ std::unique_ptr<NvEncoder> NvCodecVideoEncoderImpl::CreateEncoder(
     int height,
     int framerate,
     int target_bitrate_bps,
-    int max_bitrate_bps
+    int max_bitrate_bps,
+    bool intra_refresh
 #ifdef _WIN32
     ,
     ID3D11Device* id3d11_device,
@@ -654,6 +669,34 @@ std::unique_ptr<NvEncoder> NvCodecVideoEncoderImpl::CreateEncoder(
       encode_config.encodeCodecConfig.av1Config.repeatSeqHdr = 1;
     }
 
+    if (intra_refresh && (codec == CudaVideoCodec::H264 ||
+                          codec == CudaVideoCodec::H265)) {
+      const GUID guid = codec == CudaVideoCodec::H264 ? NV_ENC_CODEC_H264_GUID
+                                                      : NV_ENC_CODEC_HEVC_GUID;
+      if (encoder->GetCapabilityValue(guid,
+                                      NV_ENC_CAPS_SUPPORT_INTRA_REFRESH) == 0) {
+        RTC_LOG(LS_WARNING) << __FUNCTION__
+                            << ": intra refresh is not supported by this GPU";
+      } else {
+        const uint32_t period = framerate * kIntraRefreshPeriodSeconds;
+        const uint32_t count =
+            std::max(1, framerate / kIntraRefreshFramesDivisor);
+        if (codec == CudaVideoCodec::H264) {
+          auto& h264 = encode_config.encodeCodecConfig.h264Config;
+          h264.enableIntraRefresh = 1;
+          h264.intraRefreshPeriod = period;
+          h264.intraRefreshCnt = count;
+        } else {
+          auto& hevc = encode_config.encodeCodecConfig.hevcConfig;
+          hevc.enableIntraRefresh = 1;
+          hevc.intraRefreshPeriod = period;
+          hevc.intraRefreshCnt = count;
+        }
+        RTC_LOG(LS_INFO) << __FUNCTION__ << " intra refresh period:" << period
+                         << " count:" << count;
+      }
+    }
+
     encoder->CreateEncoder(&initialize_params);
 
     RTC_LOG(LS_INFO) << __FUNCTION__ << " framerate:" << framerate
@@ -712,14 +755,14 @@ bool NvCodecVideoEncoder::IsSupported(std::shared_ptr<CudaContext> cuda_context,
         id3d11_context.GetAddressOf())));
 
     auto encoder = NvCodecVideoEncoderImpl::CreateEncoder(
-        codec, 640, 480, 30, 100 * 1000, 500 * 1000, id3d11_device.Get(),
+        codec, 640, 480, 30, 100 * 1000, 500 * 1000, false, id3d11_device.Get(),
         id3d11_texture.GetAddressOf());
 #endif
 #ifdef __linux__
     auto cuda = std::unique_ptr<NvCodecVideoEncoderCuda>(
         new NvCodecVideoEncoderCuda(cuda_context));
     auto encoder = NvCodecVideoEncoderImpl::CreateEncoder(
-        codec, 640, 480, 30, 100 * 1000, 500 * 1000, cuda.get(), true);
+        codec, 640, 480, 30, 100 * 1000, 500 * 1000, false, cuda.get(), true);
 #endif
     if (encoder == nullptr) {
       return false;
@@ -734,9 +777,10 @@ bool NvCodecVideoEncoder::IsSupported(std::shared_ptr<CudaContext> cuda_context,
 
 std::unique_ptr<NvCodecVideoEncoder> NvCodecVideoEncoder::Create(
     std::shared_ptr<CudaContext> cuda_context,
-    CudaVideoCodec codec) {
+    CudaVideoCodec codec,
+    bool intra_refresh) {
   return std::unique_ptr<NvCodecVideoEncoder>(
-      new NvCodecVideoEncoderImpl(cuda_context, codec));
+      new NvCodecVideoEncoderImpl(cuda_context, codec, intra_refresh));
 }
 
 }  // namespace sora
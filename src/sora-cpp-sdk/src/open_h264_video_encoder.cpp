@@ -15,11 +15,16 @@
 #include "sora/open_h264_video_encoder.h"
 
 #include <algorithm>
+#include <atomic>
+#include <condition_variable>
 #include <cstddef>
 #include <cstdint>
 #include <cstring>
+#include <functional>
 #include <limits>
+#include <map>
 #include <memory>
+#include <mutex>
 #include <optional>
 #include <string>
 #include <utility>
@@ -37,6 +42,7 @@
 #include <absl/container/inlined_vector.h>
 #include <absl/memory/memory.h>
 #include <api/environment/environment.h>
+#include <api/array_view.h>
 #include <api/environment/environment_factory.h>
 #include <api/scoped_refptr.h>
 #include <api/units/data_rate.h>
@@ -54,6 +60,7 @@
 #include <api/video_codecs/video_codec.h>
 #include <api/video_codecs/video_encoder.h>
 #include <common_video/h264/h264_bitstream_parser.h>
+#include <common_video/h264/h264_common.h>
 #include <common_video/libyuv/include/webrtc_libyuv.h>
 #include <media/base/media_constants.h>
 #include <modules/video_coding/codecs/h264/include/h264.h>
@@ -67,6 +74,10 @@
 #include <modules/video_coding/utility/simulcast_utility.h>
 #include <rtc_base/checks.h>
 #include <rtc_base/logging.h>
+#include <rtc_base/platform_thread.h>
+#include <rtc_base/ref_counted_object.h>
+#include <rtc_base/time_utils.h>
+#include <system_wrappers/include/clock.h>
 #include <system_wrappers/include/metrics.h>
 
 // libyuv
@@ -82,6 +93,34 @@ class ISVCEncoder;
 
 namespace webrtc {
 
+class OpenH264LayerWorkerPool;
+class OpenH264Library;
+class OpenH264EncodedBufferPool;
+
+// Everything an initialized layer encoder depends on, except the bitrate
+// and frame rate that SetRates() changes anyway. An idle encoder with the
+// same key can be reused without InitializeExt.
+struct OpenH264EncoderKey {
+  int width = 0;
+  int height = 0;
+  float max_frame_rate = 0;
+  bool frame_dropping_on = false;
+  int key_frame_interval = 0;
+  int num_temporal_layers = 1;
+  VideoCodecMode mode = VideoCodecMode::kRealtimeVideo;
+  H264PacketizationMode packetization_mode =
+      H264PacketizationMode::NonInterleaved;
+  size_t max_payload_size = 0;
+  int number_of_cores = 0;
+  std::optional<int> encoder_thread_limit;
+  sora::OpenH264ContentProfile content_profile =
+      sora::OpenH264ContentProfile::kAuto;
+  bool low_latency = false;
+  bool intra_refresh = false;
+
+  bool operator==(const OpenH264EncoderKey&) const = default;
+};
+
 class OpenH264VideoEncoder : public VideoEncoder {
  public:
   struct LayerConfig {
@@ -102,7 +141,7 @@ class OpenH264VideoEncoder : public VideoEncoder {
 
   OpenH264VideoEncoder(const Environment& env,
                        H264EncoderSettings settings,
-                       std::string openh264);
+                       sora::OpenH264VideoEncoderConfig config);
 
   ~OpenH264VideoEncoder() override;
 
@@ -135,13 +174,25 @@ class OpenH264VideoEncoder : public VideoEncoder {
 
  private:
   SEncParamExt CreateEncoderParams(size_t i) const;
+  OpenH264EncoderKey CreateEncoderKey(size_t i) const;
+  bool UseDesktopProfile() const;
 
-  webrtc::H264BitstreamParser h264_bitstream_parser_;
+  // Runs on the pool threads for every layer that is encoded this frame
+  void EncodeLayer(size_t i, const VideoFrame& input_frame);
+
+  // One per layer, the layers are encoded concurrently
+  std::vector<std::unique_ptr<webrtc::H264BitstreamParser>>
+      h264_bitstream_parsers_;
+  std::vector<std::unique_ptr<OpenH264EncodedBufferPool>>
+      encoded_buffer_pools_;
   // Reports statistics with histograms.
   void ReportInit();
   void ReportError();
 
   std::vector<ISVCEncoder*> encoders_;
+  // Key of each initialized encoder, nullopt until InitializeExt succeeded.
+  // Release() hands the initialized ones to the warm pool.
+  std::vector<std::optional<OpenH264EncoderKey>> encoder_keys_;
   std::vector<SSourcePicture> pictures_;
   std::vector<webrtc::scoped_refptr<I420Buffer>> downscaled_buffers_;
   std::vector<LayerConfig> configurations_;
@@ -163,20 +214,35 @@ class OpenH264VideoEncoder : public VideoEncoder {
 
   std::vector<uint8_t> tl0sync_limit_;
 
+  // Per-layer state of the frame being encoded
+  std::vector<bool> layer_active_;
+  std::vector<bool> layer_key_frame_;
+  // Intra refresh mode: the key frame of this encode is a loss recovery one
+  // that runs with a reduced bitrate, and until when further requests are
+  // served by it
+  std::vector<bool> layer_recovery_;
+  std::vector<int64_t> layer_refresh_until_ms_;
+  // Desktop profile: frames encoded since the capturer last reported a
+  // change, and the last encode, to skip frames where nothing changed
+  std::vector<int> layer_static_frames_;
+  std::vector<int> layer_last_qp_;
+  std::vector<int64_t> layer_last_encode_ms_;
+  std::vector<std::vector<ScalableVideoController::LayerFrameConfig>>
+      layer_frames_;
+  std::vector<SFrameBSInfo> layer_infos_;
+  std::vector<int> layer_results_;
+  // Encodes simulcast layers in parallel, kept across InitEncode
+  std::unique_ptr<OpenH264LayerWorkerPool> layer_pool_;
+
  private:
   bool InitOpenH264();
   void ReleaseOpenH264();
 
   std::string openh264_;
-#if defined(_WIN32)
-  HMODULE openh264_handle_ = nullptr;
-#else
-  void* openh264_handle_ = nullptr;
-#endif
-  using CreateEncoderFunc = int (*)(ISVCEncoder**);
-  using DestroyEncoderFunc = void (*)(ISVCEncoder*);
-  CreateEncoderFunc create_encoder_ = nullptr;
-  DestroyEncoderFunc destroy_encoder_ = nullptr;
+  sora::OpenH264ContentProfile content_profile_;
+  bool low_latency_;
+  bool intra_refresh_;
+  std::shared_ptr<OpenH264Library> library_;
 };
 
 }  // namespace webrtc
@@ -191,6 +257,48 @@ const bool kOpenH264EncoderDetailedLogging = false;
 static const int kLowH264QpThreshold = 24;
 static const int kHighH264QpThreshold = 37;
 
+// Longest key frame interval in low latency mode
+static const float kLowLatencyGopSeconds = 2.0f;
+
+// Intra refresh mode.
+// A key frame requested after loss is coded with this share of the target
+// bitrate, so that it is not several times larger than a P frame. The
+// following P frames bring the quality back.
+static const float kRecoveryBitrateRatio = 0.5f;
+// Requests arriving this long after a recovery key frame are answered by it.
+// The receiver keeps asking until the key frame has arrived, and a second
+// one right behind the first only adds to the burst.
+static const int64_t kRecoveryCycleMs = 500;
+
+// Desktop profile.
+// Below kDesktopMinQp static content only burns bits that the next scroll or
+// window switch needs, above kDesktopMaxQp small text gets unreadable, so the
+// rate controller skips frames instead.
+static const int kDesktopMinQp = 16;
+static const int kDesktopMaxQp = 38;
+// Long-term references: windows that are switched back to are predicted from
+// the old picture instead of being coded as intra blocks.
+static const int kDesktopLtrRefNum = 2;
+static const int kDesktopLtrMarkPeriod = 30;
+// Frames that the capturer reports as unchanged (empty update rect) are not
+// encoded once the picture has settled: after this many frames without a
+// change, which refine the quality of the last change, or right away when the
+// last frame already had the lowest QP. The receiver keeps showing the same
+// picture anyway.
+static const int kDesktopRefineFrames = 8;
+// Still encode now and then, so that the receiver does not see a stalled
+// stream
+static const int64_t kDesktopMaxStaticSkipMs = 1000;
+
+// Warm pool: initialized layer encoders kept after Release() for the next
+// InitEncode() with the same parameters, e.g. after a renegotiation or a new
+// connection. One 1080p encoder holds some tens of MB, so only a few are kept
+// and only for a while.
+static const size_t kMaxIdleEncoders = 4;
+static const int64_t kIdleEncoderTimeoutMs = 30000;
+
+std::atomic<sora::OpenH264InitCallback> g_init_callback{nullptr};
+
 // Used by histograms. Values of entries should not be changed.
 enum H264EncoderImplEvent {
   kH264EncoderEventInit = 0,
@@ -261,16 +369,327 @@ std::optional<ScalabilityMode> ScalabilityModeFromTemporalLayers(
 
 }  // namespace
 
+// Persistent threads that encode the simulcast layers of one frame in
+// parallel. The calling thread takes part too, so N layers need N - 1 threads.
+class OpenH264LayerWorkerPool {
+ public:
+  explicit OpenH264LayerWorkerPool(size_t num_threads) {
+    for (size_t i = 0; i < num_threads; ++i) {
+      threads_.push_back(webrtc::PlatformThread::SpawnJoinable(
+          [this] { WorkerLoop(); }, "OpenH264LayerThread",
+          webrtc::ThreadAttributes().SetPriority(
+              webrtc::ThreadPriority::kHigh)));
+    }
+  }
+  ~OpenH264LayerWorkerPool() {
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      stop_ = true;
+    }
+    start_cv_.notify_all();
+    for (auto& thread : threads_) {
+      thread.Finalize();
+    }
+  }
+
+  size_t num_threads() const { return threads_.size(); }
+
+  // Calls task(i) for every i in [0, count) and returns when all are done
+  void Run(size_t count, const std::function<void(size_t)>& task) {
+    std::unique_lock<std::mutex> lock(mutex_);
+    task_ = &task;
+    next_ = 0;
+    count_ = count;
+    remaining_ = count;
+    start_cv_.notify_all();
+    RunTasks(lock);
+    done_cv_.wait(lock, [this] { return remaining_ == 0; });
+    task_ = nullptr;
+  }
+
+ private:
+  // Takes tasks until none are left to start. `lock` is held on entry/exit.
+  void RunTasks(std::unique_lock<std::mutex>& lock) {
+    while (task_ != nullptr && next_ < count_) {
+      const size_t i = next_++;
+      const auto* task = task_;
+      lock.unlock();
+      (*task)(i);
+      lock.lock();
+      if (--remaining_ == 0) {
+        done_cv_.notify_all();
+      }
+    }
+  }
+
+  void WorkerLoop() {
+    std::unique_lock<std::mutex> lock(mutex_);
+    while (true) {
+      start_cv_.wait(lock, [this] {
+        return stop_ || (task_ != nullptr && next_ < count_);
+      });
+      if (stop_) {
+        return;
+      }
+      RunTasks(lock);
+    }
+  }
+
+  std::vector<webrtc::PlatformThread> threads_;
+  std::mutex mutex_;
+  std::condition_variable start_cv_;
+  std::condition_variable done_cv_;
+  const std::function<void(size_t)>* task_ = nullptr;
+  size_t next_ = 0;
+  size_t count_ = 0;
+  size_t remaining_ = 0;
+  bool stop_ = false;
+};
+
+// The OpenH264 shared library, loaded once per path for the whole process.
+// Every encoder and every idle encoder of the warm pool holds a reference,
+// it is unloaded with the last one.
+class OpenH264Library {
+ public:
+  static std::shared_ptr<OpenH264Library> Load(const std::string& path) {
+    static std::mutex mutex;
+    static std::map<std::string, std::weak_ptr<OpenH264Library>> libraries;
+    std::lock_guard<std::mutex> lock(mutex);
+    auto& entry = libraries[path];
+    if (auto library = entry.lock()) {
+      return library;
+    }
+    auto library = std::shared_ptr<OpenH264Library>(new OpenH264Library());
+    if (!library->Open(path)) {
+      return nullptr;
+    }
+    entry = library;
+    return library;
+  }
+
+  ~OpenH264Library() {
+    if (handle_ != nullptr) {
+#if defined(_WIN32)
+      FreeLibrary(handle_);
+#else
+      ::dlclose(handle_);
+#endif
+    }
+  }
+
+  int CreateEncoder(ISVCEncoder** encoder) const {
+    return create_encoder_(encoder);
+  }
+  void DestroyEncoder(ISVCEncoder* encoder) const {
+    RTC_CHECK_EQ(0, encoder->Uninitialize());
+    destroy_encoder_(encoder);
+  }
+
+ private:
+  OpenH264Library() = default;
+
+  bool Open(const std::string& path) {
+#if defined(_WIN32)
+    HMODULE handle = LoadLibraryA(path.c_str());
+#else
+    void* handle = ::dlopen(path.c_str(), RTLD_LAZY);
+#endif
+    if (handle == nullptr) {
+      return false;
+    }
+#if defined(_WIN32)
+    create_encoder_ =
+        (CreateEncoderFunc)::GetProcAddress(handle, "WelsCreateSVCEncoder");
+    destroy_encoder_ =
+        (DestroyEncoderFunc)::GetProcAddress(handle, "WelsDestroySVCEncoder");
+    if (create_encoder_ == nullptr || destroy_encoder_ == nullptr) {
+      FreeLibrary(handle);
+      return false;
+    }
+#else
+    create_encoder_ =
+        (CreateEncoderFunc)::dlsym(handle, "WelsCreateSVCEncoder");
+    destroy_encoder_ =
+        (DestroyEncoderFunc)::dlsym(handle, "WelsDestroySVCEncoder");
+    if (create_encoder_ == nullptr || destroy_encoder_ == nullptr) {
+      ::dlclose(handle);
+      return false;
+    }
+#endif
+    handle_ = handle;
+    return true;
+  }
+
+#if defined(_WIN32)
+  HMODULE handle_ = nullptr;
+#else
+  void* handle_ = nullptr;
+#endif
+  using CreateEncoderFunc = int (*)(ISVCEncoder**);
+  using DestroyEncoderFunc = void (*)(ISVCEncoder*);
+  CreateEncoderFunc create_encoder_ = nullptr;
+  DestroyEncoderFunc destroy_encoder_ = nullptr;
+};
+
+// Idle initialized encoders of all OpenH264VideoEncoder instances, so that
+// they also survive WebRTC destroying the VideoEncoder on a new connection.
+// Expired encoders are destroyed on the next Take() / Put().
+class OpenH264EncoderPool {
+ public:
+  static OpenH264EncoderPool& Instance() {
+    // Never destroyed: the encoders would have to be destroyed after the
+    // library registry at exit
+    static auto* instance = new OpenH264EncoderPool();
+    return *instance;
+  }
+
+  // An idle encoder of `library` initialized with `key`, nullptr if none
+  ISVCEncoder* Take(const std::shared_ptr<OpenH264Library>& library,
+                    const OpenH264EncoderKey& key) {
+    std::vector<Idle> expired;
+    ISVCEncoder* encoder = nullptr;
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      expired = RemoveExpired();
+      // The most recently used one
+      for (auto it = idle_.rbegin(); it != idle_.rend(); ++it) {
+        if (it->library == library && it->key == key) {
+          encoder = it->encoder;
+          idle_.erase(std::next(it).base());
+          break;
+        }
+      }
+    }
+    Destroy(expired);
+    return encoder;
+  }
+
+  void Put(std::shared_ptr<OpenH264Library> library,
+           const OpenH264EncoderKey& key,
+           ISVCEncoder* encoder) {
+    std::vector<Idle> expired;
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      expired = RemoveExpired();
+      idle_.push_back({std::move(library), key, encoder, TimeMillis()});
+      if (idle_.size() > kMaxIdleEncoders) {
+        expired.push_back(std::move(idle_.front()));
+        idle_.erase(idle_.begin());
+      }
+    }
+    Destroy(expired);
+  }
+
+ private:
+  struct Idle {
+    std::shared_ptr<OpenH264Library> library;
+    OpenH264EncoderKey key;
+    ISVCEncoder* encoder;
+    int64_t idle_since_ms;
+  };
+
+  // `mutex_` is held
+  std::vector<Idle> RemoveExpired() {
+    std::vector<Idle> expired;
+    const int64_t now_ms = TimeMillis();
+    // Oldest first
+    while (!idle_.empty() &&
+           now_ms - idle_.front().idle_since_ms >= kIdleEncoderTimeoutMs) {
+      expired.push_back(std::move(idle_.front()));
+      idle_.erase(idle_.begin());
+    }
+    return expired;
+  }
+
+  // Outside of `mutex_`, Uninitialize() joins the encoder threads
+  static void Destroy(std::vector<Idle>& encoders) {
+    for (auto& idle : encoders) {
+      idle.library->DestroyEncoder(idle.encoder);
+    }
+  }
+
+  std::mutex mutex_;
+  std::vector<Idle> idle_;
+};
+
+// Buffers for the encoded frames of one layer. OpenH264 overwrites its own
+// output buffer with the next frame, so the bytes have to be copied out, but
+// not into a fresh allocation every frame: a buffer is reused once WebRTC has
+// released the frame that was in it. New buffers are sized by the largest
+// recent frame, so that a buffer rarely has to grow.
+class OpenH264EncodedBufferPool {
+ public:
+  // A buffer of `size` bytes, for exactly the encoded frame
+  scoped_refptr<EncodedImageBufferInterface> Get(size_t size) {
+    // Peak of the recent frames, decaying by 1/64 per frame
+    recent_peak_ = std::max(size, recent_peak_ - recent_peak_ / 64);
+    const size_t capacity = recent_peak_ + recent_peak_ / 4;
+
+    for (auto& buffer : buffers_) {
+      // Still referenced by a frame that is being sent
+      if (!buffer->HasOneRef()) {
+        continue;
+      }
+      // Grow it, or shrink it when a key frame burst is long over
+      if (buffer->capacity() < size || buffer->capacity() > capacity * 4) {
+        buffer->Reset(capacity);
+      }
+      buffer->set_size(size);
+      return buffer;
+    }
+    scoped_refptr<RefCountedObject<Buffer>> buffer(
+        new RefCountedObject<Buffer>(capacity));
+    buffer->set_size(size);
+    if (buffers_.size() < kMaxBuffers) {
+      buffers_.push_back(buffer);
+    }
+    return buffer;
+  }
+
+ private:
+  // Frames in flight per layer; more only while the send side lags
+  static constexpr size_t kMaxBuffers = 4;
+
+  class Buffer : public EncodedImageBufferInterface {
+   public:
+    explicit Buffer(size_t capacity) { Reset(capacity); }
+    const uint8_t* data() const override { return data_.get(); }
+    uint8_t* data() override { return data_.get(); }
+    // The encoded frame, GetEncodedData() readers must not see the rest
+    size_t size() const override { return size_; }
+    size_t capacity() const { return capacity_; }
+    void set_size(size_t size) {
+      RTC_DCHECK_LE(size, capacity_);
+      size_ = size;
+    }
+    // Not zero-filled, the encoded bytes are copied over it
+    void Reset(size_t capacity) {
+      data_.reset(new uint8_t[capacity]);
+      capacity_ = capacity;
+      size_ = 0;
+    }
+
+   private:
+    std::unique_ptr<uint8_t[]> data_;
+    size_t capacity_ = 0;
+    size_t size_ = 0;
+  };
+
+  std::vector<scoped_refptr<RefCountedObject<Buffer>>> buffers_;
+  size_t recent_peak_ = 0;
+};
+
 // Helper method used by OpenH264VideoEncoder::Encode.
-// Copies the encoded bytes from `info` to `encoded_image`. The
-// `encoded_image->_buffer` may be deleted and reallocated if a bigger buffer is
-// required.
+// Copies the encoded bytes from `info` to `encoded_image`, into a buffer of
+// `buffer_pool`.
 //
 // After OpenH264 encoding, the encoded bytes are stored in `info` spread out
 // over a number of layers and "NAL units". Each NAL unit is a fragment starting
 // with the four-byte start code {0,0,0,1}. All of this data (including the
 // start codes) is copied to the `encoded_image->_buffer`.
-static void RtpFragmentize(EncodedImage* encoded_image, SFrameBSInfo* info) {
+static void RtpFragmentize(EncodedImage* encoded_image,
+                           SFrameBSInfo* info,
+                           OpenH264EncodedBufferPool* buffer_pool) {
   // Calculate minimum buffer size required to hold encoded data.
   size_t required_capacity = 0;
   size_t fragments_count = 0;
@@ -284,7 +703,14 @@ static void RtpFragmentize(EncodedImage* encoded_image, SFrameBSInfo* info) {
       required_capacity += layerInfo.pNalLengthInByte[nal];
     }
   }
-  auto buffer = EncodedImageBuffer::Create(required_capacity);
+  // Let go of the previous frame first, so that its buffer can be reused if
+  // WebRTC is done with it
+  encoded_image->ClearEncodedData();
+  if (required_capacity == 0) {
+    // Skipped by the rate controller
+    return;
+  }
+  auto buffer = buffer_pool->Get(required_capacity);
   encoded_image->SetEncodedData(buffer);
 
   // Iterate layers and NAL units, note each NAL unit as a fragment and copy
@@ -312,9 +738,55 @@ static void RtpFragmentize(EncodedImage* encoded_image, SFrameBSInfo* info) {
   }
 }
 
-OpenH264VideoEncoder::OpenH264VideoEncoder(const Environment& env,
-                                           H264EncoderSettings settings,
-                                           std::string openh264)
+// QP of the last slice of the frame in `info`, like
+// H264BitstreamParser::ParseBitstream on the whole frame but without scanning
+// the slice data for start codes: OpenH264 reports where each NAL unit is, and
+// the QP is in the slice header at the start of the NAL unit. Parameter sets
+// are passed whole, the parser needs them to read the slice headers.
+static std::optional<int> ParseLastSliceQp(H264BitstreamParser* parser,
+                                           const SFrameBSInfo& info) {
+  // Slice header up to slice_qp_delta, with room for long reference list
+  // modifications and memory management operations
+  constexpr size_t kSliceHeaderBytes = 64;
+  // Start code and NAL unit header
+  constexpr size_t kNalHeaderBytes = 5;
+
+  ArrayView<const uint8_t> last_slice;
+  for (int layer = 0; layer < info.iLayerNum; ++layer) {
+    const SLayerBSInfo& layer_info = info.sLayerInfo[layer];
+    const uint8_t* nal_data = layer_info.pBsBuf;
+    for (int nal = 0; nal < layer_info.iNalCount; ++nal) {
+      const size_t nal_size = layer_info.pNalLengthInByte[nal];
+      if (nal_size >= kNalHeaderBytes) {
+        switch (static_cast<H264::NaluType>(nal_data[4] & 0x1f)) {
+          case H264::NaluType::kSps:
+          case H264::NaluType::kPps:
+            parser->ParseBitstream(
+                ArrayView<const uint8_t>(nal_data, nal_size));
+            break;
+          case H264::NaluType::kSlice:
+          case H264::NaluType::kIdr:
+            last_slice = ArrayView<const uint8_t>(
+                nal_data, std::min(nal_size, kSliceHeaderBytes));
+            break;
+          default:
+            break;
+        }
+      }
+      nal_data += nal_size;
+    }
+  }
+  if (last_slice.empty()) {
+    return std::nullopt;
+  }
+  parser->ParseBitstream(last_slice);
+  return parser->GetLastSliceQp();
+}
+
+OpenH264VideoEncoder::OpenH264VideoEncoder(
+    const Environment& env,
+    H264EncoderSettings settings,
+    sora::OpenH264VideoEncoderConfig config)
     : env_(env),
       packetization_mode_(settings.packetization_mode),
       max_payload_size_(0),
@@ -322,7 +794,10 @@ OpenH264VideoEncoder::OpenH264VideoEncoder(const Environment& env,
       encoded_image_callback_(nullptr),
       has_reported_init_(false),
       has_reported_error_(false),
-      openh264_(std::move(openh264)) {
+      openh264_(std::move(config.openh264)),
+      content_profile_(config.content_profile),
+      low_latency_(config.low_latency),
+      intra_refresh_(config.intra_refresh) {
   downscaled_buffers_.reserve(kMaxSimulcastStreams - 1);
   encoded_images_.reserve(kMaxSimulcastStreams);
   encoders_.reserve(kMaxSimulcastStreams);
@@ -337,62 +812,20 @@ OpenH264VideoEncoder::~OpenH264VideoEncoder() {
 }
 
 bool OpenH264VideoEncoder::InitOpenH264() {
-  if (openh264_handle_ != nullptr) {
-    return true;
-  }
-
-#if defined(_WIN32)
-  HMODULE handle = LoadLibraryA(openh264_.c_str());
-#else
-  void* handle = ::dlopen(openh264_.c_str(), RTLD_LAZY);
-#endif
-  if (handle == nullptr) {
-    return false;
-  }
-#if defined(_WIN32)
-  create_encoder_ =
-      (CreateEncoderFunc)::GetProcAddress(handle, "WelsCreateSVCEncoder");
-  if (create_encoder_ == nullptr) {
-    FreeLibrary(handle);
-    return false;
-  }
-  destroy_encoder_ =
-      (DestroyEncoderFunc)::GetProcAddress(handle, "WelsDestroySVCEncoder");
-  if (destroy_encoder_ == nullptr) {
-    FreeLibrary(handle);
-    return false;
-  }
-#else
-  create_encoder_ = (CreateEncoderFunc)::dlsym(handle, "WelsCreateSVCEncoder");
-  if (create_encoder_ == nullptr) {
-    ::dlclose(handle);
-    return false;
-  }
-  destroy_encoder_ =
-      (DestroyEncoderFunc)::dlsym(handle, "WelsDestroySVCEncoder");
-  if (destroy_encoder_ == nullptr) {
-    ::dlclose(handle);
-    return false;
+  if (library_ == nullptr) {
+    library_ = OpenH264Library::Load(openh264_);
   }
-#endif
-  openh264_handle_ = handle;
-  return true;
+  return library_ != nullptr;
 }
 
 void OpenH264VideoEncoder::ReleaseOpenH264() {
-  if (openh264_handle_ != nullptr) {
-#if defined(_WIN32)
-    FreeLibrary(openh264_handle_);
-#else
-    ::dlclose(openh264_handle_);
-#endif
-    openh264_handle_ = nullptr;
-  }
+  library_.reset();
 }
 
 int32_t OpenH264VideoEncoder::InitEncode(
     const VideoCodec* inst,
     const VideoEncoder::Settings& settings) {
+  const int64_t init_start_us = TimeMicros();
   ReportInit();
   if (!inst || inst->codecType != kVideoCodecH264) {
     ReportError();
@@ -428,17 +861,45 @@ int32_t OpenH264VideoEncoder::InitEncode(
   downscaled_buffers_.resize(number_of_streams - 1);
   encoded_images_.resize(number_of_streams);
   encoders_.resize(number_of_streams);
+  encoder_keys_.resize(number_of_streams);
   pictures_.resize(number_of_streams);
   svc_controllers_.resize(number_of_streams);
   scalability_modes_.resize(number_of_streams);
   configurations_.resize(number_of_streams);
   tl0sync_limit_.resize(number_of_streams);
+  h264_bitstream_parsers_.resize(number_of_streams);
+  for (auto& parser : h264_bitstream_parsers_) {
+    parser = std::make_unique<webrtc::H264BitstreamParser>();
+  }
+  encoded_buffer_pools_.resize(number_of_streams);
+  for (auto& pool : encoded_buffer_pools_) {
+    pool = std::make_unique<OpenH264EncodedBufferPool>();
+  }
+  layer_active_.assign(number_of_streams, false);
+  layer_key_frame_.assign(number_of_streams, false);
+  layer_recovery_.assign(number_of_streams, false);
+  layer_refresh_until_ms_.assign(number_of_streams, 0);
+  layer_static_frames_.assign(number_of_streams, 0);
+  layer_last_qp_.assign(number_of_streams, -1);
+  layer_last_encode_ms_.assign(number_of_streams,
+                               std::numeric_limits<int64_t>::min() / 2);
+  layer_frames_.resize(number_of_streams);
+  layer_infos_.resize(number_of_streams);
+  layer_results_.assign(number_of_streams, 0);
 
   max_payload_size_ = settings.max_payload_size;
   number_of_cores_ = settings.number_of_cores;
   encoder_thread_limit_ = settings.encoder_thread_limit;
   codec_ = *inst;
 
+  const size_t pool_threads =
+      number_of_cores_ > 1 ? static_cast<size_t>(number_of_streams - 1) : 0;
+  if (pool_threads == 0) {
+    layer_pool_.reset();
+  } else if (!layer_pool_ || layer_pool_->num_threads() != pool_threads) {
+    layer_pool_ = std::make_unique<OpenH264LayerWorkerPool>(pool_threads);
+  }
+
   // Code expects simulcastStream resolutions to be correct, make sure they are
   // filled even when there are no simulcast layers.
   if (codec_.numberOfSimulcastStreams == 0) {
@@ -446,28 +907,9 @@ int32_t OpenH264VideoEncoder::InitEncode(
     codec_.simulcastStream[0].height = codec_.height;
   }
 
+  sora::OpenH264InitStats stats;
   for (int i = 0, idx = number_of_streams - 1; i < number_of_streams;
        ++i, --idx) {
-    ISVCEncoder* openh264_encoder;
-    // Create encoder.
-    if (create_encoder_(&openh264_encoder) != 0) {
-      // Failed to create encoder.
-      RTC_LOG(LS_ERROR) << "Failed to create OpenH264 encoder";
-      RTC_DCHECK(!openh264_encoder);
-      Release();
-      ReportError();
-      return WEBRTC_VIDEO_CODEC_ERROR;
-    }
-    RTC_DCHECK(openh264_encoder);
-    if (kOpenH264EncoderDetailedLogging) {
-      int trace_level = WELS_LOG_DETAIL;
-      openh264_encoder->SetOption(ENCODER_OPTION_TRACE_LEVEL, &trace_level);
-    }
-    // else WELS_LOG_DEFAULT is used by default.
-
-    // Store h264 encoder.
-    encoders_[i] = openh264_encoder;
-
     // Set internal settings from codec_settings
     configurations_[i].simulcast_idx = idx;
     configurations_[i].sending = false;
@@ -492,26 +934,55 @@ int32_t OpenH264VideoEncoder::InitEncode(
     configurations_[i].max_bps = codec_.maxBitrate * 1000;
     configurations_[i].target_bps = codec_.startBitrate * 1000;
 
-    // Create encoder parameters based on the layer configuration.
-    SEncParamExt encoder_params = CreateEncoderParams(i);
+    // An encoder that was released with the same parameters only needs the
+    // rates of SetRates() below, and starts with a key frame like a new one
+    const OpenH264EncoderKey key = CreateEncoderKey(i);
+    if (ISVCEncoder* pooled =
+            OpenH264EncoderPool::Instance().Take(library_, key)) {
+      encoders_[i] = pooled;
+      encoder_keys_[i] = key;
+      stats.reused_encoders++;
+    } else {
+      ISVCEncoder* openh264_encoder;
+      // Create encoder.
+      if (library_->CreateEncoder(&openh264_encoder) != 0) {
+        // Failed to create encoder.
+        RTC_LOG(LS_ERROR) << "Failed to create OpenH264 encoder";
+        RTC_DCHECK(!openh264_encoder);
+        Release();
+        ReportError();
+        return WEBRTC_VIDEO_CODEC_ERROR;
+      }
+      RTC_DCHECK(openh264_encoder);
+      if (kOpenH264EncoderDetailedLogging) {
+        int trace_level = WELS_LOG_DETAIL;
+        openh264_encoder->SetOption(ENCODER_OPTION_TRACE_LEVEL, &trace_level);
+      }
+      // else WELS_LOG_DEFAULT is used by default.
+
+      // Store h264 encoder.
+      encoders_[i] = openh264_encoder;
 
-    // Initialize.
-    if (openh264_encoder->InitializeExt(&encoder_params) != 0) {
-      RTC_LOG(LS_ERROR) << "Failed to initialize OpenH264 encoder";
-      Release();
-      ReportError();
-      return WEBRTC_VIDEO_CODEC_ERROR;
+      // Create encoder parameters based on the layer configuration.
+      SEncParamExt encoder_params = CreateEncoderParams(i);
+
+      // Initialize.
+      if (openh264_encoder->InitializeExt(&encoder_params) != 0) {
+        RTC_LOG(LS_ERROR) << "Failed to initialize OpenH264 encoder";
+        Release();
+        ReportError();
+        return WEBRTC_VIDEO_CODEC_ERROR;
+      }
+      encoder_keys_[i] = key;
+      stats.created_encoders++;
     }
+    ISVCEncoder* openh264_encoder = encoders_[i];
     // TODO(pbos): Base init params on these values before submitting.
     int video_format = EVideoFormatType::videoFormatI420;
     openh264_encoder->SetOption(ENCODER_OPTION_DATAFORMAT, &video_format);
 
-    // Initialize encoded image. Default buffer size: size of unencoded data.
-
-    const size_t new_capacity =
-        CalcBufferSize(VideoType::kI420, codec_.simulcastStream[idx].width,
-                       codec_.simulcastStream[idx].height);
-    encoded_images_[i].SetEncodedData(EncodedImageBuffer::Create(new_capacity));
+    // Initialize encoded image. The buffers come from encoded_buffer_pools_
+    // when there is something to copy into them.
     encoded_images_[i]._encodedWidth = codec_.simulcastStream[idx].width;
     encoded_images_[i]._encodedHeight = codec_.simulcastStream[idx].height;
     encoded_images_[i].set_size(0);
@@ -535,18 +1006,38 @@ int32_t OpenH264VideoEncoder::InitEncode(
       init_allocator.Allocate(VideoBitrateAllocationParameters(
           DataRate::KilobitsPerSec(codec_.startBitrate), codec_.maxFramerate));
   SetRates(RateControlParameters(allocation, codec_.maxFramerate));
+
+  if (low_latency_ && !encoders_.empty()) {
+    const SEncParamExt params = CreateEncoderParams(0);
+    stats.low_latency = true;
+    stats.frame_skip = params.bEnableFrameSkip;
+    stats.max_gop_seconds = params.fMaxFrameRate > 0
+                                ? params.uiIntraPeriod / params.fMaxFrameRate
+                                : 0;
+    stats.ref_frames = std::max(0, params.iNumRefFrame);
+  }
+  stats.init_us = TimeMicros() - init_start_us;
+  RTC_LOG(LS_INFO) << "OpenH264 InitEncode took " << stats.init_us
+                   << "us, reused_encoders=" << stats.reused_encoders
+                   << " created_encoders=" << stats.created_encoders;
+  if (auto callback = g_init_callback.load(std::memory_order_relaxed)) {
+    callback(stats);
+  }
   return WEBRTC_VIDEO_CODEC_OK;
 }
 
 int32_t OpenH264VideoEncoder::Release() {
   while (!encoders_.empty()) {
     ISVCEncoder* openh264_encoder = encoders_.back();
-    if (openh264_encoder) {
-      RTC_CHECK_EQ(0, openh264_encoder->Uninitialize());
-      destroy_encoder_(openh264_encoder);
+    const auto& key = encoder_keys_[encoders_.size() - 1];
+    if (openh264_encoder && key) {
+      OpenH264EncoderPool::Instance().Put(library_, *key, openh264_encoder);
+    } else if (openh264_encoder) {
+      library_->DestroyEncoder(openh264_encoder);
     }
     encoders_.pop_back();
   }
+  encoder_keys_.clear();
   downscaled_buffers_.clear();
   configurations_.clear();
   encoded_images_.clear();
@@ -554,6 +1045,18 @@ int32_t OpenH264VideoEncoder::Release() {
   tl0sync_limit_.clear();
   svc_controllers_.clear();
   scalability_modes_.clear();
+  h264_bitstream_parsers_.clear();
+  encoded_buffer_pools_.clear();
+  layer_active_.clear();
+  layer_key_frame_.clear();
+  layer_recovery_.clear();
+  layer_refresh_until_ms_.clear();
+  layer_static_frames_.clear();
+  layer_last_qp_.clear();
+  layer_last_encode_ms_.clear();
+  layer_frames_.clear();
+  layer_infos_.clear();
+  layer_results_.clear();
   return WEBRTC_VIDEO_CODEC_OK;
 }
 
@@ -649,7 +1152,44 @@ int32_t OpenH264VideoEncoder::Encode(
   RTC_DCHECK_EQ(configurations_[0].width, frame_buffer->width());
   RTC_DCHECK_EQ(configurations_[0].height, frame_buffer->height());
 
-  // Encode image for each layer.
+  // Nothing changed since the previous frame. Frames without an update rect
+  // may have changed anywhere.
+  const bool unchanged =
+      input_frame.has_update_rect() && input_frame.update_rect().IsEmpty();
+  const bool desktop = UseDesktopProfile();
+  // Capture time, so that offline encodes behave like real-time ones
+  const int64_t frame_ms = input_frame.timestamp_us() / 1000;
+  const int64_t now_ms = env_.clock().TimeInMilliseconds();
+
+  size_t active_layers = 0;
+  for (size_t i = 0; i < encoders_.size(); ++i) {
+    layer_active_[i] =
+        configurations_[i].sending &&
+        !(frame_types != nullptr && i < frame_types->size() &&
+          (*frame_types)[i] == VideoFrameType::kEmptyFrame);
+    if (layer_active_[i] && desktop && unchanged && !is_keyframe_needed) {
+      const size_t simulcast_idx =
+          static_cast<size_t>(configurations_[i].simulcast_idx);
+      const bool key_frame_requested =
+          frame_types && simulcast_idx < frame_types->size() &&
+          (*frame_types)[simulcast_idx] == VideoFrameType::kVideoFrameKey;
+      const bool settled = layer_static_frames_[i] >= kDesktopRefineFrames ||
+                           (layer_last_qp_[i] >= 0 &&
+                            layer_last_qp_[i] <= kDesktopMinQp);
+      if (!key_frame_requested && settled &&
+          frame_ms - layer_last_encode_ms_[i] < kDesktopMaxStaticSkipMs) {
+        layer_active_[i] = false;
+      }
+    }
+    if (layer_active_[i]) {
+      active_layers++;
+    }
+  }
+
+  // Prepare the input of every layer before any encode starts.
+  // A layer is downscaled from the closest larger picture that is prepared
+  // anyway, so layers that are not encoded this time cost nothing.
+  size_t scale_source = 0;
   for (size_t i = 0; i < encoders_.size(); ++i) {
     // EncodeFrame input.
     pictures_[i] = {0};
@@ -657,7 +1197,6 @@ int32_t OpenH264VideoEncoder::Encode(
     pictures_[i].iPicHeight = configurations_[i].height;
     pictures_[i].iColorFormat = EVideoFormatType::videoFormatI420;
     pictures_[i].uiTimeStamp = input_frame.ntp_time_ms();
-    // Downscale images on second and ongoing layers.
     if (i == 0) {
       pictures_[i].iStride[0] = frame_buffer->StrideY();
       pictures_[i].iStride[1] = frame_buffer->StrideU();
@@ -666,6 +1205,9 @@ int32_t OpenH264VideoEncoder::Encode(
       pictures_[i].pData[1] = const_cast<uint8_t*>(frame_buffer->DataU());
       pictures_[i].pData[2] = const_cast<uint8_t*>(frame_buffer->DataV());
     } else {
+      if (!layer_active_[i]) {
+        continue;
+      }
       pictures_[i].iStride[0] = downscaled_buffers_[i - 1]->StrideY();
       pictures_[i].iStride[1] = downscaled_buffers_[i - 1]->StrideU();
       pictures_[i].iStride[2] = downscaled_buffers_[i - 1]->StrideV();
@@ -675,26 +1217,25 @@ int32_t OpenH264VideoEncoder::Encode(
           const_cast<uint8_t*>(downscaled_buffers_[i - 1]->DataU());
       pictures_[i].pData[2] =
           const_cast<uint8_t*>(downscaled_buffers_[i - 1]->DataV());
-      // Scale the image down a number of times by downsampling factor.
-      libyuv::I420Scale(pictures_[i - 1].pData[0], pictures_[i - 1].iStride[0],
-                        pictures_[i - 1].pData[1], pictures_[i - 1].iStride[1],
-                        pictures_[i - 1].pData[2], pictures_[i - 1].iStride[2],
-                        configurations_[i - 1].width,
-                        configurations_[i - 1].height, pictures_[i].pData[0],
-                        pictures_[i].iStride[0], pictures_[i].pData[1],
-                        pictures_[i].iStride[1], pictures_[i].pData[2],
-                        pictures_[i].iStride[2], configurations_[i].width,
-                        configurations_[i].height, libyuv::kFilterBox);
-    }
-
-    if (!configurations_[i].sending) {
-      continue;
+      const SSourcePicture& src = pictures_[scale_source];
+      libyuv::I420Scale(src.pData[0], src.iStride[0], src.pData[1],
+                        src.iStride[1], src.pData[2], src.iStride[2],
+                        configurations_[scale_source].width,
+                        configurations_[scale_source].height,
+                        pictures_[i].pData[0], pictures_[i].iStride[0],
+                        pictures_[i].pData[1], pictures_[i].iStride[1],
+                        pictures_[i].pData[2], pictures_[i].iStride[2],
+                        configurations_[i].width, configurations_[i].height,
+                        libyuv::kFilterBox);
     }
-    if (frame_types != nullptr && i < frame_types->size()) {
-      // Skip frame?
-      if ((*frame_types)[i] == VideoFrameType::kEmptyFrame) {
-        continue;
-      }
+    if (layer_active_[i]) {
+      scale_source = i;
+    }
+  }
+
+  for (size_t i = 0; i < encoders_.size(); ++i) {
+    if (!layer_active_[i]) {
+      continue;
     }
     // Send a key frame either when this layer is configured to require one
     // or we have explicitly been asked to.
@@ -704,6 +1245,23 @@ int32_t OpenH264VideoEncoder::Encode(
         is_keyframe_needed ||
         (frame_types && simulcast_idx < frame_types->size() &&
          (*frame_types)[simulcast_idx] == VideoFrameType::kVideoFrameKey);
+    layer_recovery_[i] = false;
+    if (send_key_frame && intra_refresh_ && !is_keyframe_needed) {
+      // Requested by the receiver after loss, the layer itself has sent a key
+      // frame already
+      if (now_ms < layer_refresh_until_ms_[i]) {
+        send_key_frame = false;
+      } else {
+        layer_refresh_until_ms_[i] = now_ms + kRecoveryCycleMs;
+        layer_recovery_[i] = true;
+        SBitrateInfo recovery_bitrate;
+        memset(&recovery_bitrate, 0, sizeof(SBitrateInfo));
+        recovery_bitrate.iLayer = SPATIAL_LAYER_ALL;
+        recovery_bitrate.iBitrate = static_cast<int>(
+            configurations_[i].target_bps * kRecoveryBitrateRatio);
+        encoders_[i]->SetOption(ENCODER_OPTION_BITRATE, &recovery_bitrate);
+      }
+    }
     if (send_key_frame) {
       // API doc says ForceIntraFrame(false) does nothing, but calling this
       // function forces a key frame regardless of the `bIDR` argument's value.
@@ -711,45 +1269,68 @@ int32_t OpenH264VideoEncoder::Encode(
       encoders_[i]->ForceIntraFrame(true);
       configurations_[i].key_frame_request = false;
     }
-    // EncodeFrame output.
-    SFrameBSInfo info;
-    memset(&info, 0, sizeof(SFrameBSInfo));
+    layer_key_frame_[i] = send_key_frame;
 
-    std::vector<ScalableVideoController::LayerFrameConfig> layer_frames;
+    layer_frames_[i].clear();
     if (svc_controllers_[i]) {
-      layer_frames = svc_controllers_[i]->NextFrameConfig(send_key_frame);
-      RTC_CHECK_EQ(layer_frames.size(), 1);
+      layer_frames_[i] = svc_controllers_[i]->NextFrameConfig(send_key_frame);
+      RTC_CHECK_EQ(layer_frames_[i].size(), 1);
+    }
+  }
+
+  // Encode! The layers are independent encoders, so with simulcast the frame
+  // takes as long as the slowest layer instead of the sum of all of them.
+  if (layer_pool_ && active_layers > 1) {
+    const std::function<void(size_t)> task = [this, &input_frame](size_t i) {
+      EncodeLayer(i, input_frame);
+    };
+    layer_pool_->Run(encoders_.size(), task);
+  } else {
+    for (size_t i = 0; i < encoders_.size(); ++i) {
+      EncodeLayer(i, input_frame);
+    }
+  }
+
+  for (size_t i = 0; i < encoders_.size(); ++i) {
+    if (!layer_recovery_[i]) {
+      continue;
     }
+    SBitrateInfo target_bitrate;
+    memset(&target_bitrate, 0, sizeof(SBitrateInfo));
+    target_bitrate.iLayer = SPATIAL_LAYER_ALL;
+    target_bitrate.iBitrate = configurations_[i].target_bps;
+    encoders_[i]->SetOption(ENCODER_OPTION_BITRATE, &target_bitrate);
+  }
 
-    // Encode!
-    int enc_ret = encoders_[i]->EncodeFrame(&pictures_[i], &info);
-    if (enc_ret != 0) {
+  // Deliver in layer order
+  for (size_t i = 0; i < encoders_.size(); ++i) {
+    if (!layer_active_[i]) {
+      continue;
+    }
+    if (layer_results_[i] != 0) {
       RTC_LOG(LS_ERROR)
-          << "OpenH264 frame encoding failed, EncodeFrame returned " << enc_ret
-          << ".";
+          << "OpenH264 frame encoding failed, EncodeFrame returned "
+          << layer_results_[i] << ".";
       ReportError();
       return WEBRTC_VIDEO_CODEC_ERROR;
     }
 
-    encoded_images_[i]._encodedWidth = configurations_[i].width;
-    encoded_images_[i]._encodedHeight = configurations_[i].height;
-    encoded_images_[i].SetRtpTimestamp(input_frame.rtp_timestamp());
-    encoded_images_[i].SetColorSpace(input_frame.color_space());
-    encoded_images_[i]._frameType = ConvertToVideoFrameType(info.eFrameType);
-    encoded_images_[i].SetSimulcastIndex(configurations_[i].simulcast_idx);
-
-    // Split encoded image up into fragments. This also updates
-    // `encoded_image_`.
-    RtpFragmentize(&encoded_images_[i], &info);
+    const SFrameBSInfo& info = layer_infos_[i];
+    const bool send_key_frame = layer_key_frame_[i];
+    auto& layer_frames = layer_frames_[i];
 
     // Encoder can skip frames to save bandwidth in which case
     // `encoded_images_[i]._length` == 0.
+    if (encoded_images_[i].size() == 0 && !unchanged) {
+      // The change of a skipped frame has not been shown yet, so the
+      // unchanged frames after it are encoded until one of them comes out
+      layer_static_frames_[i] = 0;
+      layer_last_qp_[i] = -1;
+    }
     if (encoded_images_[i].size() > 0) {
-      // Parse QP.
-      h264_bitstream_parser_.ParseBitstream(encoded_images_[i]);
-      encoded_images_[i].qp_ =
-          h264_bitstream_parser_.GetLastSliceQp().value_or(-1);
-
+      layer_static_frames_[i] = unchanged ? layer_static_frames_[i] + 1 : 0;
+      layer_last_qp_[i] = encoded_images_[i].qp_;
+      layer_last_encode_ms_[i] = frame_ms;
       // Deliver encoded image.
       CodecSpecificInfo codec_specific;
       codec_specific.codecType = kVideoCodecH264;
@@ -806,6 +1387,68 @@ int32_t OpenH264VideoEncoder::Encode(
   return WEBRTC_VIDEO_CODEC_OK;
 }
 
+void OpenH264VideoEncoder::EncodeLayer(size_t i,
+                                       const VideoFrame& input_frame) {
+  if (!layer_active_[i]) {
+    return;
+  }
+  // EncodeFrame output.
+  SFrameBSInfo& info = layer_infos_[i];
+  memset(&info, 0, sizeof(SFrameBSInfo));
+  layer_results_[i] = encoders_[i]->EncodeFrame(&pictures_[i], &info);
+  if (layer_results_[i] != 0) {
+    return;
+  }
+
+  encoded_images_[i]._encodedWidth = configurations_[i].width;
+  encoded_images_[i]._encodedHeight = configurations_[i].height;
+  encoded_images_[i].SetRtpTimestamp(input_frame.rtp_timestamp());
+  encoded_images_[i].SetColorSpace(input_frame.color_space());
+  encoded_images_[i]._frameType = ConvertToVideoFrameType(info.eFrameType);
+  encoded_images_[i].SetSimulcastIndex(configurations_[i].simulcast_idx);
+
+  // Split encoded image up into fragments. This also updates
+  // `encoded_image_`.
+  RtpFragmentize(&encoded_images_[i], &info, encoded_buffer_pools_[i].get());
+
+  if (encoded_images_[i].size() > 0) {
+    // Parse QP.
+    encoded_images_[i].qp_ =
+        ParseLastSliceQp(h264_bitstream_parsers_[i].get(), info).value_or(-1);
+  }
+}
+
+bool OpenH264VideoEncoder::UseDesktopProfile() const {
+  switch (content_profile_) {
+    case sora::OpenH264ContentProfile::kAuto:
+      return codec_.mode == VideoCodecMode::kScreensharing;
+    case sora::OpenH264ContentProfile::kCamera:
+      return false;
+    case sora::OpenH264ContentProfile::kDesktop:
+      return true;
+  }
+  return false;
+}
+
+OpenH264EncoderKey OpenH264VideoEncoder::CreateEncoderKey(size_t i) const {
+  OpenH264EncoderKey key;
+  key.width = configurations_[i].width;
+  key.height = configurations_[i].height;
+  key.max_frame_rate = configurations_[i].max_frame_rate;
+  key.frame_dropping_on = configurations_[i].frame_dropping_on;
+  key.key_frame_interval = configurations_[i].key_frame_interval;
+  key.num_temporal_layers = configurations_[i].num_temporal_layers;
+  key.mode = codec_.mode;
+  key.packetization_mode = packetization_mode_;
+  key.max_payload_size = max_payload_size_;
+  key.number_of_cores = number_of_cores_;
+  key.encoder_thread_limit = encoder_thread_limit_;
+  key.content_profile = content_profile_;
+  key.low_latency = low_latency_;
+  key.intra_refresh = intra_refresh_;
+  return key;
+}
+
 // Initialization parameters.
 // There are two ways to initialize. There is SEncParamBase (cleared with
 // memset(&p, 0, sizeof(SEncParamBase)) used in Initialize, and SEncParamExt
@@ -821,6 +1464,10 @@ SEncParamExt OpenH264VideoEncoder::CreateEncoderParams(size_t i) const {
   } else {
     RTC_DCHECK_NOTREACHED();
   }
+  const bool desktop = UseDesktopProfile();
+  if (content_profile_ == sora::OpenH264ContentProfile::kCamera) {
+    encoder_params.iUsageType = CAMERA_VIDEO_REAL_TIME;
+  }
   encoder_params.iPicWidth = configurations_[i].width;
   encoder_params.iPicHeight = configurations_[i].height;
   encoder_params.iTargetBitrate = configurations_[i].target_bps;
@@ -869,6 +1516,48 @@ SEncParamExt OpenH264VideoEncoder::CreateEncoderParams(size_t i) const {
     // theoretically use all available reference buffers.
     encoder_params.iNumRefFrame = encoder_params.iTemporalLayerNum - 1;
   }
+  if (desktop) {
+    encoder_params.iUsageType = SCREEN_CONTENT_REAL_TIME;
+    encoder_params.bEnableLongTermReference = true;
+    encoder_params.iLTRRefNum = kDesktopLtrRefNum;
+    encoder_params.iLtrMarkPeriod = kDesktopLtrMarkPeriod;
+    // Let OpenH264 size the reference list for the long-term references
+    encoder_params.iNumRefFrame = AUTO_REF_PIC_COUNT;
+    // A window switch or slide change is coded as an I frame right away
+    // instead of spreading the change over several blurry P frames
+    encoder_params.bEnableSceneChangeDetect = true;
+    // Static background is coded as skip blocks
+    encoder_params.bEnableBackgroundDetection = true;
+    // Adaptive quantization raises the QP of high contrast blocks, which is
+    // exactly where text is
+    encoder_params.bEnableAdaptiveQuant = false;
+    encoder_params.iMinQp = kDesktopMinQp;
+    encoder_params.iMaxQp = kDesktopMaxQp;
+    RTC_LOG(LS_INFO) << "OpenH264 desktop content profile";
+  }
+  if (low_latency_) {
+    // OpenH264 never uses B-frames or lookahead, so what is left is to keep
+    // every frame close to the target size and to recover quickly from loss.
+    // Skipping a frame costs less latency than a burst the pacer has to drain.
+    encoder_params.bEnableFrameSkip = true;
+    const int gop = std::max(1, static_cast<int>(encoder_params.fMaxFrameRate *
+                                                 kLowLatencyGopSeconds));
+    if (encoder_params.uiIntraPeriod == 0 ||
+        encoder_params.uiIntraPeriod > static_cast<uint32_t>(gop)) {
+      encoder_params.uiIntraPeriod = gop;
+    }
+    // The desktop profile needs its long-term references
+    if (encoder_params.iTemporalLayerNum <= 1 && !desktop) {
+      encoder_params.iNumRefFrame = 1;
+    }
+    RTC_LOG(LS_INFO) << "OpenH264 low latency: uiIntraPeriod="
+                     << encoder_params.uiIntraPeriod;
+  }
+  if (intra_refresh_) {
+    // Key frames only when the receiver asks for one
+    encoder_params.uiIntraPeriod = 0;
+    RTC_LOG(LS_INFO) << "OpenH264 intra refresh: no periodic key frames";
+  }
   RTC_LOG(LS_INFO) << "OpenH264 version is " << OPENH264_MAJOR << "."
                    << OPENH264_MINOR;
   switch (packetization_mode_) {
@@ -935,9 +1624,21 @@ void OpenH264VideoEncoder::LayerConfig::SetStreamState(bool send_stream) {
 
 namespace sora {
 
+void SetOpenH264InitCallback(OpenH264InitCallback callback) {
+  webrtc::g_init_callback.store(callback);
+}
+
 std::unique_ptr<webrtc::VideoEncoder> CreateOpenH264VideoEncoder(
     const webrtc::SdpVideoFormat& format,
     std::string openh264) {
+  OpenH264VideoEncoderConfig config;
+  config.openh264 = std::move(openh264);
+  return CreateOpenH264VideoEncoder(format, std::move(config));
+}
+
+std::unique_ptr<webrtc::VideoEncoder> CreateOpenH264VideoEncoder(
+    const webrtc::SdpVideoFormat& format,
+    OpenH264VideoEncoderConfig config) {
   webrtc::H264EncoderSettings settings;
   if (auto it = format.parameters.find(webrtc::kH264FmtpPacketizationMode);
       it != format.parameters.end()) {
@@ -951,7 +1652,7 @@ std::unique_ptr<webrtc::VideoEncoder> CreateOpenH264VideoEncoder(
   }
 
   return absl::make_unique<webrtc::OpenH264VideoEncoder>(
-      webrtc::CreateEnvironment(), settings, std::move(openh264));
+      webrtc::CreateEnvironment(), settings, std::move(config));
 }
 
 }  // namespace sora
@@ -10,6 +10,7 @@
 
 #include "sora/scalable_track_source.h"
 
+#include <atomic>
 #include <cstdint>
 #include <optional>
 
@@ -17,6 +18,7 @@
 #include <api/media_stream_interface.h>
 #include <api/scoped_refptr.h>
 #include <api/video/i420_buffer.h>
+#include <api/video/nv12_buffer.h>
 #include <api/video/video_frame.h>
 #include <api/video/video_frame_buffer.h>
 #include <api/video/video_rotation.h>
@@ -28,9 +30,63 @@
 
 namespace sora {
 
+namespace {
+
+std::atomic<ScalableVideoTrackSource::TraceCallback> g_trace_callback{nullptr};
+
+// Frames held downstream (broadcaster, encoder queue) that may each keep a
+// pooled buffer alive. When all of them are in use a buffer is allocated.
+constexpr size_t kMaxPooledBuffers = 8;
+
+webrtc::scoped_refptr<webrtc::I420Buffer> CreateI420(
+    webrtc::VideoFrameBufferPool& pool,
+    int width,
+    int height) {
+  if (auto buffer = pool.CreateI420Buffer(width, height)) {
+    return buffer;
+  }
+  return webrtc::I420Buffer::Create(width, height);
+}
+
+webrtc::scoped_refptr<webrtc::NV12Buffer> CreateNV12(
+    webrtc::VideoFrameBufferPool& pool,
+    int width,
+    int height) {
+  if (auto buffer = pool.CreateNV12Buffer(width, height)) {
+    return buffer;
+  }
+  return webrtc::NV12Buffer::Create(width, height);
+}
+
+// libyuv has no NV12 to NV12 rotation. The interleaved UV plane is rotated as
+// a plane of 16-bit pixels instead, which needs it to be 2-byte aligned.
+bool CanRotateNV12(const webrtc::NV12BufferInterface& src) {
+  return reinterpret_cast<uintptr_t>(src.DataUV()) % 2 == 0 &&
+         src.StrideUV() % 2 == 0;
+}
+
+void RotateNV12(const webrtc::NV12BufferInterface& src,
+                webrtc::NV12Buffer* dst,
+                libyuv::RotationMode mode) {
+  libyuv::RotatePlane(src.DataY(), src.StrideY(), dst->MutableDataY(),
+                      dst->StrideY(), src.width(), src.height(), mode);
+  libyuv::RotatePlane_16(
+      reinterpret_cast<const uint16_t*>(src.DataUV()), src.StrideUV() / 2,
+      reinterpret_cast<uint16_t*>(dst->MutableDataUV()), dst->StrideUV() / 2,
+      src.ChromaWidth(), src.ChromaHeight(), mode);
+}
+
+}  // namespace
+
+void ScalableVideoTrackSource::SetTraceCallback(TraceCallback callback) {
+  g_trace_callback.store(callback);
+}
+
 ScalableVideoTrackSource::ScalableVideoTrackSource(
     ScalableVideoTrackSourceConfig config)
-    : AdaptedVideoTrackSource(4), config_(config) {}
+    : AdaptedVideoTrackSource(4),
+      config_(config),
+      buffer_pool_(false, kMaxPooledBuffers) {}
 ScalableVideoTrackSource::~ScalableVideoTrackSource() {}
 
 bool ScalableVideoTrackSource::is_screencast() const {
@@ -50,9 +106,17 @@ bool ScalableVideoTrackSource::remote() const {
   return false;
 }
 
+void ScalableVideoTrackSource::SetMaxFramerate(int max_framerate) {
+  video_adapter()->OnOutputFormatRequest(
+      std::nullopt, std::nullopt,
+      max_framerate > 0 ? std::optional<int>(max_framerate) : std::nullopt);
+}
+
 bool ScalableVideoTrackSource::OnCapturedFrame(
     const webrtc::VideoFrame& video_frame) {
   webrtc::VideoFrame frame = video_frame;
+  const TraceCallback trace = g_trace_callback.load(std::memory_order_relaxed);
+  const int64_t received_us = trace ? webrtc::TimeMicros() : 0;
 
   const int64_t timestamp_us = frame.timestamp_us();
   const int64_t translated_timestamp_us =
@@ -82,18 +146,33 @@ bool ScalableVideoTrackSource::OnCapturedFrame(
         break;
     }
 
-    webrtc::scoped_refptr<webrtc::I420Buffer> rotated =
-        webrtc::I420Buffer::Create(width, height);
-    webrtc::scoped_refptr<webrtc::I420BufferInterface> src =
-        frame.video_frame_buffer()->ToI420();
-    libyuv::I420Rotate(src->DataY(), src->StrideY(), src->DataU(),
-                       src->StrideU(), src->DataV(), src->StrideV(),
-                       rotated->MutableDataY(), rotated->StrideY(),
-                       rotated->MutableDataU(), rotated->StrideU(),
-                       rotated->MutableDataV(), rotated->StrideV(),
-                       frame.width(), frame.height(), mode);
+    webrtc::scoped_refptr<webrtc::VideoFrameBuffer> src =
+        frame.video_frame_buffer();
+    webrtc::scoped_refptr<webrtc::VideoFrameBuffer> rotated;
+    if (src->type() == webrtc::VideoFrameBuffer::Type::kNV12 &&
+        CanRotateNV12(*src->GetNV12())) {
+      webrtc::scoped_refptr<webrtc::NV12Buffer> nv12 =
+          CreateNV12(buffer_pool_, width, height);
+      RotateNV12(*src->GetNV12(), nv12.get(), mode);
+      rotated = nv12;
+    } else {
+      webrtc::scoped_refptr<webrtc::I420Buffer> i420 =
+          CreateI420(buffer_pool_, width, height);
+      webrtc::scoped_refptr<webrtc::I420BufferInterface> src_i420 =
+          src->ToI420();
+      libyuv::I420Rotate(src_i420->DataY(), src_i420->StrideY(),
+                         src_i420->DataU(), src_i420->StrideU(),
+                         src_i420->DataV(), src_i420->StrideV(),
+                         i420->MutableDataY(), i420->StrideY(),
+                         i420->MutableDataU(), i420->StrideU(),
+                         i420->MutableDataV(), i420->StrideV(), frame.width(),
+                         frame.height(), mode);
+      rotated = i420;
+    }
     frame.set_video_frame_buffer(rotated);
     frame.set_rotation(webrtc::kVideoRotation_0);
+    // The changed area of the capturer is not rotated along
+    frame.clear_update_rect();
   }
 
   int adapted_width;
@@ -114,26 +193,56 @@ bool ScalableVideoTrackSource::OnCapturedFrame(
 
   if (frame.video_frame_buffer()->type() ==
       webrtc::VideoFrameBuffer::Type::kNative) {
+    if (trace) {
+      trace(frame.timestamp_us(), received_us, webrtc::TimeMicros(),
+            frame.width(), frame.height());
+    }
     OnFrame(frame);
     return true;
   }
 
   webrtc::scoped_refptr<webrtc::VideoFrameBuffer> buffer =
       frame.video_frame_buffer();
+  // Changed area reported by the capturer, kept so that encoders can spend
+  // the bits there
+  std::optional<webrtc::VideoFrame::UpdateRect> update_rect;
+  if (frame.has_update_rect()) {
+    update_rect = frame.update_rect();
+  }
 
   if (adapted_width != frame.width() || adapted_height != frame.height()) {
-    // Video adapter has requested a down-scale. Allocate a new buffer and
-    // return scaled version.
-    webrtc::scoped_refptr<webrtc::I420Buffer> i420_buffer =
-        webrtc::I420Buffer::Create(adapted_width, adapted_height);
-    i420_buffer->ScaleFrom(*buffer->ToI420());
-    buffer = i420_buffer;
+    // Video adapter has requested a down-scale. NV12 is scaled as NV12,
+    // everything else through I420.
+    webrtc::scoped_refptr<webrtc::VideoFrameBuffer> scaled;
+    if (buffer->type() == webrtc::VideoFrameBuffer::Type::kNV12) {
+      webrtc::scoped_refptr<webrtc::NV12Buffer> nv12 =
+          CreateNV12(buffer_pool_, adapted_width, adapted_height);
+      nv12->CropAndScaleFrom(*buffer->GetNV12(), 0, 0, buffer->width(),
+                             buffer->height());
+      scaled = nv12;
+    } else {
+      webrtc::scoped_refptr<webrtc::I420Buffer> i420 =
+          CreateI420(buffer_pool_, adapted_width, adapted_height);
+      i420->ScaleFrom(*buffer->ToI420());
+      scaled = i420;
+    }
+    if (update_rect) {
+      update_rect = update_rect->ScaleWithFrame(
+          frame.width(), frame.height(), 0, 0, frame.width(), frame.height(),
+          adapted_width, adapted_height);
+    }
+    buffer = scaled;
   }
 
+  if (trace) {
+    trace(translated_timestamp_us, received_us, webrtc::TimeMicros(),
+          buffer->width(), buffer->height());
+  }
   OnFrame(webrtc::VideoFrame::Builder()
               .set_video_frame_buffer(buffer)
               .set_rotation(frame.rotation())
               .set_timestamp_us(translated_timestamp_us)
+              .set_update_rect(update_rect)
               .build());
 
   return true;
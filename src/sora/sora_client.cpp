@@ -8,6 +8,10 @@
 #include <boost/beast/websocket/stream.hpp>
 #include <boost/json.hpp>
 
+// WebRTC
+#include <rtc_base/time_utils.h>
+
+#include "metrics/metrics_registry.h"
 #include "momo_version.h"
 #include "ssl_verifier.h"
 #include "url_parts.h"
@@ -64,7 +68,12 @@ SoraClient::SoraClient(boost::asio::io_context& ioc,
       manager_(manager),
       retry_count_(0),
       config_(std::move(config)),
-      watchdog_(ioc, std::bind(&SoraClient::OnWatchdogExpired, this)) {
+      watchdog_(ioc, std::bind(&SoraClient::OnWatchdogExpired, this)),
+      // Sora makes the offers, Momo cannot restart ICE itself. Recovery waits
+      // for ICE to come back over the new network with continual gathering.
+      ice_recovery_(ioc,
+                    []() { return false; },
+                    std::bind(&SoraClient::OnIceRecoveryFailed, this)) {
   Reset();
 }
 
@@ -121,6 +130,7 @@ void SoraClient::Close(std::function<void()> on_close) {
 
 void SoraClient::Reset() {
   watchdog_.Disable();
+  ice_recovery_.Reset();
   connection_ = nullptr;
 
   connecting_wss_.clear();
@@ -132,6 +142,7 @@ void SoraClient::Connect() {
   RTC_LOG(LS_INFO) << __FUNCTION__;
 
   watchdog_.Enable(30);
+  connect_ms_ = webrtc::TimeMillis();
 
   ws_.reset();
   connecting_wss_.clear();
@@ -172,6 +183,17 @@ void SoraClient::ReconnectAfter() {
   retry_count_++;
 }
 
+void SoraClient::OnIceRecoveryFailed() {
+  // The recovery already waited for the connection, the first reconnect does
+  // not wait again
+  if (retry_count_ == 0) {
+    retry_count_++;
+    OnWatchdogExpired();
+  } else {
+    ReconnectAfter();
+  }
+}
+
 void SoraClient::OnWatchdogExpired() {
   RTC_LOG(LS_INFO) << __FUNCTION__ << " closing...";
   Close([this]() {
@@ -389,6 +411,10 @@ std::shared_ptr<RTCConnection> SoraClient::CreateRTCConnection(
   }
 
   rtc_config.servers = ice_servers;
+  // Candidates of a network that comes up later (Wi-Fi handover) are
+  // gathered too, so that the connection can move to it
+  rtc_config.continual_gathering_policy =
+      webrtc::PeerConnectionInterface::GATHER_CONTINUALLY;
 
   // macOS Simulcast: Somehow the resolution falls infinitely, so disable cpu_adaptation to avoid it
 #if defined(__APPLE__)
@@ -726,8 +752,16 @@ void SoraClient::OnIceConnectionStateChange(
 void SoraClient::OnIceCandidate(const std::string sdp_mid,
                                 const int sdp_mlineindex,
                                 const std::string sdp) {
-  boost::json::value json_message = {{"type", "candidate"}, {"candidate", sdp}};
-  ws_->WriteText(boost::json::serialize(json_message));
+  // With continual gathering candidates keep coming after the WebSocket may
+  // have been closed for the DataChannel signaling
+  boost::asio::post(ioc_, [self = shared_from_this(), sdp]() {
+    if (!self->ws_) {
+      return;
+    }
+    boost::json::value json_message = {{"type", "candidate"},
+                                       {"candidate", sdp}};
+    self->ws_->WriteText(boost::json::serialize(json_message));
+  });
 }
 
 void SoraClient::DoIceConnectionStateChange(
@@ -735,15 +769,20 @@ void SoraClient::DoIceConnectionStateChange(
   RTC_LOG(LS_INFO) << __FUNCTION__ << ": newState="
                    << Util::IceConnectionStateToString(new_state);
 
+  // Disconnected and failed connections are reconnected by ice_recovery_
+  // when they do not come back
+  ice_recovery_.OnIceConnectionStateChange(new_state);
   switch (new_state) {
     case webrtc::PeerConnectionInterface::IceConnectionState::
         kIceConnectionConnected:
       retry_count_ = 0;
       watchdog_.Enable(60);
-      break;
-    case webrtc::PeerConnectionInterface::IceConnectionState::
-        kIceConnectionFailed:
-      ReconnectAfter();
+      if (connect_ms_ != 0) {
+        MetricsRegistry::Instance().Set(
+            "session_start", "ice_connected_ms",
+            static_cast<double>(webrtc::TimeMillis() - connect_ms_));
+        connect_ms_ = 0;
+      }
       break;
     default:
       break;
@@ -15,6 +15,7 @@
 #include <boost/json.hpp>
 
 #include "metrics/stats_collector.h"
+#include "rtc/ice_recovery.h"
 #include "rtc/rtc_manager.h"
 #include "rtc/rtc_message_sender.h"
 #include "sora_data_channel_on_asio.h"
@@ -84,6 +85,7 @@ class SoraClient : public std::enable_shared_from_this<SoraClient>,
  private:
   void ReconnectAfter();
   void OnWatchdogExpired();
+  void OnIceRecoveryFailed();
   bool ParseURL(const std::string& url, URLParts& parts, bool& ssl) const;
 
  private:
@@ -154,6 +156,9 @@ class SoraClient : public std::enable_shared_from_this<SoraClient>,
   webrtc::PeerConnectionInterface::IceConnectionState rtc_state_;
 
   WatchDog watchdog_;
+  IceRecovery ice_recovery_;
+  // Time of Connect(), for the "session_start" metrics
+  int64_t connect_ms_ = 0;
 };
 
 #endif  // SORA_CLIENT_H_
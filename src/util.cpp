@@ -165,6 +165,8 @@ const std::vector<ConfigOptionSpec>& GetConfigOptionSpecs() {
         {"general", "window_height", "--window-height",
          ConfigOptionType::Value},
         {"general", "fullscreen", "--fullscreen", ConfigOptionType::Flag},
+        {"general", "audio_target_latency", "--audio-target-latency",
+         ConfigOptionType::Value},
         {"general", "insecure", "--insecure", ConfigOptionType::Flag},
         {"general", "low_latency", "--low-latency", ConfigOptionType::Flag},
         {"general", "log_level", "--log-level", ConfigOptionType::Value},
@@ -201,11 +203,23 @@ const std::vector<ConfigOptionSpec>& GetConfigOptionSpecs() {
         {"general", "h265_decoder", "--h265-decoder",
          ConfigOptionType::Value},
         {"general", "openh264", "--openh264", ConfigOptionType::Value},
+        {"general", "video_content_profile", "--video-content-profile",
+         ConfigOptionType::Value},
+        {"general", "intra_refresh", "--intra-refresh", ConfigOptionType::Flag},
+        {"general", "network_adaptation", "--network-adaptation",
+         ConfigOptionType::Flag},
+        {"general", "warm_connection", "--warm-connection",
+         ConfigOptionType::Flag},
         {"general", "serial", "--serial", ConfigOptionType::Serial},
+        {"general", "serial_raw", "--serial-raw", ConfigOptionType::Flag},
+        {"general", "serial_batch_ms", "--serial-batch-ms",
+         ConfigOptionType::Value},
+        {"general", "bulk_dir", "--bulk-dir", ConfigOptionType::Value},
         {"general", "metrics_port", "--metrics-port",
          ConfigOptionType::Value},
         {"general", "metrics_allow_external_ip",
          "--metrics-allow-external-ip", ConfigOptionType::Flag},
+        {"general", "frame_trace", "--frame-trace", ConfigOptionType::Flag},
         {"general", "client_cert", "--client-cert", ConfigOptionType::Value},
         {"general", "client_key", "--client-key", ConfigOptionType::Value},
         {"general", "proxy_url", "--proxy-url", ConfigOptionType::Value},
@@ -529,12 +543,17 @@ void Util::ParseArgs(int argc,
       ->check(CLI::Range(180, 16384));
   app.add_flag("--fullscreen", args.fullscreen,
                "Use fullscreen window for videos (if SDL is available)");
+  app.add_option("--audio-target-latency", args.audio_target_latency,
+                 "Target latency in milliseconds of the received audio "
+                 "(if SDL is available, default: 80)")
+      ->check(CLI::Range(10, 1000));
   app.add_flag("--version", version, "Show version information");
   app.add_flag("--insecure", args.insecure,
                "Allow insecure server connections when using SSL");
   app.add_flag("--low-latency", args.low_latency,
-               "Enable low-latency rendering and pipeline tweaks (SDL vsync "
-               "off, minimal render delay)");
+               "Enable the low-latency profile (zero playout delay, SDL vsync "
+               "off and render on arrival, 40ms audio target, OpenH264 frame "
+               "skipping and short GOP)");
   auto log_level_map = std::vector<std::pair<std::string, int>>(
       {{"verbose", 0}, {"info", 1}, {"warning", 2}, {"error", 3}, {"none", 4}});
   app.add_option("--log-level", log_level, "Log severity level threshold")
@@ -599,6 +618,21 @@ void Util::ParseArgs(int argc,
 
   app.add_option("--openh264", args.openh264, "OpenH264 dynamic library path")
       ->check(CLI::ExistingFile);
+  app.add_option("--video-content-profile", args.video_content_profile,
+                 "Encoder tuning for the video content (auto: desktop when "
+                 "capturing the screen, default: auto)")
+      ->check(CLI::IsMember({"auto", "camera", "desktop"}));
+  app.add_flag("--intra-refresh", args.intra_refresh,
+               "Replace periodic key frames with intra refresh (NVENC "
+               "H.264/H.265) and send smaller key frames after packet loss "
+               "(OpenH264)");
+  app.add_flag("--network-adaptation", args.network_adaptation,
+               "Lower the frame rate first, then the resolution, when RTT, "
+               "packet loss or encode time show the link or the encoder "
+               "cannot keep up");
+  app.add_flag("--warm-connection", args.warm_connection,
+               "Create the connection of the next session ahead, with its ICE "
+               "candidates gathered, to start sessions faster");
 
   auto is_serial_setting_format = CLI::Validator(
       [](std::string input) -> std::string {
@@ -621,12 +655,26 @@ void Util::ParseArgs(int argc,
                  "Serial port settings for datachannel passthrough "
                  "[DEVICE],[BAUDRATE]")
       ->check(is_serial_setting_format);
+  app.add_flag("--serial-raw", args.serial_raw,
+               "Send the serial data as it comes instead of one message per "
+               "line");
+  app.add_option("--serial-batch-ms", args.serial_batch_ms,
+                 "Send the serial lines that come within this time as one "
+                 "message, joined by newlines (default: 0, one message per "
+                 "line)")
+      ->check(CLI::Range(0, 1000));
+  app.add_option("--bulk-dir", args.bulk_dir,
+                 "Directory where files sent by the other side are saved "
+                 "(default: none, files are refused)");
 
   app.add_option("--metrics-port", args.metrics_port,
                  "Metrics server port number (default: -1)")
       ->check(CLI::Range(-1, 65535));
   app.add_flag("--metrics-allow-external-ip", args.metrics_allow_external_ip,
                "Allow access to Metrics server from external IP");
+  app.add_flag("--frame-trace", args.frame_trace,
+               "Record per-frame capture, encode and packetization times, "
+               "served as Chrome trace JSON at /trace of the Metrics server");
 
   app.add_option("--client-cert", args.client_cert,
                  "Cert file path for client certification (PEM format)")
@@ -985,6 +1033,10 @@ string_view Util::MimeType(string_view path) {
     return "text/plain";
   if (iequals(ext, ".js"))
     return "application/javascript";
+  if (iequals(ext, ".mjs"))
+    return "application/javascript";
+  if (iequals(ext, ".wasm"))
+    return "application/wasm";
   if (iequals(ext, ".json"))
     return "application/json";
   if (iequals(ext, ".xml"))
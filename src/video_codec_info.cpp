@@ -0,0 +1,221 @@
+#include "video_codec_info.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <ctime>
+#include <fstream>
+#include <iterator>
+#include <sstream>
+
+#if defined(__linux__)
+#include <sys/utsname.h>
+#endif
+
+// Boost
+#include <boost/filesystem/operations.hpp>
+#include <boost/filesystem/path.hpp>
+#include <boost/json.hpp>
+
+// WebRTC
+#include <rtc_base/logging.h>
+
+#include "metrics/metrics_registry.h"
+#include "momo_version.h"
+
+namespace {
+
+// A driver update that the key does not notice is picked up after this long
+constexpr std::time_t kMaxCacheAgeSeconds = 7 * 24 * 60 * 60;
+
+const std::pair<const char*, std::vector<VideoCodecInfo::Type>
+                                 VideoCodecInfo::*>
+    kCodecLists[] = {
+        {"vp8_encoders", &VideoCodecInfo::vp8_encoders},
+        {"vp8_decoders", &VideoCodecInfo::vp8_decoders},
+        {"vp9_encoders", &VideoCodecInfo::vp9_encoders},
+        {"vp9_decoders", &VideoCodecInfo::vp9_decoders},
+        {"av1_encoders", &VideoCodecInfo::av1_encoders},
+        {"av1_decoders", &VideoCodecInfo::av1_decoders},
+        {"h264_encoders", &VideoCodecInfo::h264_encoders},
+        {"h264_decoders", &VideoCodecInfo::h264_decoders},
+        {"h265_encoders", &VideoCodecInfo::h265_encoders},
+        {"h265_decoders", &VideoCodecInfo::h265_decoders},
+};
+
+const VideoCodecInfo::Type kTypes[] = {
+    VideoCodecInfo::Type::Jetson, VideoCodecInfo::Type::NVIDIA,
+    VideoCodecInfo::Type::Intel,  VideoCodecInfo::Type::VideoToolbox,
+    VideoCodecInfo::Type::V4L2,   VideoCodecInfo::Type::Software,
+};
+
+std::string ReadFile(const std::string& file) {
+  std::ifstream ifs(file, std::ios::binary);
+  if (!ifs) {
+    return "";
+  }
+  return std::string(std::istreambuf_iterator<char>(ifs),
+                     std::istreambuf_iterator<char>());
+}
+
+// Changes with Momo and with the drivers and devices the probes look at
+std::string CacheKey() {
+  std::stringstream ss;
+  ss << MomoVersion::GetClientName() << "\n"
+     << MomoVersion::GetLibwebrtcName() << "\n";
+#if defined(__linux__)
+  utsname name;
+  if (uname(&name) == 0) {
+    // The kernel comes with the Intel and V4L2 drivers
+    ss << name.release << "\n";
+  }
+  ss << ReadFile("/proc/driver/nvidia/version");
+  boost::system::error_code ec;
+  std::vector<std::string> devices;
+  for (boost::filesystem::directory_iterator it("/sys/class/drm", ec), end;
+       !ec && it != end; it.increment(ec)) {
+    const std::string name = it->path().filename().string();
+    if (name.rfind("renderD", 0) != 0) {
+      continue;
+    }
+    const std::string device = (it->path() / "device").string();
+    devices.push_back(name + " " + ReadFile(device + "/vendor") + " " +
+                      ReadFile(device + "/device"));
+  }
+  std::sort(devices.begin(), devices.end());
+  for (const auto& device : devices) {
+    ss << device;
+  }
+#endif
+  return ss.str();
+}
+
+bool ReadCache(const std::string& file,
+               const std::string& key,
+               VideoCodecInfo* info) {
+  const std::string data = ReadFile(file);
+  if (data.empty()) {
+    return false;
+  }
+  boost::system::error_code ec;
+  boost::json::value cache = boost::json::parse(data, ec);
+  if (ec || !cache.is_object()) {
+    return false;
+  }
+  const auto& obj = cache.as_object();
+  const boost::json::value* cached_key = obj.if_contains("key");
+  const boost::json::value* created = obj.if_contains("created");
+  const boost::json::value* codecs = obj.if_contains("codecs");
+  if (cached_key == nullptr || !cached_key->is_string() ||
+      cached_key->as_string() != key || created == nullptr ||
+      !created->is_int64() || codecs == nullptr || !codecs->is_object()) {
+    return false;
+  }
+  const std::time_t age = std::time(nullptr) - created->as_int64();
+  if (age < 0 || age > kMaxCacheAgeSeconds) {
+    return false;
+  }
+
+  VideoCodecInfo cached;
+  for (const auto& list : kCodecLists) {
+    const boost::json::value* names =
+        codecs->as_object().if_contains(list.first);
+    if (names == nullptr || !names->is_array()) {
+      return false;
+    }
+    for (const auto& name : names->as_array()) {
+      if (!name.is_string()) {
+        return false;
+      }
+      bool found = false;
+      for (auto type : kTypes) {
+        if (name.as_string() == VideoCodecInfo::TypeToString(type).second) {
+          (cached.*list.second).push_back(type);
+          found = true;
+          break;
+        }
+      }
+      if (!found) {
+        return false;
+      }
+    }
+  }
+  *info = std::move(cached);
+  return true;
+}
+
+void WriteCache(const std::string& file,
+                const std::string& key,
+                const VideoCodecInfo& info) {
+  boost::json::object codecs;
+  for (const auto& list : kCodecLists) {
+    boost::json::array names;
+    for (auto type : info.*list.second) {
+      names.push_back(
+          boost::json::string(VideoCodecInfo::TypeToString(type).second));
+    }
+    codecs[list.first] = std::move(names);
+  }
+  boost::json::object cache = {
+      {"key", key},
+      {"created", static_cast<int64_t>(std::time(nullptr))},
+      {"codecs", std::move(codecs)},
+  };
+
+  // Another Momo starting at the same time reads either file, never half of
+  // one
+  const std::string tmp = file + ".tmp";
+  {
+    std::ofstream ofs(tmp, std::ios::binary | std::ios::trunc);
+    ofs << boost::json::serialize(cache);
+    if (!ofs) {
+      RTC_LOG(LS_WARNING) << "Failed to write " << tmp;
+      return;
+    }
+  }
+  boost::system::error_code ec;
+  boost::filesystem::rename(tmp, file, ec);
+  if (ec) {
+    RTC_LOG(LS_WARNING) << "Failed to write " << file << ": " << ec.message();
+    boost::filesystem::remove(tmp, ec);
+  }
+}
+
+}  // namespace
+
+const VideoCodecInfo& VideoCodecInfo::Get() {
+  // Called by the option parser, RTCManager and the codec factories
+  static const VideoCodecInfo info = Load();
+  return info;
+}
+
+VideoCodecInfo VideoCodecInfo::Load() {
+  const auto start = std::chrono::steady_clock::now();
+  const char* cache_file = std::getenv("MOMO_VIDEO_CODEC_CACHE");
+  const bool use_cache = cache_file != nullptr && *cache_file != '\0';
+
+  VideoCodecInfo info;
+  bool from_cache = false;
+  std::string key;
+  if (use_cache) {
+    key = CacheKey();
+    from_cache = ReadCache(cache_file, key, &info);
+  }
+  if (!from_cache) {
+    info = Probe();
+    if (use_cache) {
+      WriteCache(cache_file, key, info);
+    }
+  }
+
+  const double elapsed_ms =
+      std::chrono::duration<double, std::milli>(
+          std::chrono::steady_clock::now() - start)
+          .count();
+  RTC_LOG(LS_INFO) << "Video codecs " << (from_cache ? "read" : "probed")
+                   << " in " << elapsed_ms << " ms";
+  auto& metrics = MetricsRegistry::Instance();
+  metrics.Set("codec_probe", "probe_ms", elapsed_ms);
+  metrics.Set("codec_probe", "from_cache", from_cache ? 1 : 0);
+  return info;
+}
@@ -57,9 +57,8 @@ struct VideoCodecInfo {
       // Use the first one
       return codecs[0];
     }
-    auto it = std::find(codecs.begin(), codecs.end(), specified);
-    if (it != codecs.end()) {
-      return *it;
+    if (Has(codecs, specified)) {
+      return specified;
     }
     return Type::NotSupported;
   }
@@ -94,7 +93,20 @@ struct VideoCodecInfo {
     }
   }
 
-  static VideoCodecInfo Get() {
+  static bool Has(const std::vector<Type>& types, Type type) {
+    return std::find(types.begin(), types.end(), type) != types.end();
+  }
+
+  // The encoders and decoders of this machine. The hardware is probed once
+  // per process, which opens the devices. With MOMO_VIDEO_CODEC_CACHE set to
+  // a file, the result is also kept there for the next start, as long as
+  // Momo, the drivers and the devices stay the same.
+  static const VideoCodecInfo& Get();
+
+ private:
+  static VideoCodecInfo Load();
+
+  static VideoCodecInfo Probe() {
 #if defined(_WIN32)
     return GetWindows();
 #elif defined(__APPLE__)
@@ -104,7 +116,6 @@ struct VideoCodecInfo {
 #endif
   }
 
- private:
 #if defined(_WIN32)
 
   static VideoCodecInfo GetWindows() {
@@ -36,6 +36,31 @@ class ZlibHelper {
     return output;
   }
 
+  // gzip format (RFC 1952) for HTTP Content-Encoding, Compress() writes the
+  // zlib format
+  static std::string Gzip(const std::string& input,
+                          int level = Z_BEST_COMPRESSION) {
+    z_stream stream = {};
+    // 15 bits window + 16 for the gzip header and trailer
+    if (deflateInit2(&stream, level, Z_DEFLATED, 15 + 16, 8,
+                     Z_DEFAULT_STRATEGY) != Z_OK) {
+      throw std::exception();
+    }
+    std::string output;
+    output.resize(deflateBound(&stream, input.size()));
+    stream.next_in = (Bytef*)input.data();
+    stream.avail_in = input.size();
+    stream.next_out = (Bytef*)output.data();
+    stream.avail_out = output.size();
+    int ret = deflate(&stream, Z_FINISH);
+    deflateEnd(&stream);
+    if (ret != Z_STREAM_END) {
+      throw std::exception();
+    }
+    output.resize(stream.total_out);
+    return output;
+  }
+
   static std::string Uncompress(const std::string& input) {
     return Uncompress((const uint8_t*)input.data(), input.size());
   }
@@ -49,8 +49,10 @@ class Momo:
         window_width: int | None = None,  # 180-16384
         window_height: int | None = None,  # 180-16384
         fullscreen: bool = False,
+        audio_target_latency: int | None = None,  # 10-1000
         version: bool = False,
         insecure: bool = False,
+        low_latency: bool = False,
         log_level: Literal["verbose", "info", "warning", "error", "none"] | None = None,
         screen_capture: bool = False,
         disable_echo_cancellation: bool = False,
@@ -69,11 +71,19 @@ class Momo:
         h264_decoder: Literal["default", "vpl", "nvidia", "videotoolbox"] | None = None,
         h265_encoder: Literal["default", "vpl", "nvidia", "videotoolbox"] | None = None,
         h265_decoder: Literal["default", "vpl", "nvidia", "videotoolbox"] | None = None,
+        video_content_profile: Literal["auto", "camera", "desktop"] | None = None,
+        intra_refresh: bool = False,
+        network_adaptation: bool = False,
+        warm_connection: bool = False,
         openh264: str | None = None,  # File path (automatically obtained from the OPENH264_PATH environment variable).
         # Other common settings.
         serial: str | None = None,  # [DEVICE],[BAUDRATE]
+        serial_raw: bool = False,
+        serial_batch_ms: int | None = None,
+        bulk_dir: str | None = None,
         metrics_port: int = 9090,
         metrics_allow_external_ip: bool = False,
+        frame_trace: bool = False,
         client_cert: str | None = None,  # PEM file path
         client_key: str | None = None,  # PEM file path
         proxy_url: str | None = None,
@@ -166,8 +176,10 @@ class Momo:
             "window_width": window_width,
             "window_height": window_height,
             "fullscreen": fullscreen,
+            "audio_target_latency": audio_target_latency,
             "version": version,
             "insecure": insecure,
+            "low_latency": low_latency,
             "log_level": log_level,
             "screen_capture": screen_capture,
             "disable_echo_cancellation": disable_echo_cancellation,
@@ -185,10 +197,18 @@ class Momo:
             "h264_decoder": h264_decoder,
             "h265_encoder": h265_encoder,
             "h265_decoder": h265_decoder,
+            "video_content_profile": video_content_profile,
+            "intra_refresh": intra_refresh,
+            "network_adaptation": network_adaptation,
+            "warm_connection": warm_connection,
             "openh264": openh264,
             "serial": serial,
+            "serial_raw": serial_raw,
+            "serial_batch_ms": serial_batch_ms,
+            "bulk_dir": bulk_dir,
             "metrics_port": metrics_port,
             "metrics_allow_external_ip": metrics_allow_external_ip,
+            "frame_trace": frame_trace,
             "client_cert": client_cert,
             "client_key": client_key,
             "proxy_url": proxy_url,
@@ -418,12 +438,16 @@ class Momo:
             args.extend(["--window-height", str(kwargs["window_height"])])
         if kwargs.get("fullscreen"):
             args.append("--fullscreen")
+        if kwargs.get("audio_target_latency") is not None:
+            args.extend(["--audio-target-latency", str(kwargs["audio_target_latency"])])
 
         # Other basic settings
         if kwargs.get("version"):
             args.append("--version")
         if kwargs.get("insecure"):
             args.append("--insecure")
+        if kwargs.get("low_latency"):
+            args.append("--low-latency")
         if kwargs.get("log_level"):
             args.extend(["--log-level", kwargs["log_level"]])
         if kwargs.get("screen_capture"):
@@ -462,16 +486,32 @@ class Momo:
             args.extend(["--h265-encoder", kwargs["h265_encoder"]])
         if kwargs.get("h265_decoder"):
             args.extend(["--h265-decoder", kwargs["h265_decoder"]])
+        if kwargs.get("video_content_profile"):
+            args.extend(["--video-content-profile", kwargs["video_content_profile"]])
+        if kwargs.get("intra_refresh"):
+            args.append("--intra-refresh")
+        if kwargs.get("network_adaptation"):
+            args.append("--network-adaptation")
+        if kwargs.get("warm_connection"):
+            args.append("--warm-connection")
         if kwargs.get("openh264"):
             args.extend(["--openh264", kwargs["openh264"]])
 
         # Other common settings
         if kwargs.get("serial"):
             args.extend(["--serial", kwargs["serial"]])
+        if kwargs.get("serial_raw"):
+            args.append("--serial-raw")
+        if kwargs.get("serial_batch_ms") is not None:
+            args.extend(["--serial-batch-ms", str(kwargs["serial_batch_ms"])])
+        if kwargs.get("bulk_dir"):
+            args.extend(["--bulk-dir", kwargs["bulk_dir"]])
         if kwargs.get("metrics_port") is not None and kwargs["metrics_port"] != -1:
             args.extend(["--metrics-port", str(kwargs["metrics_port"])])
         if kwargs.get("metrics_allow_external_ip"):
             args.append("--metrics-allow-external-ip")
+        if kwargs.get("frame_trace"):
+            args.append("--frame-trace")
         if kwargs.get("client_cert"):
             args.extend(["--client-cert", kwargs["client_cert"]])
         if kwargs.get("client_key"):
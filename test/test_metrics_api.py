@@ -1,5 +1,7 @@
 """E2E test for the metrics API."""
 
+import json
+
 from momo import Momo, MomoMode
 
 
@@ -20,6 +22,7 @@ def test_metrics_response_structure(free_port, port_allocator):
         assert "version" in data
         assert "libwebrtc" in data
         assert "environment" in data
+        assert "momo" in data
         assert "stats" in data
 
         # Check that the version information is a string.
@@ -27,10 +30,50 @@ def test_metrics_response_structure(free_port, port_allocator):
         assert isinstance(data["libwebrtc"], str)
         assert isinstance(data["environment"], str)
 
+        # Momo's own component metrics are grouped by component name.
+        assert isinstance(data["momo"], dict)
+
         # Check that the stats field exists (it may be an empty array in the initial state).
         assert data["stats"] is not None
 
 
+def test_prometheus_endpoint(free_port, port_allocator):
+    """Confirm the Prometheus text exposition endpoint."""
+    with Momo(
+        mode=MomoMode.P2P,
+        metrics_port=free_port,
+        port=next(port_allocator),
+        fake_capture_device=True,
+    ) as m:
+        response = m._http_client.get(
+            f"http://localhost:{m.metrics_port}/metrics/prometheus"
+        )
+        assert response.status_code == 200
+        assert response.headers["content-type"].startswith("text/plain")
+        assert "momo_info{" in response.text
+        assert "momo_rtc_connected" in response.text
+
+
+def test_stream_endpoint(free_port, port_allocator):
+    """Confirm that /metrics/stream starts with a snapshot event."""
+    with Momo(
+        mode=MomoMode.P2P,
+        metrics_port=free_port,
+        port=next(port_allocator),
+        fake_capture_device=True,
+    ) as m:
+        with m._http_client.stream(
+            "GET", f"http://localhost:{m.metrics_port}/metrics/stream?interval=1"
+        ) as response:
+            assert response.status_code == 200
+            assert response.headers["content-type"].startswith("text/event-stream")
+            lines = response.iter_lines()
+            assert next(lines) == "event: snapshot"
+            data = json.loads(next(lines).removeprefix("data: "))
+            assert "timestamp" in data
+            assert isinstance(data["stats"], dict)
+
+
 def test_invalid_endpoint_returns_404(free_port, port_allocator):
     """Confirm that a non-existent endpoint returns 404."""
     with Momo(